@@ -15,13 +15,29 @@ INCLUDE_DIR = -I .
 # Do not change the include dir name
 MK_CFLAGS = -g -Wall -Werror
 
-gvd = gvd_cli_cfg_sys.c \
+gvd = gvd_bench.c \
+      gvd_cli_cfg_sys.c \
+      gvd_cli_file.c \
+      gvd_cli_filter.c \
+      gvd_cli_file_tree.c \
       gvd_cli_parser.c \
       gvd_cli_tree.c \
       gvd_cli_tty.c \
+      gvd_cli_tty_headless.c \
+      gvd_cli_tty_vt100.c \
+      gvd_cmd_buf.c \
+      gvd_cmd_history.c \
       gvd_common.c \
+      gvd_event.c \
+      gvd_file_view.c \
+      gvd_key_map.c \
       gvd_line_buffer.c \
+      gvd_line_spill.c \
+      gvd_log_writer.c \
       gvd_main.c \
+      gvd_notify.c \
+      gvd_replay.c \
+      gvd_session_rec.c \
       gvd_tty.c \
       gvd_util.c \
       gvd_cli_example.c \
@@ -29,4 +45,4 @@ gvd = gvd_cli_cfg_sys.c \
 
 # define relied so path for bin target
 # keep the var name as bin_LDSO
-gvd_LDSO = -lncurses
+gvd_LDSO = -lncurses -lpthread
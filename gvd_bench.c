@@ -0,0 +1,782 @@
+/*
+ * gvd_bench.c
+ *
+ * Micro benchmarks, run as "gvd bench <suite> [args]"
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gvd_tty.h"
+#include "gvd_util.h"
+#include "gvd_bench.h"
+#include "gvd_common.h"
+#include "gvd_cli_tree.h"
+#include "gvd_cli_parser.h"
+#include "gvd_line_spill.h"
+#include "gvd_key_map.h"
+#include "gvd_cli_tty.h"
+#include "gvd_cmd_history.h"
+#include "gvd_line_buffer.h"
+#include "gvd_cli_tty_headless.h"
+
+#define BENCH_FILE_LINES_DEFAULT 10000
+#define BENCH_FILE_ROUNDS_DEFAULT 50
+#define BENCH_CMD_MAX_LEN 255
+#define BENCH_FILE_NAME_MAX_LEN 63
+#define BENCH_SEARCH_LINES_DEFAULT 1000000
+#define BENCH_SEARCH_ROUNDS_DEFAULT 5
+#define BENCH_LINE_MAX_LEN 127
+#define BENCH_HISTORY_CMDS_DEFAULT 100000
+#define BENCH_HISTORY_ROUNDS_DEFAULT 100
+#define BENCH_KEYS_ROUNDS_DEFAULT 1000000
+#define BENCH_SCR_ROUNDS_DEFAULT 1000
+//! keeps the keys of all rounds, BENCH_SCR_ROUND_KEYS_MAX each, small
+#define BENCH_SCR_ROUNDS_MAX 100000
+#define BENCH_SCR_ROUND_KEYS_MAX 64
+//! lines of the file shown by each command of the flood load
+#define BENCH_SCR_FLOOD_LINES 100
+//! pages scrolled up, then down, by each round of the scroll load
+#define BENCH_SCR_SCROLL_PAGES 10
+#define BENCH_SCR_CMD "show time"
+
+typedef struct bench_suite_s {
+    char *name;
+    char *help_string;
+    int (*run)(int argc, char *argv[]);
+} bench_suite_t;
+
+typedef struct bench_file_cmd_s {
+    char *name;
+    //%s is replaced with the file name
+    char *native_cmd;
+    char *exec_cmd;
+} bench_file_cmd_t;
+
+typedef struct bench_search_s {
+    char *name;
+    char *pattern;
+    bool backward;
+} bench_search_t;
+
+static int bench_file_utils(int argc, char *argv[]);
+static int bench_search(int argc, char *argv[]);
+static int bench_history(int argc, char *argv[]);
+static int bench_keys(int argc, char *argv[]);
+static int bench_screen(int argc, char *argv[]);
+
+static bench_suite_t bench_suites[] = {
+    {"file", "[LINES] [ROUNDS], native file commands vs exec",
+     bench_file_utils},
+    {"search", "[LINES] [ROUNDS], scrollback search on disk tier",
+     bench_search},
+    {"history", "[COMMANDS] [ROUNDS], command history add and search",
+     bench_history},
+    {"keys", "[ROUNDS], key dispatch of the prompt", bench_keys},
+    {"screen", "[ROWS] [COLS] [ROUNDS], rendering on a headless terminal",
+     bench_screen},
+};
+
+//only the first line has the marker, the last line has its own
+static bench_search_t bench_searches[] = {
+    {"miss",   "no such text",  TRUE},
+    {"oldest", "FIRST-LINE",    TRUE},
+    {"newest", "LAST-LINE",     TRUE},
+    {"fwd",    "LAST-LINE",     FALSE},
+};
+
+//the first search builds the index
+static bench_search_t bench_history_searches[] = {
+    {"index",  "FIRST-CMD",     TRUE},
+    {"oldest", "FIRST-CMD",     TRUE},
+    {"newest", "LAST-CMD",      TRUE},
+    {"common", "GigabitEth",    TRUE},
+    {"miss",   "no such cmd",   TRUE},
+    {"short",  "/7",            TRUE},
+};
+
+static bench_file_cmd_t bench_file_cmds[] = {
+    {"cat",  "show file %s",         "exec \"cat %s\""},
+    {"head", "show file %s head 10", "exec \"head -n 10 %s\""},
+    {"tail", "show file %s tail 10", "exec \"tail -n 10 %s\""},
+    {"wc",   "show file %s count",   "exec \"wc %s\""},
+    {"grep", "grep ERROR %s",        "exec \"grep ERROR %s\""},
+    {"incl", "show file %s | include ERROR", "exec \"grep ERROR %s\""},
+    {"excl", "show file %s | exclude INFO",  "exec \"grep -v INFO %s\""},
+    {"count", "show file %s | count ERROR",  "exec \"grep -c ERROR %s\""},
+    {"ls",   "dir /tmp",             "exec \"ls -l /tmp\""},
+};
+
+extern gvd_tty_t gvd_tty;
+
+uint64_t
+bench_now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static uint64_t
+bench_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int
+make_bench_file (char *file_name, uint32_t lines)
+{
+    FILE *fp;
+    uint32_t i;
+    int fd;
+
+    snprintf(file_name, BENCH_FILE_NAME_MAX_LEN+1, "/tmp/gvd_bench_XXXXXX");
+    fd = mkstemp(file_name);
+    if (fd == -1) {
+        return -1;
+    }
+
+    fp = fdopen(fd, "w");
+    if (!fp) {
+        close(fd);
+        unlink(file_name);
+        return -1;
+    }
+
+    for (i = 0; i < lines; i++) {
+        fprintf(fp, "%08u %s interface GigabitEthernet0/%u changed state\n",
+                i, (i%100 == 0)?"ERROR":"INFO ", i%48);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+//average time of one request in us, output size in bytes
+static uint64_t
+time_one_cmd (char *cmd, uint32_t rounds, uint32_t *output_len_p)
+{
+    uint64_t start;
+    char *output;
+    uint32_t i;
+
+    *output_len_p = 0;
+    start = bench_now_us();
+    for (i = 0; i < rounds; i++) {
+        (void)cli_parser_request(&gvd_tty, PARSER_REQ_EXEC, cmd, &output);
+        if (output) {
+            *output_len_p = strlen(output);
+            free(output);
+        }
+    }
+
+    return (bench_now_us() - start)/rounds;
+}
+
+static int
+bench_file_utils (int argc, char *argv[])
+{
+    char file_name[BENCH_FILE_NAME_MAX_LEN+1];
+    char native_cmd[BENCH_CMD_MAX_LEN+1], exec_cmd[BENCH_CMD_MAX_LEN+1];
+    uint32_t lines, rounds, i, native_len, exec_len;
+    uint64_t native_us, exec_us;
+    bench_file_cmd_t *cmd_p;
+
+    lines = (argc > 0)?atoi(argv[0]):BENCH_FILE_LINES_DEFAULT;
+    rounds = (argc > 1)?atoi(argv[1]):BENCH_FILE_ROUNDS_DEFAULT;
+    if (lines == 0 || rounds == 0) {
+        return -1;
+    }
+
+    if (make_bench_file(file_name, lines) == -1) {
+        printf("Can't create bench file.\n");
+        return -1;
+    }
+
+    printf("File utilities, %u lines, %u rounds, us per command\n\n",
+           lines, rounds);
+    printf("%-6s %12s %12s %9s %12s\n",
+           "cmd", "native(us)", "exec(us)", "speedup", "bytes");
+
+    for (i = 0; i < ARRAY_LEN(bench_file_cmds); i++) {
+        cmd_p = &bench_file_cmds[i];
+        snprintf(native_cmd, sizeof(native_cmd), cmd_p->native_cmd, file_name);
+        snprintf(exec_cmd, sizeof(exec_cmd), cmd_p->exec_cmd, file_name);
+
+        gvd_return_exec_cli_mode(&gvd_tty);
+        native_us = time_one_cmd(native_cmd, rounds, &native_len);
+
+        gvd_enter_lower_cli_mode(&gvd_tty, CLI_MODE_SHELL);
+        exec_us = time_one_cmd(exec_cmd, rounds, &exec_len);
+
+        printf("%-6s %12llu %12llu %8.1fx %12u\n", cmd_p->name,
+               (unsigned long long)native_us, (unsigned long long)exec_us,
+               native_us?(double)exec_us/native_us:0.0, native_len);
+    }
+
+    gvd_return_exec_cli_mode(&gvd_tty);
+    unlink(file_name);
+    return 0;
+}
+
+static void
+fill_bench_spill (uint32_t lines)
+{
+    char line[BENCH_LINE_MAX_LEN+1];
+    uint32_t i;
+    int len;
+
+    //whole history fits, nothing is dropped
+    line_spill_set_limit(0);
+    line_spill_set_limit((uint64_t)lines*(BENCH_LINE_MAX_LEN+1));
+
+    for (i = 0; i < lines; i++) {
+        len = snprintf(line, sizeof(line),
+                       "%08u %s interface GigabitEthernet0/%u changed "
+                       "state%s\n", i, (i%100 == 0)?"ERROR":"INFO ", i%48,
+                       (i == 0)?" FIRST-LINE":
+                       ((i == lines-1)?" LAST-LINE":""));
+        line_spill_append(i, line, len, i);
+    }
+    return;
+}
+
+static int
+bench_search (int argc, char *argv[])
+{
+    uint32_t lines, rounds, i, k, off;
+    uint64_t start, us, seq, from_seq;
+    line_spill_stats_t stats;
+    bench_search_t *search_p;
+    bool found;
+
+    lines = (argc > 0)?atoi(argv[0]):BENCH_SEARCH_LINES_DEFAULT;
+    rounds = (argc > 1)?atoi(argv[1]):BENCH_SEARCH_ROUNDS_DEFAULT;
+    if (lines == 0 || rounds == 0) {
+        return -1;
+    }
+
+    start = bench_now_us();
+    fill_bench_spill(lines);
+    line_spill_get_stats(&stats);
+    printf("Scrollback search, %u lines, %llu MB on disk, filled in %llu ms\n\n",
+           lines, (unsigned long long)(stats.bytes >> 20),
+           (unsigned long long)(bench_now_us() - start)/1000);
+    printf("%-8s %-14s %12s %12s %10s\n",
+           "search", "pattern", "line", "time(us)", "MB/s");
+
+    for (i = 0; i < ARRAY_LEN(bench_searches); i++) {
+        search_p = &bench_searches[i];
+        from_seq = search_p->backward?lines:0;
+        found = FALSE;
+        seq = 0;
+
+        start = bench_now_us();
+        for (k = 0; k < rounds; k++) {
+            found = line_spill_search(search_p->pattern,
+                                      strlen(search_p->pattern), from_seq, 0,
+                                      search_p->backward, &seq, &off);
+        }
+        us = (bench_now_us() - start)/rounds;
+
+        printf("%-8s %-14s %12lld %12llu %10.0f\n", search_p->name,
+               search_p->pattern, found?(long long)seq:-1LL,
+               (unsigned long long)us, us?(double)stats.bytes/us:0.0);
+    }
+
+    line_spill_clean();
+    return 0;
+}
+
+static int
+bench_history (int argc, char *argv[])
+{
+    char cmd[BENCH_LINE_MAX_LEN+1];
+    uint32_t cmds, rounds, i, k, seq, first, end;
+    bench_search_t *search_p;
+    cmd_history_t *hist_p;
+    uint64_t start, us;
+    bool found;
+    int len;
+
+    cmds = (argc > 0)?atoi(argv[0]):BENCH_HISTORY_CMDS_DEFAULT;
+    rounds = (argc > 1)?atoi(argv[1]):BENCH_HISTORY_ROUNDS_DEFAULT;
+    if (cmds == 0 || cmds > CMD_HISTORY_DEPTH_MAX || rounds == 0) {
+        return -1;
+    }
+
+    hist_p = cmd_history_create(cmds);
+    if (!hist_p) {
+        printf("Can't create command history.\n");
+        return -1;
+    }
+
+    start = bench_now_us();
+    for (i = 0; i < cmds; i++) {
+        len = snprintf(cmd, sizeof(cmd),
+                       "show interface GigabitEthernet%u/%u counters%s",
+                       i%8, i%48, (i == 0)?" FIRST-CMD":
+                       ((i == cmds-1)?" LAST-CMD":""));
+        cmd_history_add(hist_p, cmd, len);
+    }
+    us = bench_now_us() - start;
+    cmd_history_get_range(hist_p, &first, &end);
+    printf("Command history, %u commands kept, %.3f us per add\n\n",
+           end - first, (double)us/cmds);
+    printf("%-8s %-14s %12s %12s\n", "search", "pattern", "command",
+           "time(us)");
+
+    for (i = 0; i < ARRAY_LEN(bench_history_searches); i++) {
+        search_p = &bench_history_searches[i];
+        found = FALSE;
+        seq = 0;
+
+        //the index is built once, time that search alone
+        k = (i == 0)?rounds-1:0;
+        start = bench_now_us();
+        for (; k < rounds; k++) {
+            found = cmd_history_search(hist_p, search_p->pattern,
+                                       strlen(search_p->pattern), end, &seq);
+        }
+        us = (bench_now_us() - start)/((i == 0)?1:rounds);
+
+        printf("%-8s %-14s %12lld %12llu\n", search_p->name,
+               search_p->pattern, found?(long long)seq:-1LL,
+               (unsigned long long)us);
+    }
+
+    cmd_history_destroy(hist_p);
+    return 0;
+}
+
+typedef struct bench_keys_s {
+    char *name;
+    int keys[8];
+} bench_keys_t;
+
+static uint64_t bench_key_sum = 0;
+
+static int
+bench_key_handler (int input)
+{
+    bench_key_sum += input;
+    return PROCESS_CONTINUE;
+}
+
+//the prompt's own keys, handlers do nothing
+static key_action_t bench_key_actions[] = {
+    {"help", "", bench_key_handler, '?'},
+    {"complete", "", bench_key_handler, '\t'},
+    {"enter", "", bench_key_handler, GVD_KEY_ENTER},
+    {"backspace", "", bench_key_handler, GVD_KEY_BACKSPACE},
+    {"delete", "", bench_key_handler, GVD_KEY_DEL},
+    {"history-up", "", bench_key_handler, GVD_KEY_UP},
+    {"history-down", "", bench_key_handler, GVD_KEY_DOWN},
+    {"left", "", bench_key_handler, GVD_KEY_LEFT},
+    {"right", "", bench_key_handler, GVD_KEY_RIGHT},
+    {"home", "", bench_key_handler, GVD_KEY_HOME},
+    {"end", "", bench_key_handler, GVD_KEY_END},
+    {"page-up", "", bench_key_handler, GVD_KEY_PGUP},
+    {"page-down", "", bench_key_handler, GVD_KEY_PGDOWN},
+    {"resize", "", bench_key_handler, GVD_RESIZE},
+    {"clear-line", "", bench_key_handler, GVD_CTRL_C},
+    {"exit-mode", "", bench_key_handler, GVD_CTRL_Z},
+    {"search-scrollback", "", bench_key_handler, GVD_CTRL_F},
+    {"search-history", "", bench_key_handler, GVD_CTRL_R},
+};
+
+static bench_keys_t bench_key_sets[] = {
+    {"text",    {'s', 'h', 'o', 'w', ' ', '-', '9', '|'}},
+    {"special", {GVD_KEY_UP, GVD_KEY_LEFT, GVD_KEY_BACKSPACE, '\t', '?',
+                 GVD_KEY_PGDOWN, GVD_CTRL_R, GVD_RESIZE}},
+    {"unbound", {1, 2, 5, 0x80, 0xff, KEY_F(1), KEY_F(12), KEY_IC}},
+};
+
+//dispatch as the prompt does, a bound key first, then text
+static int
+bench_dispatch_key (int input)
+{
+    key_handler_t handler;
+
+    handler = key_map_lookup(input);
+    if (!handler && key_map_is_text(input)) {
+        handler = bench_key_handler;
+    }
+
+    return handler?handler(input):PROCESS_CONTINUE;
+}
+
+static int
+bench_keys (int argc, char *argv[])
+{
+    uint32_t rounds, i, k, j;
+    bench_keys_t *set_p;
+    uint64_t start, us;
+
+    rounds = (argc > 0)?atoi(argv[0]):BENCH_KEYS_ROUNDS_DEFAULT;
+    if (rounds == 0) {
+        return -1;
+    }
+
+    key_map_init(bench_key_actions, ARRAY_LEN(bench_key_actions));
+
+    printf("Key dispatch, %u rounds of 8 keys, handlers do nothing\n\n",
+           rounds);
+    printf("%-8s %12s %12s\n", "keys", "time(us)", "ns/key");
+
+    for (i = 0; i < ARRAY_LEN(bench_key_sets); i++) {
+        set_p = &bench_key_sets[i];
+
+        start = bench_now_us();
+        for (k = 0; k < rounds; k++) {
+            for (j = 0; j < ARRAY_LEN(set_p->keys); j++) {
+                (void)bench_dispatch_key(set_p->keys[j]);
+            }
+        }
+        us = bench_now_us() - start;
+
+        printf("%-8s %12llu %12.2f\n", set_p->name, (unsigned long long)us,
+               (double)us*1000/((uint64_t)rounds*ARRAY_LEN(set_p->keys)));
+    }
+
+    //keeps the handler calls from being dropped
+    return (bench_key_sum == 0)?-1:0;
+}
+
+typedef struct bench_scr_load_s {
+    char *name;
+    //keys of one round, put in keys, up to max
+    uint32_t (*make_keys)(int *keys, uint32_t max);
+} bench_scr_load_t;
+
+static uint32_t bench_scr_make_typing(int *keys, uint32_t max);
+static uint32_t bench_scr_make_flood(int *keys, uint32_t max);
+static uint32_t bench_scr_make_scroll(int *keys, uint32_t max);
+static uint32_t bench_scr_make_resize(int *keys, uint32_t max);
+
+//scroll goes over what flood printed
+static bench_scr_load_t bench_scr_loads[] = {
+    {"typing", bench_scr_make_typing},
+    {"flood",  bench_scr_make_flood},
+    {"scroll", bench_scr_make_scroll},
+    {"resize", bench_scr_make_resize},
+};
+
+static bench_prompt_t *bench_prompt_p = NULL;
+static uint32_t bench_scr_rows, bench_scr_cols;
+//shown by each command of the flood load
+static char bench_scr_file[BENCH_FILE_NAME_MAX_LEN+1];
+static bool bench_scr_flood_half = FALSE;
+static bool bench_scr_small = FALSE;
+
+//keys of str, up to max, then enter if asked
+static uint32_t
+bench_scr_make_str (int *keys, uint32_t max, char *str, bool enter)
+{
+    uint32_t cnt = 0;
+
+    for (; *str && cnt < max - 1; str++) {
+        keys[cnt++] = *str;
+    }
+    if (enter) {
+        keys[cnt++] = GVD_KEY_ENTER;
+    }
+    return cnt;
+}
+
+//a command typed, then enter
+static uint32_t
+bench_scr_make_typing (int *keys, uint32_t max)
+{
+    return bench_scr_make_str(keys, max, BENCH_SCR_CMD, TRUE);
+}
+
+//every other round shows half, the same screen twice would draw nothing
+static uint32_t
+bench_scr_make_flood (int *keys, uint32_t max)
+{
+    char cmd[BENCH_CMD_MAX_LEN+1];
+
+    bench_scr_flood_half = !bench_scr_flood_half;
+    if (bench_scr_flood_half) {
+        snprintf(cmd, sizeof(cmd), "show file %s head %u", bench_scr_file,
+                 BENCH_SCR_FLOOD_LINES/2);
+    } else {
+        snprintf(cmd, sizeof(cmd), "show file %s", bench_scr_file);
+    }
+    return bench_scr_make_str(keys, max, cmd, TRUE);
+}
+
+static uint32_t
+bench_scr_make_scroll (int *keys, uint32_t max)
+{
+    uint32_t cnt = 0, i;
+
+    for (i = 0; i < BENCH_SCR_SCROLL_PAGES && cnt < max; i++) {
+        keys[cnt++] = GVD_KEY_PGUP;
+    }
+    for (i = 0; i < BENCH_SCR_SCROLL_PAGES && cnt < max; i++) {
+        keys[cnt++] = GVD_KEY_PGDOWN;
+    }
+    return cnt;
+}
+
+//each resize goes between the size given and half of it
+static uint32_t
+bench_scr_make_resize (int *keys, uint32_t max)
+{
+    keys[0] = GVD_RESIZE;
+    keys[1] = GVD_RESIZE;
+    return 2;
+}
+
+//the console's own key handling, the terminal changes size before it
+static void
+bench_scr_key (int input)
+{
+    if (input == GVD_RESIZE) {
+        bench_scr_small = !bench_scr_small;
+        if (bench_scr_small) {
+            tty_headless_set_size(bench_scr_rows/2 + 1, bench_scr_cols/2 + 1);
+        } else {
+            tty_headless_set_size(bench_scr_rows, bench_scr_cols);
+        }
+    }
+
+    (void)bench_prompt_p->key_process(input);
+    return;
+}
+
+//keys of str given to the console and drawn, not timed
+static int
+bench_scr_type (char *str, bool enter)
+{
+    int keys[BENCH_CMD_MAX_LEN+1], input;
+    uint32_t cnt;
+
+    cnt = bench_scr_make_str(keys, ARRAY_LEN(keys), str, enter);
+    if (tty_headless_set_keys(keys, cnt) == -1) {
+        return -1;
+    }
+    while (tty_poll_one_key(&input)) {
+        bench_scr_key(input);
+        flush_line_buffer_to_scr();
+    }
+    tty_flush();
+    return 0;
+}
+
+/*
+ * Each key is drawn before the next is read, as when typed, so a key is a
+ * frame and its latency the time to apply and draw it.
+ */
+static int
+bench_scr_run_load (bench_scr_load_t *load_p, uint32_t rounds)
+{
+    uint64_t start, us, key_start, ns, ns_sum = 0, ns_max = 0;
+    tty_output_stats_t before, after;
+    uint32_t cnt, i;
+    int *keys, input;
+
+    keys = malloc((size_t)rounds * BENCH_SCR_ROUND_KEYS_MAX * sizeof(int));
+    if (!keys) {
+        return -1;
+    }
+
+    cnt = 0;
+    for (i = 0; i < rounds; i++) {
+        cnt += load_p->make_keys(keys + cnt, BENCH_SCR_ROUND_KEYS_MAX);
+    }
+    if (tty_headless_set_keys(keys, cnt) == -1) {
+        free(keys);
+        return -1;
+    }
+    free(keys);
+
+    tty_get_output_stats(&before);
+    start = bench_now_us();
+    while (tty_poll_one_key(&input)) {
+        key_start = bench_now_ns();
+        bench_scr_key(input);
+        flush_line_buffer_to_scr();
+        ns = bench_now_ns() - key_start;
+        ns_sum += ns;
+        if (ns > ns_max) {
+            ns_max = ns;
+        }
+    }
+    us = bench_now_us() - start;
+    tty_get_output_stats(&after);
+
+    after.bytes -= before.bytes;
+    after.writes -= before.writes;
+    printf("%-8s %8u %8llu %10llu %10.0f %12llu %8llu %10llu %10llu\n",
+           load_p->name, cnt, (unsigned long long)after.writes,
+           (unsigned long long)us,
+           us?(double)after.writes*1000000/us:0,
+           (unsigned long long)after.bytes,
+           (unsigned long long)(after.writes?after.bytes/after.writes:0),
+           (unsigned long long)(cnt?ns_sum/cnt:0),
+           (unsigned long long)ns_max);
+    return 0;
+}
+
+/*
+ * The command is typed at the prompt and the rows left on the headless
+ * screen are read back, they must show the prompt and the command, split
+ * over as many rows as it takes.
+ */
+static int
+bench_scr_check (void)
+{
+    char want[BENCH_CMD_MAX_LEN+1], row[BENCH_CMD_MAX_LEN+1];
+    uint32_t rows, cols, want_len, row_cnt, len, y, i;
+
+    tty_get_scr_size(&rows, &cols);
+    want_len = snprintf(want, sizeof(want), "%s%s",
+                        gvd_tty_get_ps(&gvd_tty, NULL), BENCH_SCR_CMD);
+    row_cnt = (want_len - 1)/cols + 1;
+    if (want_len >= sizeof(want) || cols > BENCH_CMD_MAX_LEN ||
+        row_cnt > rows) {
+        return 0;
+    }
+
+    if (bench_scr_type(BENCH_SCR_CMD, FALSE) == -1) {
+        return -1;
+    }
+
+    //prompt ends on the last row written
+    for (y = rows; y > 0; y--) {
+        if (tty_headless_get_row(y - 1, row, sizeof(row))) {
+            break;
+        }
+    }
+    if (y < row_cnt) {
+        return -1;
+    }
+
+    for (i = 0; i < row_cnt; i++) {
+        len = want_len - i*cols;
+        if (len > cols) {
+            len = cols;
+        }
+        //blanks at the end of a row are not read back
+        while (len && want[i*cols + len - 1] == ' ') {
+            len--;
+        }
+        if (tty_headless_get_row(y - row_cnt + i, row, sizeof(row)) != len ||
+            memcmp(row, want + i*cols, len) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+bench_screen (int argc, char *argv[])
+{
+    uint32_t rounds, i;
+    int rc = 0;
+
+    bench_scr_rows = (argc > 0)?atoi(argv[0]):TTY_HEADLESS_ROWS_DEFAULT;
+    bench_scr_cols = (argc > 1)?atoi(argv[1]):TTY_HEADLESS_COLS_DEFAULT;
+    rounds = (argc > 2)?atoi(argv[2]):BENCH_SCR_ROUNDS_DEFAULT;
+    if (bench_scr_rows < 2 || bench_scr_cols < 2 || rounds == 0 ||
+        rounds > BENCH_SCR_ROUNDS_MAX) {
+        printf("ROWS and COLS from 2, ROUNDS from 1 to %u.\n",
+               BENCH_SCR_ROUNDS_MAX);
+        return -1;
+    }
+
+    if (make_bench_file(bench_scr_file, BENCH_SCR_FLOOD_LINES) == -1) {
+        return -1;
+    }
+
+    tty_set_ops(tty_headless_get_ops());
+    if (tty_headless_set_size(bench_scr_rows, bench_scr_cols) == -1) {
+        unlink(bench_scr_file);
+        return -1;
+    }
+    line_buffer_set_log_name(NULL);
+    if (line_buffer_init() == -1) {
+        unlink(bench_scr_file);
+        return -1;
+    }
+    if (bench_prompt_p->init() == -1 ||
+        bench_scr_type("terminal length 0", TRUE) == -1) {
+        line_buffer_clean();
+        unlink(bench_scr_file);
+        return -1;
+    }
+
+    printf("Rendering on a %ux%u headless terminal, %u rounds, "
+           "bytes as sent to a VT100\n\n", bench_scr_rows, bench_scr_cols,
+           rounds);
+    printf("%-8s %8s %8s %10s %10s %12s %8s %10s %10s\n", "load", "keys",
+           "frames", "time(us)", "frames/s", "bytes", "B/frame",
+           "avg(ns)", "max(ns)");
+
+    for (i = 0; i < ARRAY_LEN(bench_scr_loads); i++) {
+        rc = bench_scr_run_load(&bench_scr_loads[i], rounds);
+        if (rc == -1) {
+            break;
+        }
+    }
+
+    if (rc == 0) {
+        rc = bench_scr_check();
+        printf("\nScreen check: %s\n", (rc == 0)?"ok":"failed");
+    }
+
+    line_buffer_clean();
+    unlink(bench_scr_file);
+    return rc;
+}
+
+static void
+print_bench_usage (void)
+{
+    uint32_t i;
+
+    printf("Usage: gvd bench <suite> [args]\n\n");
+    for (i = 0; i < ARRAY_LEN(bench_suites); i++) {
+        printf("  %-8s %s\n", bench_suites[i].name,
+               bench_suites[i].help_string);
+    }
+    return;
+}
+
+int
+gvd_bench_main (int argc, char *argv[], bench_prompt_t *prompt_p)
+{
+    uint32_t i;
+    int rc;
+
+    bench_prompt_p = prompt_p;
+
+    if (argc < 1) {
+        print_bench_usage();
+        return -1;
+    }
+
+    rc = gvd_init_cli_tree();
+    if (rc == -1) {
+        return -1;
+    }
+
+    for (i = 0; i < ARRAY_LEN(bench_suites); i++) {
+        if (strcmp(argv[0], bench_suites[i].name) == 0) {
+            return bench_suites[i].run(argc-1, argv+1);
+        }
+    }
+
+    print_bench_usage();
+    return -1;
+}
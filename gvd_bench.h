@@ -0,0 +1,18 @@
+#ifndef __GVD_BENCH_H__
+#define __GVD_BENCH_H__
+
+#include <stdint.h>
+
+//the console prompt, the screen bench types at it
+typedef struct bench_prompt_s {
+    //ready for keys, the prompt printed
+    int (*init)(void);
+    int (*key_process)(int input);
+} bench_prompt_t;
+
+uint64_t
+bench_now_us(void);
+
+int
+gvd_bench_main(int argc, char *argv[], bench_prompt_t *prompt_p);
+#endif //__GVD_BENCH_H__
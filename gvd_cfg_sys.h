@@ -73,20 +73,449 @@ KEYWORD(node_show_ver,
         node_show_time,
         "version", "System hardware and software status");
 
-KEYWORD(node_show,
+/* show logfile {statistics | segments | line <1-2147483647> | time WORD} */
+
+END(node_show_logfile_stats_end, exec_show_logfile_stats);
+END(node_show_logfile_segs_end, exec_show_logfile_segments);
+END(node_show_logfile_line_end, exec_show_logfile_line);
+END(node_show_logfile_time_end, exec_show_logfile_time);
+
+STRING(node_show_logfile_time_val,
+       node_show_logfile_time_end,
+       NO_ALT,
+       OBJ(P_STRING, P0),
+       "Time of today, hh:mm or hh:mm:ss");
+
+KEYWORD(node_show_logfile_time,
+        node_show_logfile_time_val,
+        NO_ALT,
+        "time", "First line logged at or after a time");
+
+NUMBER(node_show_logfile_line_val,
+       node_show_logfile_line_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 2147483647,
+       "Line number, counted from 1 over all segments");
+
+KEYWORD(node_show_logfile_line,
+        node_show_logfile_line_val,
+        node_show_logfile_time,
+        "line", "One line of the log file");
+
+KEYWORD(node_show_logfile_segs,
+        node_show_logfile_segs_end,
+        node_show_logfile_line,
+        "segments", "Log file segments and their lines");
+
+KEYWORD(node_show_logfile_stats,
+        node_show_logfile_stats_end,
+        node_show_logfile_segs,
+        "statistics", "Log writer queue and write statistics");
+
+KEYWORD(node_show_logfile,
+        node_show_logfile_stats,
         node_show_ver,
+        "logfile", "Console log file");
+
+/* show scrollback */
+
+END(node_show_scrollback_end, exec_show_scrollback);
+
+KEYWORD(node_show_scrollback,
+        node_show_scrollback_end,
+        node_show_logfile,
+        "scrollback", "Scrollback memory and disk usage");
+
+/* show console {since hh:mm | last <1-1440> minutes} */
+
+END(node_show_console_since_end, exec_show_console_since);
+END(node_show_console_last_end, exec_show_console_last);
+
+KEYWORD(node_show_console_last_min,
+        node_show_console_last_end,
+        NO_ALT,
+        "minutes", "Minutes back from now");
+
+NUMBER(node_show_console_last_val,
+       node_show_console_last_min,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 1440,
+       "Number of minutes");
+
+KEYWORD(node_show_console_last,
+        node_show_console_last_val,
+        NO_ALT,
+        "last", "Console lines of the last minutes");
+
+TIME(node_show_console_since_val,
+     node_show_console_since_end,
+     NO_ALT,
+     OBJ(P_INT, P0), OBJ(P_INT, P1),
+     "Time within the last day");
+
+KEYWORD(node_show_console_since,
+        node_show_console_since_val,
+        node_show_console_last,
+        "since", "Console lines since a time");
+
+KEYWORD(node_show_console,
+        node_show_console_since,
+        node_show_scrollback,
+        "console", "Console lines with the time of each");
+
+/* show recording */
+
+END(node_show_recording_end, exec_show_recording);
+
+KEYWORD(node_show_recording,
+        node_show_recording_end,
+        node_show_console,
+        "recording", "Session recording file and statistics");
+
+/* show terminal */
+
+END(node_show_terminal_end, exec_show_terminal);
+
+KEYWORD(node_show_terminal,
+        node_show_terminal_end,
+        node_show_recording,
+        "terminal", "Terminal line parameters and screen updates");
+
+/* show key-bindings */
+
+END(node_show_key_bind_end, exec_show_key_bindings);
+
+KEYWORD(node_show_key_bind,
+        node_show_key_bind_end,
+        node_show_terminal,
+        "key-bindings", "Keys of the prompt and what they do");
+
+/* show history */
+
+END(node_show_history_end, exec_show_history);
+
+KEYWORD(node_show_history,
+        node_show_history_end,
+        node_show_key_bind,
+        "history", "Commands run on this terminal");
+
+KEYWORD(node_show,
+        node_show_history,
         node_shell,
         "show", "Show running system information");
 
 
+/* terminal command-timeout <0-86400> */
+
+END(node_terminal_cmd_timeout_end, exec_terminal_cmd_timeout);
+
+NUMBER(node_terminal_cmd_timeout_val,
+       node_terminal_cmd_timeout_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 86400,
+       "Seconds before a running command is aborted, 0 for no timeout");
+
+KEYWORD(node_terminal_cmd_timeout,
+        node_terminal_cmd_timeout_val,
+        NO_ALT,
+        "command-timeout", "Set the watchdog timeout for each command");
+
+/* terminal command-length <256-8192> */
+
+END(node_terminal_cmd_len_end, exec_terminal_cmd_length);
+
+NUMBER(node_terminal_cmd_len_val,
+       node_terminal_cmd_len_end,
+       NO_ALT,
+       OBJ(P_INT, P0), CMD_MAX_LEN_MIN, CMD_MAX_LEN_LIMIT,
+       "Characters, longer commands are refused");
+
+KEYWORD(node_terminal_cmd_len,
+        node_terminal_cmd_len_val,
+        node_terminal_cmd_timeout,
+        "command-length", "Set the longest command accepted");
+
+/* terminal history size <1-100000> */
+
+END(node_terminal_history_size_end, exec_terminal_history_size);
+
+NUMBER(node_terminal_history_size_val,
+       node_terminal_history_size_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, CMD_HISTORY_DEPTH_MAX,
+       "Commands kept");
+
+KEYWORD(node_terminal_history_size,
+        node_terminal_history_size_val,
+        NO_ALT,
+        "size", "Set number of commands kept");
+
+KEYWORD(node_terminal_history,
+        node_terminal_history_size,
+        node_terminal_cmd_len,
+        "history", "Set command history");
+
+/* terminal hostname [WORD] */
+
+END(node_terminal_host_end, exec_terminal_hostname);
+
+STRING_MAX(node_terminal_host_name,
+           node_terminal_host_end,
+           node_terminal_host_end,
+           OBJ(P_STRING, P0), GVD_HOST_NAME_MAX_LEN,
+           "Host name shown in the prompt, the system one if not given");
+
+KEYWORD(node_terminal_host,
+        node_terminal_host_name,
+        node_terminal_history,
+        "hostname", "Set host name of this terminal");
+
+/* terminal length {<0-512> | auto} */
+
+END(node_terminal_len_end, exec_terminal_length);
+END(node_terminal_len_auto_end, exec_terminal_length_auto);
+
+KEYWORD(node_terminal_len_auto,
+        node_terminal_len_auto_end,
+        NO_ALT,
+        "auto", "Follow the screen size");
+
+NUMBER(node_terminal_len_val,
+       node_terminal_len_end,
+       node_terminal_len_auto,
+       OBJ(P_INT, P0), 0, 512,
+       "Number of lines on screen, 0 for no pausing");
+
+KEYWORD(node_terminal_len,
+        node_terminal_len_val,
+        node_terminal_host,
+        "length", "Set number of lines on a screen");
+
+/* terminal scrollback {memory <64-65536> | disk <0-65536>} */
+
+END(node_terminal_sb_mem_end, exec_terminal_scrollback_memory);
+END(node_terminal_sb_disk_end, exec_terminal_scrollback_disk);
+
+NUMBER(node_terminal_sb_disk_val,
+       node_terminal_sb_disk_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 65536,
+       "Megabytes of older lines kept on disk, 0 for none");
+
+KEYWORD(node_terminal_sb_disk,
+        node_terminal_sb_disk_val,
+        NO_ALT,
+        "disk", "Set scrollback kept on disk");
+
+NUMBER(node_terminal_sb_mem_val,
+       node_terminal_sb_mem_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 64, 65536,
+       "Kilobytes of recent lines kept in memory");
+
+KEYWORD(node_terminal_sb_mem,
+        node_terminal_sb_mem_val,
+        node_terminal_sb_disk,
+        "memory", "Set scrollback kept in memory");
+
+KEYWORD(node_terminal_sb,
+        node_terminal_sb_mem,
+        node_terminal_len,
+        "scrollback", "Set scrollback size");
+
+KEYWORD(node_terminal,
+        node_terminal_sb,
+        node_show,
+        "terminal", "Set terminal line parameters");
+
+/* send log WORD [count <1-100000>] */
+
+END(node_send_log_end, exec_send_log);
+
+NUMBER(node_send_log_count_val,
+       node_send_log_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, NOTIFY_SEND_COUNT_MAX,
+       "Number of times, posted from a thread of its own");
+
+KEYWORD(node_send_log_count,
+        node_send_log_count_val,
+        node_send_log_end,
+        "count", "Post the message more than once");
+
+STRING_MAX(node_send_log_msg,
+           node_send_log_count,
+           NO_ALT,
+           OBJ(P_STRING, P0), NOTIFY_MSG_MAX_LEN,
+           "Message, embraced with quotes if contain space");
+
+KEYWORD(node_send_log,
+        node_send_log_msg,
+        NO_ALT,
+        "log", "Post a message to the console, as a log would");
+
+KEYWORD(node_send,
+        node_send_log,
+        node_terminal,
+        "send", "Send a notification to the console");
+
+/* recording rotate {size <0-4096> | keep <1-64>} */
+
+END(node_recording_rotate_size_end, exec_recording_rotate_size);
+END(node_recording_rotate_keep_end, exec_recording_rotate_keep);
+
+NUMBER(node_recording_rotate_keep_val,
+       node_recording_rotate_keep_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, SESSION_REC_ROTATE_KEEP_MAX,
+       "Number of rotated recordings kept");
+
+KEYWORD(node_recording_rotate_keep,
+        node_recording_rotate_keep_val,
+        NO_ALT,
+        "keep", "Set how many rotated recordings are kept");
+
+NUMBER(node_recording_rotate_size_val,
+       node_recording_rotate_size_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 4096,
+       "Megabytes, 0 for no rotation");
+
+KEYWORD(node_recording_rotate_size,
+        node_recording_rotate_size_val,
+        node_recording_rotate_keep,
+        "size", "Rotate the recording when it grows to a size");
+
+KEYWORD(node_recording_rotate,
+        node_recording_rotate_size,
+        NO_ALT,
+        "rotate", "Set recording rotation");
+
+/* recording {start [WORD] | stop} */
+
+END(node_recording_start_end, exec_recording_start);
+END(node_recording_stop_end, exec_recording_stop);
+
+STRING(node_recording_start_name,
+       node_recording_start_end,
+       node_recording_start_end,
+       OBJ(P_STRING, P0),
+       "File name, appended to if it exists");
+
+KEYWORD(node_recording_stop,
+        node_recording_stop_end,
+        node_recording_rotate,
+        "stop", "Stop recording");
+
+KEYWORD(node_recording_start,
+        node_recording_start_name,
+        node_recording_stop,
+        "start", "Record commands, output and mode changes to a file");
+
+KEYWORD(node_recording,
+        node_recording_start,
+        node_send,
+        "recording", "Record the session for replay");
+
 /* logfile {flush | clear} */
 
 END(node_config_flush_end, exec_logfile_flush);
 END(node_config_clear_end, exec_logfile_clear);
 
+/* logfile write-interval <0-10000> */
+
+END(node_logfile_write_intv_end, exec_logfile_write_interval);
+
+NUMBER(node_logfile_write_intv_val,
+       node_logfile_write_intv_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 10000,
+       "Milliseconds a line may wait before written, 0 for no wait");
+
+KEYWORD(node_logfile_write_intv,
+        node_logfile_write_intv_val,
+        NO_ALT,
+        "write-interval", "Set how long lines are batched before written");
+
+/* logfile fsync {never | always | interval <1-3600>} */
+
+END(node_logfile_fsync_never_end, exec_logfile_fsync_never);
+END(node_logfile_fsync_always_end, exec_logfile_fsync_always);
+END(node_logfile_fsync_intv_end, exec_logfile_fsync_interval);
+
+NUMBER(node_logfile_fsync_intv_val,
+       node_logfile_fsync_intv_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 3600,
+       "Seconds between two syncs");
+
+KEYWORD(node_logfile_fsync_intv,
+        node_logfile_fsync_intv_val,
+        NO_ALT,
+        "interval", "Sync periodically");
+
+KEYWORD(node_logfile_fsync_always,
+        node_logfile_fsync_always_end,
+        node_logfile_fsync_intv,
+        "always", "Sync after every write");
+
+KEYWORD(node_logfile_fsync_never,
+        node_logfile_fsync_never_end,
+        node_logfile_fsync_always,
+        "never", "Leave it to the system");
+
+KEYWORD(node_logfile_fsync,
+        node_logfile_fsync_never,
+        node_logfile_write_intv,
+        "fsync", "Set when log file is synced to disk");
+
+/* logfile rotate {size <0-65536> | interval <0-10080> | keep <1-1024>} */
+
+END(node_logfile_rotate_size_end, exec_logfile_rotate_size);
+END(node_logfile_rotate_intv_end, exec_logfile_rotate_interval);
+END(node_logfile_rotate_keep_end, exec_logfile_rotate_keep);
+
+NUMBER(node_logfile_rotate_keep_val,
+       node_logfile_rotate_keep_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 1024,
+       "Number of rotated segments kept");
+
+KEYWORD(node_logfile_rotate_keep,
+        node_logfile_rotate_keep_val,
+        NO_ALT,
+        "keep", "Set how many rotated segments are kept");
+
+NUMBER(node_logfile_rotate_intv_val,
+       node_logfile_rotate_intv_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 10080,
+       "Minutes, 0 for no rotation by time");
+
+KEYWORD(node_logfile_rotate_intv,
+        node_logfile_rotate_intv_val,
+        node_logfile_rotate_keep,
+        "interval", "Rotate log file periodically");
+
+NUMBER(node_logfile_rotate_size_val,
+       node_logfile_rotate_size_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 0, 65536,
+       "Megabytes, 0 for no rotation by size");
+
+KEYWORD(node_logfile_rotate_size,
+        node_logfile_rotate_size_val,
+        node_logfile_rotate_intv,
+        "size", "Rotate log file when it grows to a size");
+
+KEYWORD(node_logfile_rotate,
+        node_logfile_rotate_size,
+        node_logfile_fsync,
+        "rotate", "Set log file rotation");
+
 KEYWORD(node_logfile_clear,
         node_config_clear_end,
-        NO_ALT,
+        node_logfile_rotate,
         "clear", "Clear console log file");
 
 KEYWORD(node_logfile_flush,
@@ -96,9 +525,33 @@ KEYWORD(node_logfile_flush,
 
 KEYWORD(node_logfile,
         node_logfile_flush,
-        node_show,
+        node_recording,
         "logfile", "Do action on console log file");
 
+/* key-binding WORD WORD */
+
+END(node_config_key_bind_end, exec_config_key_binding);
+
+STRING_MAX(node_config_key_bind_action,
+           node_config_key_bind_end,
+           NO_ALT,
+           OBJ(P_STRING, P1), KEY_MAP_NAME_MAX_LEN,
+           "Action, as in show key-bindings, none or default");
+
+STRING_MAX(node_config_key_bind_key,
+           node_config_key_bind_action,
+           NO_ALT,
+           OBJ(P_STRING, P0), KEY_MAP_NAME_MAX_LEN,
+           "Key, as ctrl-a, tab, up or page-down");
+
+KEYWORD(node_config_key_bind,
+        node_config_key_bind_key,
+        NO_ALT,
+        "key-binding", "Set what a key does at the prompt of all terminals");
+
+// Link to Config mode
+LINK_ROOT(node_config_key_bind, CLI_MODE_CONFIG);
+
 /* configure terminal */
 
 END_SUBMODE(node_config_term_end, exec_config_term, CLI_MODE_CONFIG);
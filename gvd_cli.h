@@ -9,15 +9,111 @@ exec_show_time(struct cli_parser_info_s *cpi_p);
 void
 exec_show_version(struct cli_parser_info_s *cpi_p);
 
+void
+exec_show_scrollback(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_history(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_terminal(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_key_bindings(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_console_since(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_console_last(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_recording(struct cli_parser_info_s *cpi_p);
+
+void
+exec_recording_start(struct cli_parser_info_s *cpi_p);
+
+void
+exec_recording_stop(struct cli_parser_info_s *cpi_p);
+
+void
+exec_recording_rotate_size(struct cli_parser_info_s *cpi_p);
+
+void
+exec_recording_rotate_keep(struct cli_parser_info_s *cpi_p);
+
+void
+exec_send_log(struct cli_parser_info_s *cpi_p);
+
 void
 exec_logfile_flush(struct cli_parser_info_s *cpi_p);
 
 void
 exec_logfile_clear(struct cli_parser_info_s *cpi_p);
 
+void
+exec_logfile_write_interval(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_fsync_never(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_fsync_always(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_fsync_interval(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_logfile_stats(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_logfile_segments(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_logfile_line(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_logfile_time(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_rotate_size(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_rotate_interval(struct cli_parser_info_s *cpi_p);
+
+void
+exec_logfile_rotate_keep(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_cmd_timeout(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_hostname(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_cmd_length(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_history_size(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_length(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_length_auto(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_scrollback_memory(struct cli_parser_info_s *cpi_p);
+
+void
+exec_terminal_scrollback_disk(struct cli_parser_info_s *cpi_p);
+
 void
 exec_config_term(struct cli_parser_info_s *cpi_p);
 
+void
+exec_config_key_binding(struct cli_parser_info_s *cpi_p);
+
 void
 exec_quit(struct cli_parser_info_s *cpi_p);
 
@@ -45,4 +141,25 @@ exec_gvd_global(struct cli_parser_info_s *cpi_p);
 void
 exec_gvd_local(struct cli_parser_info_s *cpi_p);
 
+void
+exec_show_file(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_file_head(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_file_tail(struct cli_parser_info_s *cpi_p);
+
+void
+exec_show_file_count(struct cli_parser_info_s *cpi_p);
+
+void
+exec_more(struct cli_parser_info_s *cpi_p);
+
+void
+exec_dir(struct cli_parser_info_s *cpi_p);
+
+void
+exec_grep(struct cli_parser_info_s *cpi_p);
+
 #endif//__GVD_CLI_CFG_DEFAULT_H__
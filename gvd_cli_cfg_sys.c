@@ -1,6 +1,7 @@
 #include <pwd.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -10,10 +11,17 @@
 #include <sys/utsname.h>
 #include "gvd_tty.h"
 #include "gvd_util.h"
+#include "gvd_event.h"
 #include "gvd_common.h"
+#include "gvd_cli_tty.h"
+#include "gvd_key_map.h"
+#include "gvd_notify.h"
 #include "gvd_cli_tree.h"
 #include "gvd_cli_parser.h"
+#include "gvd_line_spill.h"
+#include "gvd_log_writer.h"
 #include "gvd_line_buffer.h"
+#include "gvd_session_rec.h"
 
 #ifdef __GVD_LINUX__
 #include <sys/sysinfo.h>
@@ -30,6 +38,23 @@
 #define SECS_PER_DAY  (24*SECS_PER_HOUR)
 #define SECS_PER_WEEK (7*SECS_PER_DAY)
 
+//! lines walked between checks of a cancel
+#define CONSOLE_CANCEL_CHECK_LINES 4096
+
+extern int is_autotest_mode;
+
+//lines [next_seq, end_seq) of the scrollback
+typedef struct console_more_ctx_s {
+    uint64_t next_seq;
+    uint64_t end_seq;
+} console_more_ctx_t;
+
+//commands [next_seq, end_seq) of the history
+typedef struct history_more_ctx_s {
+    uint32_t next_seq;
+    uint32_t end_seq;
+} history_more_ctx_t;
+
 void
 exec_show_time (struct cli_parser_info_s *cpi_p)
 {
@@ -174,6 +199,287 @@ exec_show_version (struct cli_parser_info_s *cpi_p)
 
 #endif
 
+void
+exec_show_scrollback (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    line_buffer_stats_t stats;
+
+    line_buffer_get_stats(&stats);
+
+    printb(output_p, "Lines %llu to %llu\n",
+           (unsigned long long)stats.first_seq,
+           (unsigned long long)stats.last_seq);
+    printb(output_p, "Memory: %llu lines, %llu of %u bytes\n",
+           (unsigned long long)stats.mem_lines,
+           (unsigned long long)stats.mem_bytes, stats.mem_size);
+    if (stats.spill.max_bytes == 0) {
+        printb(output_p, "Disk: disabled\n");
+        return;
+    }
+    printb(output_p, "Disk: %llu lines, %llu of %llu bytes, "
+           "%u segments, %u bytes mapped\n",
+           (unsigned long long)stats.spill.line_cnt,
+           (unsigned long long)stats.spill.bytes,
+           (unsigned long long)stats.spill.max_bytes,
+           stats.spill.seg_cnt, stats.spill.window_size);
+    return;
+}
+
+static bool
+console_more_handler (cli_parser_info_t *cpi_p, void *more_ctx,
+                      uint32_t line_cnt)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    console_more_ctx_t *ctx_p = more_ctx;
+    line_buffer_stats_t stats;
+    uint64_t time_ms, walked = 0;
+    uint32_t len;
+    time_t t;
+    struct tm tm;
+    char *data;
+
+    while (line_cnt > 0 && ctx_p->next_seq < ctx_p->end_seq) {
+        //lines dropped from disk while paging are skipped
+        if ((walked % CONSOLE_CANCEL_CHECK_LINES) == 0) {
+            line_buffer_get_stats(&stats);
+            if (ctx_p->next_seq < stats.first_seq) {
+                ctx_p->next_seq = stats.first_seq;
+                continue;
+            }
+        }
+        walked++;
+
+        if (!line_buffer_get_line(ctx_p->next_seq++, &data, &len, &time_ms)) {
+            continue;
+        }
+
+        t = time_ms/1000;
+        localtime_r(&t, &tm);
+        printb(output_p, "%02d:%02d:%02d.%03u ", tm.tm_hour, tm.tm_min,
+               tm.tm_sec, (uint32_t)(time_ms%1000));
+        printb_raw(output_p, data, len);
+        if (len == 0 || data[len-1] != '\n') {
+            printb(output_p, "\n");
+        }
+        line_cnt--;
+
+        if ((walked % CONSOLE_CANCEL_CHECK_LINES) == 0 &&
+            cli_parser_is_cancelled(cpi_p)) {
+            break;
+        }
+    }
+
+    return (ctx_p->next_seq < ctx_p->end_seq);
+}
+
+//lines since time_ms up to the command itself, page by page
+static void
+show_console_since (cli_parser_info_t *cpi_p, time_t t)
+{
+    console_more_ctx_t *ctx_p;
+    line_buffer_stats_t stats;
+    struct tm tm;
+
+    line_buffer_get_stats(&stats);
+
+    ctx_p = calloc(1, sizeof(console_more_ctx_t));
+    if (!ctx_p) {
+        return;
+    }
+    ctx_p->next_seq = line_buffer_find_time((uint64_t)t*1000);
+    ctx_p->end_seq = stats.last_seq;
+
+    if (ctx_p->next_seq >= ctx_p->end_seq) {
+        localtime_r(&t, &tm);
+        printb(&cpi_p->cli_output, "No lines since %02d:%02d:%02d.\n",
+               tm.tm_hour, tm.tm_min, tm.tm_sec);
+        free(ctx_p);
+        return;
+    }
+
+    cli_set_more_handler(cpi_p, console_more_handler, ctx_p, free);
+    return;
+}
+
+void
+exec_show_console_since (struct cli_parser_info_s *cpi_p)
+{
+    time_t t;
+
+    //a time still to come today means yesterday
+    t = get_today_time(GET_OBJ(P_INT, 0), GET_OBJ(P_INT, 1), 0);
+    if (t > time(NULL)) {
+        t -= SECS_PER_DAY;
+    }
+
+    show_console_since(cpi_p, t);
+    return;
+}
+
+void
+exec_show_console_last (struct cli_parser_info_s *cpi_p)
+{
+    show_console_since(cpi_p, time(NULL) - GET_OBJ(P_INT, 0)*SECS_PER_MIN);
+    return;
+}
+
+static bool
+history_more_handler (cli_parser_info_t *cpi_p, void *more_ctx,
+                      uint32_t line_cnt)
+{
+    history_more_ctx_t *ctx_p = more_ctx;
+    cmd_history_t *hist_p = cpi_p->tty_p->history_p;
+    uint32_t len;
+    char *data;
+
+    while (line_cnt > 0 && ctx_p->next_seq < ctx_p->end_seq) {
+        if (cmd_history_get(hist_p, ctx_p->next_seq, &data, &len)) {
+            printb(&cpi_p->cli_output, "%6u  ", ctx_p->next_seq);
+            printb_raw(&cpi_p->cli_output, data, len);
+            printb(&cpi_p->cli_output, "\n");
+            line_cnt--;
+        }
+        ctx_p->next_seq++;
+    }
+
+    return (ctx_p->next_seq < ctx_p->end_seq);
+}
+
+//commands of this terminal, oldest first, page by page
+void
+exec_show_history (struct cli_parser_info_s *cpi_p)
+{
+    cmd_history_t *hist_p = cpi_p->tty_p->history_p;
+    history_more_ctx_t *ctx_p;
+
+    if (!hist_p) {
+        printb(&cpi_p->cli_output, "No command history.\n");
+        return;
+    }
+
+    ctx_p = calloc(1, sizeof(history_more_ctx_t));
+    if (!ctx_p) {
+        return;
+    }
+    cmd_history_get_range(hist_p, &ctx_p->next_seq, &ctx_p->end_seq);
+
+    cli_set_more_handler(cpi_p, history_more_handler, ctx_p, free);
+    return;
+}
+
+void
+exec_show_terminal (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    gvd_tty_t *tty_p = cpi_p->tty_p;
+    scr_render_stats_t stats;
+    tty_input_stats_t input_stats;
+    tty_output_stats_t output_stats;
+    event_loop_stats_t event_stats;
+    notify_stats_t notify_stats;
+    cmd_history_stats_t hist_stats;
+    key_map_stats_t key_stats;
+
+    line_buffer_get_render_stats(&stats);
+
+    if (tty_p->term_len == GVD_TERM_LEN_AUTO) {
+        printb(output_p, "Length: auto, %u lines\n", tty_p->scr_len);
+    } else {
+        printb(output_p, "Length: %d lines\n", tty_p->term_len);
+    }
+    printb(output_p, "Command timeout: %u seconds\n", tty_p->cmd_timeout);
+    printb(output_p, "Command length: %u characters\n", tty_p->cmd_max_len);
+    printb(output_p, "Host name: %s\n",
+           tty_p->host_name[0]?tty_p->host_name:"system");
+    if (tty_p->history_p) {
+        cmd_history_get_stats(tty_p->history_p, &hist_stats);
+        printb(output_p, "History: %u of %u commands, %u bytes arena%s\n",
+               hist_stats.cnt, hist_stats.depth, hist_stats.arena_size,
+               hist_stats.saved?", saved":"");
+        printb(output_p, "History index: %s, %llu postings\n",
+               hist_stats.indexed?"built":"not built",
+               (unsigned long long)hist_stats.postings);
+    }
+    printb(output_p, "Screen updates: %llu, coalesced %llu\n",
+           (unsigned long long)stats.frames,
+           (unsigned long long)stats.frames_coalesced);
+    printb(output_p, "Full redraws: %llu, scrolls %llu\n",
+           (unsigned long long)stats.full_redraws,
+           (unsigned long long)stats.scrolls);
+    printb(output_p, "Rows drawn: %llu, unchanged %llu\n",
+           (unsigned long long)stats.rows_drawn,
+           (unsigned long long)stats.rows_skipped);
+    printb(output_p, "Wrap blocks: %llu counted, %llu skipped\n",
+           (unsigned long long)stats.wrap_blocks_counted,
+           (unsigned long long)stats.wrap_blocks_skipped);
+    printb(output_p, "Cell edits: %llu\n",
+           (unsigned long long)stats.cell_edits);
+    tty_get_input_stats(&input_stats);
+    printb(output_p, "Input keys: %llu in %llu reads, %llu pastes\n",
+           (unsigned long long)input_stats.keys,
+           (unsigned long long)input_stats.reads,
+           (unsigned long long)input_stats.pastes);
+    key_map_get_stats(&key_stats);
+    printb(output_p, "Key handling: avg %llu ns, max %llu ns\n",
+           (unsigned long long)(key_stats.keys?
+                                key_stats.handle_ns/key_stats.keys:0),
+           (unsigned long long)key_stats.handle_ns_max);
+    tty_get_output_stats(&output_stats);
+    printb(output_p, "Terminal: %s, %llu bytes in %llu writes\n",
+           tty_get_backend_name(),
+           (unsigned long long)output_stats.bytes,
+           (unsigned long long)output_stats.writes);
+    event_loop_get_stats(&event_stats);
+    printb(output_p, "Event loop: %u sources, %llu wakeups, "
+           "%llu fd %llu timer %llu signal events\n", event_stats.sources,
+           (unsigned long long)event_stats.wakeups,
+           (unsigned long long)event_stats.fd_events,
+           (unsigned long long)event_stats.timer_events,
+           (unsigned long long)event_stats.signal_events);
+    notify_get_stats(&notify_stats);
+    printb(output_p, "Notifications: %llu queued, %llu dropped, "
+           "%llu coalesced, %llu drains\n",
+           (unsigned long long)notify_stats.queued,
+           (unsigned long long)notify_stats.dropped,
+           (unsigned long long)notify_stats.coalesced,
+           (unsigned long long)notify_stats.drains);
+    return;
+}
+
+//each action with the keys bound to it
+void
+exec_show_key_bindings (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    char keys[128], name[KEY_MAP_NAME_MAX_LEN+1];
+    key_action_t *action_p;
+    uint32_t idx, len;
+    char *bound;
+    int key;
+
+    printb(output_p, "%-18s %-24s %s\n", "Action", "Keys", "Description");
+    for (idx = 0; (action_p = key_map_get_action(idx)); idx++) {
+        len = 0;
+        keys[0] = '\0';
+        for (key = 0; key < GVD_KEY_CODE_MAX; key++) {
+            bound = key_map_get_action_name(key);
+            if (!bound || strcmp(bound, action_p->name) != 0 ||
+                !key_map_get_name(key, name, sizeof(name))) {
+                continue;
+            }
+            len += snprintf(keys + len, sizeof(keys) - len, "%s%s",
+                            len?",":"", name);
+            if (len >= sizeof(keys)) {
+                len = sizeof(keys) - 1;
+            }
+        }
+        printb(output_p, "%-18s %-24s %s\n", action_p->name,
+               len?keys:"-", action_p->help_string);
+    }
+    return;
+}
+
 void
 exec_logfile_flush (struct cli_parser_info_s *cpi_p)
 {
@@ -189,12 +495,451 @@ exec_logfile_clear (struct cli_parser_info_s *cpi_p)
     return;
 }
 
+void
+exec_logfile_write_interval (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_flush_interval(GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_logfile_fsync_never (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_fsync(LOG_FSYNC_NEVER, 0);
+    return;
+}
+
+void
+exec_logfile_fsync_always (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_fsync(LOG_FSYNC_ALWAYS, 0);
+    return;
+}
+
+void
+exec_logfile_fsync_interval (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_fsync(LOG_FSYNC_INTERVAL, GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_logfile_rotate_size (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_rotate_size((uint64_t)GET_OBJ(P_INT, 0)*1024*1024);
+    return;
+}
+
+void
+exec_logfile_rotate_interval (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_rotate_interval(GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_logfile_rotate_keep (struct cli_parser_info_s *cpi_p)
+{
+    log_writer_set_rotate_keep(GET_OBJ(P_INT, 0));
+    return;
+}
+
+static void
+format_log_time (uint64_t time_us, char *buf, uint32_t len)
+{
+    time_t sec = time_us/1000000;
+    struct tm tm;
+
+    if (time_us == 0) {
+        safe_strncpy(buf, "-", len-1);
+        return;
+    }
+
+    localtime_r(&sec, &tm);
+    strftime(buf, len, "%m-%d %H:%M:%S", &tm);
+    return;
+}
+
+static log_segment_t *
+get_log_segments (uint32_t *cnt_p)
+{
+    log_segment_t *segs;
+
+    log_writer_sync();
+
+    segs = calloc(LOG_ROTATE_KEEP_MAX+1, sizeof(log_segment_t));
+    if (!segs) {
+        *cnt_p = 0;
+        return NULL;
+    }
+
+    *cnt_p = log_writer_get_segments(segs, LOG_ROTATE_KEEP_MAX+1);
+    return segs;
+}
+
+//seek with the segment index, then skip what's left line by line
+static void
+print_log_line (log_segment_t *seg_p, uint64_t line_no,
+                print_buffer_t *output_p)
+{
+    char name[LOG_NAME_MAX_LEN+16], *line = NULL;
+    log_index_entry_t entry;
+    size_t line_cap = 0;
+    ssize_t len = -1;
+    uint64_t i;
+    FILE *fp;
+
+    if (!log_writer_find_index_entry(seg_p->no, line_no, 0, &entry)) {
+        printb(output_p, "No index for line %llu.\n",
+               (unsigned long long)line_no);
+        return;
+    }
+
+    log_writer_get_segment_name(seg_p->no, FALSE, name, sizeof(name));
+    fp = fopen(name, "r");
+    if (!fp) {
+        printb(output_p, "Fail to open %s.\n", name);
+        return;
+    }
+
+    if (fseeko(fp, entry.offset, SEEK_SET) == 0) {
+        for (i = entry.line; i <= line_no; i++) {
+            len = getline(&line, &line_cap, fp);
+            if (len < 0) {
+                break;
+            }
+        }
+    }
+    fclose(fp);
+
+    if (len < 0) {
+        printb(output_p, "Fail to read line %llu from %s.\n",
+               (unsigned long long)line_no, name);
+    } else {
+        printb(output_p, "%s:%llu: %s%s", name, (unsigned long long)line_no,
+               line, (line[len-1] == '\n')?"":"\n");
+    }
+    free(line);
+    return;
+}
+
+void
+exec_show_logfile_segments (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    char name[LOG_NAME_MAX_LEN+16], first[32], last[32];
+    log_segment_t *segs;
+    uint32_t i, cnt;
+
+    segs = get_log_segments(&cnt);
+    if (!segs) {
+        return;
+    }
+
+    printb(output_p, "%-20s %10s %10s %12s %-14s %-14s\n",
+           "File", "First line", "Lines", "Bytes", "First time", "Last time");
+    for (i = 0; i < cnt; i++) {
+        log_writer_get_segment_name(segs[i].no, FALSE, name, sizeof(name));
+        format_log_time(segs[i].first_us, first, sizeof(first));
+        format_log_time(segs[i].last_us, last, sizeof(last));
+        printb(output_p, "%-20s %10llu %10llu %12llu %-14s %-14s\n", name,
+               (unsigned long long)segs[i].first_line,
+               (unsigned long long)segs[i].line_cnt,
+               (unsigned long long)segs[i].bytes, first, last);
+    }
+
+    free(segs);
+    return;
+}
+
+void
+exec_show_logfile_line (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    uint64_t line_no = GET_OBJ(P_INT, 0);
+    log_segment_t *segs;
+    uint32_t i, cnt;
+
+    segs = get_log_segments(&cnt);
+    if (!segs) {
+        return;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        if (line_no >= segs[i].first_line &&
+            line_no < segs[i].first_line + segs[i].line_cnt) {
+            break;
+        }
+    }
+
+    if (i == cnt) {
+        printb(output_p, "Line %llu is not in the log file.\n",
+               (unsigned long long)line_no);
+    } else {
+        print_log_line(&segs[i], line_no, output_p);
+    }
+
+    free(segs);
+    return;
+}
+
+void
+exec_show_logfile_time (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    log_index_entry_t entry;
+    log_segment_t *segs;
+    uint64_t time_us;
+    uint32_t i, cnt;
+    time_t t;
+
+    if (parse_clock_time(GET_OBJ(P_STRING, 0), &t) != 0) {
+        printb(output_p, "Invalid time %s, use hh:mm or hh:mm:ss.\n",
+               GET_OBJ(P_STRING, 0));
+        return;
+    }
+    time_us = (uint64_t)t*1000000;
+
+    segs = get_log_segments(&cnt);
+    if (!segs) {
+        return;
+    }
+
+    //first segment with lines logged since then, its index narrows it down
+    for (i = 0; i < cnt; i++) {
+        if (segs[i].line_cnt > 0 && segs[i].last_us >= time_us) {
+            break;
+        }
+    }
+
+    if (i == cnt ||
+        !log_writer_find_index_entry(segs[i].no, 0, time_us, &entry)) {
+        printb(output_p, "Nothing logged since %s.\n", GET_OBJ(P_STRING, 0));
+    } else {
+        print_log_line(&segs[i], entry.line, output_p);
+    }
+
+    free(segs);
+    return;
+}
+
+void
+exec_show_logfile_stats (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    log_writer_stats_t stats;
+
+    log_writer_get_stats(&stats);
+
+    printb(output_p, "Queue: %llu of %u bytes, %llu stalls\n",
+           (unsigned long long)stats.queue_bytes, stats.queue_size,
+           (unsigned long long)stats.stalls);
+    printb(output_p, "Written: %llu bytes in %llu writes\n",
+           (unsigned long long)stats.bytes_written,
+           (unsigned long long)stats.writes);
+    printb(output_p, "Write latency: avg %llu us, max %llu us\n",
+           (unsigned long long)(stats.writes?
+                                stats.write_us_total/stats.writes:0),
+           (unsigned long long)stats.write_us_max);
+    printb(output_p, "Write interval: %u ms, %llu rotations\n",
+           stats.flush_interval_ms, (unsigned long long)stats.rotations);
+    if (stats.fsync_policy == LOG_FSYNC_ALWAYS) {
+        printb(output_p, "Fsync: always, %llu done\n",
+               (unsigned long long)stats.fsyncs);
+    } else if (stats.fsync_policy == LOG_FSYNC_INTERVAL) {
+        printb(output_p, "Fsync: every %u seconds, %llu done\n",
+               stats.fsync_interval, (unsigned long long)stats.fsyncs);
+    } else {
+        printb(output_p, "Fsync: never\n");
+    }
+    return;
+}
+
+void
+exec_terminal_cmd_timeout (struct cli_parser_info_s *cpi_p)
+{
+    cpi_p->tty_p->cmd_timeout = GET_OBJ(P_INT, 0);
+    return;
+}
+
+void
+exec_terminal_cmd_length (struct cli_parser_info_s *cpi_p)
+{
+    cpi_p->tty_p->cmd_max_len = GET_OBJ(P_INT, 0);
+    return;
+}
+
+void
+exec_terminal_history_size (struct cli_parser_info_s *cpi_p)
+{
+    cmd_history_t *hist_p = cpi_p->tty_p->history_p;
+
+    if (!hist_p || cmd_history_set_depth(hist_p, GET_OBJ(P_INT, 0)) != 0) {
+        printb(&cpi_p->cli_output, "Failed to resize command history.\n");
+    }
+    return;
+}
+
+void
+exec_terminal_hostname (struct cli_parser_info_s *cpi_p)
+{
+    gvd_tty_set_host_name(cpi_p->tty_p, GET_OBJ(P_STRING, 0));
+    return;
+}
+
+void
+exec_terminal_length (struct cli_parser_info_s *cpi_p)
+{
+    cpi_p->tty_p->term_len = GET_OBJ(P_INT, 0);
+    return;
+}
+
+void
+exec_terminal_length_auto (struct cli_parser_info_s *cpi_p)
+{
+    cpi_p->tty_p->term_len = GVD_TERM_LEN_AUTO;
+    return;
+}
+
+void
+exec_terminal_scrollback_memory (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+
+    if (line_buffer_set_mem_size(GET_OBJ(P_INT, 0)*1024) != 0) {
+        printb(output_p, "Failed to resize scrollback memory.\n");
+    }
+    return;
+}
+
+void
+exec_terminal_scrollback_disk (struct cli_parser_info_s *cpi_p)
+{
+    line_spill_set_limit((uint64_t)GET_OBJ(P_INT, 0)*1024*1024);
+    return;
+}
+
+void
+exec_show_recording (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    session_rec_stats_t stats;
+
+    session_rec_get_stats(&stats);
+
+    if (!stats.running) {
+        printb(output_p, "Recording: off\n");
+        return;
+    }
+    printb(output_p, "Recording: %s\n", stats.name);
+    printb(output_p, "Records: %llu, %llu bytes\n",
+           (unsigned long long)stats.records,
+           (unsigned long long)stats.bytes);
+    printb(output_p, "Writes: %llu, %llu failed\n",
+           (unsigned long long)stats.writes,
+           (unsigned long long)stats.write_errors);
+    printb(output_p, "File size: %llu bytes\n",
+           (unsigned long long)stats.file_size);
+    if (stats.rotate_size) {
+        printb(output_p, "Rotation: at %llu MB, %u kept, %llu rotations\n",
+               (unsigned long long)stats.rotate_size/(1024*1024),
+               stats.rotate_keep, (unsigned long long)stats.rotations);
+    } else {
+        printb(output_p, "Rotation: off\n");
+    }
+    return;
+}
+
+void
+exec_recording_start (struct cli_parser_info_s *cpi_p)
+{
+    char *file_name = GET_OBJ(P_STRING, 0);
+
+    if (!file_name) {
+        file_name = SESSION_REC_NAME_DEFAULT;
+    }
+
+    if (session_rec_start(file_name) == -1) {
+        printb(&cpi_p->cli_output, "%% Can't record to %s.\n", file_name);
+    }
+    return;
+}
+
+void
+exec_recording_stop (struct cli_parser_info_s *cpi_p)
+{
+    session_rec_stop();
+    return;
+}
+
+void
+exec_recording_rotate_size (struct cli_parser_info_s *cpi_p)
+{
+    session_rec_set_rotate_size((uint64_t)GET_OBJ(P_INT, 0)*1024*1024);
+    return;
+}
+
+void
+exec_recording_rotate_keep (struct cli_parser_info_s *cpi_p)
+{
+    session_rec_set_rotate_keep(GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_send_log (struct cli_parser_info_s *cpi_p)
+{
+    char *msg = GET_OBJ(P_STRING, 0);
+    uint32_t count = GET_OBJ(P_INT, 0);
+
+    //no console drains the queue in autotest, the messages print here
+    if (is_autotest_mode) {
+        if (count > 1) {
+            printb(&cpi_p->cli_output, "%s (%u times)\n", msg, count);
+        } else {
+            printb(&cpi_p->cli_output, "%s\n", msg);
+        }
+        return;
+    }
+
+    //without count the message is posted right here
+    if (count == 0) {
+        (void)notify_post("%s", msg);
+        return;
+    }
+
+    if (notify_send_thread(msg, count) == -1) {
+        printb(&cpi_p->cli_output, "%% Can't start the sending thread.\n");
+    }
+    return;
+}
+
 void
 exec_config_term (struct cli_parser_info_s *cpi_p)
 {
     return;
 }
 
+//the key map is one for the process, a binding changes all terminals
+void
+exec_config_key_binding (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    int key;
+
+    key = key_map_get_code(GET_OBJ(P_STRING, 0));
+    if (key == -1) {
+        printb(output_p, "Unknown key %s.\n", GET_OBJ(P_STRING, 0));
+        return;
+    }
+
+    if (key_map_bind(key, GET_OBJ(P_STRING, 1)) != 0) {
+        printb(output_p, "Unknown action %s, see show key-bindings.\n",
+               GET_OBJ(P_STRING, 1));
+    }
+    return;
+}
+
 void
 exec_quit (struct cli_parser_info_s *cpi_p)
 {
@@ -229,7 +974,9 @@ exec_shell_cmd (struct cli_parser_info_s *cpi_p)
     print_buffer_t *output_p = &cpi_p->cli_output;
 
     cmd = GET_OBJ(P_STRING, 0);
-    run_shell_cmd(cmd, output_p);
+    run_shell_cmd(cmd, output_p, &cpi_p->cancel);
+    //the command may have set the system host name
+    gvd_tty_host_name_changed();
     printb(output_p, "\n\n");
     return;
 }
@@ -0,0 +1,571 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "gvd_util.h"
+#include "gvd_common.h"
+#include "gvd_file_view.h"
+#include "gvd_cli_parser.h"
+
+//! check for cancel once every so many lines
+#define FILE_CANCEL_CHECK_LINES 4096
+//! default directory for dir command
+#define DIR_DEFAULT_PATH "."
+#define DIR_ENTRY_TIME_MAX_LEN 31
+#define FILE_PATH_MAX_LEN 1023
+//! pattern without these chars is searched as plain string
+#define REGEX_META_CHARS ".[]()*+?{}|^$\\"
+
+enum {
+    FILE_SHOW_ALL = 0,
+    FILE_SHOW_HEAD,
+    FILE_SHOW_TAIL,
+    FILE_SHOW_COUNT,
+    FILE_GREP_LITERAL,
+    FILE_GREP_REGEX,
+};
+
+//state of a file command between pages
+typedef struct file_more_ctx_s {
+    file_view_t view;
+    int show_type;
+    //lines left to show for head
+    uint32_t lines_left;
+    //whole content, [cur, end) not walked yet, for tail and literal grep
+    char *content;
+    char *cur;
+    char *end;
+    char *pattern;
+    size_t pattern_len;
+    regex_t regex;
+} file_more_ctx_t;
+
+typedef struct dir_entry_s {
+    char *name;
+    struct stat stat_info;
+} dir_entry_t;
+
+//print [start, end) of file content, never copy into a temp string
+static void
+print_file_range (print_buffer_t *output_p, char *start, char *end)
+{
+    uint32_t len;
+
+    while (start < end) {
+        len = (end-start > UINT32_MAX/2)?(UINT32_MAX/2):(end-start);
+        printb_raw(output_p, start, len);
+        start += len;
+    }
+    return;
+}
+
+static void
+print_file_line (print_buffer_t *output_p, char *line, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    print_file_range(output_p, line, line+len);
+    if (line[len-1] != '\n') {
+        printb(output_p, "\n");
+    }
+    return;
+}
+
+//full file in one go, no need to split lines
+static bool
+show_file_all (cli_parser_info_t *cpi_p, file_more_ctx_t *ctx_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    char *chunk, last = '\n';
+    size_t len;
+
+    while (file_view_next_chunk(&ctx_p->view, &chunk, &len)) {
+        print_file_range(output_p, chunk, chunk+len);
+        last = chunk[len-1];
+        if (cli_parser_is_cancelled(cpi_p)) {
+            return TRUE;
+        }
+    }
+
+    if (last != '\n') {
+        printb(output_p, "\n");
+    }
+    return FALSE;
+}
+
+static bool
+show_file_lines (cli_parser_info_t *cpi_p, file_more_ctx_t *ctx_p,
+                 uint32_t line_cnt)
+{
+    uint32_t cnt, want;
+    char *span;
+    size_t len;
+
+    if (line_cnt == CLI_MORE_ALL && ctx_p->show_type == FILE_SHOW_ALL) {
+        return show_file_all(cpi_p, ctx_p);
+    }
+
+    for (;;) {
+        want = (line_cnt < ctx_p->lines_left)?line_cnt:ctx_p->lines_left;
+        if (want == 0 ||
+            !file_view_next_lines(&ctx_p->view, want, &span, &len, &cnt)) {
+            break;
+        }
+        print_file_line(&cpi_p->cli_output, span, len);
+        ctx_p->lines_left -= cnt;
+        line_cnt -= cnt;
+    }
+
+    return (ctx_p->lines_left > 0 && !file_view_at_end(&ctx_p->view));
+}
+
+//lines in [cur, end) of the content
+static bool
+show_content_lines (cli_parser_info_t *cpi_p, file_more_ctx_t *ctx_p,
+                    uint32_t line_cnt)
+{
+    char *next;
+
+    while (line_cnt > 0 && ctx_p->cur < ctx_p->end) {
+        next = memchr(ctx_p->cur, '\n', ctx_p->end-ctx_p->cur);
+        next = next?(next+1):ctx_p->end;
+        print_file_line(&cpi_p->cli_output, ctx_p->cur, next-ctx_p->cur);
+        ctx_p->cur = next;
+        line_cnt--;
+    }
+
+    return (ctx_p->cur < ctx_p->end);
+}
+
+static char *
+find_tail_start (char *content, size_t size, uint32_t line_cnt)
+{
+    char *p = content + size;
+
+    //the last line break ends the last line, not a new one
+    if (p > content && *(p-1) == '\n') {
+        p--;
+    }
+
+    while (p > content) {
+        if (*(p-1) == '\n') {
+            if (--line_cnt == 0) {
+                break;
+            }
+        }
+        p--;
+    }
+
+    return p;
+}
+
+static int
+init_file_tail (file_more_ctx_t *ctx_p, uint32_t line_cnt)
+{
+    size_t size;
+    int rc;
+
+    //mapped file only touches the last pages here
+    rc = file_view_get_content(&ctx_p->view, &ctx_p->content, &size);
+    if (rc == -1) {
+        return -1;
+    }
+
+    ctx_p->cur = find_tail_start(ctx_p->content, size, line_cnt);
+    ctx_p->end = ctx_p->content + size;
+    return 0;
+}
+
+static void
+show_file_count (cli_parser_info_t *cpi_p, file_view_t *view_p)
+{
+    uint64_t lines = 0, words = 0, bytes = 0;
+    bool in_word = FALSE;
+    char *chunk, *p;
+    size_t len;
+
+    while (file_view_next_chunk(view_p, &chunk, &len)) {
+        bytes += len;
+        for (p = chunk; p < chunk+len; p++) {
+            if (*p == '\n') {
+                lines++;
+            }
+            if (isspace((unsigned char)*p)) {
+                in_word = FALSE;
+            } else if (!in_word) {
+                in_word = TRUE;
+                words++;
+            }
+        }
+    }
+
+    printb(&cpi_p->cli_output, "Lines %llu, words %llu, bytes %llu\n",
+           (unsigned long long)lines, (unsigned long long)words,
+           (unsigned long long)bytes);
+    return;
+}
+
+//literal pattern, search whole content at once instead of line by line
+static bool
+grep_literal (cli_parser_info_t *cpi_p, file_more_ctx_t *ctx_p,
+              uint32_t line_cnt)
+{
+    char *p, *line, *next;
+
+    while (line_cnt > 0 && ctx_p->cur < ctx_p->end) {
+        p = gvd_memmem(ctx_p->cur, ctx_p->end-ctx_p->cur,
+                       ctx_p->pattern, ctx_p->pattern_len);
+        if (!p) {
+            ctx_p->cur = ctx_p->end;
+            break;
+        }
+
+        line = memrchr(ctx_p->content, '\n', p-ctx_p->content);
+        line = line?(line+1):ctx_p->content;
+        next = memchr(p, '\n', ctx_p->end-p);
+        next = next?(next+1):ctx_p->end;
+
+        print_file_line(&cpi_p->cli_output, line, next-line);
+        ctx_p->cur = next;
+        line_cnt--;
+
+        if (cli_parser_is_cancelled(cpi_p)) {
+            break;
+        }
+    }
+
+    return (ctx_p->cur < ctx_p->end);
+}
+
+static bool
+grep_regex (cli_parser_info_t *cpi_p, file_more_ctx_t *ctx_p,
+            uint32_t line_cnt)
+{
+    uint32_t walked = 0;
+    regmatch_t match;
+    char *line;
+    size_t len;
+
+    while (line_cnt > 0 && file_view_next_line(&ctx_p->view, &line, &len)) {
+        //match in place, line is not '\0' terminated
+        match.rm_so = 0;
+        match.rm_eo = (line[len-1] == '\n')?(len-1):len;
+        if (regexec(&ctx_p->regex, line, 1, &match, REG_STARTEND) == 0) {
+            print_file_line(&cpi_p->cli_output, line, len);
+            line_cnt--;
+        }
+
+        if ((++walked % FILE_CANCEL_CHECK_LINES) == 0 &&
+            cli_parser_is_cancelled(cpi_p)) {
+            break;
+        }
+    }
+
+    return !file_view_at_end(&ctx_p->view);
+}
+
+static bool
+file_more_handler (cli_parser_info_t *cpi_p, void *more_ctx, uint32_t line_cnt)
+{
+    file_more_ctx_t *ctx_p = more_ctx;
+
+    switch (ctx_p->show_type) {
+    case FILE_SHOW_TAIL:
+        return show_content_lines(cpi_p, ctx_p, line_cnt);
+
+    case FILE_GREP_LITERAL:
+        return grep_literal(cpi_p, ctx_p, line_cnt);
+
+    case FILE_GREP_REGEX:
+        return grep_regex(cpi_p, ctx_p, line_cnt);
+
+    default:
+        return show_file_lines(cpi_p, ctx_p, line_cnt);
+    }
+}
+
+static void
+free_file_more_ctx (void *more_ctx)
+{
+    file_more_ctx_t *ctx_p = more_ctx;
+
+    if (ctx_p->show_type == FILE_GREP_REGEX) {
+        regfree(&ctx_p->regex);
+    }
+    if (ctx_p->pattern) {
+        free(ctx_p->pattern);
+    }
+
+    file_view_close(&ctx_p->view);
+    free(ctx_p);
+    return;
+}
+
+static file_more_ctx_t *
+open_file_more_ctx (cli_parser_info_t *cpi_p, char *file_name, int show_type)
+{
+    file_more_ctx_t *ctx_p;
+    int rc;
+
+    ctx_p = calloc(1, sizeof(file_more_ctx_t));
+    if (!ctx_p) {
+        return NULL;
+    }
+
+    rc = file_view_open(&ctx_p->view, file_name);
+    if (rc == -1) {
+        printb(&cpi_p->cli_output, "%% Can't open file %s.\n\n", file_name);
+        free(ctx_p);
+        return NULL;
+    }
+
+    ctx_p->show_type = show_type;
+    return ctx_p;
+}
+
+//output is generated page by page after the command returns
+static void
+show_file (cli_parser_info_t *cpi_p, int show_type, uint32_t line_cnt)
+{
+    file_more_ctx_t *ctx_p;
+    int rc = 0;
+
+    ctx_p = open_file_more_ctx(cpi_p, GET_OBJ(P_STRING, 0), show_type);
+    if (!ctx_p) {
+        return;
+    }
+
+    switch (show_type) {
+    case FILE_SHOW_HEAD:
+        ctx_p->lines_left = line_cnt;
+        break;
+
+    case FILE_SHOW_TAIL:
+        rc = init_file_tail(ctx_p, line_cnt);
+        break;
+
+    case FILE_SHOW_COUNT:
+        show_file_count(cpi_p, &ctx_p->view);
+        rc = -1;
+        break;
+
+    default:
+        ctx_p->lines_left = UINT32_MAX;
+        break;
+    }
+
+    if (rc == -1) {
+        free_file_more_ctx(ctx_p);
+        return;
+    }
+
+    cli_set_more_handler(cpi_p, file_more_handler, ctx_p, free_file_more_ctx);
+    return;
+}
+
+void
+exec_show_file (struct cli_parser_info_s *cpi_p)
+{
+    show_file(cpi_p, FILE_SHOW_ALL, 0);
+    return;
+}
+
+void
+exec_show_file_head (struct cli_parser_info_s *cpi_p)
+{
+    show_file(cpi_p, FILE_SHOW_HEAD, GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_show_file_tail (struct cli_parser_info_s *cpi_p)
+{
+    show_file(cpi_p, FILE_SHOW_TAIL, GET_OBJ(P_INT, 0));
+    return;
+}
+
+void
+exec_show_file_count (struct cli_parser_info_s *cpi_p)
+{
+    show_file(cpi_p, FILE_SHOW_COUNT, 0);
+    return;
+}
+
+void
+exec_more (struct cli_parser_info_s *cpi_p)
+{
+    show_file(cpi_p, FILE_SHOW_ALL, 0);
+    return;
+}
+
+static int
+cmp_dir_entry (const void *a, const void *b)
+{
+    const dir_entry_t *entry_a = a, *entry_b = b;
+
+    return strcmp(entry_a->name, entry_b->name);
+}
+
+static void
+make_mode_str (mode_t mode, char *mode_str)
+{
+    char *perm = "rwxrwxrwx";
+    int i;
+
+    mode_str[0] = S_ISDIR(mode)?'d':(S_ISLNK(mode)?'l':'-');
+    for (i = 0; i < 9; i++) {
+        mode_str[i+1] = (mode & (1 << (8-i)))?perm[i]:'-';
+    }
+    mode_str[10] = '\0';
+    return;
+}
+
+static dir_entry_t *
+collect_dir_entries (char *dir_name, uint32_t *cnt_p)
+{
+    char path[FILE_PATH_MAX_LEN+1];
+    dir_entry_t *entries = NULL, *new_entries;
+    uint32_t cnt = 0, max_cnt = 0;
+    struct dirent *dirent_p;
+    DIR *dir_p;
+
+    dir_p = opendir(dir_name);
+    if (!dir_p) {
+        return NULL;
+    }
+
+    while ((dirent_p = readdir(dir_p)) != NULL) {
+        if (strcmp(dirent_p->d_name, ".") == 0 ||
+            strcmp(dirent_p->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (cnt == max_cnt) {
+            max_cnt = max_cnt?max_cnt*2:64;
+            new_entries = realloc(entries, max_cnt*sizeof(dir_entry_t));
+            if (!new_entries) {
+                break;
+            }
+            entries = new_entries;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", dir_name, dirent_p->d_name);
+        if (lstat(path, &entries[cnt].stat_info) == -1) {
+            continue;
+        }
+        entries[cnt].name = safe_clone(dirent_p->d_name, 0);
+        if (!entries[cnt].name) {
+            continue;
+        }
+        cnt++;
+    }
+
+    closedir(dir_p);
+
+    *cnt_p = cnt;
+    if (!entries) {
+        //empty directory is not an error
+        entries = calloc(1, sizeof(dir_entry_t));
+    }
+    return entries;
+}
+
+void
+exec_dir (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    char mode_str[11], time_str[DIR_ENTRY_TIME_MAX_LEN+1], *dir_name;
+    unsigned long long total_size = 0;
+    dir_entry_t *entries, *entry_p;
+    uint32_t i, cnt = 0;
+    struct tm tm;
+
+    dir_name = GET_OBJ(P_STRING, 0);
+    if (!dir_name) {
+        dir_name = DIR_DEFAULT_PATH;
+    }
+
+    entries = collect_dir_entries(dir_name, &cnt);
+    if (!entries) {
+        printb(output_p, "%% Can't open directory %s.\n\n", dir_name);
+        return;
+    }
+
+    qsort(entries, cnt, sizeof(dir_entry_t), cmp_dir_entry);
+
+    printb(output_p, "Directory of %s\n\n", dir_name);
+    for (i = 0; i < cnt; i++) {
+        entry_p = &entries[i];
+        make_mode_str(entry_p->stat_info.st_mode, mode_str);
+        localtime_r(&entry_p->stat_info.st_mtime, &tm);
+        strftime(time_str, sizeof(time_str), "%b %d %Y %H:%M", &tm);
+        printb(output_p, "  %s  %12llu  %s  %s\n", mode_str,
+               (unsigned long long)entry_p->stat_info.st_size,
+               time_str, entry_p->name);
+        total_size += entry_p->stat_info.st_size;
+        free(entry_p->name);
+    }
+    printb(output_p, "\n%u entries, %llu bytes\n\n", cnt, total_size);
+
+    free(entries);
+    return;
+}
+
+static bool
+is_pattern_literal (char *pattern)
+{
+    return (strpbrk(pattern, REGEX_META_CHARS) == NULL);
+}
+
+void
+exec_grep (struct cli_parser_info_s *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+    char *pattern, *file_name;
+    file_more_ctx_t *ctx_p;
+    size_t size;
+    int rc;
+
+    pattern = GET_OBJ(P_STRING, 0);
+    file_name = GET_OBJ(P_STRING, 1);
+
+    if (is_pattern_literal(pattern)) {
+        ctx_p = open_file_more_ctx(cpi_p, file_name, FILE_GREP_LITERAL);
+        if (!ctx_p) {
+            return;
+        }
+        ctx_p->pattern = safe_clone(pattern, 0);
+        ctx_p->pattern_len = strlen(pattern);
+        rc = file_view_get_content(&ctx_p->view, &ctx_p->content, &size);
+        if (rc == -1 || !ctx_p->pattern) {
+            free_file_more_ctx(ctx_p);
+            return;
+        }
+        ctx_p->cur = ctx_p->content;
+        ctx_p->end = ctx_p->content + size;
+    } else {
+        ctx_p = open_file_more_ctx(cpi_p, file_name, FILE_SHOW_ALL);
+        if (!ctx_p) {
+            return;
+        }
+        rc = regcomp(&ctx_p->regex, pattern, REG_EXTENDED|REG_NOSUB);
+        if (rc != 0) {
+            printb(output_p, "%% Invalid regular expression %s.\n\n", pattern);
+            free_file_more_ctx(ctx_p);
+            return;
+        }
+        ctx_p->show_type = FILE_GREP_REGEX;
+    }
+
+    cli_set_more_handler(cpi_p, file_more_handler, ctx_p, free_file_more_ctx);
+    return;
+}
@@ -0,0 +1,111 @@
+#ifndef __GVD_CLI_FILE_H__
+#define __GVD_CLI_FILE_H__
+
+#include "gvd_cli_base.h"
+#include "gvd_cli.h"
+
+/* grep WORD WORD */
+
+END(node_grep_end, exec_grep);
+
+STRING(node_grep_file,
+       node_grep_end,
+       NO_ALT,
+       OBJ(P_STRING, P1),
+       "File name");
+
+STRING(node_grep_pattern,
+       node_grep_file,
+       NO_ALT,
+       OBJ(P_STRING, P0),
+       "Regular expression, embraced with quotes if contain space");
+
+KEYWORD(node_grep,
+        node_grep_pattern,
+        NO_ALT,
+        "grep", "Print lines of a file matching a pattern");
+
+/* more WORD */
+
+END(node_more_end, exec_more);
+
+STRING(node_more_name,
+       node_more_end,
+       NO_ALT,
+       OBJ(P_STRING, P0),
+       "File name");
+
+KEYWORD(node_more,
+        node_more_name,
+        node_grep,
+        "more", "Display the contents of a file");
+
+/* dir [WORD] */
+
+END(node_dir_end, exec_dir);
+
+STRING(node_dir_name,
+       node_dir_end,
+       node_dir_end,
+       OBJ(P_STRING, P0),
+       "Directory name");
+
+KEYWORD(node_dir,
+        node_dir_name,
+        node_more,
+        "dir", "List files on a directory");
+
+/* show file WORD [head <1-1000000> | tail <1-1000000> | count] */
+
+END(node_show_file_end, exec_show_file);
+END(node_show_file_head_end, exec_show_file_head);
+END(node_show_file_tail_end, exec_show_file_tail);
+END(node_show_file_count_end, exec_show_file_count);
+
+KEYWORD(node_show_file_count,
+        node_show_file_count_end,
+        node_show_file_end,
+        "count", "Count lines, words and bytes");
+
+NUMBER(node_show_file_tail_cnt,
+       node_show_file_tail_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 1000000,
+       "Number of lines");
+
+KEYWORD(node_show_file_tail,
+        node_show_file_tail_cnt,
+        node_show_file_count,
+        "tail", "Show the last lines of the file");
+
+NUMBER(node_show_file_head_cnt,
+       node_show_file_head_end,
+       NO_ALT,
+       OBJ(P_INT, P0), 1, 1000000,
+       "Number of lines");
+
+KEYWORD(node_show_file_head,
+        node_show_file_head_cnt,
+        node_show_file_tail,
+        "head", "Show the first lines of the file");
+
+STRING(node_show_file_name,
+       node_show_file_head,
+       NO_ALT,
+       OBJ(P_STRING, P0),
+       "File name");
+
+KEYWORD(node_show_file,
+        node_show_file_name,
+        NO_ALT,
+        "file", "Contents of a file");
+
+KEYWORD(node_file_show,
+        node_show_file,
+        node_dir,
+        "show", "Show running system information");
+
+// Link to Exec mode
+LINK_ROOT(node_file_show, CLI_MODE_EXEC);
+
+#endif //__GVD_CLI_FILE_H__
@@ -0,0 +1,22 @@
+#include "gvd_util.h"
+#include "gvd_common.h"
+#include "gvd_cli_tree.h"
+#include "gvd_cli_file.h"
+
+static cli_tree_root_link_t *tree_root_links[] =
+{
+    &link_name(node_file_show, CLI_MODE_EXEC),
+};
+
+int
+gvd_init_file_cli_tree (void)
+{
+    int rc;
+
+    rc = cli_link_root_nodes(tree_root_links, ARRAY_LEN(tree_root_links));
+    if (rc == -1) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef __GVD_CLI_FILE_TREE_H__
+#define __GVD_CLI_FILE_TREE_H__
+
+int
+gvd_init_file_cli_tree(void);
+#endif //__GVD_CLI_FILE_TREE_H__
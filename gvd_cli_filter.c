@@ -0,0 +1,603 @@
+/*
+ * gvd_cli_filter.c
+ *
+ * Output modifiers, "command | include REGEX" and friends. The command
+ * output is filtered line by line as it's generated, so with a generator
+ * the full unfiltered output is never held at once.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gvd_util.h"
+#include "gvd_common.h"
+#include "gvd_cli_parser.h"
+#include "gvd_cli_filter.h"
+
+//! lines asked from the wrapped generator each time
+#define CLI_FILTER_BATCH_LINES 65536
+//! same as the indent of parser help
+#define CLI_FILTER_HELP_INDENT 2
+//! chars with special meaning in extended regex
+#define CLI_FILTER_REGEX_META ".[]()*+?{}|^$\\"
+//! longest literal kept for the prefilter, a cut required run still is one
+#define CLI_FILTER_LITERAL_MAX_LEN 255
+
+typedef struct cli_filter_type_s {
+    int type;
+    char *keyword;
+    char *help_string;
+} cli_filter_type_t;
+
+static cli_filter_type_t cli_filter_types[] = {
+    {CLI_FILTER_BEGIN,   "begin",   "Begin with the line that matches"},
+    {CLI_FILTER_COUNT,   "count",   "Count number of lines which match"},
+    {CLI_FILTER_EXCLUDE, "exclude", "Exclude lines that match"},
+    {CLI_FILTER_INCLUDE, "include", "Include lines that match"},
+    {CLI_FILTER_SECTION, "section", "Sections whose first line matches"},
+};
+
+//cut cli at the first '|' starting a token outside quotes
+char *
+cli_filter_split (char *cli)
+{
+    bool escaped = FALSE, in_quotes = FALSE;
+    char *p;
+
+    for (p = cli; *p; p++) {
+        if (escaped) {
+            escaped = FALSE;
+            continue;
+        }
+
+        switch (*p) {
+        case '\\':
+            escaped = TRUE;
+            break;
+
+        case '\"':
+            in_quotes = !in_quotes;
+            break;
+
+        case '|':
+            if (!in_quotes && (p == cli || *(p-1) == ' ')) {
+                *p = '\0';
+                return (p+1);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static char *
+skip_filter_spaces (char *str)
+{
+    while (*str == ' ') {
+        str++;
+    }
+    return str;
+}
+
+//filter types with keyword starting with token
+static uint32_t
+match_filter_types (char *token, uint32_t token_len,
+                    cli_filter_type_t **matches)
+{
+    uint32_t i, cnt = 0;
+
+    for (i = 0; i < ARRAY_LEN(cli_filter_types); i++) {
+        if (strncmp(cli_filter_types[i].keyword, token, token_len) == 0) {
+            matches[cnt++] = &cli_filter_types[i];
+        }
+    }
+
+    return cnt;
+}
+
+/*
+ * Longest run of plain chars any match of the pattern must contain.
+ * Only top level chars count, alternation gives up, and a char followed
+ * by a quantifier allowing zero is not required.
+ */
+static char *
+extract_required_literal (char *pattern, size_t *len_p)
+{
+    char run[CLI_FILTER_LITERAL_MAX_LEN+1];
+    char best[CLI_FILTER_LITERAL_MAX_LEN+1];
+    size_t run_len = 0, best_len = 0;
+    uint32_t depth = 0;
+    char *p = pattern;
+
+    if (strchr(pattern, '|')) {
+        return NULL;
+    }
+
+    for (;; p++) {
+        if (*p == '\0' || *p == '.' || *p == '^' || *p == '$' ||
+            *p == '(' || *p == ')' || *p == '[' || *p == '*' ||
+            *p == '?' || *p == '{' || *p == '+' || *p == '\\' || depth > 0) {
+            //these make the char before optional
+            if ((*p == '*' || *p == '?' || *p == '{') && run_len > 0) {
+                run_len--;
+            }
+            if (run_len > best_len) {
+                memcpy(best, run, run_len);
+                best_len = run_len;
+            }
+            run_len = 0;
+        }
+
+        if (*p == '\0') {
+            break;
+        }
+
+        if (*p == '(') {
+            depth++;
+        } else if (*p == ')') {
+            depth = depth?(depth-1):0;
+        } else if (*p == '[') {
+            //']' right after '[' or '[^' is a member, not the end
+            p += (p[1] == '^')?2:1;
+            p = strchr(p+(*p == ']'), ']');
+            if (!p) {
+                break;
+            }
+        } else if (*p == '{') {
+            p = strchr(p, '}');
+            if (!p) {
+                break;
+            }
+        } else if (*p == '\\') {
+            //escaped punctuation is itself, \w and the like are classes
+            if (p[1] == '\0') {
+                break;
+            }
+            p++;
+            if (depth == 0 && strchr(CLI_FILTER_REGEX_META, *p) &&
+                run_len < CLI_FILTER_LITERAL_MAX_LEN) {
+                run[run_len++] = *p;
+            }
+        } else if (depth == 0 && !strchr(CLI_FILTER_REGEX_META, *p) &&
+                   run_len < CLI_FILTER_LITERAL_MAX_LEN) {
+            run[run_len++] = *p;
+        }
+    }
+
+    if (best_len == 0) {
+        return NULL;
+    }
+
+    *len_p = best_len;
+    return safe_clone(best, best_len);
+}
+
+void
+cli_filter_free (cli_filter_t *filter_p)
+{
+    if (filter_p->more_ctx_free) {
+        filter_p->more_ctx_free(filter_p->more_ctx);
+    }
+    if (filter_p->literal) {
+        free(filter_p->literal);
+    }
+    if (!filter_p->literal_only) {
+        regfree(&filter_p->regex);
+    }
+
+    free_print_buffer(&filter_p->raw);
+    free_print_buffer(&filter_p->pending);
+    free(filter_p);
+    return;
+}
+
+cli_filter_t *
+cli_filter_create (char *filter_str, print_buffer_t *output_p)
+{
+    cli_filter_type_t *matches[ARRAY_LEN(cli_filter_types)];
+    cli_filter_t *filter_p;
+    char *token, *pattern;
+    uint32_t token_len;
+    size_t len;
+    int rc;
+
+    token = skip_filter_spaces(filter_str);
+    token_len = strcspn(token, " ");
+    if (token_len == 0 ||
+        match_filter_types(token, token_len, matches) != 1) {
+        printb(output_p, "%% Invalid output modifier.\n\n");
+        return NULL;
+    }
+
+    //rest of the line is the pattern, quotes are optional
+    pattern = skip_filter_spaces(token+token_len);
+    len = strlen(pattern);
+    if (len >= 2 && pattern[0] == '\"' && pattern[len-1] == '\"') {
+        pattern[len-1] = '\0';
+        pattern++;
+    }
+    if (*pattern == '\0') {
+        printb(output_p, "%% Regular expression is missing.\n\n");
+        return NULL;
+    }
+
+    filter_p = calloc(1, sizeof(cli_filter_t));
+    if (!filter_p) {
+        return NULL;
+    }
+    filter_p->type = matches[0]->type;
+
+    if (strpbrk(pattern, CLI_FILTER_REGEX_META) == NULL) {
+        filter_p->literal_only = TRUE;
+        filter_p->literal = safe_clone(pattern, 0);
+        filter_p->literal_len = strlen(pattern);
+    } else {
+        rc = regcomp(&filter_p->regex, pattern, REG_EXTENDED|REG_NOSUB);
+        if (rc != 0) {
+            printb(output_p, "%% Invalid regular expression %s.\n\n", pattern);
+            filter_p->literal_only = TRUE;
+            cli_filter_free(filter_p);
+            return NULL;
+        }
+        filter_p->literal = extract_required_literal(pattern,
+                                                     &filter_p->literal_len);
+    }
+
+    if ((filter_p->literal_only && !filter_p->literal) ||
+        alloc_print_buffer(&filter_p->raw) == -1 ||
+        alloc_print_buffer(&filter_p->pending) == -1) {
+        cli_filter_free(filter_p);
+        return NULL;
+    }
+
+    return filter_p;
+}
+
+static bool
+is_section_child (char *line)
+{
+    return (*line == ' ' || *line == '\t');
+}
+
+static void
+filter_emit (print_buffer_t *output_p, char *start, char *end)
+{
+    if (end > start) {
+        printb_raw(output_p, start, end-start);
+    }
+    return;
+}
+
+//[start, end) holds whole lines none of which matches
+static void
+filter_unmatched_range (cli_filter_t *filter_p, char *start, char *end,
+                        print_buffer_t *output_p)
+{
+    char *next;
+
+    switch (filter_p->type) {
+    case CLI_FILTER_EXCLUDE:
+        filter_emit(output_p, start, end);
+        break;
+
+    case CLI_FILTER_SECTION:
+        while (start < end) {
+            next = memchr(start, '\n', end-start);
+            next = next?(next+1):end;
+            if (!is_section_child(start)) {
+                filter_p->in_section = FALSE;
+            } else if (filter_p->in_section) {
+                filter_emit(output_p, start, next);
+            }
+            start = next;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+static void
+filter_one_line (cli_filter_t *filter_p, char *line, char *next, bool matched,
+                 print_buffer_t *output_p)
+{
+    switch (filter_p->type) {
+    case CLI_FILTER_BEGIN:
+        filter_p->begun = filter_p->begun || matched;
+        if (filter_p->begun) {
+            filter_emit(output_p, line, next);
+        }
+        break;
+
+    case CLI_FILTER_COUNT:
+        filter_p->match_cnt += matched;
+        break;
+
+    case CLI_FILTER_EXCLUDE:
+        if (!matched) {
+            filter_emit(output_p, line, next);
+        }
+        break;
+
+    case CLI_FILTER_INCLUDE:
+        if (matched) {
+            filter_emit(output_p, line, next);
+        }
+        break;
+
+    case CLI_FILTER_SECTION:
+        if (!is_section_child(line)) {
+            filter_p->in_section = matched;
+        }
+        if (filter_p->in_section) {
+            filter_emit(output_p, line, next);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+static bool
+filter_match_line (cli_filter_t *filter_p, char *line, char *next)
+{
+    regmatch_t match;
+
+    if (filter_p->literal_only) {
+        return TRUE;
+    }
+
+    //match in place, line is not '\0' terminated
+    match.rm_so = 0;
+    match.rm_eo = next - line;
+    if (match.rm_eo > 0 && line[match.rm_eo-1] == '\n') {
+        match.rm_eo--;
+    }
+    return (regexec(&filter_p->regex, line, 1, &match, REG_STARTEND) == 0);
+}
+
+/*
+ * Lines without the required literal can't match, jump from one literal
+ * hit to the next and only look at the lines holding them.
+ */
+static void
+filter_lines (cli_filter_t *filter_p, char *data, size_t len,
+              print_buffer_t *output_p)
+{
+    char *pos = data, *end = data + len, *hit, *line, *next;
+    bool matched;
+
+    while (pos < end) {
+        if (filter_p->type == CLI_FILTER_BEGIN && filter_p->begun) {
+            filter_emit(output_p, pos, end);
+            return;
+        }
+
+        hit = pos;
+        if (filter_p->literal) {
+            hit = gvd_memmem(pos, end-pos, filter_p->literal,
+                             filter_p->literal_len);
+            if (!hit) {
+                filter_unmatched_range(filter_p, pos, end, output_p);
+                return;
+            }
+        }
+
+        line = (hit > pos)?memrchr(pos, '\n', hit-pos):NULL;
+        line = line?(line+1):pos;
+        filter_unmatched_range(filter_p, pos, line, output_p);
+
+        next = memchr(hit, '\n', end-hit);
+        next = next?(next+1):end;
+        matched = filter_match_line(filter_p, line, next);
+        filter_one_line(filter_p, line, next, matched, output_p);
+        pos = next;
+    }
+
+    return;
+}
+
+//move up to line_cnt filtered lines to output, return lines moved
+static uint32_t
+take_pending_lines (cli_filter_t *filter_p, print_buffer_t *output_p,
+                    uint32_t line_cnt)
+{
+    print_buffer_t *pending_p = &filter_p->pending;
+    char *start, *p, *end;
+    uint32_t taken = 0;
+
+    start = pending_p->buf + filter_p->pending_pos;
+    end = pending_p->buf + pending_p->offset;
+    p = start;
+
+    while (p < end && taken < line_cnt) {
+        p = memchr(p, '\n', end-p);
+        p = p?(p+1):end;
+        taken++;
+    }
+
+    filter_emit(output_p, start, p);
+    filter_p->pending_pos += p - start;
+    if (filter_p->pending_pos == pending_p->offset) {
+        reset_print_buffer(pending_p);
+        filter_p->pending_pos = 0;
+    }
+
+    return taken;
+}
+
+static void
+finish_filter (cli_filter_t *filter_p, print_buffer_t *output_p)
+{
+    filter_p->done = TRUE;
+
+    if (filter_p->type == CLI_FILTER_COUNT) {
+        printb(output_p, "Number of lines which match regexp = %llu\n",
+               (unsigned long long)filter_p->match_cnt);
+    }
+    return;
+}
+
+static bool
+filter_more_handler (cli_parser_info_t *cpi_p, void *more_ctx,
+                     uint32_t line_cnt)
+{
+    cli_filter_t *filter_p = more_ctx;
+    print_buffer_t output, *target_p;
+    uint32_t taken;
+    bool more;
+
+    for (;;) {
+        taken = take_pending_lines(filter_p, &cpi_p->cli_output, line_cnt);
+        if (line_cnt != CLI_MORE_ALL) {
+            line_cnt -= taken;
+        }
+        if (line_cnt == 0 || filter_p->done ||
+            cli_parser_is_cancelled(cpi_p)) {
+            break;
+        }
+
+        //wrapped generator prints to raw buffer
+        output = cpi_p->cli_output;
+        reset_print_buffer(&filter_p->raw);
+        cpi_p->cli_output = filter_p->raw;
+        more = filter_p->more_handler(cpi_p, filter_p->more_ctx,
+                                      CLI_FILTER_BATCH_LINES);
+        filter_p->raw = cpi_p->cli_output;
+        cpi_p->cli_output = output;
+
+        //no paging, nothing to hold back
+        target_p = (line_cnt == CLI_MORE_ALL)?&cpi_p->cli_output:
+                                              &filter_p->pending;
+        filter_lines(filter_p, filter_p->raw.buf, filter_p->raw.offset,
+                     target_p);
+        if (!more) {
+            finish_filter(filter_p, target_p);
+        }
+    }
+
+    return (!filter_p->done ||
+            filter_p->pending_pos < filter_p->pending.offset);
+}
+
+static void
+filter_more_ctx_free (void *more_ctx)
+{
+    cli_filter_free(more_ctx);
+    return;
+}
+
+//filter takes over the command's generator
+void
+cli_filter_attach (cli_parser_info_t *cpi_p, cli_filter_t *filter_p)
+{
+    filter_p->more_handler = cpi_p->more_handler;
+    filter_p->more_ctx = cpi_p->more_ctx;
+    filter_p->more_ctx_free = cpi_p->more_ctx_free;
+
+    cli_set_more_handler(cpi_p, filter_more_handler, filter_p,
+                         filter_more_ctx_free);
+    return;
+}
+
+static void
+print_filter_help (print_buffer_t *output_p, char *keyword, char *help_string)
+{
+    printb(output_p, "%*s%-8s%*s%s\n", CLI_FILTER_HELP_INDENT, "", keyword,
+           CLI_FILTER_HELP_INDENT, "", help_string);
+    return;
+}
+
+void
+cli_filter_query (char *filter_str, print_buffer_t *output_p)
+{
+    cli_filter_type_t *matches[ARRAY_LEN(cli_filter_types)];
+    uint32_t token_len, cnt, i;
+    char *token;
+
+    token = skip_filter_spaces(filter_str);
+    token_len = strcspn(token, " ");
+    cnt = match_filter_types(token, token_len, matches);
+
+    if (cnt == 0) {
+        printb(output_p, "%% Invalid output modifier.\n\n");
+        return;
+    }
+
+    //keyword done, pattern next
+    if (token[token_len] == ' ') {
+        if (cnt == 1) {
+            print_filter_help(output_p, "LINE", "Regular expression");
+            printb(output_p, "\n");
+        } else {
+            printb(output_p, "%% Ambiguous output modifier.\n\n");
+        }
+        return;
+    }
+
+    printb(output_p, "Output modifiers:\n");
+    for (i = 0; i < cnt; i++) {
+        print_filter_help(output_p, matches[i]->keyword,
+                          matches[i]->help_string);
+    }
+    printb(output_p, "\n");
+    return;
+}
+
+//same output as the parser, new command line then keyword list if any
+void
+cli_filter_auto_fill (char *cli_org, uint32_t filter_offset, char *filter_str,
+                      print_buffer_t *output_p)
+{
+    cli_filter_type_t *matches[ARRAY_LEN(cli_filter_types)];
+    uint32_t token_len, token_offset, cnt, i, common_len;
+    char *token;
+
+    token = skip_filter_spaces(filter_str);
+    token_len = strlen(token);
+    if (token_len == 0 || strchr(token, ' ')) {
+        return;
+    }
+
+    cnt = match_filter_types(token, token_len, matches);
+    if (cnt == 0) {
+        return;
+    }
+
+    token_offset = filter_offset + (token - filter_str);
+    if (cnt == 1) {
+        printb(output_p, "%.*s%s \n", token_offset, cli_org,
+               matches[0]->keyword);
+        return;
+    }
+
+    common_len = strlen(matches[0]->keyword);
+    for (i = 1; i < cnt; i++) {
+        while (strncmp(matches[0]->keyword, matches[i]->keyword,
+                       common_len) != 0) {
+            common_len--;
+        }
+    }
+
+    printb(output_p, "%.*s%.*s\n", token_offset, cli_org, common_len,
+           matches[0]->keyword);
+    for (i = 0; i < cnt; i++) {
+        printb(output_p, "%s%*s", matches[i]->keyword,
+               (i+1 < cnt)?CLI_FILTER_HELP_INDENT:0, "");
+    }
+    printb(output_p, "\n");
+    return;
+}
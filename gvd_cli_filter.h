@@ -0,0 +1,60 @@
+#ifndef __GVD_CLI_FILTER_H__
+#define __GVD_CLI_FILTER_H__
+
+#include <regex.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "gvd_common.h"
+#include "gvd_cli_parser.h"
+
+enum {
+    CLI_FILTER_BEGIN = 0,
+    CLI_FILTER_COUNT,
+    CLI_FILTER_EXCLUDE,
+    CLI_FILTER_INCLUDE,
+    CLI_FILTER_SECTION,
+};
+
+//output modifier after '|', lives as long as the command output
+typedef struct cli_filter_s {
+    int type;
+    regex_t regex;
+    //any matching line must contain it, NULL if nothing is certain
+    char *literal;
+    size_t literal_len;
+    //pattern is plain string, literal hit is a match
+    bool literal_only;
+    bool begun;
+    bool in_section;
+    uint64_t match_cnt;
+    //wrapped generator of command output
+    cli_more_handler more_handler;
+    void *more_ctx;
+    cli_more_ctx_free more_ctx_free;
+    bool done;
+    //output of wrapped generator, one batch a time
+    print_buffer_t raw;
+    //filtered but not handed out, [pending_pos, offset)
+    print_buffer_t pending;
+    uint32_t pending_pos;
+} cli_filter_t;
+
+char *
+cli_filter_split(char *cli);
+
+cli_filter_t *
+cli_filter_create(char *filter_str, print_buffer_t *output_p);
+
+void
+cli_filter_free(cli_filter_t *filter_p);
+
+void
+cli_filter_attach(cli_parser_info_t *cpi_p, cli_filter_t *filter_p);
+
+void
+cli_filter_query(char *filter_str, print_buffer_t *output_p);
+
+void
+cli_filter_auto_fill(char *cli_org, uint32_t filter_offset, char *filter_str,
+                     print_buffer_t *output_p);
+#endif //__GVD_CLI_FILTER_H__
@@ -8,8 +8,8 @@
 #include "gvd_common.h"
 #include "gvd_cli_tree.h"
 #include "gvd_cli_parser.h"
-
-#define CLI_TOKEN_MAX_CNT 64
+#include "gvd_cli_filter.h"
+#include "gvd_session_rec.h"
 
 #define CLI_QUERY_INDENT_SPACE_CNT 2
 
@@ -24,8 +24,9 @@ enum {
     PARSER_EXIT_PARAM_FAIL,
 };
 
+//token_starts is sized for the command, free with free_split_info()
 typedef struct cli_split_info_s {
-    char *token_starts[CLI_TOKEN_MAX_CNT];
+    char **token_starts;
     uint32_t token_cnt;
 } cli_split_info_t;
 
@@ -34,6 +35,8 @@ typedef struct node_param_handler_s {
     bool (*node_handler)(cli_tree_node_t *, cli_parser_info_t *, char *);
 } node_param_handler_t;
 
+static cancel_poll_handler cancel_poll = NULL;
+
 static char *week_day[] = {"Monday", "Tuesday", "Wednesday", "Thursday",
                            "Friday", "Saturday", "Sunday"};
 
@@ -104,16 +107,31 @@ preprocess_cli (char *cli)
     return cli;
 }
 
+static void
+free_split_info (cli_split_info_t *split_info_p)
+{
+    free(split_info_p->token_starts);
+    memset(split_info_p, 0, sizeof(cli_split_info_t));
+    return;
+}
+
+//tokens are split by spaces, so there are at most half the chars plus one
 static int
 split_cli (char *cli, cli_split_info_t *split_info_p, char **err_pos)
 {
-    char **starts_p = split_info_p->token_starts;
+    char **starts_p;
     uint32_t token_cnt = 1;
     bool escaped = FALSE, in_quotes = FALSE;
 
     *err_pos = NULL;
     memset(split_info_p, 0, sizeof(cli_split_info_t));
 
+    starts_p = malloc((strlen(cli)/2 + 1) * sizeof(char *));
+    if (!starts_p) {
+        return -1;
+    }
+    split_info_p->token_starts = starts_p;
+
     *(starts_p++) = cli;
 
     while (*cli) {
@@ -130,7 +148,7 @@ split_cli (char *cli, cli_split_info_t *split_info_p, char **err_pos)
             } else {
                 *(cli++) = '\0';
                 cli = skip_spaces(cli);
-                if (token_cnt++ > CLI_TOKEN_MAX_CNT) return -1;
+                token_cnt++;
                 *(starts_p++) = cli;
             }
             break;
@@ -180,7 +198,7 @@ mark_fail_token (cli_parser_info_t *cpi_p, char *token)
         return;
     }
 
-    ps_len = get_ps_len();
+    (void)gvd_tty_get_ps(cpi_p->tty_p, &ps_len);
     token_pos = token - cpi_p->cli;
 
     len = ps_len + token_pos;
@@ -311,7 +329,7 @@ preprocess_str_param (char *token)
     }
 
     token_len = strlen(token);
-    str = calloc(token_len, sizeof(char));
+    str = calloc(token_len+1, sizeof(char));
     if (!str) {
         return NULL;
     }
@@ -595,6 +613,8 @@ parse_cli (cli_parser_info_t *cpi_p,
     }
 }
 
+static void attach_cli_filter(cli_parser_info_t *cpi_p);
+
 static int
 exec_cli (cli_parser_info_t *cpi_p, cli_tree_node_t *node_p)
 {
@@ -614,6 +634,9 @@ exec_cli (cli_parser_info_t *cpi_p, cli_tree_node_t *node_p)
 
     cpi_p->flag = node_p->flag;
     node_p->cli_handler(cpi_p);
+    if (cpi_p->filter_p) {
+        attach_cli_filter(cpi_p);
+    }
     if (cpi_p->process_result != PROCESS_CONTINUE) {
         return cpi_p->process_result;
     }
@@ -642,12 +665,14 @@ cli_parser_exec (cli_parser_info_t *cpi_p)
 
     ret = split_cli(cli, &split_info, &err_pos);
     if (ret == -1) {
+        free_split_info(&split_info);
         mark_fail_token(cpi_p, err_pos);
         printb(output_p, "Invalid command.\n\n");
         return PROCESS_CONTINUE;
     }
 
     node_p = parse_cli(cpi_p, &split_info);
+    free_split_info(&split_info);
     if (!node_p) {
         return PROCESS_CONTINUE;
     }
@@ -979,6 +1004,7 @@ cli_parser_query (cli_parser_info_t *cpi_p)
 
     ret = split_cli(cli, &split_info, &err_pos);
     if (ret == -1) {
+        free_split_info(&split_info);
         mark_fail_token(cpi_p, err_pos);
         printb(output_p, "Invalid command.\n\n");
         return;
@@ -987,12 +1013,13 @@ cli_parser_query (cli_parser_info_t *cpi_p)
     if (!last_token) {
         last_token = split_info.token_starts[split_info.token_cnt-1];
         split_info.token_cnt--;
-        if (*last_token == '\"') {
-            return;
-        }
     }
 
-    node_p = cli_query_get_help_node(cpi_p, &split_info);
+    node_p = NULL;
+    if (*last_token != '\"') {
+        node_p = cli_query_get_help_node(cpi_p, &split_info);
+    }
+    free_split_info(&split_info);
     if (!node_p) {
         return;
     }
@@ -1146,6 +1173,7 @@ cli_parser_auto_fill (cli_parser_info_t *cpi_p)
 
     ret = split_cli(cli, &split_info, &err_pos);
     if (ret == -1) {
+        free_split_info(&split_info);
         mark_fail_token(cpi_p, err_pos);
         printb(output_p, "Invalid command.\n\n");
         return;
@@ -1153,11 +1181,11 @@ cli_parser_auto_fill (cli_parser_info_t *cpi_p)
 
     last_token = split_info.token_starts[split_info.token_cnt-1];
     split_info.token_cnt--;
-    if (*last_token == '\"') {
-        return;
+    node_p = NULL;
+    if (*last_token != '\"') {
+        node_p = cli_query_get_help_node(cpi_p, &split_info);
     }
-
-    node_p = cli_query_get_help_node(cpi_p, &split_info);
+    free_split_info(&split_info);
     if (!node_p) {
         return;
     }
@@ -1227,6 +1255,8 @@ init_cli_parser_info (cli_parser_info_t *cpi_p, char *cli_in)
     cpi_p->cli = cli;
     cpi_p->cli_org = cli_in;
     cpi_p->process_result = PROCESS_CONTINUE;
+    cpi_p->filter_str = cli_filter_split(cli);
+    cpi_p->filter_p = NULL;
     memset(cpi_p->P_INT_buf, 0, P_MAX*sizeof(int));
     memset(cpi_p->P_STRING_buf, 0, P_MAX*sizeof(char *));
 
@@ -1249,6 +1279,11 @@ clean_cli_parser_info (cli_parser_info_t *cpi_p)
     }
 
     free(cpi_p->cli);
+    free(cpi_p->user_data);
+
+    if (cpi_p->filter_p) {
+        cli_filter_free(cpi_p->filter_p);
+    }
 
     if (cpi_p->cli_output.buf) {
         free(cpi_p->cli_output.buf);
@@ -1259,6 +1294,10 @@ clean_cli_parser_info (cli_parser_info_t *cpi_p)
     cpi_p->set_default = 0;
     cpi_p->root_node_p = NULL;
     cpi_p->cli = NULL;
+    cpi_p->user_data = NULL;
+    cpi_p->user_data_len = 0;
+    cpi_p->filter_str = NULL;
+    cpi_p->filter_p = NULL;
     memset(cpi_p->P_INT_buf, 0, P_MAX*sizeof(int));
     memset(cpi_p->P_STRING_buf, 0, P_MAX*sizeof(char *));
     memset(&cpi_p->cli_output, 0, sizeof(print_buffer_t));
@@ -1266,14 +1305,310 @@ clean_cli_parser_info (cli_parser_info_t *cpi_p)
     return;
 }
 
+//a copy of data is kept until the command is done, any length
+int
+cli_parser_set_user_data (cli_parser_info_t *cpi_p, void *data, uint32_t len)
+{
+    char *user_data;
+
+    user_data = malloc(len + 1);
+    if (!user_data) {
+        return -1;
+    }
+    memcpy(user_data, data, len);
+    user_data[len] = '\0';
+
+    free(cpi_p->user_data);
+    cpi_p->user_data = user_data;
+    cpi_p->user_data_len = len;
+    return 0;
+}
+
+bool
+cli_parser_is_cancelled (cli_parser_info_t *cpi_p)
+{
+    return is_cancelled(&cpi_p->cancel);
+}
+
+void
+cli_parser_set_cancel_poll (cancel_poll_handler poll_handler)
+{
+    cancel_poll = poll_handler;
+    return;
+}
+
+static void
+report_cli_cancelled (cli_parser_info_t *cpi_p)
+{
+    print_buffer_t *output_p = &cpi_p->cli_output;
+
+    switch (cpi_p->cancel.reason) {
+    case CANCEL_REASON_USER:
+        printb(output_p, "\n%% Command aborted.\n\n");
+        break;
+
+    case CANCEL_REASON_TIMEOUT:
+        printb(output_p, "\n%% Command timed out after %u seconds.\n\n",
+               cpi_p->tty_p->cmd_timeout);
+        break;
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+void
+cli_set_more_handler (cli_parser_info_t *cpi_p, cli_more_handler handler,
+                      void *more_ctx, cli_more_ctx_free ctx_free)
+{
+    cpi_p->more_handler = handler;
+    cpi_p->more_ctx = more_ctx;
+    cpi_p->more_ctx_free = ctx_free;
+    return;
+}
+
+bool
+cli_parser_more_pending (gvd_tty_t *tty_p)
+{
+    return (tty_p->cpi.more_handler != NULL);
+}
+
+void
+cli_parser_more_stop (gvd_tty_t *tty_p)
+{
+    cli_parser_info_t *cpi_p = &tty_p->cpi;
+
+    if (cpi_p->more_ctx_free) {
+        cpi_p->more_ctx_free(cpi_p->more_ctx);
+    }
+
+    cpi_p->more_handler = NULL;
+    cpi_p->more_ctx = NULL;
+    cpi_p->more_ctx_free = NULL;
+    return;
+}
+
+static uint32_t
+get_page_len (gvd_tty_t *tty_p)
+{
+    if (tty_p->term_len != GVD_TERM_LEN_AUTO) {
+        return tty_p->term_len;
+    }
+
+    //keep the last line for --More--
+    if (tty_p->scr_len > 1) {
+        return tty_p->scr_len - 1;
+    }
+
+    return 0;
+}
+
+static void
+run_more_handler (cli_parser_info_t *cpi_p, uint32_t line_cnt)
+{
+    bool more;
+
+    if (line_cnt == CLI_MORE_PAGE) {
+        line_cnt = get_page_len(cpi_p->tty_p);
+    }
+    if (line_cnt == 0) {
+        line_cnt = CLI_MORE_ALL;
+    }
+
+    more = cpi_p->more_handler(cpi_p, cpi_p->more_ctx, line_cnt);
+    if (!more || cli_parser_is_cancelled(cpi_p)) {
+        cli_parser_more_stop(cpi_p->tty_p);
+    }
+
+    return;
+}
+
+typedef struct cli_more_text_s {
+    char *buf;
+    //first byte not printed yet
+    char *cur;
+} cli_more_text_t;
+
+//pointer after the first line_cnt lines of text
+static char *
+skip_text_lines (char *text, uint32_t line_cnt)
+{
+    char *p = text;
+
+    while (line_cnt > 0 && *p) {
+        p = strchr(p, '\n');
+        if (!p) {
+            return text + strlen(text);
+        }
+        p++;
+        line_cnt--;
+    }
+
+    return p;
+}
+
+static bool
+more_text_handler (cli_parser_info_t *cpi_p, void *more_ctx, uint32_t line_cnt)
+{
+    cli_more_text_t *text_p = more_ctx;
+    char *end;
+
+    end = skip_text_lines(text_p->cur, line_cnt);
+    printb_raw(&cpi_p->cli_output, text_p->cur, end-text_p->cur);
+    text_p->cur = end;
+
+    return (*end != '\0');
+}
+
+static void
+free_more_text (void *more_ctx)
+{
+    cli_more_text_t *text_p = more_ctx;
+
+    free(text_p->buf);
+    free(text_p);
+    return;
+}
+
+//hand out what's in cli_output through a generator
+static bool
+move_output_to_more_text (cli_parser_info_t *cpi_p)
+{
+    cli_more_text_t *text_p;
+    char *buf = cpi_p->cli_output.buf;
+    int rc;
+
+    text_p = calloc(1, sizeof(cli_more_text_t));
+    if (!text_p) {
+        return FALSE;
+    }
+
+    rc = alloc_print_buffer(&cpi_p->cli_output);
+    if (rc == -1) {
+        cpi_p->cli_output.buf = buf;
+        free(text_p);
+        return FALSE;
+    }
+
+    text_p->buf = buf;
+    text_p->cur = buf;
+    cli_set_more_handler(cpi_p, more_text_handler, text_p, free_more_text);
+    return TRUE;
+}
+
+//output not from a generator but longer than a page, hand it out page by page
+static void
+page_cli_output (cli_parser_info_t *cpi_p, uint32_t page_len)
+{
+    char *buf = cpi_p->cli_output.buf;
+
+    if (!buf || *skip_text_lines(buf, page_len) == '\0') {
+        return;
+    }
+
+    if (move_output_to_more_text(cpi_p)) {
+        run_more_handler(cpi_p, page_len);
+    }
+    return;
+}
+
+//the filter works on what the handler printed or will generate
+static void
+attach_cli_filter (cli_parser_info_t *cpi_p)
+{
+    if (!cpi_p->more_handler && !move_output_to_more_text(cpi_p)) {
+        return;
+    }
+
+    cli_filter_attach(cpi_p, cpi_p->filter_p);
+    cpi_p->filter_p = NULL;
+    return;
+}
+
+//commands of spaces only are not kept
+static void
+record_cli_history (gvd_tty_t *tty_p, char *cli)
+{
+    uint32_t len = strlen(cli);
+
+    if (!tty_p->history_p || strspn(cli, " ") == len) {
+        return;
+    }
+
+    cmd_history_add(tty_p->history_p, cli, len);
+    return;
+}
+
+static void
+record_cli_output (gvd_tty_t *tty_p, char *output)
+{
+    if (output && *output) {
+        session_rec_append(SESSION_REC_OUTPUT, tty_p->vty_id, output,
+                           strlen(output));
+    }
+    return;
+}
+
+//next piece of output from the pending generator
+bool
+cli_parser_more (gvd_tty_t *tty_p, uint32_t line_cnt, char **output)
+{
+    cli_parser_info_t *cpi_p = &tty_p->cpi;
+    int rc;
+
+    *output = NULL;
+
+    if (!cpi_p->more_handler) {
+        return FALSE;
+    }
+
+    rc = alloc_print_buffer(&cpi_p->cli_output);
+    if (rc == -1) {
+        cli_parser_more_stop(tty_p);
+        return FALSE;
+    }
+
+    arm_cancel_token(&cpi_p->cancel, tty_p->cmd_timeout, cancel_poll);
+    run_more_handler(cpi_p, line_cnt);
+    report_cli_cancelled(cpi_p);
+    disarm_cancel_token(&cpi_p->cancel);
+
+    *output = safe_clone(cpi_p->cli_output.buf, 0);
+    free_print_buffer(&cpi_p->cli_output);
+    memset(&cpi_p->cli_output, 0, sizeof(print_buffer_t));
+    record_cli_output(tty_p, *output);
+
+    return cli_parser_more_pending(tty_p);
+}
+
 int
 cli_parser_request (gvd_tty_t *tty_p, int req_code, char *cli_in, char **output)
 {
     cli_parser_info_t *cpi_p = &tty_p->cpi;
+    char msg[128];
     int ret;
 
     *output = NULL;
 
+    //a new request drops what's left from the last generator
+    cli_parser_more_stop(tty_p);
+
+    //refused before it's split, recorded or kept in the history
+    if (req_code == PARSER_REQ_EXEC && strlen(cli_in) > tty_p->cmd_max_len) {
+        snprintf(msg, sizeof(msg), "Command longer than %u characters, "
+                 "see terminal command-length.\n\n", tty_p->cmd_max_len);
+        *output = safe_clone(msg, 0);
+        return PROCESS_CONTINUE;
+    }
+
+    if (req_code == PARSER_REQ_EXEC) {
+        session_rec_append(SESSION_REC_INPUT, tty_p->vty_id, cli_in,
+                           strlen(cli_in));
+        record_cli_history(tty_p, cli_in);
+    }
+
     ret = init_cli_parser_info(cpi_p, cli_in);
     if (ret == -1) {
         return PROCESS_CONTINUE;
@@ -1285,15 +1620,43 @@ cli_parser_request (gvd_tty_t *tty_p, int req_code, char *cli_in, char **output)
 
     switch (req_code) {
     case PARSER_REQ_EXEC:
+        if (cpi_p->filter_str) {
+            cpi_p->filter_p = cli_filter_create(cpi_p->filter_str,
+                                                &cpi_p->cli_output);
+            if (!cpi_p->filter_p) {
+                ret = PROCESS_CONTINUE;
+                break;
+            }
+        }
+        arm_cancel_token(&cpi_p->cancel, tty_p->cmd_timeout, cancel_poll);
         ret = cli_parser_exec(cpi_p);
+        if (cpi_p->more_handler) {
+            run_more_handler(cpi_p, CLI_MORE_PAGE);
+        } else if (get_page_len(tty_p) > 0) {
+            page_cli_output(cpi_p, get_page_len(tty_p));
+        }
+        report_cli_cancelled(cpi_p);
+        disarm_cancel_token(&cpi_p->cancel);
         break;
 
     case PARSER_REQ_QUERY:
+        if (cpi_p->filter_str) {
+            cli_filter_query(cpi_p->filter_str, &cpi_p->cli_output);
+            ret = PROCESS_CONTINUE;
+            break;
+        }
         cli_parser_query(cpi_p);
         ret = PROCESS_CONTINUE;
         break;
 
     case PARSER_REQ_AUTO_FILL:
+        if (cpi_p->filter_str) {
+            cli_filter_auto_fill(cpi_p->cli_org,
+                                 cpi_p->filter_str - cpi_p->cli,
+                                 cpi_p->filter_str, &cpi_p->cli_output);
+            ret = PROCESS_CONTINUE;
+            break;
+        }
         cli_parser_auto_fill(cpi_p);
         ret = PROCESS_CONTINUE;
         break;
@@ -1303,6 +1666,9 @@ cli_parser_request (gvd_tty_t *tty_p, int req_code, char *cli_in, char **output)
     }
 
     *output = safe_clone(cpi_p->cli_output.buf, 0);
+    if (req_code == PARSER_REQ_EXEC) {
+        record_cli_output(tty_p, *output);
+    }
 
     clean_cli_parser_info(cpi_p);
     return ret;
@@ -5,7 +5,10 @@
 #include "gvd_common.h"
 #include "gvd_cli_tree.h"
 
-#define USER_DATA_MAX_LEN 127
+//! line_cnt for cli_parser_more(), one page of the terminal
+#define CLI_MORE_PAGE 0
+//! line_cnt for more handler, no paging
+#define CLI_MORE_ALL UINT32_MAX
 
 #define OBJ(type, idx) (type<<8 | idx)
 
@@ -32,12 +35,21 @@ enum {
 };
 
 struct gvd_tty_s;
+struct cli_filter_s;
+struct cli_parser_info_s;
+
+//! print up to line_cnt lines to cli_output, return FALSE when all done
+typedef bool (*cli_more_handler)(struct cli_parser_info_s *cpi_p,
+                                 void *more_ctx, uint32_t line_cnt);
+typedef void (*cli_more_ctx_free)(void *more_ctx);
 
 typedef struct cli_parser_info_s {
     int flag;
     bool set_no;
     bool set_default;
-    char user_data[USER_DATA_MAX_LEN+1];
+    //handler's own data, see cli_parser_set_user_data()
+    char *user_data;
+    uint32_t user_data_len;
     int P_INT_buf[P_MAX];
     char *P_STRING_buf[P_MAX];
     print_buffer_t cli_output;
@@ -46,10 +58,27 @@ typedef struct cli_parser_info_s {
     char *cli;
     char *cli_org;
     int process_result;
+    cancel_token_t cancel;
+    //text after '|', and the filter made from it until it's attached
+    char *filter_str;
+    struct cli_filter_s *filter_p;
+    //output generator, lives across requests until all output is done
+    cli_more_handler more_handler;
+    void *more_ctx;
+    cli_more_ctx_free more_ctx_free;
 } cli_parser_info_t;
 
 int cli_parser_request(struct gvd_tty_s *tty_p, int req_code, char *cmd,
                        char **output);
-uint32_t get_ps_len(void);
+bool cli_parser_is_cancelled(cli_parser_info_t *cpi_p);
+int cli_parser_set_user_data(cli_parser_info_t *cpi_p, void *data,
+                             uint32_t len);
+void cli_set_more_handler(cli_parser_info_t *cpi_p, cli_more_handler handler,
+                          void *more_ctx, cli_more_ctx_free ctx_free);
+bool cli_parser_more_pending(struct gvd_tty_s *tty_p);
+bool cli_parser_more(struct gvd_tty_s *tty_p, uint32_t line_cnt,
+                     char **output);
+void cli_parser_more_stop(struct gvd_tty_s *tty_p);
+void cli_parser_set_cancel_poll(cancel_poll_handler poll_handler);
 char *gvd_run_cli(struct gvd_tty_s *tty_p, char *cli);
 #endif //__GVD_CLI_PARSER_H__
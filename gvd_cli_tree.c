@@ -5,8 +5,12 @@
 #include "gvd_tty.h"
 #include "gvd_util.h"
 #include "gvd_common.h"
+#include "gvd_key_map.h"
+#include "gvd_notify.h"
+#include "gvd_session_rec.h"
 #include "gvd_cfg_sys.h"
 #include "gvd_cli_tree.h"
+#include "gvd_cli_file_tree.h"
 #include "gvd_cli_example_tree.h"
 
 #define EXIT_HELP_STR_MAX_LEN 63
@@ -40,6 +44,7 @@ static cli_tree_root_link_t *tree_root_links[] =
 {
     &link_name(node_quit, CLI_MODE_EXEC),
     &link_name(node_shell_exec, CLI_MODE_SHELL),
+    &link_name(node_config_key_bind, CLI_MODE_CONFIG),
 };
 
 static cli_mode_t *exec_mode_p = NULL;
@@ -52,9 +57,7 @@ cli_mode_t *
 gvd_find_cli_mode (int mode)
 {
     uint32_t i;
-    cli_mode_t *cli_mode_p;
 
-    cli_mode_p = cli_mode_buf_p;
     for (i = 0; i < cli_mode_cnt; i++) {
         if (cli_mode_buf_p[i].mode == mode) {
             return &cli_mode_buf_p[i];
@@ -454,6 +457,11 @@ gvd_init_cli_tree (void)
         return -1;
     }
 
+    rc = gvd_init_file_cli_tree();
+    if (rc == -1) {
+        return -1;
+    }
+
     rc = gvd_init_example_cli_tree();
     if (rc == -1) {
         return -1;
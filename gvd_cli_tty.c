@@ -5,12 +5,32 @@
  * October, 2014
  */
 
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <ncurses.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "gvd_util.h"
 #include "gvd_cli_tty.h"
+#include "gvd_cli_tty_vt100.h"
 
-void
-tty_init (void)
+//! tab stop width when drawing a row
+#define TTY_TAB_SIZE 8
+
+static tty_input_stats_t tty_input_stats;
+static tty_output_stats_t tty_output_stats;
+
+static tty_ops_t curses_tty_ops;
+static tty_ops_t *tty_ops_p = &curses_tty_ops;
+
+//row being drawn, as wide as the screen
+static tty_cell_t *tty_row_cells = NULL;
+static uint32_t tty_row_size = 0;
+
+static void
+curses_tty_init (void)
 {
     initscr();
     //cbreak();
@@ -18,32 +38,322 @@ tty_init (void)
     //Enter key is \n in nl(), \r in nonl()
     nl();
     scrollok(stdscr, FALSE);
+    //let curses scroll with terminal line ops instead of repainting
+    idlok(stdscr, TRUE);
     noecho();
     intrflush(stdscr, FALSE);
     keypad(stdscr, TRUE);
+    define_key("\033[200~", GVD_KEY_PASTE_START);
+    define_key("\033[201~", GVD_KEY_PASTE_END);
     refresh();
+    printf(TTY_PASTE_ON);
+    fflush(stdout);
+}
+
+static void
+curses_tty_reset (void)
+{
+    printf(TTY_PASTE_OFF);
+    fflush(stdout);
+    endwin();
+}
+
+//getch() updates the screen first
+static bool
+curses_tty_read_key (int *key_p, bool block)
+{
+    int key;
+
+    if (!block) {
+        nodelay(stdscr, TRUE);
+    }
+    key = getch();
+    if (!block) {
+        nodelay(stdscr, FALSE);
+    }
+
+    if (key == ERR) {
+        return FALSE;
+    }
+
+    *key_p = key;
+    return TRUE;
+}
+
+static void
+curses_tty_get_cursor (uint32_t *y_p, uint32_t *x_p)
+{
+    int x, y;
+
+    getyx(stdscr, y, x);
+    *y_p = y;
+    *x_p = x;
+    return;
+}
+
+static void
+curses_tty_move_cursor (uint32_t y, uint32_t x)
+{
+    move(y, x);
+    return;
+}
+
+static void
+curses_tty_get_scr_size (uint32_t *y_p, uint32_t *x_p)
+{
+    getmaxyx(stdscr, *y_p, *x_p);
+    return;
+}
+
+static chtype
+get_mark_attr (uint8_t mark)
+{
+    switch (mark) {
+    case TTY_MARK_MATCH:
+        return A_REVERSE;
+    case TTY_MARK_CURRENT:
+        return A_REVERSE | A_BOLD | A_UNDERLINE;
+    default:
+        return A_NORMAL;
+    }
+}
+
+static void
+curses_tty_draw_row (uint32_t y, tty_cell_t *cells, uint32_t cnt)
+{
+    uint32_t x;
+
+    move(y, 0);
+    for (x = 0; x < cnt; x++) {
+        addch((unsigned char)cells[x].ch | get_mark_attr(cells[x].mark));
+    }
+
+    //row is full, cursor already wrapped to the next row
+    if (cnt < (uint32_t)getmaxx(stdscr)) {
+        clrtoeol();
+    }
+    return;
+}
+
+//positive count moves content up, negative moves it down
+static void
+curses_tty_scroll_rows (int cnt)
+{
+    scrollok(stdscr, TRUE);
+    wscrl(stdscr, cnt);
+    scrollok(stdscr, FALSE);
+    return;
+}
+
+//rest of the row moves right, the cursor goes after ch
+static void
+curses_tty_insert_char (uint32_t y, uint32_t x, char ch)
+{
+    move(y, x);
+    insch((unsigned char)ch);
+    move(y, x+1);
+    return;
+}
+
+//rest of the row moves left, the cursor stays
+static void
+curses_tty_delete_char (uint32_t y, uint32_t x)
+{
+    move(y, x);
+    delch();
+    return;
+}
+
+static void
+curses_tty_erase_scr (void)
+{
+    erase();
+    return;
+}
+
+static void
+curses_tty_flush (void)
+{
+    refresh();
+    return;
+}
+
+//resizeterm() queues KEY_RESIZE, as the curses SIGWINCH handler would
+static void
+curses_tty_resize (void)
+{
+    struct winsize ws;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 &&
+        ws.ws_row > 0 && ws.ws_col > 0) {
+        resizeterm(ws.ws_row, ws.ws_col);
+    }
+    return;
+}
+
+static tty_ops_t curses_tty_ops = {
+    .name = "curses",
+    .init = curses_tty_init,
+    .reset = curses_tty_reset,
+    .read_key = curses_tty_read_key,
+    .get_cursor = curses_tty_get_cursor,
+    .move_cursor = curses_tty_move_cursor,
+    .get_scr_size = curses_tty_get_scr_size,
+    .draw_row = curses_tty_draw_row,
+    .scroll_rows = curses_tty_scroll_rows,
+    .insert_char = curses_tty_insert_char,
+    .delete_char = curses_tty_delete_char,
+    .erase_scr = curses_tty_erase_scr,
+    .flush = curses_tty_flush,
+    .resize = curses_tty_resize,
+};
+
+//before tty_init, -1 if there is no such backend
+int
+tty_set_backend (char *name)
+{
+    if (strcmp(name, curses_tty_ops.name) == 0) {
+        tty_ops_p = &curses_tty_ops;
+        return 0;
+    }
+
+    if (strcmp(name, tty_vt100_get_ops()->name) == 0) {
+        tty_ops_p = tty_vt100_get_ops();
+        return 0;
+    }
+
+    return -1;
+}
+
+//backend not chosen by name, as the headless one of benchmarks
+void
+tty_set_ops (tty_ops_t *ops_p)
+{
+    tty_ops_p = ops_p;
+    return;
+}
+
+char *
+tty_get_backend_name (void)
+{
+    return tty_ops_p->name;
+}
+
+void
+tty_init (void)
+{
+    tty_ops_p->init();
+    return;
 }
 
 void
 tty_reset (void)
 {
-    endwin();
+    tty_ops_p->reset();
+    free(tty_row_cells);
+    tty_row_cells = NULL;
+    tty_row_size = 0;
+    return;
+}
+
+static void
+count_input_key (int key)
+{
+    tty_input_stats.keys++;
+    if (key == GVD_KEY_PASTE_START) {
+        tty_input_stats.pastes++;
+    }
+    return;
 }
 
 bool
 tty_read_one_key (int *key_read)
 {
-    *key_read = getch();
+    (void)tty_ops_p->read_key(key_read, TRUE);
+    tty_input_stats.reads++;
+    count_input_key(*key_read);
+    return TRUE;
+}
+
+//read one key if any typed, never block
+bool
+tty_poll_one_key (int *key_read)
+{
+    if (!tty_ops_p->read_key(key_read, FALSE)) {
+        return FALSE;
+    }
+
+    count_input_key(*key_read);
     return TRUE;
 }
 
+/*
+ * Take the keys typed or pasted so far, up to max, never block. Called
+ * when the console is readable, so a burst of keys is drawn once.
+ */
+uint32_t
+tty_poll_keys (int *keys, uint32_t max)
+{
+    uint32_t cnt = 0;
+
+    while (cnt < max && tty_ops_p->read_key(&keys[cnt], FALSE)) {
+        count_input_key(keys[cnt++]);
+    }
+
+    if (cnt) {
+        tty_input_stats.reads++;
+    }
+    return cnt;
+}
+
+//what was drawn goes to the terminal, before waiting for input
+void
+tty_flush (void)
+{
+    tty_ops_p->flush();
+    return;
+}
+
+//terminal size changed, the backend takes the new one
+void
+tty_resize (void)
+{
+    tty_ops_p->resize();
+    return;
+}
+
+void
+tty_get_input_stats (tty_input_stats_t *stats_p)
+{
+    *stats_p = tty_input_stats;
+    return;
+}
+
+//one write of a backend doing its own output
+void
+tty_count_output (uint32_t bytes)
+{
+    tty_output_stats.bytes += bytes;
+    tty_output_stats.writes++;
+    return;
+}
+
+void
+tty_get_output_stats (tty_output_stats_t *stats_p)
+{
+    *stats_p = tty_output_stats;
+    return;
+}
+
 void
 tty_move_cursor_left (void)
 {
-    int x, y;
+    uint32_t x, y;
 
-    getyx(stdscr, y, x);
-    move(y, --x);
+    tty_ops_p->get_cursor(&y, &x);
+    if (x > 0) {
+        tty_ops_p->move_cursor(y, x-1);
+    }
 
     return;
 }
@@ -51,10 +361,10 @@ tty_move_cursor_left (void)
 void
 tty_move_cursor_right (void)
 {
-    int x, y;
+    uint32_t x, y;
 
-    getyx(stdscr, y, x);
-    move(y, ++x);
+    tty_ops_p->get_cursor(&y, &x);
+    tty_ops_p->move_cursor(y, x+1);
 
     return;
 }
@@ -63,10 +373,10 @@ tty_move_cursor_right (void)
 void
 tty_move_cursor_pos (int pos)
 {
-    int x, y;
+    uint32_t x, y;
 
-    getyx(stdscr, y, x);
-    move(y, pos);
+    tty_ops_p->get_cursor(&y, &x);
+    tty_ops_p->move_cursor(y, pos);
 
     return;
 }
@@ -74,7 +384,86 @@ tty_move_cursor_pos (int pos)
 void
 tty_get_scr_size (uint32_t *y_p, uint32_t *x_p)
 {
-    getmaxyx(stdscr, *y_p, *x_p);
+    tty_ops_p->get_scr_size(y_p, x_p);
+    return;
+}
+
+//draw one screen row, tabs expand and other non-printables show as '?'
+void
+tty_draw_row (uint32_t y, char *data, uint32_t len, uint8_t *marks)
+{
+    uint32_t width, rows, x, i, pad;
+    tty_cell_t *cells;
+    uint8_t mark;
+
+    tty_ops_p->get_scr_size(&rows, &width);
+    if (y >= rows) {
+        return;
+    }
+
+    if (tty_row_size < width) {
+        cells = realloc(tty_row_cells, width * sizeof(tty_cell_t));
+        if (!cells) {
+            return;
+        }
+        tty_row_cells = cells;
+        tty_row_size = width;
+    }
+    cells = tty_row_cells;
+
+    for (i = 0, x = 0; i < len && x < width; i++) {
+        mark = marks?marks[i]:TTY_MARK_NONE;
+        if (data[i] == '\t') {
+            pad = TTY_TAB_SIZE - x%TTY_TAB_SIZE;
+            for (; pad > 0 && x < width; pad--, x++) {
+                cells[x].ch = ' ';
+                cells[x].mark = mark;
+            }
+            continue;
+        }
+        cells[x].ch = isprint((unsigned char)data[i])?data[i]:'?';
+        cells[x].mark = mark;
+        x++;
+    }
+
+    tty_ops_p->draw_row(y, cells, x);
     return;
 }
 
+//positive count moves content up, negative moves it down
+void
+tty_scroll_rows (int cnt)
+{
+    tty_ops_p->scroll_rows(cnt);
+    return;
+}
+
+//rest of the row moves right, the cursor goes after ch
+void
+tty_insert_char (uint32_t y, uint32_t x, char ch)
+{
+    tty_ops_p->insert_char(y, x, ch);
+    return;
+}
+
+//rest of the row moves left, the cursor stays
+void
+tty_delete_char (uint32_t y, uint32_t x)
+{
+    tty_ops_p->delete_char(y, x);
+    return;
+}
+
+void
+tty_erase_scr (void)
+{
+    tty_ops_p->erase_scr();
+    return;
+}
+
+void
+tty_move_cursor_yx (uint32_t y, uint32_t x)
+{
+    tty_ops_p->move_cursor(y, x);
+    return;
+}
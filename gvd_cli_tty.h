@@ -8,6 +8,7 @@
 #define __GVD_CLI_TTY_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <ncurses.h>
 
 #define GVD_KEY_BACKSPACE   KEY_BACKSPACE
@@ -23,13 +24,92 @@
 #define GVD_KEY_PGDOWN      KEY_NPAGE
 #define GVD_RESIZE          KEY_RESIZE
 #define GVD_CTRL_C          3 //CTRL C
+#define GVD_CTRL_F          6 //CTRL F
+#define GVD_CTRL_R          18 //CTRL R
+#define GVD_KEY_ESC         27 //ESC
 #define GVD_CTRL_Z          26 //CTRL Z
+//bracketed paste, keys between the two were pasted
+#define GVD_KEY_PASTE_START (KEY_MAX+1)
+#define GVD_KEY_PASTE_END   (KEY_MAX+2)
+//! key codes are below this, ncurses ones and ours
+#define GVD_KEY_CODE_MAX    (KEY_MAX+3)
+
+//! highlight of a byte passed to tty_draw_row
+#define TTY_MARK_NONE       0
+#define TTY_MARK_MATCH      1
+#define TTY_MARK_CURRENT    2
+
+//! terminal sends pasted text between ESC[200~ and ESC[201~
+#define TTY_PASTE_ON "\033[?2004h"
+#define TTY_PASTE_OFF "\033[?2004l"
+
+//! backend used if none is set
+#define TTY_BACKEND_DEFAULT "curses"
+
+//one screen cell, the byte shown and its mark
+typedef struct tty_cell_s {
+    char ch;
+    uint8_t mark;
+} tty_cell_t;
+
+/*
+ * Terminal backend, tty_* calls end up here. Rows come to draw_row as
+ * cells, tabs expanded and non-printables replaced, cnt no more than the
+ * screen width. read_key shows what was drawn before it reads, as flush
+ * does. resize is called on SIGWINCH, GVD_RESIZE is the key read next.
+ */
+typedef struct tty_ops_s {
+    char *name;
+    void (*init)(void);
+    void (*reset)(void);
+    bool (*read_key)(int *key_p, bool block);
+    void (*get_cursor)(uint32_t *y_p, uint32_t *x_p);
+    void (*move_cursor)(uint32_t y, uint32_t x);
+    void (*get_scr_size)(uint32_t *y_p, uint32_t *x_p);
+    void (*draw_row)(uint32_t y, tty_cell_t *cells, uint32_t cnt);
+    void (*scroll_rows)(int cnt);
+    void (*insert_char)(uint32_t y, uint32_t x, char ch);
+    void (*delete_char)(uint32_t y, uint32_t x);
+    void (*erase_scr)(void);
+    void (*flush)(void);
+    void (*resize)(void);
+} tty_ops_t;
+
+typedef struct tty_input_stats_s {
+    uint64_t keys;
+    //batches of keys read together, all typed by the time of the read
+    uint64_t reads;
+    uint64_t pastes;
+} tty_input_stats_t;
+
+//bytes the backend wrote itself, none for curses
+typedef struct tty_output_stats_s {
+    uint64_t bytes;
+    uint64_t writes;
+} tty_output_stats_t;
+
+int tty_set_backend(char *name);
+void tty_set_ops(tty_ops_t *ops_p);
+char *tty_get_backend_name(void);
+void tty_count_output(uint32_t bytes);
+void tty_get_output_stats(tty_output_stats_t *stats_p);
 
 void tty_init(void);
 void tty_reset(void);
 bool tty_read_one_key(int *key_read);
+bool tty_poll_one_key(int *key_read);
+uint32_t tty_poll_keys(int *keys, uint32_t max);
+void tty_flush(void);
+void tty_resize(void);
+void tty_get_input_stats(tty_input_stats_t *stats_p);
 void tty_move_cursor_left(void);
 void tty_move_cursor_right(void);
 void tty_move_cursor_pos(int pos);
+void tty_move_cursor_yx(uint32_t y, uint32_t x);
 void tty_get_scr_size(uint32_t *y_p, uint32_t *x_p);
+void tty_draw_row(uint32_t y, char *data, uint32_t len, uint8_t *marks);
+void tty_scroll_rows(int cnt);
+void tty_insert_char(uint32_t y, uint32_t x, char ch);
+void tty_delete_char(uint32_t y, uint32_t x);
+void tty_erase_scr(void);
 #endif
@@ -0,0 +1,220 @@
+/*
+ * gvd_cli_tty_headless.c
+ *
+ * Terminal backend with no terminal, for benchmarks and tests. Frames go
+ * through the vt100 backend's encoder, on a screen of the size set, and
+ * the bytes it would write are counted and dropped. Keys come from a
+ * script, so the renderer is measured without a TTY and the rows it left
+ * on screen can be read back.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gvd_util.h"
+#include "gvd_cli_tty.h"
+#include "gvd_cli_tty_vt100.h"
+#include "gvd_cli_tty_headless.h"
+
+typedef struct hl_scr_s {
+    tty_vt_enc_t enc;
+    int *keys;
+    uint32_t key_cnt;
+    uint32_t key_pos;
+} hl_scr_t;
+
+static hl_scr_t hl_scr;
+
+//screen is blank after, as a terminal's is after a resize
+int
+tty_headless_set_size (uint32_t rows, uint32_t cols)
+{
+    if (rows == 0 || cols == 0) {
+        return -1;
+    }
+
+    return tty_vt_enc_set_size(&hl_scr.enc, rows, cols);
+}
+
+//keys read from now on, the old ones not read are dropped
+int
+tty_headless_set_keys (int *keys, uint32_t cnt)
+{
+    int *copy = NULL;
+
+    if (cnt) {
+        copy = malloc(cnt * sizeof(int));
+        if (!copy) {
+            return -1;
+        }
+        memcpy(copy, keys, cnt * sizeof(int));
+    }
+
+    free(hl_scr.keys);
+    hl_scr.keys = copy;
+    hl_scr.key_cnt = cnt;
+    hl_scr.key_pos = 0;
+    return 0;
+}
+
+//text of row y, blanks at the end dropped, 0 past the screen
+uint32_t
+tty_headless_get_row (uint32_t y, char *buf, uint32_t size)
+{
+    tty_cell_t *row;
+    uint32_t len = 0, x;
+
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    if (y >= hl_scr.enc.rows || !hl_scr.enc.cells) {
+        return 0;
+    }
+
+    row = hl_scr.enc.cells + y * hl_scr.enc.cols;
+    for (x = 0; x < hl_scr.enc.cols && x < size - 1; x++) {
+        buf[x] = row[x].ch;
+        if (row[x].ch != ' ') {
+            len = x + 1;
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static void
+hl_tty_init (void)
+{
+    if (!hl_scr.enc.cells) {
+        (void)tty_headless_set_size(TTY_HEADLESS_ROWS_DEFAULT,
+                                    TTY_HEADLESS_COLS_DEFAULT);
+    }
+}
+
+static void
+hl_tty_reset (void)
+{
+    tty_vt_enc_free(&hl_scr.enc);
+    free(hl_scr.keys);
+    hl_scr.keys = NULL;
+    hl_scr.key_cnt = 0;
+    hl_scr.key_pos = 0;
+}
+
+//the frame drawn is done, one write of it
+static void
+hl_tty_flush (void)
+{
+    uint32_t len;
+
+    len = tty_vt_enc_end_frame(&hl_scr.enc);
+    if (len) {
+        tty_count_output(len);
+        hl_scr.enc.out_len = 0;
+    }
+    return;
+}
+
+//size is only changed by tty_headless_set_size()
+static void
+hl_tty_resize (void)
+{
+    return;
+}
+
+//FALSE once the script is read
+static bool
+hl_tty_read_key (int *key_p, bool block)
+{
+    hl_tty_flush();
+
+    if (hl_scr.key_pos >= hl_scr.key_cnt) {
+        *key_p = ERR;
+        return FALSE;
+    }
+
+    *key_p = hl_scr.keys[hl_scr.key_pos++];
+    return TRUE;
+}
+
+static void
+hl_tty_get_cursor (uint32_t *y_p, uint32_t *x_p)
+{
+    *y_p = hl_scr.enc.cur_y;
+    *x_p = hl_scr.enc.cur_x;
+    return;
+}
+
+static void
+hl_tty_move_cursor (uint32_t y, uint32_t x)
+{
+    tty_vt_enc_move_cursor(&hl_scr.enc, y, x);
+    return;
+}
+
+static void
+hl_tty_get_scr_size (uint32_t *y_p, uint32_t *x_p)
+{
+    *y_p = hl_scr.enc.rows;
+    *x_p = hl_scr.enc.cols;
+    return;
+}
+
+static void
+hl_tty_draw_row (uint32_t y, tty_cell_t *cells, uint32_t cnt)
+{
+    tty_vt_enc_draw_row(&hl_scr.enc, y, cells, cnt);
+    return;
+}
+
+static void
+hl_tty_scroll_rows (int cnt)
+{
+    tty_vt_enc_scroll_rows(&hl_scr.enc, cnt);
+    return;
+}
+
+static void
+hl_tty_insert_char (uint32_t y, uint32_t x, char ch)
+{
+    tty_vt_enc_insert_char(&hl_scr.enc, y, x, ch);
+    return;
+}
+
+static void
+hl_tty_delete_char (uint32_t y, uint32_t x)
+{
+    tty_vt_enc_delete_char(&hl_scr.enc, y, x);
+    return;
+}
+
+static void
+hl_tty_erase_scr (void)
+{
+    tty_vt_enc_erase_scr(&hl_scr.enc);
+    return;
+}
+
+static tty_ops_t headless_tty_ops = {
+    .name = "headless",
+    .init = hl_tty_init,
+    .reset = hl_tty_reset,
+    .read_key = hl_tty_read_key,
+    .get_cursor = hl_tty_get_cursor,
+    .move_cursor = hl_tty_move_cursor,
+    .get_scr_size = hl_tty_get_scr_size,
+    .draw_row = hl_tty_draw_row,
+    .scroll_rows = hl_tty_scroll_rows,
+    .insert_char = hl_tty_insert_char,
+    .delete_char = hl_tty_delete_char,
+    .erase_scr = hl_tty_erase_scr,
+    .flush = hl_tty_flush,
+    .resize = hl_tty_resize,
+};
+
+tty_ops_t *
+tty_headless_get_ops (void)
+{
+    return &headless_tty_ops;
+}
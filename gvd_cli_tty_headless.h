@@ -0,0 +1,22 @@
+#ifndef __GVD_CLI_TTY_HEADLESS_H__
+#define __GVD_CLI_TTY_HEADLESS_H__
+
+#include <stdint.h>
+#include "gvd_cli_tty.h"
+
+//! screen size until one is set
+#define TTY_HEADLESS_ROWS_DEFAULT 24
+#define TTY_HEADLESS_COLS_DEFAULT 80
+
+tty_ops_t *
+tty_headless_get_ops(void);
+
+int
+tty_headless_set_size(uint32_t rows, uint32_t cols);
+
+int
+tty_headless_set_keys(int *keys, uint32_t cnt);
+
+uint32_t
+tty_headless_get_row(uint32_t y, char *buf, uint32_t size);
+#endif //__GVD_CLI_TTY_HEADLESS_H__
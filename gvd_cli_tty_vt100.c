@@ -0,0 +1,705 @@
+/*
+ * gvd_cli_tty_vt100.c
+ *
+ * Terminal backend writing ANSI sequences itself, no curses. It keeps the
+ * cells the terminal shows, a row drawn is compared with them and only
+ * the span that changed goes out. Scrolls and single character edits use
+ * the terminal's own line operations. Sequences collect in one buffer,
+ * written with one write() before keys are read, that is once per frame.
+ *
+ * The cells and the sequences are the encoder, tty_vt_enc_t, which knows
+ * nothing of the terminal, so the headless backend sends its frames
+ * through the same code and counts what would be written.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "gvd_util.h"
+#include "gvd_cli_tty.h"
+#include "gvd_cli_tty_vt100.h"
+
+//! first size of the output buffer, it grows for bigger frames
+#define VT_OUT_INIT_SIZE (64*1024)
+//! bytes of keys read at once
+#define VT_IN_BUF_SIZE 4096
+//! ms to wait for the rest of an escape sequence, ESC alone after that
+#define VT_ESC_WAIT_MS 25
+//! screen size if the terminal does not tell
+#define VT_ROWS_DEFAULT 24
+#define VT_COLS_DEFAULT 80
+
+//! alternate screen, scroll region reset, no autowrap
+#define VT_SCR_ENTER "\033[?1049h\033[r\033[?7l\033[0m\033[H\033[2J"
+#define VT_SCR_LEAVE "\033[0m\033[?7h\033[?1049l"
+
+typedef struct vt_scr_s {
+    tty_vt_enc_t enc;
+    struct termios org_termios;
+    bool termios_saved;
+    uint8_t in_buf[VT_IN_BUF_SIZE];
+    uint32_t in_pos;
+    uint32_t in_len;
+} vt_scr_t;
+
+typedef struct vt_key_seq_s {
+    char *seq;
+    int key;
+} vt_key_seq_t;
+
+//keys after ESC, both normal and application cursor mode
+static vt_key_seq_t vt_key_seqs[] = {
+    {"[A",    GVD_KEY_UP},
+    {"[B",    GVD_KEY_DOWN},
+    {"[C",    GVD_KEY_RIGHT},
+    {"[D",    GVD_KEY_LEFT},
+    {"[H",    GVD_KEY_HOME},
+    {"[F",    GVD_KEY_END},
+    {"OA",    GVD_KEY_UP},
+    {"OB",    GVD_KEY_DOWN},
+    {"OC",    GVD_KEY_RIGHT},
+    {"OD",    GVD_KEY_LEFT},
+    {"OH",    GVD_KEY_HOME},
+    {"OF",    GVD_KEY_END},
+    {"OP",    KEY_F(1)},
+    {"OQ",    KEY_F(2)},
+    {"OR",    KEY_F(3)},
+    {"OS",    KEY_F(4)},
+    {"[1~",   GVD_KEY_HOME},
+    {"[2~",   KEY_IC},
+    {"[3~",   GVD_KEY_DEL},
+    {"[4~",   GVD_KEY_END},
+    {"[5~",   GVD_KEY_PGUP},
+    {"[6~",   GVD_KEY_PGDOWN},
+    {"[7~",   GVD_KEY_HOME},
+    {"[8~",   GVD_KEY_END},
+    {"[200~", GVD_KEY_PASTE_START},
+    {"[201~", GVD_KEY_PASTE_END},
+};
+
+static vt_scr_t vt_scr;
+//set on SIGWINCH, the size is read again by the next key read
+static bool vt_resized = FALSE;
+
+void
+tty_vt_enc_out (tty_vt_enc_t *enc_p, const char *data, uint32_t len)
+{
+    uint32_t size;
+    char *out;
+
+    if (enc_p->out_len + len > enc_p->out_size) {
+        size = enc_p->out_size?enc_p->out_size:VT_OUT_INIT_SIZE;
+        while (size < enc_p->out_len + len) {
+            size *= 2;
+        }
+        out = realloc(enc_p->out, size);
+        if (!out) {
+            return;
+        }
+        enc_p->out = out;
+        enc_p->out_size = size;
+    }
+
+    memcpy(enc_p->out + enc_p->out_len, data, len);
+    enc_p->out_len += len;
+    return;
+}
+
+static void
+vt_out_str (tty_vt_enc_t *enc_p, const char *str)
+{
+    tty_vt_enc_out(enc_p, str, strlen(str));
+    return;
+}
+
+//cursor position sequence, rows and columns count from 1
+static void
+vt_out_cup (tty_vt_enc_t *enc_p, uint32_t y, uint32_t x)
+{
+    char seq[32];
+    int len;
+
+    len = snprintf(seq, sizeof(seq), "\033[%u;%uH", y+1, x+1);
+    tty_vt_enc_out(enc_p, seq, len);
+    return;
+}
+
+static void
+vt_goto (tty_vt_enc_t *enc_p, uint32_t y, uint32_t x)
+{
+    if (enc_p->term_y == y && enc_p->term_x == x) {
+        return;
+    }
+
+    if (enc_p->term_y == y && x == 0) {
+        tty_vt_enc_out(enc_p, "\r", 1);
+    } else {
+        vt_out_cup(enc_p, y, x);
+    }
+
+    enc_p->term_y = y;
+    enc_p->term_x = x;
+    return;
+}
+
+static void
+vt_set_mark (tty_vt_enc_t *enc_p, uint8_t mark)
+{
+    if (enc_p->term_mark == mark) {
+        return;
+    }
+
+    switch (mark) {
+    case TTY_MARK_MATCH:
+        vt_out_str(enc_p, "\033[0;7m");
+        break;
+    case TTY_MARK_CURRENT:
+        vt_out_str(enc_p, "\033[0;1;4;7m");
+        break;
+    default:
+        vt_out_str(enc_p, "\033[0m");
+        break;
+    }
+
+    enc_p->term_mark = mark;
+    return;
+}
+
+static void
+blank_vt_cells (tty_cell_t *cells, uint32_t cnt)
+{
+    uint32_t i;
+
+    for (i = 0; i < cnt; i++) {
+        cells[i].ch = ' ';
+        cells[i].mark = TTY_MARK_NONE;
+    }
+    return;
+}
+
+static bool
+is_same_vt_cell (tty_cell_t *a, tty_cell_t *b)
+{
+    return (a->ch == b->ch && a->mark == b->mark);
+}
+
+void
+tty_vt_enc_erase_scr (tty_vt_enc_t *enc_p)
+{
+    vt_set_mark(enc_p, TTY_MARK_NONE);
+    vt_out_str(enc_p, "\033[H\033[2J");
+    blank_vt_cells(enc_p->cells, enc_p->rows * enc_p->cols);
+    enc_p->term_y = 0;
+    enc_p->term_x = 0;
+    enc_p->cur_y = 0;
+    enc_p->cur_x = 0;
+    return;
+}
+
+//cells of a new size, the terminal is cleared as after a resize
+int
+tty_vt_enc_set_size (tty_vt_enc_t *enc_p, uint32_t rows, uint32_t cols)
+{
+    tty_cell_t *cells;
+
+    cells = realloc(enc_p->cells, rows * cols * sizeof(tty_cell_t));
+    if (!cells) {
+        enc_p->rows = 0;
+        enc_p->cols = 0;
+        return -1;
+    }
+
+    enc_p->cells = cells;
+    enc_p->rows = rows;
+    enc_p->cols = cols;
+    tty_vt_enc_erase_scr(enc_p);
+    return 0;
+}
+
+void
+tty_vt_enc_free (tty_vt_enc_t *enc_p)
+{
+    free(enc_p->cells);
+    free(enc_p->out);
+    memset(enc_p, 0, sizeof(tty_vt_enc_t));
+    return;
+}
+
+void
+tty_vt_enc_move_cursor (tty_vt_enc_t *enc_p, uint32_t y, uint32_t x)
+{
+    if (y >= enc_p->rows || x >= enc_p->cols) {
+        return;
+    }
+
+    enc_p->cur_y = y;
+    enc_p->cur_x = x;
+    return;
+}
+
+//cursor goes where it's wanted, bytes of the frame to write
+uint32_t
+tty_vt_enc_end_frame (tty_vt_enc_t *enc_p)
+{
+    if (enc_p->cur_y < enc_p->rows && enc_p->cur_x < enc_p->cols) {
+        vt_goto(enc_p, enc_p->cur_y, enc_p->cur_x);
+    }
+    return enc_p->out_len;
+}
+
+/*
+ * Cells from the first to the last one changed are written, and if the
+ * row is blank after them the rest is erased instead. The cursor ends up
+ * after the cells, on the next row for a full one.
+ */
+void
+tty_vt_enc_draw_row (tty_vt_enc_t *enc_p, uint32_t y, tty_cell_t *cells,
+                     uint32_t cnt)
+{
+    tty_cell_t *shown, blank = {' ', TTY_MARK_NONE}, *want;
+    uint32_t x, first, end, text_end;
+
+    if (y >= enc_p->rows) {
+        return;
+    }
+
+    shown = enc_p->cells + y * enc_p->cols;
+    first = enc_p->cols;
+    end = 0;
+    text_end = 0;
+    for (x = 0; x < enc_p->cols; x++) {
+        want = (x < cnt)?&cells[x]:&blank;
+        if (!is_same_vt_cell(want, &blank)) {
+            text_end = x + 1;
+        }
+        if (!is_same_vt_cell(want, &shown[x])) {
+            if (first == enc_p->cols) {
+                first = x;
+            }
+            end = x + 1;
+        }
+    }
+
+    if (cnt < enc_p->cols) {
+        enc_p->cur_y = y;
+        enc_p->cur_x = cnt;
+    } else if (y + 1 < enc_p->rows) {
+        enc_p->cur_y = y + 1;
+        enc_p->cur_x = 0;
+    } else {
+        enc_p->cur_y = y;
+        enc_p->cur_x = enc_p->cols - 1;
+    }
+
+    if (first == enc_p->cols) {
+        return;
+    }
+
+    vt_goto(enc_p, y, first);
+    for (x = first; x < end && x < text_end; x++) {
+        vt_set_mark(enc_p, cells[x].mark);
+        tty_vt_enc_out(enc_p, &cells[x].ch, 1);
+        shown[x] = cells[x];
+    }
+
+    if (x < end) {
+        vt_set_mark(enc_p, TTY_MARK_NONE);
+        vt_out_str(enc_p, "\033[K");
+        blank_vt_cells(shown + x, enc_p->cols - x);
+    }
+
+    enc_p->term_y = y;
+    enc_p->term_x = (x < enc_p->cols)?x:TTY_VT_POS_UNKNOWN;
+    return;
+}
+
+//line feed at the bottom and reverse index at the top move the rows
+void
+tty_vt_enc_scroll_rows (tty_vt_enc_t *enc_p, int cnt)
+{
+    uint32_t n = (cnt > 0)?cnt:-cnt, row_size, i;
+    tty_cell_t *cells = enc_p->cells;
+
+    if (n == 0) {
+        return;
+    }
+    if (n >= enc_p->rows) {
+        tty_vt_enc_erase_scr(enc_p);
+        return;
+    }
+
+    row_size = enc_p->cols * sizeof(tty_cell_t);
+    vt_set_mark(enc_p, TTY_MARK_NONE);
+    if (cnt > 0) {
+        vt_goto(enc_p, enc_p->rows - 1, 0);
+        for (i = 0; i < n; i++) {
+            tty_vt_enc_out(enc_p, "\n", 1);
+        }
+        memmove(cells, cells + n * enc_p->cols, (enc_p->rows - n) * row_size);
+        blank_vt_cells(cells + (enc_p->rows - n) * enc_p->cols,
+                       n * enc_p->cols);
+    } else {
+        vt_goto(enc_p, 0, 0);
+        for (i = 0; i < n; i++) {
+            vt_out_str(enc_p, "\033M");
+        }
+        memmove(cells + n * enc_p->cols, cells, (enc_p->rows - n) * row_size);
+        blank_vt_cells(cells, n * enc_p->cols);
+    }
+    return;
+}
+
+void
+tty_vt_enc_insert_char (tty_vt_enc_t *enc_p, uint32_t y, uint32_t x, char ch)
+{
+    tty_cell_t *shown;
+
+    if (y >= enc_p->rows || x >= enc_p->cols) {
+        return;
+    }
+
+    shown = enc_p->cells + y * enc_p->cols;
+    vt_goto(enc_p, y, x);
+    vt_set_mark(enc_p, TTY_MARK_NONE);
+    vt_out_str(enc_p, "\033[@");
+    tty_vt_enc_out(enc_p, &ch, 1);
+    memmove(shown + x + 1, shown + x,
+            (enc_p->cols - x - 1) * sizeof(tty_cell_t));
+    shown[x].ch = ch;
+    shown[x].mark = TTY_MARK_NONE;
+
+    enc_p->term_x = (x + 1 < enc_p->cols)?x + 1:TTY_VT_POS_UNKNOWN;
+    tty_vt_enc_move_cursor(enc_p, y, x + 1);
+    return;
+}
+
+void
+tty_vt_enc_delete_char (tty_vt_enc_t *enc_p, uint32_t y, uint32_t x)
+{
+    tty_cell_t *shown;
+
+    if (y >= enc_p->rows || x >= enc_p->cols) {
+        return;
+    }
+
+    shown = enc_p->cells + y * enc_p->cols;
+    vt_goto(enc_p, y, x);
+    vt_set_mark(enc_p, TTY_MARK_NONE);
+    vt_out_str(enc_p, "\033[P");
+    memmove(shown + x, shown + x + 1,
+            (enc_p->cols - x - 1) * sizeof(tty_cell_t));
+    blank_vt_cells(shown + enc_p->cols - 1, 1);
+
+    tty_vt_enc_move_cursor(enc_p, y, x);
+    return;
+}
+
+//the frame is dropped on error
+static void
+vt_flush (void)
+{
+    tty_vt_enc_t *enc_p = &vt_scr.enc;
+    struct iovec iov;
+
+    if (tty_vt_enc_end_frame(enc_p) == 0) {
+        return;
+    }
+
+    iov.iov_base = enc_p->out;
+    iov.iov_len = enc_p->out_len;
+    (void)gvd_write_all(STDOUT_FILENO, &iov, 1, GVD_WRITE_AT_POS);
+
+    tty_count_output(enc_p->out_len);
+    enc_p->out_len = 0;
+    return;
+}
+
+//terminal cleared and the cells with it, after start and resize
+static void
+reset_vt_scr (void)
+{
+    uint32_t rows = VT_ROWS_DEFAULT, cols = VT_COLS_DEFAULT;
+    struct winsize ws;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 &&
+        ws.ws_row > 0 && ws.ws_col > 0) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+    (void)tty_vt_enc_set_size(&vt_scr.enc, rows, cols);
+    return;
+}
+
+static void
+vt_tty_init (void)
+{
+    struct termios raw;
+
+    if (tcgetattr(STDIN_FILENO, &vt_scr.org_termios) == 0) {
+        vt_scr.termios_saved = TRUE;
+        raw = vt_scr.org_termios;
+        //keys as typed, Ctrl-C too, output is positioned by us
+        raw.c_iflag &= ~(BRKINT | ICRNL | INLCR | IGNCR | INPCK | ISTRIP |
+                         IXON);
+        raw.c_oflag &= ~OPOST;
+        raw.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+        raw.c_cflag |= CS8;
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+
+    vt_scr.enc.term_mark = TTY_MARK_NONE;
+    vt_out_str(&vt_scr.enc, VT_SCR_ENTER);
+    vt_out_str(&vt_scr.enc, TTY_PASTE_ON);
+    reset_vt_scr();
+    vt_flush();
+}
+
+static void
+vt_tty_reset (void)
+{
+    vt_set_mark(&vt_scr.enc, TTY_MARK_NONE);
+    vt_out_str(&vt_scr.enc, TTY_PASTE_OFF);
+    vt_out_str(&vt_scr.enc, VT_SCR_LEAVE);
+    vt_scr.enc.cur_y = TTY_VT_POS_UNKNOWN;
+    vt_flush();
+
+    if (vt_scr.termios_saved) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &vt_scr.org_termios);
+    }
+
+    tty_vt_enc_free(&vt_scr.enc);
+    memset(&vt_scr, 0, sizeof(vt_scr_t));
+}
+
+//wait up to ms for bytes, -1 for no limit, FALSE if none came
+static bool
+fill_vt_input (int ms)
+{
+    struct pollfd pfd;
+    ssize_t n;
+
+    if (vt_scr.in_pos > 0) {
+        memmove(vt_scr.in_buf, vt_scr.in_buf + vt_scr.in_pos,
+                vt_scr.in_len - vt_scr.in_pos);
+        vt_scr.in_len -= vt_scr.in_pos;
+        vt_scr.in_pos = 0;
+    }
+    if (vt_scr.in_len == VT_IN_BUF_SIZE) {
+        return TRUE;
+    }
+
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, ms) <= 0) {
+        return FALSE;
+    }
+
+    n = read(STDIN_FILENO, vt_scr.in_buf + vt_scr.in_len,
+             VT_IN_BUF_SIZE - vt_scr.in_len);
+    if (n <= 0) {
+        return FALSE;
+    }
+
+    vt_scr.in_len += n;
+    return TRUE;
+}
+
+/*
+ * Key of an escape sequence at in_pos, 0 to wait for more bytes, -1 for
+ * a sequence not known, which is dropped. len is the bytes it takes.
+ */
+static int
+decode_vt_esc_seq (uint32_t *len_p)
+{
+    uint8_t *p = vt_scr.in_buf + vt_scr.in_pos + 1;
+    uint32_t avail = vt_scr.in_len - vt_scr.in_pos - 1, i, len;
+
+    if (avail == 0) {
+        return 0;
+    }
+    if (p[0] != '[' && p[0] != 'O') {
+        *len_p = 1;
+        return GVD_KEY_ESC;
+    }
+
+    //ESC [ params final, ESC O final
+    for (len = 1; len < avail; len++) {
+        if (p[0] == 'O' || (p[len] >= 0x40 && p[len] <= 0x7e)) {
+            break;
+        }
+    }
+    if (len == avail) {
+        return 0;
+    }
+    len++;
+    *len_p = len + 1;
+
+    for (i = 0; i < ARRAY_LEN(vt_key_seqs); i++) {
+        if (strlen(vt_key_seqs[i].seq) == len &&
+            memcmp(vt_key_seqs[i].seq, p, len) == 0) {
+            return vt_key_seqs[i].key;
+        }
+    }
+    return -1;
+}
+
+//one key from the bytes read, FALSE if they don't hold a whole one
+static bool
+decode_vt_key (int *key_p)
+{
+    uint32_t len = 0;
+    uint8_t ch;
+    int key;
+
+    while (vt_scr.in_pos < vt_scr.in_len) {
+        ch = vt_scr.in_buf[vt_scr.in_pos];
+        if (ch != 0x1b) {
+            vt_scr.in_pos++;
+            if (ch == '\r') {
+                *key_p = GVD_KEY_ENTER;
+            } else if (ch == 0x7f || ch == 0x08) {
+                *key_p = GVD_KEY_BACKSPACE;
+            } else {
+                *key_p = ch;
+            }
+            return TRUE;
+        }
+
+        key = decode_vt_esc_seq(&len);
+        if (key == 0) {
+            //rest of the sequence is on its way, or it's ESC alone
+            if (fill_vt_input(VT_ESC_WAIT_MS)) {
+                continue;
+            }
+            vt_scr.in_pos++;
+            *key_p = GVD_KEY_ESC;
+            return TRUE;
+        }
+
+        vt_scr.in_pos += len;
+        if (key != -1) {
+            *key_p = key;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static bool
+vt_tty_read_key (int *key_p, bool block)
+{
+    vt_flush();
+
+    for (;;) {
+        if (vt_resized) {
+            vt_resized = FALSE;
+            reset_vt_scr();
+            *key_p = GVD_RESIZE;
+            return TRUE;
+        }
+
+        if (decode_vt_key(key_p)) {
+            return TRUE;
+        }
+
+        if (!fill_vt_input(block?-1:0) && !block) {
+            return FALSE;
+        }
+    }
+}
+
+static void
+vt_tty_get_cursor (uint32_t *y_p, uint32_t *x_p)
+{
+    *y_p = vt_scr.enc.cur_y;
+    *x_p = vt_scr.enc.cur_x;
+    return;
+}
+
+static void
+vt_tty_move_cursor (uint32_t y, uint32_t x)
+{
+    tty_vt_enc_move_cursor(&vt_scr.enc, y, x);
+    return;
+}
+
+static void
+vt_tty_get_scr_size (uint32_t *y_p, uint32_t *x_p)
+{
+    *y_p = vt_scr.enc.rows;
+    *x_p = vt_scr.enc.cols;
+    return;
+}
+
+static void
+vt_tty_draw_row (uint32_t y, tty_cell_t *cells, uint32_t cnt)
+{
+    tty_vt_enc_draw_row(&vt_scr.enc, y, cells, cnt);
+    return;
+}
+
+static void
+vt_tty_scroll_rows (int cnt)
+{
+    tty_vt_enc_scroll_rows(&vt_scr.enc, cnt);
+    return;
+}
+
+static void
+vt_tty_insert_char (uint32_t y, uint32_t x, char ch)
+{
+    tty_vt_enc_insert_char(&vt_scr.enc, y, x, ch);
+    return;
+}
+
+static void
+vt_tty_delete_char (uint32_t y, uint32_t x)
+{
+    tty_vt_enc_delete_char(&vt_scr.enc, y, x);
+    return;
+}
+
+static void
+vt_tty_erase_scr (void)
+{
+    tty_vt_enc_erase_scr(&vt_scr.enc);
+    return;
+}
+
+static void
+vt_tty_resize (void)
+{
+    vt_resized = TRUE;
+    return;
+}
+
+static tty_ops_t vt100_tty_ops = {
+    .name = "vt100",
+    .init = vt_tty_init,
+    .reset = vt_tty_reset,
+    .read_key = vt_tty_read_key,
+    .get_cursor = vt_tty_get_cursor,
+    .move_cursor = vt_tty_move_cursor,
+    .get_scr_size = vt_tty_get_scr_size,
+    .draw_row = vt_tty_draw_row,
+    .scroll_rows = vt_tty_scroll_rows,
+    .insert_char = vt_tty_insert_char,
+    .delete_char = vt_tty_delete_char,
+    .erase_scr = vt_tty_erase_scr,
+    .flush = vt_flush,
+    .resize = vt_tty_resize,
+};
+
+tty_ops_t *
+tty_vt100_get_ops (void)
+{
+    return &vt100_tty_ops;
+}
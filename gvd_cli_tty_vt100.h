@@ -0,0 +1,64 @@
+#ifndef __GVD_CLI_TTY_VT100_H__
+#define __GVD_CLI_TTY_VT100_H__
+
+#include <stdint.h>
+#include "gvd_cli_tty.h"
+
+//! terminal cursor not known, the next move positions it fully
+#define TTY_VT_POS_UNKNOWN UINT32_MAX
+
+/*
+ * Cells a VT100 terminal shows and the sequences that bring it to the
+ * cells drawn since, out_len bytes in out. Whoever owns it writes them
+ * and sets out_len back to 0.
+ */
+typedef struct tty_vt_enc_s {
+    uint32_t rows;
+    uint32_t cols;
+    tty_cell_t *cells;
+    //cursor wanted, placed when the frame ends
+    uint32_t cur_y;
+    uint32_t cur_x;
+    //where the terminal has it
+    uint32_t term_y;
+    uint32_t term_x;
+    uint8_t term_mark;
+    char *out;
+    uint32_t out_len;
+    uint32_t out_size;
+} tty_vt_enc_t;
+
+tty_ops_t *
+tty_vt100_get_ops(void);
+
+int
+tty_vt_enc_set_size(tty_vt_enc_t *enc_p, uint32_t rows, uint32_t cols);
+
+void
+tty_vt_enc_free(tty_vt_enc_t *enc_p);
+
+void
+tty_vt_enc_out(tty_vt_enc_t *enc_p, const char *data, uint32_t len);
+
+void
+tty_vt_enc_move_cursor(tty_vt_enc_t *enc_p, uint32_t y, uint32_t x);
+
+uint32_t
+tty_vt_enc_end_frame(tty_vt_enc_t *enc_p);
+
+void
+tty_vt_enc_draw_row(tty_vt_enc_t *enc_p, uint32_t y, tty_cell_t *cells,
+                    uint32_t cnt);
+
+void
+tty_vt_enc_scroll_rows(tty_vt_enc_t *enc_p, int cnt);
+
+void
+tty_vt_enc_insert_char(tty_vt_enc_t *enc_p, uint32_t y, uint32_t x, char ch);
+
+void
+tty_vt_enc_delete_char(tty_vt_enc_t *enc_p, uint32_t y, uint32_t x);
+
+void
+tty_vt_enc_erase_scr(tty_vt_enc_t *enc_p);
+#endif //__GVD_CLI_TTY_VT100_H__
@@ -0,0 +1,179 @@
+/*
+ * gvd_cmd_buf.c
+ *
+ * Gap buffer holding the command line being edited, see cmd_buf_t. It
+ * grows by doubling, there is no length limit here, callers keep the
+ * command within the length set for the terminal.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gvd_util.h"
+#include "gvd_cmd_buf.h"
+
+//! first size, commands typed by hand mostly fit
+#define CMD_BUF_INIT_SIZE 256
+
+int
+cmd_buf_init (cmd_buf_t *cb_p)
+{
+    memset(cb_p, 0, sizeof(cmd_buf_t));
+
+    cb_p->buf = malloc(CMD_BUF_INIT_SIZE);
+    if (!cb_p->buf) {
+        return -1;
+    }
+    cb_p->size = CMD_BUF_INIT_SIZE;
+    cb_p->gap_end = CMD_BUF_INIT_SIZE;
+    return 0;
+}
+
+void
+cmd_buf_free (cmd_buf_t *cb_p)
+{
+    if (cb_p->buf) {
+        free(cb_p->buf);
+    }
+    memset(cb_p, 0, sizeof(cmd_buf_t));
+    return;
+}
+
+uint32_t
+cmd_buf_len (cmd_buf_t *cb_p)
+{
+    return cb_p->size - (cb_p->gap_end - cb_p->gap_start);
+}
+
+uint32_t
+cmd_buf_pos (cmd_buf_t *cb_p)
+{
+    return cb_p->pos;
+}
+
+static void
+move_cmd_buf_gap (cmd_buf_t *cb_p, uint32_t pos)
+{
+    uint32_t cnt;
+
+    if (pos < cb_p->gap_start) {
+        cnt = cb_p->gap_start - pos;
+        memmove(cb_p->buf + cb_p->gap_end - cnt, cb_p->buf + pos, cnt);
+        cb_p->gap_start -= cnt;
+        cb_p->gap_end -= cnt;
+    } else if (pos > cb_p->gap_start) {
+        cnt = pos - cb_p->gap_start;
+        memmove(cb_p->buf + cb_p->gap_start, cb_p->buf + cb_p->gap_end, cnt);
+        cb_p->gap_start += cnt;
+        cb_p->gap_end += cnt;
+    }
+
+    return;
+}
+
+//keep a gap of need bytes at least
+static bool
+reserve_cmd_buf_gap (cmd_buf_t *cb_p, uint32_t need)
+{
+    uint32_t size, tail_len;
+    char *buf;
+
+    if (cb_p->gap_end - cb_p->gap_start >= need) {
+        return TRUE;
+    }
+
+    size = cb_p->size;
+    while (size - cmd_buf_len(cb_p) < need) {
+        size *= 2;
+    }
+
+    buf = realloc(cb_p->buf, size);
+    if (!buf) {
+        return FALSE;
+    }
+
+    tail_len = cb_p->size - cb_p->gap_end;
+    memmove(buf + size - tail_len, buf + cb_p->gap_end, tail_len);
+    cb_p->buf = buf;
+    cb_p->gap_end = size - tail_len;
+    cb_p->size = size;
+    return TRUE;
+}
+
+//one byte of the gap is kept for the '\0' of cmd_buf_str()
+bool
+cmd_buf_insert (cmd_buf_t *cb_p, char ch)
+{
+    if (!reserve_cmd_buf_gap(cb_p, 2)) {
+        return FALSE;
+    }
+
+    move_cmd_buf_gap(cb_p, cb_p->pos);
+    cb_p->buf[cb_p->gap_start++] = ch;
+    cb_p->pos++;
+    return TRUE;
+}
+
+bool
+cmd_buf_delete_prev (cmd_buf_t *cb_p)
+{
+    if (cb_p->pos == 0) {
+        return FALSE;
+    }
+
+    move_cmd_buf_gap(cb_p, cb_p->pos);
+    cb_p->gap_start--;
+    cb_p->pos--;
+    return TRUE;
+}
+
+bool
+cmd_buf_delete_next (cmd_buf_t *cb_p)
+{
+    if (cb_p->pos == cmd_buf_len(cb_p)) {
+        return FALSE;
+    }
+
+    move_cmd_buf_gap(cb_p, cb_p->pos);
+    cb_p->gap_end++;
+    return TRUE;
+}
+
+void
+cmd_buf_move (cmd_buf_t *cb_p, uint32_t pos)
+{
+    cb_p->pos = (pos > cmd_buf_len(cb_p))?cmd_buf_len(cb_p):pos;
+    return;
+}
+
+//whole line replaced, the cursor goes to its end
+bool
+cmd_buf_set (cmd_buf_t *cb_p, char *str, uint32_t len)
+{
+    cmd_buf_clear(cb_p);
+    if (!reserve_cmd_buf_gap(cb_p, len + 1)) {
+        return FALSE;
+    }
+
+    memcpy(cb_p->buf, str, len);
+    cb_p->gap_start = len;
+    cb_p->pos = len;
+    return TRUE;
+}
+
+void
+cmd_buf_clear (cmd_buf_t *cb_p)
+{
+    cb_p->gap_start = 0;
+    cb_p->gap_end = cb_p->size;
+    cb_p->pos = 0;
+    return;
+}
+
+//the line as one string, valid until the next edit
+char *
+cmd_buf_str (cmd_buf_t *cb_p)
+{
+    move_cmd_buf_gap(cb_p, cmd_buf_len(cb_p));
+    cb_p->buf[cb_p->gap_start] = '\0';
+    return cb_p->buf;
+}
@@ -0,0 +1,52 @@
+#ifndef __GVD_CMD_BUF_H__
+#define __GVD_CMD_BUF_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Command line being edited, a gap buffer. Text is buf without the gap
+ * [gap_start, gap_end). The gap moves to the cursor when an edit is made
+ * there, so typing at one place costs no copy of the rest of the line.
+ */
+typedef struct cmd_buf_s {
+    char *buf;
+    uint32_t size;
+    uint32_t gap_start;
+    uint32_t gap_end;
+    uint32_t pos;
+} cmd_buf_t;
+
+int
+cmd_buf_init(cmd_buf_t *cb_p);
+
+void
+cmd_buf_free(cmd_buf_t *cb_p);
+
+uint32_t
+cmd_buf_len(cmd_buf_t *cb_p);
+
+uint32_t
+cmd_buf_pos(cmd_buf_t *cb_p);
+
+bool
+cmd_buf_insert(cmd_buf_t *cb_p, char ch);
+
+bool
+cmd_buf_delete_prev(cmd_buf_t *cb_p);
+
+bool
+cmd_buf_delete_next(cmd_buf_t *cb_p);
+
+void
+cmd_buf_move(cmd_buf_t *cb_p, uint32_t pos);
+
+bool
+cmd_buf_set(cmd_buf_t *cb_p, char *str, uint32_t len);
+
+void
+cmd_buf_clear(cmd_buf_t *cb_p);
+
+char *
+cmd_buf_str(cmd_buf_t *cb_p);
+#endif //__GVD_CMD_BUF_H__
@@ -0,0 +1,564 @@
+/*
+ * gvd_cmd_history.c
+ *
+ * Command history, see cmd_history_t. Commands are copied into one byte
+ * arena used as a ring, an entry keeps where its command starts, so adding
+ * a command is a copy and never frees anything. The oldest commands go when
+ * the depth or the arena is used up. History can be kept in a file, one
+ * command per line, appended as commands come in and read back at start
+ * through mmap.
+ *
+ * Search is backed by a trigram index, every 3 bytes of a command hash to
+ * a bucket holding the seqs of the commands having them, oldest first. A
+ * search walks the shortest bucket of the pattern backward and checks the
+ * commands found there, so it costs about the matches, not the history.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gvd_util.h"
+#include "gvd_cmd_history.h"
+
+//! arena bytes per command of the depth, commands are mostly short
+#define CMD_HISTORY_BYTES_PER_CMD 64
+//! smallest arena, the longest command always fits
+#define CMD_HISTORY_ARENA_MIN (8*CMD_MAX_LEN_LIMIT)
+//! bits of the trigram bucket number
+#define CMD_HISTORY_TRIGRAM_BITS 16
+#define CMD_HISTORY_TRIGRAM_BUCKETS (1 << CMD_HISTORY_TRIGRAM_BITS)
+//! first size of a bucket
+#define CMD_HISTORY_BUCKET_INIT_SIZE 8
+
+typedef struct cmd_history_entry_s {
+    //position in the arena, counted from the first byte ever added
+    uint64_t pos;
+    uint32_t len;
+} cmd_history_entry_t;
+
+//seqs [start, cnt) of a bucket, below start were dropped
+typedef struct trigram_bucket_s {
+    uint32_t *seqs;
+    uint32_t start;
+    uint32_t cnt;
+    uint32_t size;
+} trigram_bucket_t;
+
+/*
+ * Commands are numbered by seq as they are added, [head_seq, end_seq) are
+ * kept, entry of seq is entries[seq % depth]. A command never wraps in the
+ * arena, one not fitting at its end starts over at the arena start.
+ */
+struct cmd_history_s {
+    char *arena;
+    uint32_t arena_size;
+    uint64_t next_pos;
+    cmd_history_entry_t *entries;
+    uint32_t depth;
+    uint32_t head_seq;
+    uint32_t end_seq;
+    //built at the first search, kept up as commands are added
+    trigram_bucket_t *trigrams;
+    uint64_t postings;
+    int fd;
+};
+
+static uint32_t
+get_trigram_bucket (char *p)
+{
+    uint32_t key;
+
+    key = (uint8_t)p[0] << 16 | (uint8_t)p[1] << 8 | (uint8_t)p[2];
+    return (key * 2654435761u) >> (32 - CMD_HISTORY_TRIGRAM_BITS);
+}
+
+static char *
+get_cmd_history_data (cmd_history_t *hist_p, cmd_history_entry_t *entry_p)
+{
+    return hist_p->arena + (entry_p->pos % hist_p->arena_size);
+}
+
+//seqs of commands gone are dropped from the front to make room first
+static bool
+add_trigram_posting (cmd_history_t *hist_p, trigram_bucket_t *bucket_p,
+                     uint32_t seq)
+{
+    uint32_t *seqs, size;
+
+    if (bucket_p->cnt > bucket_p->start &&
+        bucket_p->seqs[bucket_p->cnt-1] == seq) {
+        return TRUE;
+    }
+
+    if (bucket_p->cnt == bucket_p->size) {
+        while (bucket_p->start < bucket_p->cnt &&
+               bucket_p->seqs[bucket_p->start] < hist_p->head_seq) {
+            bucket_p->start++;
+        }
+        if (bucket_p->start > 0) {
+            hist_p->postings -= bucket_p->start;
+            bucket_p->cnt -= bucket_p->start;
+            memmove(bucket_p->seqs, bucket_p->seqs + bucket_p->start,
+                    bucket_p->cnt * sizeof(uint32_t));
+            bucket_p->start = 0;
+        }
+    }
+
+    if (bucket_p->cnt == bucket_p->size) {
+        size = bucket_p->size?bucket_p->size*2:CMD_HISTORY_BUCKET_INIT_SIZE;
+        seqs = realloc(bucket_p->seqs, size * sizeof(uint32_t));
+        if (!seqs) {
+            return FALSE;
+        }
+        bucket_p->seqs = seqs;
+        bucket_p->size = size;
+    }
+
+    bucket_p->seqs[bucket_p->cnt++] = seq;
+    hist_p->postings++;
+    return TRUE;
+}
+
+static void
+free_cmd_history_index (cmd_history_t *hist_p)
+{
+    uint32_t idx;
+
+    if (!hist_p->trigrams) {
+        return;
+    }
+
+    for (idx = 0; idx < CMD_HISTORY_TRIGRAM_BUCKETS; idx++) {
+        free(hist_p->trigrams[idx].seqs);
+    }
+    free(hist_p->trigrams);
+    hist_p->trigrams = NULL;
+    hist_p->postings = 0;
+    return;
+}
+
+//no memory drops the whole index, search falls back to a scan
+static void
+index_cmd_history_entry (cmd_history_t *hist_p, uint32_t seq)
+{
+    cmd_history_entry_t *entry_p;
+    uint32_t idx;
+    char *data;
+
+    entry_p = &hist_p->entries[seq % hist_p->depth];
+    data = get_cmd_history_data(hist_p, entry_p);
+    for (idx = 0; idx + 3 <= entry_p->len; idx++) {
+        if (!add_trigram_posting(hist_p,
+                &hist_p->trigrams[get_trigram_bucket(data + idx)], seq)) {
+            free_cmd_history_index(hist_p);
+            return;
+        }
+    }
+
+    return;
+}
+
+static bool
+build_cmd_history_index (cmd_history_t *hist_p)
+{
+    uint32_t seq;
+
+    hist_p->trigrams = calloc(CMD_HISTORY_TRIGRAM_BUCKETS,
+                              sizeof(trigram_bucket_t));
+    if (!hist_p->trigrams) {
+        return FALSE;
+    }
+
+    for (seq = hist_p->head_seq;
+         seq != hist_p->end_seq && hist_p->trigrams; seq++) {
+        index_cmd_history_entry(hist_p, seq);
+    }
+
+    return (hist_p->trigrams != NULL);
+}
+
+static void
+add_cmd_history_entry (cmd_history_t *hist_p, char *cmd, uint32_t len)
+{
+    cmd_history_entry_t *entry_p;
+    uint64_t pos;
+    uint32_t off;
+
+    if (len == 0 || len > hist_p->arena_size) {
+        return;
+    }
+
+    if (hist_p->end_seq - hist_p->head_seq == hist_p->depth) {
+        hist_p->head_seq++;
+    }
+
+    pos = hist_p->next_pos;
+    off = pos % hist_p->arena_size;
+    if (off + len > hist_p->arena_size) {
+        pos += hist_p->arena_size - off;
+    }
+
+    while (hist_p->head_seq != hist_p->end_seq &&
+           pos + len - hist_p->entries[hist_p->head_seq % hist_p->depth].pos >
+           hist_p->arena_size) {
+        hist_p->head_seq++;
+    }
+
+    memcpy(hist_p->arena + (pos % hist_p->arena_size), cmd, len);
+    entry_p = &hist_p->entries[hist_p->end_seq % hist_p->depth];
+    entry_p->pos = pos;
+    entry_p->len = len;
+    hist_p->next_pos = pos + len;
+
+    if (hist_p->trigrams) {
+        index_cmd_history_entry(hist_p, hist_p->end_seq);
+    }
+    hist_p->end_seq++;
+    return;
+}
+
+static int
+init_cmd_history (cmd_history_t *hist_p, uint32_t depth)
+{
+    uint64_t arena_size;
+
+    memset(hist_p, 0, sizeof(cmd_history_t));
+    hist_p->fd = -1;
+
+    arena_size = (uint64_t)depth * CMD_HISTORY_BYTES_PER_CMD;
+    if (arena_size < CMD_HISTORY_ARENA_MIN) {
+        arena_size = CMD_HISTORY_ARENA_MIN;
+    }
+
+    hist_p->arena = malloc(arena_size);
+    hist_p->entries = malloc(depth * sizeof(cmd_history_entry_t));
+    if (!hist_p->arena || !hist_p->entries) {
+        free(hist_p->arena);
+        free(hist_p->entries);
+        return -1;
+    }
+
+    hist_p->arena_size = arena_size;
+    hist_p->depth = depth;
+    return 0;
+}
+
+cmd_history_t *
+cmd_history_create (uint32_t depth)
+{
+    cmd_history_t *hist_p;
+
+    if (depth == 0 || depth > CMD_HISTORY_DEPTH_MAX) {
+        return NULL;
+    }
+
+    hist_p = malloc(sizeof(cmd_history_t));
+    if (!hist_p) {
+        return NULL;
+    }
+
+    if (init_cmd_history(hist_p, depth) != 0) {
+        free(hist_p);
+        return NULL;
+    }
+
+    return hist_p;
+}
+
+void
+cmd_history_destroy (cmd_history_t *hist_p)
+{
+    if (!hist_p) {
+        return;
+    }
+
+    free_cmd_history_index(hist_p);
+    if (hist_p->fd != -1) {
+        close(hist_p->fd);
+    }
+    free(hist_p->arena);
+    free(hist_p->entries);
+    free(hist_p);
+    return;
+}
+
+//the newest commands are kept, the index is built again at next search
+int
+cmd_history_set_depth (cmd_history_t *hist_p, uint32_t depth)
+{
+    cmd_history_t new_hist;
+    cmd_history_entry_t *entry_p;
+    uint32_t seq;
+
+    if (depth == 0 || depth > CMD_HISTORY_DEPTH_MAX) {
+        return -1;
+    }
+
+    if (depth == hist_p->depth) {
+        return 0;
+    }
+
+    if (init_cmd_history(&new_hist, depth) != 0) {
+        return -1;
+    }
+
+    seq = hist_p->head_seq;
+    if (hist_p->end_seq - seq > depth) {
+        seq = hist_p->end_seq - depth;
+    }
+    //commands keep their seqs
+    new_hist.head_seq = seq;
+    new_hist.end_seq = seq;
+    for (; seq != hist_p->end_seq; seq++) {
+        entry_p = &hist_p->entries[seq % hist_p->depth];
+        add_cmd_history_entry(&new_hist, get_cmd_history_data(hist_p, entry_p),
+                              entry_p->len);
+    }
+
+    free_cmd_history_index(hist_p);
+    free(hist_p->arena);
+    free(hist_p->entries);
+    new_hist.fd = hist_p->fd;
+    *hist_p = new_hist;
+    return 0;
+}
+
+//a failed line is dropped
+static void
+write_cmd_history_line (int fd, char *cmd, uint32_t len)
+{
+    struct iovec iov[2];
+
+    iov[0].iov_base = cmd;
+    iov[0].iov_len = len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+    (void)gvd_write_all(fd, iov, 2, GVD_WRITE_AT_POS);
+    return;
+}
+
+//commands holding a new line are not kept, the file has one per line
+void
+cmd_history_add (cmd_history_t *hist_p, char *cmd, uint32_t len)
+{
+    if (len == 0 || memchr(cmd, '\n', len)) {
+        return;
+    }
+
+    add_cmd_history_entry(hist_p, cmd, len);
+    if (hist_p->fd != -1) {
+        write_cmd_history_line(hist_p->fd, cmd, len);
+    }
+
+    return;
+}
+
+void
+cmd_history_get_range (cmd_history_t *hist_p, uint32_t *first_p,
+                       uint32_t *end_p)
+{
+    *first_p = hist_p->head_seq;
+    *end_p = hist_p->end_seq;
+    return;
+}
+
+//data is not '\0' terminated, valid until the next add
+bool
+cmd_history_get (cmd_history_t *hist_p, uint32_t seq, char **data_p,
+                 uint32_t *len_p)
+{
+    cmd_history_entry_t *entry_p;
+
+    if (seq - hist_p->head_seq >= hist_p->end_seq - hist_p->head_seq) {
+        return FALSE;
+    }
+
+    entry_p = &hist_p->entries[seq % hist_p->depth];
+    *data_p = get_cmd_history_data(hist_p, entry_p);
+    *len_p = entry_p->len;
+    return TRUE;
+}
+
+static bool
+match_cmd_history_entry (cmd_history_t *hist_p, uint32_t seq, char *pat,
+                         uint32_t len)
+{
+    cmd_history_entry_t *entry_p;
+
+    entry_p = &hist_p->entries[seq % hist_p->depth];
+    return (gvd_memmem(get_cmd_history_data(hist_p, entry_p), entry_p->len,
+                       pat, len) != NULL);
+}
+
+//last index in [start, cnt) of a seq not above seq, start-1 if none
+static int64_t
+find_trigram_posting (trigram_bucket_t *bucket_p, uint32_t seq)
+{
+    int64_t lo = bucket_p->start, hi = bucket_p->cnt, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (bucket_p->seqs[mid] <= seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo - 1;
+}
+
+//newest command at or before seq holding pat
+bool
+cmd_history_search (cmd_history_t *hist_p, char *pat, uint32_t len,
+                    uint32_t seq, uint32_t *seq_p)
+{
+    trigram_bucket_t *bucket_p, *best_p = NULL;
+    uint32_t idx, s;
+    int64_t pidx;
+
+    if (len == 0 || hist_p->head_seq == hist_p->end_seq ||
+        seq < hist_p->head_seq) {
+        return FALSE;
+    }
+
+    if (seq >= hist_p->end_seq) {
+        seq = hist_p->end_seq - 1;
+    }
+
+    if (len >= 3 && (hist_p->trigrams || build_cmd_history_index(hist_p))) {
+        for (idx = 0; idx + 3 <= len; idx++) {
+            bucket_p = &hist_p->trigrams[get_trigram_bucket(pat + idx)];
+            if (!best_p ||
+                bucket_p->cnt - bucket_p->start <
+                best_p->cnt - best_p->start) {
+                best_p = bucket_p;
+            }
+        }
+
+        for (pidx = find_trigram_posting(best_p, seq);
+             pidx >= best_p->start; pidx--) {
+            s = best_p->seqs[pidx];
+            if (s < hist_p->head_seq) {
+                break;
+            }
+            if (match_cmd_history_entry(hist_p, s, pat, len)) {
+                *seq_p = s;
+                return TRUE;
+            }
+        }
+
+        return FALSE;
+    }
+
+    for (s = seq + 1; s-- > hist_p->head_seq;) {
+        if (match_cmd_history_entry(hist_p, s, pat, len)) {
+            *seq_p = s;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//file keeping more than twice the commands kept is cut to them
+static void
+compact_cmd_history_file (char *file_name, char *data, uint32_t len)
+{
+    char tmp_name[256];
+    struct iovec iov;
+    int fd;
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", file_name);
+    fd = open(tmp_name, O_CREAT|O_WRONLY|O_TRUNC, 0666);
+    if (fd == -1) {
+        return;
+    }
+
+    iov.iov_base = data;
+    iov.iov_len = len;
+    if (gvd_write_all(fd, &iov, 1, GVD_WRITE_AT_POS) == -1) {
+        close(fd);
+        unlink(tmp_name);
+        return;
+    }
+
+    close(fd);
+    rename(tmp_name, file_name);
+    return;
+}
+
+//the last depth lines of the file are read, new commands go to its end
+int
+cmd_history_load (cmd_history_t *hist_p, char *file_name)
+{
+    struct stat st;
+    char *map, *line, *nl, *end;
+    uint64_t start, line_end;
+    uint32_t kept = 0;
+    int fd;
+
+    fd = open(file_name, O_RDONLY);
+    if (fd != -1 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            start = st.st_size;
+            while (start > 0 && kept < hist_p->depth) {
+                line_end = start;
+                if (map[line_end-1] == '\n') {
+                    line_end--;
+                }
+                start = line_end;
+                while (start > 0 && map[start-1] != '\n') {
+                    start--;
+                }
+                kept++;
+            }
+
+            end = map + st.st_size;
+            for (line = map + start; line < end; line = nl + 1) {
+                nl = memchr(line, '\n', end - line);
+                if (!nl) {
+                    nl = end;
+                }
+                if (nl - line <= CMD_MAX_LEN_LIMIT) {
+                    add_cmd_history_entry(hist_p, line, nl - line);
+                }
+            }
+
+            if (start > (uint64_t)st.st_size / 2) {
+                compact_cmd_history_file(file_name, map + start,
+                                         st.st_size - start);
+            }
+            munmap(map, st.st_size);
+        }
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+
+    if (hist_p->fd != -1) {
+        close(hist_p->fd);
+    }
+    hist_p->fd = open(file_name, O_CREAT|O_WRONLY|O_APPEND, 0666);
+    return (hist_p->fd == -1)?-1:0;
+}
+
+void
+cmd_history_get_stats (cmd_history_t *hist_p, cmd_history_stats_t *stats_p)
+{
+    memset(stats_p, 0, sizeof(cmd_history_stats_t));
+    stats_p->depth = hist_p->depth;
+    stats_p->cnt = hist_p->end_seq - hist_p->head_seq;
+    stats_p->arena_size = hist_p->arena_size;
+    stats_p->indexed = (hist_p->trigrams != NULL);
+    stats_p->postings = hist_p->postings;
+    stats_p->saved = (hist_p->fd != -1);
+    return;
+}
@@ -0,0 +1,54 @@
+#ifndef __GVD_CMD_HISTORY_H__
+#define __GVD_CMD_HISTORY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CMD_HISTORY_NAME_DEFAULT "./.console_history"
+//! commands kept by default, terminal history size sets it per VTY
+#define CMD_HISTORY_DEPTH_DEFAULT 1000
+#define CMD_HISTORY_DEPTH_MAX 100000
+
+struct cmd_history_s;
+typedef struct cmd_history_s cmd_history_t;
+
+typedef struct cmd_history_stats_s {
+    uint32_t depth;
+    uint32_t cnt;
+    uint32_t arena_size;
+    //search index, 0 postings until the first search
+    bool indexed;
+    uint64_t postings;
+    bool saved;
+} cmd_history_stats_t;
+
+cmd_history_t *
+cmd_history_create(uint32_t depth);
+
+void
+cmd_history_destroy(cmd_history_t *hist_p);
+
+int
+cmd_history_set_depth(cmd_history_t *hist_p, uint32_t depth);
+
+void
+cmd_history_add(cmd_history_t *hist_p, char *cmd, uint32_t len);
+
+void
+cmd_history_get_range(cmd_history_t *hist_p, uint32_t *first_p,
+                      uint32_t *end_p);
+
+bool
+cmd_history_get(cmd_history_t *hist_p, uint32_t seq, char **data_p,
+                uint32_t *len_p);
+
+bool
+cmd_history_search(cmd_history_t *hist_p, char *pat, uint32_t len,
+                   uint32_t seq, uint32_t *seq_p);
+
+int
+cmd_history_load(cmd_history_t *hist_p, char *file_name);
+
+void
+cmd_history_get_stats(cmd_history_t *hist_p, cmd_history_stats_t *stats_p);
+#endif //__GVD_CMD_HISTORY_H__
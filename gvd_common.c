@@ -1,15 +1,27 @@
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include "gvd_util.h"
+#include "gvd_event.h"
 #include "gvd_common.h"
+#include "gvd_file_view.h"
 
 #define PRINT_BUFFER_INIT_SIZE 1024
 #define PRINT_BUFFER_GROW_SIZE 1024
 
 #define SHELL_CMD_OUTPUT_BUF_SIZE 255
 
+//! how often a running shell command checks for cancel, in ms
+#define SHELL_CMD_POLL_INTERVAL 100
+
 int
 alloc_print_buffer (print_buffer_t *p)
 {
@@ -35,6 +47,11 @@ grow_print_buffer (print_buffer_t *p, uint32_t len)
         grow_len = PRINT_BUFFER_GROW_SIZE + len;
     }
 
+    //double big buffers, long outputs would realloc too often otherwise
+    if (grow_len < p->max_len) {
+        grow_len = p->max_len;
+    }
+
     new_len = p->max_len + grow_len;
     p->buf = realloc(p->buf, new_len);
     if (!p->buf) {
@@ -79,6 +96,45 @@ printb (print_buffer_t *p, const char *fmt, ...)
     return;
 }
 
+//append bytes as is, data needn't be '\0' terminated
+void
+printb_raw (print_buffer_t *p, const char *data, uint32_t len)
+{
+    int rc;
+
+    if (!p->buf || len == 0) {
+        return;
+    }
+
+    //keep one byte for '\0'
+    if (len >= p->free_len) {
+        rc = grow_print_buffer(p, len);
+        if (rc == -1) {
+            return;
+        }
+    }
+
+    memcpy(&p->buf[p->offset], data, len);
+    p->offset += len;
+    p->free_len -= len;
+    p->buf[p->offset] = '\0';
+    return;
+}
+
+//drop content, keep memory for reuse
+void
+reset_print_buffer (print_buffer_t *p)
+{
+    if (!p->buf) {
+        return;
+    }
+
+    p->offset = 0;
+    p->free_len = p->max_len;
+    p->buf[0] = '\0';
+    return;
+}
+
 void
 free_print_buffer (print_buffer_t *p)
 {
@@ -88,91 +144,174 @@ free_print_buffer (print_buffer_t *p)
     return;
 }
 
+//a user cancel already requested is kept, Ctrl-C may come just before
 void
-run_shell_cmd (char *cmd, print_buffer_t *output_p)
+arm_cancel_token (cancel_token_t *token_p, uint32_t timeout,
+                  cancel_poll_handler poll_handler)
 {
-    FILE *read_fp;
-    char buffer[SHELL_CMD_OUTPUT_BUF_SIZE+1];
-    uint32_t chars_read, len;
+    if (token_p->reason != CANCEL_REASON_USER) {
+        token_p->reason = CANCEL_REASON_NONE;
+    }
+    token_p->deadline = 0;
+    if (timeout > 0) {
+        token_p->deadline = time(NULL) + timeout;
+    }
+    token_p->poll_handler = poll_handler;
+    return;
+}
 
-    read_fp = popen(cmd, "r");
-    if (!read_fp) {
-        return;
+//command done, nothing carries over to the next arm
+void
+disarm_cancel_token (cancel_token_t *token_p)
+{
+    token_p->reason = CANCEL_REASON_NONE;
+    token_p->deadline = 0;
+    token_p->poll_handler = NULL;
+    return;
+}
+
+void
+request_cancel (cancel_token_t *token_p, int reason)
+{
+    if (token_p->reason == CANCEL_REASON_NONE) {
+        token_p->reason = reason;
     }
+    return;
+}
 
-    for (;;) {
-        memset(buffer, 0, sizeof(buffer));
-        chars_read = fread(buffer, sizeof(char),
-                           SHELL_CMD_OUTPUT_BUF_SIZE, read_fp);
-        if (chars_read == 0) {
-            break;
-        }
-        //TODO
-        len = strlen(buffer);
-        printb(output_p, buffer);
+bool
+is_cancelled (cancel_token_t *token_p)
+{
+    if (token_p->reason != CANCEL_REASON_NONE) {
+        return TRUE;
     }
 
-    pclose(read_fp);
-    return;
+    if (token_p->poll_handler && token_p->poll_handler()) {
+        request_cancel(token_p, CANCEL_REASON_USER);
+        return TRUE;
+    }
+
+    if (token_p->deadline != 0 && time(NULL) >= token_p->deadline) {
+        request_cancel(token_p, CANCEL_REASON_TIMEOUT);
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
-static int
-get_file_size (FILE *fp)
+static pid_t
+spawn_shell_cmd (char *cmd, int *read_fd_p)
 {
-    int cur_pos, file_size, result;
+    int pipe_fd[2], null_fd;
+    pid_t pid;
 
-    cur_pos = ftell(fp);
-    if (cur_pos == -1) {
+    if (pipe(pipe_fd) == -1) {
         return -1;
     }
 
-    result = fseek(fp, 0, SEEK_END);
-    if (result != 0) {
+    pid = fork();
+    if (pid == -1) {
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
         return -1;
     }
 
-    file_size = ftell(fp);
-    
-    result = fseek(fp, cur_pos, SEEK_SET);
-    if (result != 0) {
-        return -1;
+    if (pid == 0) {
+        //own process group, so the whole pipeline could be killed on cancel
+        setpgid(0, 0);
+        event_reset_child_signals();
+        dup2(pipe_fd[1], STDOUT_FILENO);
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        //keys belong to the console, not the command
+        null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd != -1) {
+            dup2(null_fd, STDIN_FILENO);
+            close(null_fd);
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
     }
 
-    return file_size;
+    //also set here, no race with kill() before child runs setpgid()
+    setpgid(pid, pid);
+    close(pipe_fd[1]);
+    *read_fd_p = pipe_fd[0];
+    return pid;
 }
 
-char *
-read_file_content (char *file_name)
+void
+run_shell_cmd (char *cmd, print_buffer_t *output_p, cancel_token_t *cancel_p)
 {
-    FILE *fp;
-    int file_size, read_size;
-    char *file_content = NULL;
+    char buffer[SHELL_CMD_OUTPUT_BUF_SIZE+1];
+    struct pollfd poll_fd;
+    ssize_t chars_read;
+    int read_fd, rc;
+    pid_t pid;
 
-    fp = fopen(file_name, "r");
-    if (!fp) {
-        return NULL;
+    pid = spawn_shell_cmd(cmd, &read_fd);
+    if (pid == -1) {
+        return;
     }
 
-    file_size = get_file_size(fp);
-    if (file_size == -1) {
-        fclose(fp);
-        return NULL;
+    poll_fd.fd = read_fd;
+    poll_fd.events = POLLIN;
+
+    for (;;) {
+        if (cancel_p && is_cancelled(cancel_p)) {
+            kill(-pid, SIGKILL);
+            break;
+        }
+
+        rc = poll(&poll_fd, 1, SHELL_CMD_POLL_INTERVAL);
+        if (rc == 0 || (rc == -1 && errno == EINTR)) {
+            continue;
+        }
+        if (rc == -1) {
+            break;
+        }
+
+        chars_read = read(read_fd, buffer, SHELL_CMD_OUTPUT_BUF_SIZE);
+        if (chars_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (chars_read <= 0) {
+            break;
+        }
+        buffer[chars_read] = '\0';
+        printb(output_p, "%s", buffer);
     }
 
-    file_content = calloc(file_size+1, sizeof(char));
-    if (!file_content) {
-        fclose(fp);
+    close(read_fd);
+    while (waitpid(pid, NULL, 0) == -1 && errno == EINTR);
+    return;
+}
+
+//heap copy of a whole file, '\0' terminated. Prefer file view API
+char *
+read_file_content (char *file_name)
+{
+    file_view_t view;
+    char *data, *file_content;
+    size_t size;
+    int rc;
+
+    rc = file_view_open(&view, file_name);
+    if (rc == -1) {
         return NULL;
     }
 
-    read_size = fread(file_content, sizeof(char), file_size, fp);
-    if (read_size != file_size) {
-        free(file_content);
-        fclose(fp);
+    rc = file_view_get_content(&view, &data, &size);
+    if (rc == -1) {
+        file_view_close(&view);
         return NULL;
     }
 
-    fclose(fp);
+    file_content = calloc(size+1, sizeof(char));
+    if (file_content && size > 0) {
+        memcpy(file_content, data, size);
+    }
+
+    file_view_close(&view);
     return file_content;
 }
-
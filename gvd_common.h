@@ -1,7 +1,27 @@
 #ifndef __GVD_COMMON_H__
 #define __GVD_COMMON_H__
 
+#include <time.h>
 #include <stdint.h>
+#include <signal.h>
+#include <stdbool.h>
+
+enum {
+    CANCEL_REASON_NONE = 0,
+    CANCEL_REASON_USER,
+    CANCEL_REASON_TIMEOUT,
+};
+
+//! return TRUE if the user asked to abort the running command
+typedef bool (*cancel_poll_handler)(void);
+
+typedef struct cancel_token_s {
+    //set from signal handler or poll handler, CANCEL_REASON_XXX
+    volatile sig_atomic_t reason;
+    //watchdog, 0 for no timeout
+    time_t deadline;
+    cancel_poll_handler poll_handler;
+} cancel_token_t;
 
 typedef struct print_buffer_s {
     int cmd_ret;
@@ -17,11 +37,30 @@ alloc_print_buffer(print_buffer_t *p);
 void
 printb(print_buffer_t *p, const char *fmt, ...);
 
+void
+printb_raw(print_buffer_t *p, const char *data, uint32_t len);
+
+void
+reset_print_buffer(print_buffer_t *p);
+
 void
 free_print_buffer(print_buffer_t *p);
 
 void
-run_shell_cmd(char *cmd, print_buffer_t *output_p);
+arm_cancel_token(cancel_token_t *token_p, uint32_t timeout,
+                 cancel_poll_handler poll_handler);
+
+void
+disarm_cancel_token(cancel_token_t *token_p);
+
+void
+request_cancel(cancel_token_t *token_p, int reason);
+
+bool
+is_cancelled(cancel_token_t *token_p);
+
+void
+run_shell_cmd(char *cmd, print_buffer_t *output_p, cancel_token_t *cancel_p);
 
 char *
 read_file_content(char *file_name);
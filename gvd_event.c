@@ -0,0 +1,398 @@
+/*
+ * gvd_event.c
+ *
+ * Event loop of the UI thread. One epoll set holds every source: fds like
+ * the console, a timerfd per timer, and one signalfd for all the signals
+ * taken, which are blocked so they only come this way. Handlers run on
+ * the loop, one at a time, and the idle handler before each wait, so the
+ * screen is drawn once for all that happened.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "gvd_util.h"
+#include "gvd_event.h"
+
+enum {
+    EVENT_SOURCE_FREE = 0,
+    EVENT_SOURCE_FD,
+    EVENT_SOURCE_TIMER,
+    EVENT_SOURCE_SIGNAL,
+};
+
+typedef struct event_source_s {
+    int type;
+    int fd;
+    bool periodic;
+    union {
+        event_fd_handler_t fd;
+        event_timer_handler_t timer;
+    } handler;
+    void *ctx;
+} event_source_t;
+
+typedef struct event_signal_s {
+    event_signal_handler_t handler;
+    void *ctx;
+} event_signal_t;
+
+typedef struct event_loop_s {
+    int epoll_fd;
+    event_source_t sources[EVENT_SOURCE_MAX];
+    //bumped each time a slot is taken, events of its old source don't match
+    uint32_t source_gens[EVENT_SOURCE_MAX];
+    //signals blocked for the signalfd, and their handlers
+    int signal_fd;
+    sigset_t signal_set;
+    event_signal_t signals[NSIG];
+    bool stop;
+    event_loop_stats_t stats;
+} event_loop_t;
+
+static event_loop_t event_loop = {
+    .epoll_fd = -1,
+    .signal_fd = -1,
+};
+
+int
+event_loop_init (void)
+{
+    if (event_loop.epoll_fd != -1) {
+        return 0;
+    }
+
+    event_loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (event_loop.epoll_fd == -1) {
+        return -1;
+    }
+
+    sigemptyset(&event_loop.signal_set);
+    return 0;
+}
+
+//signals taken are given back to their default handling
+void
+event_loop_clean (void)
+{
+    uint32_t i;
+
+    if (event_loop.epoll_fd == -1) {
+        return;
+    }
+
+    for (i = 0; i < EVENT_SOURCE_MAX; i++) {
+        if (event_loop.sources[i].type == EVENT_SOURCE_TIMER ||
+            event_loop.sources[i].type == EVENT_SOURCE_SIGNAL) {
+            close(event_loop.sources[i].fd);
+        }
+    }
+
+    close(event_loop.epoll_fd);
+    sigprocmask(SIG_UNBLOCK, &event_loop.signal_set, NULL);
+    memset(&event_loop, 0, sizeof(event_loop_t));
+    event_loop.epoll_fd = -1;
+    event_loop.signal_fd = -1;
+    return;
+}
+
+//slot of the new source, its index and generation are the epoll data
+static int
+add_event_source (int type, int fd, uint32_t events)
+{
+    struct epoll_event ev;
+    uint32_t i;
+
+    if (event_loop.epoll_fd == -1) {
+        return -1;
+    }
+
+    for (i = 0; i < EVENT_SOURCE_MAX; i++) {
+        if (event_loop.sources[i].type == EVENT_SOURCE_FREE) {
+            break;
+        }
+    }
+    if (i == EVENT_SOURCE_MAX) {
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)(event_loop.source_gens[i] + 1) << 32) | i;
+    if (epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        return -1;
+    }
+
+    memset(&event_loop.sources[i], 0, sizeof(event_source_t));
+    event_loop.source_gens[i]++;
+    event_loop.sources[i].type = type;
+    event_loop.sources[i].fd = fd;
+    event_loop.stats.sources++;
+    return i;
+}
+
+static void
+del_event_source (uint32_t idx)
+{
+    event_source_t *source_p = &event_loop.sources[idx];
+
+    epoll_ctl(event_loop.epoll_fd, EPOLL_CTL_DEL, source_p->fd, NULL);
+    if (source_p->type != EVENT_SOURCE_FD) {
+        close(source_p->fd);
+    }
+    memset(source_p, 0, sizeof(event_source_t));
+    event_loop.stats.sources--;
+    return;
+}
+
+//level triggered, the handler reads until it would block or leaves it
+int
+event_add_fd (int fd, uint32_t events, event_fd_handler_t handler, void *ctx)
+{
+    int idx;
+
+    idx = add_event_source(EVENT_SOURCE_FD, fd, events);
+    if (idx == -1) {
+        return -1;
+    }
+
+    event_loop.sources[idx].handler.fd = handler;
+    event_loop.sources[idx].ctx = ctx;
+    return 0;
+}
+
+void
+event_del_fd (int fd)
+{
+    uint32_t i;
+
+    for (i = 0; i < EVENT_SOURCE_MAX; i++) {
+        if (event_loop.sources[i].type == EVENT_SOURCE_FD &&
+            event_loop.sources[i].fd == fd) {
+            del_event_source(i);
+            return;
+        }
+    }
+    return;
+}
+
+//id of the timer, a one-shot one is gone once it fired
+int
+event_add_timer (uint32_t ms, bool periodic, event_timer_handler_t handler,
+                 void *ctx)
+{
+    struct itimerspec its;
+    int fd, idx;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+
+    //0 would disarm it
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = ms/1000;
+    its.it_value.tv_nsec = (ms%1000)*1000000 + (ms?0:1);
+    if (periodic) {
+        its.it_interval = its.it_value;
+    }
+    if (timerfd_settime(fd, 0, &its, NULL) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    idx = add_event_source(EVENT_SOURCE_TIMER, fd, EPOLLIN);
+    if (idx == -1) {
+        close(fd);
+        return -1;
+    }
+
+    event_loop.sources[idx].periodic = periodic;
+    event_loop.sources[idx].handler.timer = handler;
+    event_loop.sources[idx].ctx = ctx;
+    return idx;
+}
+
+void
+event_del_timer (int timer_id)
+{
+    if (timer_id < 0 || timer_id >= EVENT_SOURCE_MAX ||
+        event_loop.sources[timer_id].type != EVENT_SOURCE_TIMER) {
+        return;
+    }
+
+    del_event_source(timer_id);
+    return;
+}
+
+//the signal is blocked from now on and read from the signalfd
+int
+event_add_signal (int signo, event_signal_handler_t handler, void *ctx)
+{
+    sigset_t set;
+    int fd;
+
+    if (event_loop.epoll_fd == -1 || signo <= 0 || signo >= NSIG) {
+        return -1;
+    }
+
+    set = event_loop.signal_set;
+    sigaddset(&set, signo);
+    if (sigprocmask(SIG_BLOCK, &set, NULL) == -1) {
+        return -1;
+    }
+
+    fd = signalfd(event_loop.signal_fd, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    if (event_loop.signal_fd == -1) {
+        if (add_event_source(EVENT_SOURCE_SIGNAL, fd, EPOLLIN) == -1) {
+            close(fd);
+            return -1;
+        }
+        event_loop.signal_fd = fd;
+    }
+
+    event_loop.signal_set = set;
+    event_loop.signals[signo].handler = handler;
+    event_loop.signals[signo].ctx = ctx;
+    return 0;
+}
+
+//in a forked child, before exec, the signals blocked here are not its own
+void
+event_reset_child_signals (void)
+{
+    sigprocmask(SIG_UNBLOCK, &event_loop.signal_set, NULL);
+    return;
+}
+
+static void
+dispatch_signals (void)
+{
+    struct signalfd_siginfo info;
+    event_signal_t *signal_p;
+
+    while (read(event_loop.signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        event_loop.stats.signal_events++;
+        if (info.ssi_signo >= NSIG) {
+            continue;
+        }
+        signal_p = &event_loop.signals[info.ssi_signo];
+        if (signal_p->handler) {
+            signal_p->handler(info.ssi_signo, signal_p->ctx);
+        }
+    }
+    return;
+}
+
+static void
+dispatch_timer (uint32_t idx)
+{
+    event_source_t *source_p = &event_loop.sources[idx];
+    event_timer_handler_t handler;
+    uint64_t expirations;
+    void *ctx;
+
+    if (read(source_p->fd, &expirations, sizeof(expirations)) !=
+        sizeof(expirations)) {
+        return;
+    }
+
+    event_loop.stats.timer_events++;
+    handler = source_p->handler.timer;
+    ctx = source_p->ctx;
+    if (!source_p->periodic) {
+        del_event_source(idx);
+    }
+    handler(idx, ctx);
+    return;
+}
+
+/*
+ * Wait up to timeout_ms, -1 for no limit, and run the handlers of what
+ * happened. A source removed by an earlier handler of the same wait is
+ * skipped, also when a later handler reused its slot, as the generation
+ * of the event is the old one. Number of events, -1 on error.
+ */
+int
+event_loop_run_once (int timeout_ms)
+{
+    struct epoll_event events[EVENT_BATCH_MAX];
+    event_source_t *source_p;
+    uint32_t idx, gen;
+    int cnt, i;
+
+    cnt = epoll_wait(event_loop.epoll_fd, events, EVENT_BATCH_MAX,
+                     timeout_ms);
+    if (cnt == -1) {
+        return (errno == EINTR)?0:-1;
+    }
+    event_loop.stats.wakeups++;
+
+    for (i = 0; i < cnt; i++) {
+        idx = (uint32_t)events[i].data.u64;
+        gen = (uint32_t)(events[i].data.u64 >> 32);
+        if (event_loop.source_gens[idx] != gen) {
+            continue;
+        }
+        source_p = &event_loop.sources[idx];
+        switch (source_p->type) {
+        case EVENT_SOURCE_FD:
+            event_loop.stats.fd_events++;
+            source_p->handler.fd(source_p->fd, events[i].events,
+                                 source_p->ctx);
+            break;
+        case EVENT_SOURCE_TIMER:
+            dispatch_timer(idx);
+            break;
+        case EVENT_SOURCE_SIGNAL:
+            dispatch_signals();
+            break;
+        default:
+            break;
+        }
+    }
+
+    return cnt;
+}
+
+//until event_loop_stop(), idle runs before each wait
+int
+event_loop_run (event_idle_handler_t idle)
+{
+    event_loop.stop = FALSE;
+    while (!event_loop.stop) {
+        if (idle) {
+            idle();
+        }
+        if (event_loop.stop) {
+            break;
+        }
+        if (event_loop_run_once(-1) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+event_loop_stop (void)
+{
+    event_loop.stop = TRUE;
+    return;
+}
+
+void
+event_loop_get_stats (event_loop_stats_t *stats_p)
+{
+    *stats_p = event_loop.stats;
+    return;
+}
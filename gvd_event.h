@@ -0,0 +1,62 @@
+#ifndef __GVD_EVENT_H__
+#define __GVD_EVENT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+
+//! fds, timers and the signal fd together
+#define EVENT_SOURCE_MAX 64
+//! events taken by one wait
+#define EVENT_BATCH_MAX 16
+
+typedef void (*event_fd_handler_t)(int fd, uint32_t events, void *ctx);
+typedef void (*event_timer_handler_t)(int timer_id, void *ctx);
+typedef void (*event_signal_handler_t)(int signo, void *ctx);
+typedef void (*event_idle_handler_t)(void);
+
+typedef struct event_loop_stats_s {
+    uint64_t wakeups;
+    uint64_t fd_events;
+    uint64_t timer_events;
+    uint64_t signal_events;
+    uint32_t sources;
+} event_loop_stats_t;
+
+int
+event_loop_init(void);
+
+void
+event_loop_clean(void);
+
+int
+event_add_fd(int fd, uint32_t events, event_fd_handler_t handler, void *ctx);
+
+void
+event_del_fd(int fd);
+
+int
+event_add_timer(uint32_t ms, bool periodic, event_timer_handler_t handler,
+                void *ctx);
+
+void
+event_del_timer(int timer_id);
+
+int
+event_add_signal(int signo, event_signal_handler_t handler, void *ctx);
+
+void
+event_reset_child_signals(void);
+
+int
+event_loop_run_once(int timeout_ms);
+
+int
+event_loop_run(event_idle_handler_t idle);
+
+void
+event_loop_stop(void);
+
+void
+event_loop_get_stats(event_loop_stats_t *stats_p);
+#endif //__GVD_EVENT_H__
@@ -0,0 +1,283 @@
+/*
+ * gvd_file_view.c
+ *
+ * Read only view of a file. Regular files are mapped, nothing is copied
+ * into heap. Pipes, procfs and anything else not mappable are read as a
+ * stream through a small buffer, with the same iterators on top.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "gvd_util.h"
+#include "gvd_file_view.h"
+
+//! chunk size of chunk iterator on mapped file
+#define FILE_VIEW_CHUNK_SIZE (1024*1024)
+//! initial stream buffer size, doubled for long lines
+#define FILE_VIEW_STREAM_BUF_SIZE (64*1024)
+
+int
+file_view_open (file_view_t *view_p, const char *file_name)
+{
+    struct stat stat_info;
+    void *data;
+    int rc;
+
+    memset(view_p, 0, sizeof(file_view_t));
+
+    view_p->fd = open(file_name, O_RDONLY);
+    if (view_p->fd == -1) {
+        return -1;
+    }
+
+    rc = fstat(view_p->fd, &stat_info);
+    if (rc == -1 || S_ISDIR(stat_info.st_mode)) {
+        close(view_p->fd);
+        view_p->fd = -1;
+        return -1;
+    }
+
+    //procfs reports size 0, read it as a stream
+    if (!S_ISREG(stat_info.st_mode) || stat_info.st_size == 0 ||
+        (uint64_t)stat_info.st_size > SIZE_MAX) {
+        return 0;
+    }
+
+    data = mmap(NULL, stat_info.st_size, PROT_READ, MAP_PRIVATE,
+                view_p->fd, 0);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+
+    (void)madvise(data, stat_info.st_size, MADV_SEQUENTIAL);
+
+    //mapping holds its own reference to the file
+    close(view_p->fd);
+    view_p->fd = -1;
+    view_p->mapped = TRUE;
+    view_p->data = data;
+    view_p->size = stat_info.st_size;
+    return 0;
+}
+
+void
+file_view_close (file_view_t *view_p)
+{
+    if (view_p->mapped) {
+        munmap(view_p->data, view_p->size);
+    }
+    if (view_p->buf) {
+        free(view_p->buf);
+    }
+    if (view_p->fd != -1) {
+        close(view_p->fd);
+    }
+
+    memset(view_p, 0, sizeof(file_view_t));
+    view_p->fd = -1;
+    return;
+}
+
+//read more from stream, unconsumed bytes are moved to buffer start
+static int
+fill_stream_buf (file_view_t *view_p)
+{
+    size_t left, new_size;
+    char *new_buf;
+    ssize_t read_len;
+
+    left = view_p->buf_len - view_p->buf_pos;
+    if (view_p->buf_pos > 0) {
+        memmove(view_p->buf, view_p->buf+view_p->buf_pos, left);
+        view_p->buf_pos = 0;
+        view_p->buf_len = left;
+    }
+
+    if (view_p->buf_len == view_p->buf_size) {
+        new_size = view_p->buf_size?(view_p->buf_size*2):
+                                    FILE_VIEW_STREAM_BUF_SIZE;
+        new_buf = realloc(view_p->buf, new_size);
+        if (!new_buf) {
+            view_p->eof = TRUE;
+            return -1;
+        }
+        view_p->buf = new_buf;
+        view_p->buf_size = new_size;
+    }
+
+    do {
+        read_len = read(view_p->fd, view_p->buf+view_p->buf_len,
+                        view_p->buf_size-view_p->buf_len);
+    } while (read_len == -1 && errno == EINTR);
+
+    if (read_len <= 0) {
+        view_p->eof = TRUE;
+        return (read_len == 0)?0:-1;
+    }
+
+    view_p->buf_len += read_len;
+    return 0;
+}
+
+//line includes the trailing '\n' if any, valid until next call
+bool
+file_view_next_line (file_view_t *view_p, char **line_p, size_t *len_p)
+{
+    char *line, *end;
+    size_t avail;
+
+    if (view_p->mapped) {
+        if (view_p->pos >= view_p->size) {
+            return FALSE;
+        }
+        line = view_p->data + view_p->pos;
+        end = memchr(line, '\n', view_p->size - view_p->pos);
+        *line_p = line;
+        *len_p = end?(end-line+1):(view_p->size - view_p->pos);
+        view_p->pos += *len_p;
+        return TRUE;
+    }
+
+    for (;;) {
+        avail = view_p->buf_len - view_p->buf_pos;
+        line = view_p->buf + view_p->buf_pos;
+        end = avail?memchr(line, '\n', avail):NULL;
+        if (end || (view_p->eof && avail > 0)) {
+            *line_p = line;
+            *len_p = end?(end-line+1):avail;
+            view_p->buf_pos += *len_p;
+            return TRUE;
+        }
+        if (view_p->eof) {
+            return FALSE;
+        }
+        (void)fill_stream_buf(view_p);
+    }
+}
+
+//up to line_cnt whole lines as one span, valid until next call
+bool
+file_view_next_lines (file_view_t *view_p, uint32_t line_cnt, char **span_p,
+                      size_t *len_p, uint32_t *cnt_p)
+{
+    char *p, *end, *line_end;
+    uint32_t cnt = 1;
+    size_t len;
+
+    //at least one line, even if the stream buffer has to grow for it
+    if (!file_view_next_line(view_p, span_p, &len)) {
+        return FALSE;
+    }
+
+    p = *span_p + len;
+    end = view_p->mapped?(view_p->data + view_p->size):
+                         (view_p->buf + view_p->buf_len);
+
+    while (cnt < line_cnt && p < end) {
+        line_end = memchr(p, '\n', end-p);
+        if (!line_end) {
+            //a stream may have the rest of this line unread
+            if (view_p->mapped || view_p->eof) {
+                p = end;
+                cnt++;
+            }
+            break;
+        }
+        p = line_end + 1;
+        cnt++;
+    }
+
+    if (view_p->mapped) {
+        view_p->pos += p - (*span_p + len);
+    } else {
+        view_p->buf_pos += p - (*span_p + len);
+    }
+
+    *len_p = p - *span_p;
+    *cnt_p = cnt;
+    return TRUE;
+}
+
+//chunk boundaries are arbitrary, valid until next call
+bool
+file_view_next_chunk (file_view_t *view_p, char **chunk_p, size_t *len_p)
+{
+    size_t len, page_mask, end;
+
+    if (view_p->mapped) {
+        if (view_p->pos >= view_p->size) {
+            return FALSE;
+        }
+
+        //pages walked since the last chunk won't be needed again, keep
+        //RSS flat, the ones before were given back already
+        page_mask = sysconf(_SC_PAGESIZE) - 1;
+        end = view_p->pos & ~page_mask;
+        if (end > view_p->released) {
+            (void)madvise(view_p->data + view_p->released,
+                          end - view_p->released, MADV_DONTNEED);
+            view_p->released = end;
+        }
+
+        len = view_p->size - view_p->pos;
+        len = (len > FILE_VIEW_CHUNK_SIZE)?FILE_VIEW_CHUNK_SIZE:len;
+        *chunk_p = view_p->data + view_p->pos;
+        *len_p = len;
+        view_p->pos += len;
+        return TRUE;
+    }
+
+    if (view_p->buf_pos == view_p->buf_len) {
+        if (view_p->eof) {
+            return FALSE;
+        }
+        view_p->buf_pos = view_p->buf_len = 0;
+        (void)fill_stream_buf(view_p);
+        if (view_p->buf_len == 0) {
+            return FALSE;
+        }
+    }
+
+    *chunk_p = view_p->buf + view_p->buf_pos;
+    *len_p = view_p->buf_len - view_p->buf_pos;
+    view_p->buf_pos = view_p->buf_len;
+    return TRUE;
+}
+
+//nothing left for iterators, a stream may not know until it hits eof
+bool
+file_view_at_end (file_view_t *view_p)
+{
+    if (view_p->mapped) {
+        return (view_p->pos >= view_p->size);
+    }
+
+    return (view_p->eof && view_p->buf_pos == view_p->buf_len);
+}
+
+//whole content at once, streams are read into heap, do not mix with iterators
+int
+file_view_get_content (file_view_t *view_p, char **data_p, size_t *size_p)
+{
+    if (view_p->mapped) {
+        *data_p = view_p->data;
+        *size_p = view_p->size;
+        return 0;
+    }
+
+    while (!view_p->eof) {
+        if (fill_stream_buf(view_p) == -1) {
+            return -1;
+        }
+    }
+
+    *data_p = view_p->buf + view_p->buf_pos;
+    *size_p = view_p->buf_len - view_p->buf_pos;
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef __GVD_FILE_VIEW_H__
+#define __GVD_FILE_VIEW_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct file_view_s {
+    int fd;
+    //regular file mapped read only, otherwise read as a stream
+    bool mapped;
+    char *data;
+    size_t size;
+    //iterator position in data
+    size_t pos;
+    //mapped pages before this were given back by next_chunk
+    size_t released;
+    //stream buffer, [buf_pos, buf_len) not consumed yet
+    char *buf;
+    size_t buf_size;
+    size_t buf_len;
+    size_t buf_pos;
+    bool eof;
+} file_view_t;
+
+int
+file_view_open(file_view_t *view_p, const char *file_name);
+
+void
+file_view_close(file_view_t *view_p);
+
+bool
+file_view_next_line(file_view_t *view_p, char **line_p, size_t *len_p);
+
+bool
+file_view_next_lines(file_view_t *view_p, uint32_t line_cnt, char **span_p,
+                     size_t *len_p, uint32_t *cnt_p);
+
+bool
+file_view_next_chunk(file_view_t *view_p, char **chunk_p, size_t *len_p);
+
+bool
+file_view_at_end(file_view_t *view_p);
+
+int
+file_view_get_content(file_view_t *view_p, char **data_p, size_t *size_p);
+#endif //__GVD_FILE_VIEW_H__
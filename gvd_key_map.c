@@ -0,0 +1,234 @@
+/*
+ * gvd_key_map.c
+ *
+ * Key bindings of the console prompt. The handler of a key is found by its
+ * code in one table, and text keys by their byte in a class bitmap, so a
+ * key costs the same whatever is bound. Handlers are given by the input
+ * loop as named actions, key-binding in configuration mode binds them
+ * by name, for all terminals.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "gvd_util.h"
+#include "gvd_key_map.h"
+#include "gvd_cli_tty.h"
+
+//! class bits of a byte
+#define KEY_CLASS_TEXT 0x01
+
+//! name of the action unbinding a key
+#define KEY_ACTION_NONE "none"
+//! name of the action bound to the key at start
+#define KEY_ACTION_DEFAULT "default"
+
+typedef struct key_name_s {
+    char *name;
+    int key;
+} key_name_t;
+
+//ctrl-a to ctrl-z are named by their letter
+static key_name_t key_names[] = {
+    {"tab",           '\t'},
+    {"enter",         GVD_KEY_ENTER},
+    {"backspace",     GVD_KEY_BACKSPACE},
+    {"delete",        GVD_KEY_DEL},
+    {"up",            GVD_KEY_UP},
+    {"down",          GVD_KEY_DOWN},
+    {"left",          GVD_KEY_LEFT},
+    {"right",         GVD_KEY_RIGHT},
+    {"home",          GVD_KEY_HOME},
+    {"end",           GVD_KEY_END},
+    {"page-up",       GVD_KEY_PGUP},
+    {"page-down",     GVD_KEY_PGDOWN},
+    {"esc",           GVD_KEY_ESC},
+    {"question-mark", '?'},
+};
+
+//0-9a-zA-Z not mentioned here. so many, but what's not included? ?
+static char *allowed_text_char_set = " ~`!@#$%^&*()-_=+[]{};:,.<>/|\\\"'";
+
+static key_action_t *key_actions = NULL;
+static uint32_t key_action_cnt = 0;
+static key_action_t *key_bindings[GVD_KEY_CODE_MAX];
+static uint8_t key_classes[256];
+static key_map_stats_t key_map_stats;
+
+static void
+init_key_classes (void)
+{
+    char *str;
+    int ch;
+
+    memset(key_classes, 0, sizeof(key_classes));
+    for (ch = 0; ch < 128; ch++) {
+        if (isalnum(ch)) {
+            key_classes[ch] |= KEY_CLASS_TEXT;
+        }
+    }
+
+    for (str = allowed_text_char_set; *str; str++) {
+        key_classes[(uint8_t)*str] |= KEY_CLASS_TEXT;
+    }
+
+    return;
+}
+
+void
+key_map_init (key_action_t *actions, uint32_t cnt)
+{
+    key_actions = actions;
+    key_action_cnt = cnt;
+    init_key_classes();
+    key_map_reset();
+    return;
+}
+
+//back to the default key of each action
+void
+key_map_reset (void)
+{
+    uint32_t i;
+    int key;
+
+    memset(key_bindings, 0, sizeof(key_bindings));
+    for (i = 0; i < key_action_cnt; i++) {
+        key = key_actions[i].default_key;
+        if (key >= 0 && key < GVD_KEY_CODE_MAX) {
+            key_bindings[key] = &key_actions[i];
+        }
+    }
+
+    return;
+}
+
+key_handler_t
+key_map_lookup (int key)
+{
+    if (key < 0 || key >= GVD_KEY_CODE_MAX || !key_bindings[key]) {
+        return NULL;
+    }
+
+    return key_bindings[key]->handler;
+}
+
+bool
+key_map_is_text (int key)
+{
+    if (key < 0 || key > 0xff) {
+        return FALSE;
+    }
+
+    return (key_classes[key] & KEY_CLASS_TEXT) != 0;
+}
+
+//-1 if the name is not known
+int
+key_map_get_code (char *key_name)
+{
+    uint32_t i;
+
+    for (i = 0; i < ARRAY_LEN(key_names); i++) {
+        if (strcmp(key_name, key_names[i].name) == 0) {
+            return key_names[i].key;
+        }
+    }
+
+    if (strncmp(key_name, "ctrl-", 5) == 0 && islower(key_name[5]) &&
+        key_name[6] == '\0') {
+        return key_name[5] - 'a' + 1;
+    }
+
+    return -1;
+}
+
+//FALSE for a key with no name, which can't be bound
+bool
+key_map_get_name (int key, char *name, uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < ARRAY_LEN(key_names); i++) {
+        if (key_names[i].key == key) {
+            snprintf(name, size, "%s", key_names[i].name);
+            return TRUE;
+        }
+    }
+
+    if (key >= 1 && key <= 26) {
+        snprintf(name, size, "ctrl-%c", 'a' + key - 1);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//action "none" unbinds the key, "default" binds it as at start,
+//-1 if the action is not known
+int
+key_map_bind (int key, char *action_name)
+{
+    bool by_default;
+    uint32_t i;
+
+    if (key < 0 || key >= GVD_KEY_CODE_MAX) {
+        return -1;
+    }
+
+    if (strcmp(action_name, KEY_ACTION_NONE) == 0) {
+        key_bindings[key] = NULL;
+        return 0;
+    }
+
+    //a key with no default is left unbound
+    by_default = (strcmp(action_name, KEY_ACTION_DEFAULT) == 0);
+    if (by_default) {
+        key_bindings[key] = NULL;
+    }
+
+    for (i = 0; i < key_action_cnt; i++) {
+        if (by_default?(key_actions[i].default_key == key):
+                       (strcmp(action_name, key_actions[i].name) == 0)) {
+            key_bindings[key] = &key_actions[i];
+            return 0;
+        }
+    }
+
+    return by_default?0:-1;
+}
+
+char *
+key_map_get_action_name (int key)
+{
+    if (key < 0 || key >= GVD_KEY_CODE_MAX || !key_bindings[key]) {
+        return NULL;
+    }
+
+    return key_bindings[key]->name;
+}
+
+key_action_t *
+key_map_get_action (uint32_t idx)
+{
+    return (idx < key_action_cnt)?&key_actions[idx]:NULL;
+}
+
+void
+key_map_count_key (uint64_t ns)
+{
+    key_map_stats.keys++;
+    key_map_stats.handle_ns += ns;
+    if (ns > key_map_stats.handle_ns_max) {
+        key_map_stats.handle_ns_max = ns;
+    }
+    return;
+}
+
+void
+key_map_get_stats (key_map_stats_t *stats_p)
+{
+    *stats_p = key_map_stats;
+    return;
+}
@@ -0,0 +1,58 @@
+#ifndef __GVD_KEY_MAP_H__
+#define __GVD_KEY_MAP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//! longest key or action name
+#define KEY_MAP_NAME_MAX_LEN 31
+
+typedef int (*key_handler_t)(int input);
+
+//what a key does at the prompt, bound to default_key at start
+typedef struct key_action_s {
+    char *name;
+    char *help_string;
+    key_handler_t handler;
+    int default_key;
+} key_action_t;
+
+typedef struct key_map_stats_s {
+    uint64_t keys;
+    uint64_t handle_ns;
+    uint64_t handle_ns_max;
+} key_map_stats_t;
+
+void
+key_map_init(key_action_t *actions, uint32_t cnt);
+
+void
+key_map_reset(void);
+
+key_handler_t
+key_map_lookup(int key);
+
+bool
+key_map_is_text(int key);
+
+int
+key_map_get_code(char *key_name);
+
+bool
+key_map_get_name(int key, char *name, uint32_t size);
+
+int
+key_map_bind(int key, char *action_name);
+
+char *
+key_map_get_action_name(int key);
+
+key_action_t *
+key_map_get_action(uint32_t idx);
+
+void
+key_map_count_key(uint64_t ns);
+
+void
+key_map_get_stats(key_map_stats_t *stats_p);
+#endif //__GVD_KEY_MAP_H__
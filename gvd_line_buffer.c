@@ -3,632 +3,1336 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdint.h>
-#include <ncurses.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
 #include "gvd_util.h"
 #include "gvd_common.h"
 #include "gvd_cli_tty.h"
+#include "gvd_line_spill.h"
+#include "gvd_log_writer.h"
 #include "gvd_line_buffer.h"
 
-//! line buffer struct size
-#define LINE_BUFFER_SIZE 128
-//! line buffer content max string length, 1 for '\0'
-#define LINE_BUFFER_CONTENT_MAX_LEN \
-    (LINE_BUFFER_SIZE - sizeof(struct line_buffer_s) - 1)
-//! define for those extra long line, beyond this will be cut
-#define BIG_LINE_BUFFER_SIZE 1024
-//! big line buffer content max string length, 1 for '\0'
-#define BIG_LINE_BUFFER_CONTENT_MAX_LEN \
-    (BIG_LINE_BUFFER_SIZE - sizeof(struct line_buffer_s) - 1)
-//! Line buffer number, will do disk flush when used up
-#define LINE_BUFFER_NUM 1024
-//! how many line buffers could one mask cover
-#define LINE_BUFFER_MASK_SIZE (sizeof(int)*8)
-//! bit mask, show line buffer availability
-#define LINE_BUFFER_MASK_NUM (LINE_BUFFER_NUM/LINE_BUFFER_MASK_SIZE)
+//! default bytes of scrollback in RAM, older lines go to disk tier
+#define LINE_RING_SIZE_DEFAULT (1024*1024)
+//! max lines kept in RAM, power of 2
+#define LINE_INDEX_NUM (32*1024)
+//! lines sharing one time base, power of 2
+#define LINE_TIME_BLOCK 64
+//! time bases kept, twice the blocks in RAM so head and tail never share
+#define LINE_TIME_BASE_NUM (2*LINE_INDEX_NUM/LINE_TIME_BLOCK)
+//! one line takes at most this much of the ring, beyond this will be cut
+#define LINE_MAX_LEN (line_ring.size/4)
 //! the temp output buffer size
 #define OUTPUT_TEMP_SIZE 1023
-
-#define FLAG_GET(flag, mask) ((flag) & (mask))
-#define FLAG_SET(flag, mask) ((flag) |= (mask))
-#define FLAG_UNSET(flag, mask) ((flag) &= (~mask))
-
-//! whether this line buffer flushed to disk
-#define LINE_BUFFER_FLAG_DIRTY (1 << 0)
-//! whether this line buffer is a big one(needs free when useless)
-#define LINE_BUFFER_FLAG_BIG   (1 << 1)
-
-typedef struct line_buffer_s {
-    struct line_buffer_s *prev;
-    struct line_buffer_s *next;
+//! tab stops of output, tabs are stored as the spaces up to the next one
+#define LINE_TAB_SIZE 8
+//! no line
+#define LINE_SEQ_NONE UINT64_MAX
+//! screen row showing the search status instead of a line
+#define LINE_SEQ_STATUS (UINT64_MAX-1)
+//! lines summed up in one wrapped-row block, power of 2
+#define SCR_WRAP_BLOCK_LINES 16
+//! wrapped-row blocks cached, power of 2
+#define SCR_WRAP_BLOCK_NUM 4096
+//! bytes of the RAM ring scanned at a time when searching
+#define SEARCH_CHUNK_SIZE (64*1024)
+//! output updates the screen at most once per this many microseconds
+#define SCR_FRAME_INTERVAL_US (1000000/60)
+//! end of the line being written is not on screen
+#define SCR_ROW_NONE UINT32_MAX
+
+/*
+ * Recent scrollback is one byte ring holding line contents back to back,
+ * and a ring of line offsets and lengths indexed by line sequence number.
+ * Each line is contiguous in the byte ring, a line not fitting before the
+ * ring end starts over from the ring start. Lines evicted from the ring
+ * go to the disk tier, sequence numbers carry on there. The time of a
+ * line is kept in ms, as a delta from the base of its LINE_TIME_BLOCK.
+ */
+typedef struct line_entry_s {
+    //position in the byte stream, ring offset is pos % size
+    uint64_t pos;
     uint32_t len;
-    uint8_t flag;
-    char content[0];
-} line_buffer_t;
+    uint32_t time_delta;
+} line_entry_t;
+
+typedef struct line_ring_s {
+    char *bytes;
+    uint32_t size;
+    line_entry_t *lines;
+    //oldest line kept
+    uint64_t head_seq;
+    //line being written, always exists
+    uint64_t tail_seq;
+    //bumped on every change of the line being written
+    uint64_t tail_gen;
+    //wall clock ms of every LINE_TIME_BLOCK line
+    uint64_t *time_bases;
+    //never goes back, so line times stay sorted
+    uint64_t last_time_ms;
+} line_ring_t;
+
+//what one screen row shows, part of one line
+typedef struct scr_row_s {
+    uint64_t seq;
+    uint32_t start;
+    uint32_t end;
+    //content version, only the line being written ever changes
+    uint64_t gen;
+    //search pattern version, low bit set if the current match is in it
+    uint64_t mark;
+} scr_row_t;
 
 typedef struct scr_dump_ctx_s {
     uint32_t scr_y;
     uint32_t scr_x;
-    line_buffer_t *bottom_p;
-    uint32_t bottom_offset;
+    //last line shown, and its wrapped row shown last
+    uint64_t bottom_seq;
+    uint32_t bottom_row;
+    //rows on terminal now, and rows of the frame being built
+    scr_row_t *shown;
+    scr_row_t *frame;
+    uint32_t row_cnt;
+    bool shown_valid;
+    //output saved but not on screen yet
+    bool dirty;
+    uint64_t last_frame_us;
+    //highlight of each byte in the row being drawn
+    uint8_t *marks;
+    //row showing the end of the line being written, or SCR_ROW_NONE
+    uint32_t tail_y;
 } scr_dump_ctx_t;
 
-void *line_buffers_memory = NULL;
-static line_buffer_t* line_buffers[LINE_BUFFER_NUM];
-static int line_buffer_mask[LINE_BUFFER_MASK_NUM];
+/*
+ * Screen rows taken by each block of SCR_WRAP_BLOCK_LINES finished lines,
+ * so a scroll steps over whole blocks. Counted for one screen width, a
+ * block is recounted when used after a resize.
+ */
+typedef struct scr_wrap_block_s {
+    //slot is shared by blocks SCR_WRAP_BLOCK_NUM apart
+    uint64_t first_seq;
+    //0 if never counted
+    uint32_t width;
+    uint64_t rows;
+} scr_wrap_block_t;
+
+//incremental search, the bottom row shows the pattern while active
+typedef struct scr_search_s {
+    bool active;
+    char pattern[SCR_SEARCH_MAX_LEN+1];
+    uint32_t len;
+    //current match
+    bool found;
+    //why the last search found nothing, current match is kept
+    char *fail_msg;
+    uint64_t seq;
+    uint32_t off;
+    //bumped on pattern change, rows with matches get redrawn
+    uint64_t gen;
+    //bumped on any change of the status row
+    uint64_t status_gen;
+} scr_search_t;
+
+static line_ring_t line_ring;
+
+static uint32_t line_ring_size = LINE_RING_SIZE_DEFAULT;
 
 static char output_temp[OUTPUT_TEMP_SIZE+1];
 
-static line_buffer_t *head = NULL, *tail = NULL;
-
 static char *console_log_name = "./.console_log";
 
 static scr_dump_ctx_t scr_dump_ctx;
 
-static int logfile_fd = -1;
+static scr_render_stats_t scr_render_stats;
 
-void
-clear_disk_logfile (void)
+static scr_search_t scr_search;
+
+static scr_wrap_block_t scr_wrap_blocks[SCR_WRAP_BLOCK_NUM];
+
+static line_entry_t *
+get_line (uint64_t seq)
 {
-    if (logfile_fd == -1) {
-        return;
+    return &line_ring.lines[seq & (LINE_INDEX_NUM-1)];
+}
+
+static char *
+get_line_data (uint64_t seq)
+{
+    return &line_ring.bytes[get_line(seq)->pos % line_ring.size];
+}
+
+//line in RAM or on disk, data is valid until the next call
+static bool
+get_line_text (uint64_t seq, char **data_p, uint32_t *len_p)
+{
+    if (seq >= line_ring.head_seq) {
+        *data_p = get_line_data(seq);
+        *len_p = get_line(seq)->len;
+        return TRUE;
     }
 
-    ftruncate(logfile_fd, 0);
-    lseek(logfile_fd, 0, SEEK_SET);
-    return;
+    return line_spill_get(seq, data_p, len_p);
 }
 
+static uint32_t
+get_line_len (uint64_t seq)
+{
+    uint32_t len;
+    char *data;
+
+    if (!get_line_text(seq, &data, &len)) {
+        return 0;
+    }
+    return len;
+}
+
+static uint64_t *
+get_line_time_base (uint64_t seq)
+{
+    return &line_ring.time_bases[(seq/LINE_TIME_BLOCK) &
+                                 (LINE_TIME_BASE_NUM-1)];
+}
+
+static uint64_t
+get_wall_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+//line in RAM takes the time now
 static void
-dump_one_line_to_disk (line_buffer_t *p)
+stamp_line_time (uint64_t seq)
 {
-    if (logfile_fd == -1) {
-        return;
+    uint64_t now = get_wall_ms(), *base_p = get_line_time_base(seq);
+
+    if (now < line_ring.last_time_ms) {
+        now = line_ring.last_time_ms;
     }
+    line_ring.last_time_ms = now;
 
-    write(logfile_fd, p->content, strlen(p->content));
-    FLAG_UNSET(p->flag, LINE_BUFFER_FLAG_DIRTY);
+    if ((seq % LINE_TIME_BLOCK) == 0) {
+        *base_p = now;
+    }
+    if (now - *base_p > UINT32_MAX) {
+        now = *base_p + UINT32_MAX;
+    }
+    get_line(seq)->time_delta = now - *base_p;
     return;
 }
 
-void
-dump_all_lines_to_disk (void)
+static bool
+get_line_time (uint64_t seq, uint64_t *time_ms_p)
 {
-    line_buffer_t *p = head;
-
-    if (logfile_fd == -1) {
-        return;
+    if (seq >= line_ring.head_seq) {
+        *time_ms_p = *get_line_time_base(seq) + get_line(seq)->time_delta;
+        return TRUE;
     }
 
-    while (p != tail) {
-        if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_DIRTY)) {
-            dump_one_line_to_disk(p);
-        }
-        p = p->next;
+    return line_spill_get_time(seq, time_ms_p);
+}
+
+//oldest line still reachable
+static uint64_t
+get_first_line (void)
+{
+    uint64_t spill_cnt = line_spill_line_cnt();
+
+    if (spill_cnt > 0 &&
+        line_spill_first_seq() + spill_cnt == line_ring.head_seq) {
+        return line_spill_first_seq();
     }
+    return line_ring.head_seq;
+}
+
+void
+clear_disk_logfile (void)
+{
+    log_writer_clear();
+    return;
+}
 
+//queued to the writer thread, never waits for the disk
+static void
+dump_one_line_to_disk (uint64_t seq)
+{
+    log_writer_append(get_line_data(seq), get_line(seq)->len);
+    return;
+}
+
+//lines are queued as they finish, wait for them to reach the logfile
+void
+dump_all_lines_to_disk (void)
+{
+    log_writer_sync();
     return;
 }
 
 static int
 console_log_file_init (void)
 {
-    logfile_fd = open(console_log_name, O_CREAT|O_WRONLY|O_TRUNC, 0666);
-    if (logfile_fd == -1) {
-        return -1;
+    if (!console_log_name) {
+        return 0;
     }
+    return log_writer_start(console_log_name);
+}
 
-    return 0;
+//before line_buffer_init, NULL for no logfile
+void
+line_buffer_set_log_name (char *name)
+{
+    console_log_name = name;
+    return;
 }
 
-static line_buffer_t *
-decide_scr_dump_top (uint32_t *top_offset_p)
+//rows for lines, the bottom one is taken by search status
+static uint32_t
+get_scr_text_rows (void)
 {
-    line_buffer_t *bottom_p, *p;
-    uint32_t bottom_offset, top_offset;
-    uint32_t left_line, width, line_chars;
+    if (scr_search.active && scr_dump_ctx.scr_y > 1) {
+        return scr_dump_ctx.scr_y - 1;
+    }
+    return scr_dump_ctx.scr_y;
+}
 
-    bottom_p = scr_dump_ctx.bottom_p;
-    bottom_offset = scr_dump_ctx.bottom_offset;
-    left_line = scr_dump_ctx.scr_y;
-    width = scr_dump_ctx.scr_x;
+//screen rows of one line, an empty line still takes one
+static uint32_t
+get_line_rows (uint64_t seq)
+{
+    uint32_t len = get_line_len(seq), width = scr_dump_ctx.scr_x;
 
-    line_chars = bottom_offset;
-    p = bottom_p;
-    while (left_line > 0 && p) {
-        if (line_chars <= width) {
-            p = p->prev;
-            line_chars = p?p->len:0;
-        } else {
-            line_chars -= width;
-        }
+    return (len == 0 || width == 0)?1:((len + width - 1)/width);
+}
+
+//rows of the whole block from first_seq, only if all its lines finished
+static bool
+get_wrap_block_rows (uint64_t first_seq, uint64_t *rows_p)
+{
+    scr_wrap_block_t *block_p;
+    uint64_t seq, rows;
 
-        left_line--;
+    if (first_seq < get_first_line() ||
+        first_seq + SCR_WRAP_BLOCK_LINES > line_ring.tail_seq) {
+        return FALSE;
     }
 
-    if (!p) {
-        p = head;
-        top_offset = 0;
-    } else if (line_chars == p->len) {
-        p = p->next;
-        top_offset = 0;
-    } else {
-        top_offset = ((line_chars+width-1)/width)*width;
+    block_p = &scr_wrap_blocks[(first_seq/SCR_WRAP_BLOCK_LINES) &
+                               (SCR_WRAP_BLOCK_NUM-1)];
+    if (block_p->first_seq != first_seq ||
+        block_p->width != scr_dump_ctx.scr_x) {
+        rows = 0;
+        for (seq = first_seq; seq < first_seq + SCR_WRAP_BLOCK_LINES; seq++) {
+            rows += get_line_rows(seq);
+        }
+        block_p->first_seq = first_seq;
+        block_p->width = scr_dump_ctx.scr_x;
+        block_p->rows = rows;
+        scr_render_stats.wrap_blocks_counted++;
     }
 
-    *top_offset_p = top_offset;
-    return p;
+    *rows_p = block_p->rows;
+    return TRUE;
 }
 
 static void
-dump_line_buffer_to_scr (line_buffer_t *top_p, uint32_t top_offset)
+reset_wrap_blocks (void)
 {
-    line_buffer_t *bottom_p, *p;
-    uint32_t bottom_offset;
-    char temp;
+    memset(scr_wrap_blocks, 0, sizeof(scr_wrap_blocks));
+    return;
+}
+
+//(seq, row) goes cnt rows up, stops at the first row of the first line
+static void
+move_scr_rows_up (uint64_t *seq_p, uint32_t *row_p, uint64_t cnt)
+{
+    uint64_t seq = *seq_p, first = get_first_line(), block_rows;
+    uint64_t row = *row_p;
+
+    for (;;) {
+        if (row >= cnt) {
+            row -= cnt;
+            break;
+        }
+        if (seq == first) {
+            row = 0;
+            break;
+        }
 
-    bottom_p = scr_dump_ctx.bottom_p;
-    bottom_offset = scr_dump_ctx.bottom_offset;
+        //now at the last row of the line above
+        cnt -= row + 1;
+        while ((seq % SCR_WRAP_BLOCK_LINES) == 0 &&
+               seq >= first + SCR_WRAP_BLOCK_LINES + 1 &&
+               get_wrap_block_rows(seq - SCR_WRAP_BLOCK_LINES, &block_rows) &&
+               block_rows <= cnt) {
+            cnt -= block_rows;
+            seq -= SCR_WRAP_BLOCK_LINES;
+            scr_render_stats.wrap_blocks_skipped++;
+        }
+        seq--;
+        row = get_line_rows(seq) - 1;
+    }
 
-    clear();
+    *seq_p = seq;
+    *row_p = row;
+    return;
+}
 
-    p = top_p;
-    printw("%s", &p->content[top_offset]);
-    p = p->next;
+//(seq, row) goes cnt rows down, stops at the last row of the tail line
+static void
+move_scr_rows_down (uint64_t *seq_p, uint32_t *row_p, uint64_t cnt)
+{
+    uint64_t seq = *seq_p, block_rows;
+    uint64_t row = *row_p, rows;
 
-    if (!p) {
-        return;
+    for (;;) {
+        rows = get_line_rows(seq);
+        if (row + cnt < rows) {
+            row += cnt;
+            break;
+        }
+        if (seq == line_ring.tail_seq) {
+            row = rows - 1;
+            break;
+        }
+
+        //now at the first row of the line below
+        cnt -= rows - row;
+        seq++;
+        while ((seq % SCR_WRAP_BLOCK_LINES) == 0 &&
+               get_wrap_block_rows(seq, &block_rows) &&
+               block_rows <= cnt) {
+            cnt -= block_rows;
+            seq += SCR_WRAP_BLOCK_LINES;
+            scr_render_stats.wrap_blocks_skipped++;
+        }
+        row = 0;
     }
 
-    while (p != bottom_p) {
-        printw("%s", p->content);
-        p = p->next;
+    *seq_p = seq;
+    *row_p = row;
+    return;
+}
+
+static uint64_t
+decide_scr_dump_top (uint32_t *top_offset_p)
+{
+    uint64_t seq = scr_dump_ctx.bottom_seq;
+    uint32_t row = scr_dump_ctx.bottom_row, text_rows;
+
+    text_rows = get_scr_text_rows();
+    if (text_rows > 0) {
+        move_scr_rows_up(&seq, &row, text_rows - 1);
     }
 
-    if (bottom_offset == 0) {
-        printw("%s", p->content);
-    } else {
-        temp = p->content[bottom_offset];
-        p->content[bottom_offset] = '\0';
-        printw("%s", p->content);
-        p->content[bottom_offset] = temp;
+    *top_offset_p = row*scr_dump_ctx.scr_x;
+    return seq;
+}
+
+static void
+set_scr_row (scr_row_t *row_p, uint64_t seq, uint32_t start, uint32_t end)
+{
+    row_p->seq = seq;
+    row_p->start = start;
+    row_p->end = end;
+    row_p->gen = (seq == line_ring.tail_seq)?line_ring.tail_gen:0;
+    row_p->mark = 0;
+
+    if (scr_search.active && scr_search.len > 0 && seq < LINE_SEQ_STATUS) {
+        row_p->mark = scr_search.gen << 1;
+        if (scr_search.found && seq == scr_search.seq &&
+            start < scr_search.off + scr_search.len && end > scr_search.off) {
+            row_p->mark |= 1;
+        }
     }
+    return;
+}
 
+static void
+set_scr_status_row (scr_row_t *row_p)
+{
+    row_p->seq = LINE_SEQ_STATUS;
+    row_p->start = 0;
+    row_p->end = 0;
+    row_p->gen = scr_search.status_gen;
+    row_p->mark = 0;
     return;
 }
 
+static bool
+is_same_scr_row (scr_row_t *a_p, scr_row_t *b_p)
+{
+    return (a_p->seq == b_p->seq && a_p->start == b_p->start &&
+            a_p->end == b_p->end && a_p->gen == b_p->gen &&
+            a_p->mark == b_p->mark);
+}
+
+//cut lines from top to bottom into screen rows
 static void
-decide_scroll_up_bottom (void)
+build_scr_frame (uint64_t top_seq, uint32_t top_offset)
 {
-    line_buffer_t *bottom_p, *p;
-    uint32_t bottom_offset;
-    uint32_t left_line, width, line_chars;
+    scr_row_t *frame = scr_dump_ctx.frame;
+    uint64_t bottom_seq, seq;
+    uint32_t bottom_end, width, row, start, end, len, text_rows;
 
-    bottom_p = scr_dump_ctx.bottom_p;
-    bottom_offset = scr_dump_ctx.bottom_offset;
-    left_line = scr_dump_ctx.scr_y/2;
     width = scr_dump_ctx.scr_x;
+    bottom_seq = scr_dump_ctx.bottom_seq;
+    bottom_end = (scr_dump_ctx.bottom_row + 1)*width;
+    if (bottom_end > get_line_len(bottom_seq)) {
+        bottom_end = get_line_len(bottom_seq);
+    }
+    text_rows = get_scr_text_rows();
+    scr_dump_ctx.tail_y = SCR_ROW_NONE;
+
+    row = 0;
+    seq = top_seq;
+    start = top_offset;
+    while (row < text_rows) {
+        len = (seq == bottom_seq)?bottom_end:get_line_len(seq);
+        if (start < len || (start == 0 && len == 0)) {
+            end = (len - start > width)?(start + width):len;
+            if (seq == line_ring.tail_seq && end == get_line_len(seq)) {
+                scr_dump_ctx.tail_y = row;
+            }
+            set_scr_row(&frame[row++], seq, start, end);
+            start = end;
+            if (start < len) {
+                continue;
+            }
+        }
 
-    line_chars = bottom_p->len - bottom_offset;
-    p = bottom_p;
-    while (left_line > 0 && p) {
-        if (line_chars <= width) {
-            p = p->prev;
-            line_chars = p?p->len:0;
-        } else {
-            line_chars -= width;
+        if (seq == bottom_seq) {
+            break;
         }
+        seq++;
+        start = 0;
+    }
 
-        left_line--;
+    for (; row < scr_dump_ctx.row_cnt; row++) {
+        set_scr_row(&frame[row], LINE_SEQ_NONE, 0, 0);
+    }
+    if (text_rows < scr_dump_ctx.row_cnt) {
+        set_scr_status_row(&frame[text_rows]);
     }
+    return;
+}
 
-    if (!p) {
-        p = head;
-        bottom_offset = 0;
-    } else if (line_chars == p->len) {
-        p = p->next;
-        bottom_offset = 0;
-    } else {
-        bottom_offset = ((line_chars+width-1)/width)*width;
+static uint32_t
+format_scr_search_status (char *buf, uint32_t size)
+{
+    int len;
+
+    len = snprintf(buf, size, "search: %s%s%s%s", scr_search.pattern,
+                   scr_search.fail_msg?"  [":"",
+                   scr_search.fail_msg?scr_search.fail_msg:"",
+                   scr_search.fail_msg?"]":"");
+    if (len < 0) {
+        return 0;
     }
+    return ((uint32_t)len < size)?len:(size-1);
+}
+
+//every match overlapping the row, the current one stands out
+static void
+mark_scr_row (scr_row_t *row_p, char *data, uint32_t len)
+{
+    uint8_t *marks = scr_dump_ctx.marks, mark;
+    uint32_t plen = scr_search.len, from, to, m, i, end;
+    char *hit;
 
-    scr_dump_ctx.bottom_offset = bottom_offset;
-    scr_dump_ctx.bottom_p = p;
+    memset(marks, TTY_MARK_NONE, row_p->end - row_p->start);
 
+    from = (row_p->start + 1 > plen)?(row_p->start + 1 - plen):0;
+    to = row_p->end + plen - 1;
+    if (to > len) {
+        to = len;
+    }
+
+    while (from < to &&
+           (hit = gvd_memmem(data+from, to-from, scr_search.pattern, plen))) {
+        m = hit - data;
+        mark = TTY_MARK_MATCH;
+        if (scr_search.found && row_p->seq == scr_search.seq &&
+            m == scr_search.off) {
+            mark = TTY_MARK_CURRENT;
+        }
+
+        end = (m + plen < row_p->end)?(m + plen):row_p->end;
+        for (i = (m > row_p->start)?m:row_p->start; i < end; i++) {
+            marks[i - row_p->start] = mark;
+        }
+        from = m + 1;
+    }
     return;
 }
 
 static void
-re_calc_bottom_from_top (line_buffer_t *top_p)
+draw_scr_row (uint32_t y, scr_row_t *row_p)
+{
+    char status[SCR_SEARCH_MAX_LEN+32];
+    uint32_t len, row_len;
+    uint8_t *marks = NULL;
+    char *data;
+
+    if (row_p->seq == LINE_SEQ_STATUS) {
+        len = format_scr_search_status(status, sizeof(status));
+        tty_draw_row(y, status, len, NULL);
+        return;
+    }
+
+    row_len = row_p->end - row_p->start;
+    if (row_p->seq == LINE_SEQ_NONE ||
+        !get_line_text(row_p->seq, &data, &len) || row_p->end > len) {
+        tty_draw_row(y, NULL, 0, NULL);
+        return;
+    }
+
+    if (row_p->mark != 0) {
+        mark_scr_row(row_p, data, len);
+        marks = scr_dump_ctx.marks;
+    }
+
+    data += row_p->start;
+    if (row_len > 0 && data[row_len-1] == '\n') {
+        row_len--;
+    }
+    tty_draw_row(y, data, row_len, marks);
+    return;
+}
+
+//rows moved up when positive, down when negative, 0 for no move
+static int
+find_scr_shift (void)
 {
-    line_buffer_t *p;
-    uint32_t bottom_offset;
-    uint32_t left_line, width, line_chars;
+    scr_row_t *frame = scr_dump_ctx.frame, *shown = scr_dump_ctx.shown;
+    uint32_t k;
 
-    left_line = scr_dump_ctx.scr_y;
-    width = scr_dump_ctx.scr_x;
+    if (frame[0].seq == LINE_SEQ_NONE || is_same_scr_row(&frame[0], &shown[0])) {
+        return 0;
+    }
 
-    line_chars = top_p->len;
-    p = top_p;
-    while (left_line > 0 && p) {
-        if (line_chars <= width) {
-            p = p->next;
-            line_chars = p?p->len:0;
-        } else {
-            line_chars -= width;
+    for (k = 1; k < scr_dump_ctx.row_cnt; k++) {
+        if (is_same_scr_row(&frame[0], &shown[k])) {
+            return k;
+        }
+    }
+    for (k = 1; k < scr_dump_ctx.row_cnt; k++) {
+        if (is_same_scr_row(&frame[k], &shown[0])) {
+            return -(int)k;
         }
-
-        left_line--;
     }
+    return 0;
+}
 
-    if (!p) {
-        p = tail;
-        bottom_offset = 0;
-    } else if (p->len == line_chars) {
-        p = p->prev;
-        bottom_offset = 0;
+static void
+shift_shown_rows (int shift)
+{
+    scr_row_t *shown = scr_dump_ctx.shown;
+    uint32_t cnt = scr_dump_ctx.row_cnt, k, i;
+
+    tty_scroll_rows(shift);
+    scr_render_stats.scrolls++;
+
+    if (shift > 0) {
+        k = shift;
+        memmove(&shown[0], &shown[k], (cnt-k)*sizeof(scr_row_t));
+        for (i = cnt-k; i < cnt; i++) {
+            set_scr_row(&shown[i], LINE_SEQ_NONE, 0, 0);
+        }
     } else {
-        bottom_offset = line_chars;
+        k = -shift;
+        memmove(&shown[k], &shown[0], (cnt-k)*sizeof(scr_row_t));
+        for (i = 0; i < k; i++) {
+            set_scr_row(&shown[i], LINE_SEQ_NONE, 0, 0);
+        }
+    }
+    return;
+}
+
+//cursor goes after the last row drawn, as if the rows were typed out
+static void
+place_scr_cursor (void)
+{
+    scr_row_t *frame = scr_dump_ctx.frame;
+    char status[SCR_SEARCH_MAX_LEN+32];
+    uint32_t y, x, len;
+    char *data;
+
+    y = get_scr_text_rows();
+    if (y < scr_dump_ctx.row_cnt) {
+        x = format_scr_search_status(status, sizeof(status));
+        if (x >= scr_dump_ctx.scr_x) {
+            x = scr_dump_ctx.scr_x - 1;
+        }
+        tty_move_cursor_yx(y, x);
+        return;
     }
 
-    scr_dump_ctx.bottom_offset = bottom_offset;
-    scr_dump_ctx.bottom_p = p;
+    for (y = scr_dump_ctx.row_cnt; y > 0; y--) {
+        if (frame[y-1].seq != LINE_SEQ_NONE) {
+            break;
+        }
+    }
+    if (y == 0) {
+        tty_move_cursor_yx(0, 0);
+        return;
+    }
 
+    y--;
+    x = frame[y].end - frame[y].start;
+    if (x > 0 && get_line_text(frame[y].seq, &data, &len) &&
+        frame[y].end <= len && data[frame[y].end-1] == '\n') {
+        x = 0;
+        if (y+1 < scr_dump_ctx.row_cnt) {
+            y++;
+        }
+    }
+    if (x >= scr_dump_ctx.scr_x) {
+        x = scr_dump_ctx.scr_x - 1;
+    }
+    tty_move_cursor_yx(y, x);
     return;
 }
 
-void
-scroll_up_refresh (void)
+//only rows changed since the last frame go to the terminal
+static void
+dump_line_buffer_to_scr (uint64_t top_seq, uint32_t top_offset)
 {
-    line_buffer_t *top_p;
-    uint32_t top_offset;
+    scr_row_t *frame = scr_dump_ctx.frame, *shown = scr_dump_ctx.shown;
+    uint32_t y;
+    int shift;
 
-    decide_scroll_up_bottom();
+    if (scr_dump_ctx.row_cnt == 0) {
+        return;
+    }
 
-    top_p = decide_scr_dump_top(&top_offset);
+    build_scr_frame(top_seq, top_offset);
+    scr_render_stats.frames++;
 
-    if (top_p == head && top_offset == 0) {
-        re_calc_bottom_from_top(top_p);
+    if (!scr_dump_ctx.shown_valid) {
+        tty_erase_scr();
+        for (y = 0; y < scr_dump_ctx.row_cnt; y++) {
+            set_scr_row(&shown[y], LINE_SEQ_NONE, 0, 0);
+        }
+        scr_dump_ctx.shown_valid = TRUE;
+        scr_render_stats.full_redraws++;
+    } else {
+        shift = find_scr_shift();
+        if (shift != 0) {
+            shift_shown_rows(shift);
+        }
     }
 
-    dump_line_buffer_to_scr(top_p, top_offset);
+    for (y = 0; y < scr_dump_ctx.row_cnt; y++) {
+        if (is_same_scr_row(&frame[y], &shown[y])) {
+            scr_render_stats.rows_skipped++;
+            continue;
+        }
+        draw_scr_row(y, &frame[y]);
+        shown[y] = frame[y];
+        scr_render_stats.rows_drawn++;
+    }
 
+    place_scr_cursor();
     return;
 }
 
 static void
-decide_scroll_down_bottom (void)
+decide_scroll_up_bottom (void)
+{
+    move_scr_rows_up(&scr_dump_ctx.bottom_seq, &scr_dump_ctx.bottom_row,
+                     get_scr_text_rows()/2);
+    return;
+}
+
+static void
+re_calc_bottom_from_top (uint64_t top_seq)
 {
-    line_buffer_t *bottom_p, *p;
-    uint32_t bottom_offset;
-    uint32_t left_line, width, line_chars;
+    uint32_t text_rows = get_scr_text_rows();
 
-    bottom_p = scr_dump_ctx.bottom_p;
-    bottom_offset = scr_dump_ctx.bottom_offset;
-    left_line = scr_dump_ctx.scr_y/2;
-    width = scr_dump_ctx.scr_x;
+    scr_dump_ctx.bottom_seq = top_seq;
+    scr_dump_ctx.bottom_row = 0;
+    if (text_rows > 0) {
+        move_scr_rows_down(&scr_dump_ctx.bottom_seq, &scr_dump_ctx.bottom_row,
+                           text_rows - 1);
+    }
+    return;
+}
 
-    line_chars = bottom_offset;
-    p = bottom_p;
-    while (left_line > 0 && p) {
-        if (line_chars <= width) {
-            p = p->next;
-            line_chars = p?p->len:0;
-        } else {
-            line_chars -= width;
-        }
+//bottom line may have been evicted or rewrapped since the last scroll
+static void
+check_scr_dump_bottom (void)
+{
+    uint32_t rows;
 
-        left_line--;
+    if (scr_dump_ctx.bottom_seq < get_first_line() ||
+        scr_dump_ctx.bottom_seq > line_ring.tail_seq) {
+        scr_dump_ctx.bottom_seq = get_first_line();
+        scr_dump_ctx.bottom_row = 0;
     }
 
-    if (!p) {
-        p = tail;
-        bottom_offset = 0;
-    } else if (line_chars == p->len) {
-        p = p->prev;
-        bottom_offset = 0;
-    } else {
-        bottom_offset = p->len - line_chars;
+    rows = get_line_rows(scr_dump_ctx.bottom_seq);
+    if (scr_dump_ctx.bottom_row >= rows) {
+        scr_dump_ctx.bottom_row = rows - 1;
+    }
+    return;
+}
+
+void
+scroll_up_refresh (void)
+{
+    uint64_t top_seq;
+    uint32_t top_offset;
+
+    check_scr_dump_bottom();
+
+    decide_scroll_up_bottom();
+
+    top_seq = decide_scr_dump_top(&top_offset);
+
+    if (top_seq == get_first_line() && top_offset == 0) {
+        re_calc_bottom_from_top(top_seq);
     }
 
-    scr_dump_ctx.bottom_offset = bottom_offset;
-    scr_dump_ctx.bottom_p = p;
+    dump_line_buffer_to_scr(top_seq, top_offset);
 
     return;
 }
 
+static void
+decide_scroll_down_bottom (void)
+{
+    move_scr_rows_down(&scr_dump_ctx.bottom_seq, &scr_dump_ctx.bottom_row,
+                       get_scr_text_rows()/2);
+    return;
+}
+
 void
 scroll_down_refresh (void)
 {
-    line_buffer_t *top_p;
+    uint64_t top_seq;
     uint32_t top_offset;
 
+    check_scr_dump_bottom();
+
     decide_scroll_down_bottom();
 
-    top_p = decide_scr_dump_top(&top_offset);
+    top_seq = decide_scr_dump_top(&top_offset);
 
-    dump_line_buffer_to_scr(top_p, top_offset);
+    dump_line_buffer_to_scr(top_seq, top_offset);
 
     return;
 }
 
+static uint64_t
+get_now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
 static void
 refresh_scr (void)
 {
-    line_buffer_t *top_p;
+    uint64_t top_seq;
     uint32_t top_offset;
 
-    scr_dump_ctx.bottom_p = tail;
-    scr_dump_ctx.bottom_offset = tail->len;
+    scr_dump_ctx.dirty = FALSE;
+    scr_dump_ctx.last_frame_us = get_now_us();
 
-    top_p = decide_scr_dump_top(&top_offset);
+    scr_dump_ctx.bottom_seq = line_ring.tail_seq;
+    scr_dump_ctx.bottom_row = get_line_rows(line_ring.tail_seq) - 1;
 
-    dump_line_buffer_to_scr(top_p, top_offset);
+    top_seq = decide_scr_dump_top(&top_offset);
+
+    dump_line_buffer_to_scr(top_seq, top_offset);
 
     return;
 }
 
-void
-resize_refresh (void)
+//line in RAM holding stream position pos
+static uint64_t
+find_ring_line (uint64_t pos)
 {
-    tty_get_scr_size(&scr_dump_ctx.scr_y, &scr_dump_ctx.scr_x);
+    uint64_t lo = line_ring.head_seq, hi = line_ring.tail_seq, mid;
 
-    refresh_scr();
-    return;
+    while (lo < hi) {
+        mid = lo + (hi - lo + 1)/2;
+        if (get_line(mid)->pos <= pos) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
 }
 
-static void
-mask_line_buffer (uint32_t idx, bool used)
+//bytes left behind when a line moved to the ring start aren't a line
+static bool
+is_ring_match (uint64_t pos, uint64_t *seq_p, uint32_t *off_p)
 {
-    int mask;
-    uint32_t bit_idx;
+    line_entry_t *line_p;
+    uint64_t seq;
+
+    seq = find_ring_line(pos);
+    line_p = get_line(seq);
+    if (pos < line_p->pos ||
+        pos + scr_search.len > line_p->pos + line_p->len) {
+        return FALSE;
+    }
 
-    mask = line_buffer_mask[idx/LINE_BUFFER_MASK_SIZE];
-    bit_idx = idx & (~LINE_BUFFER_MASK_SIZE);
+    *seq_p = seq;
+    *off_p = pos - line_p->pos;
+    return TRUE;
+}
 
-    if (used) {
-        mask &= (~(1 << bit_idx));
-    } else {
-        mask |= (1 << bit_idx);
+/*
+ * Match starting in [from, to) of the RAM byte stream, the first one or
+ * the last one if backward. Scanned in chunks never crossing the ring end,
+ * no line crosses it either.
+ */
+static bool
+search_line_ring (uint64_t from, uint64_t to, bool backward,
+                  uint64_t *seq_p, uint32_t *off_p)
+{
+    uint64_t stream_end, c0, c1, wrap, hay_end, pos;
+    uint32_t plen = scr_search.len;
+    char *hay, *hit;
+    bool found;
+
+    stream_end = get_line(line_ring.tail_seq)->pos +
+                 get_line(line_ring.tail_seq)->len;
+
+    c0 = from;
+    c1 = to;
+    while (c0 < c1) {
+        if (backward) {
+            wrap = ((c1 - 1)/line_ring.size)*line_ring.size;
+            c0 = (c1 - from > SEARCH_CHUNK_SIZE)?(c1 - SEARCH_CHUNK_SIZE):from;
+            if (c0 < wrap) {
+                c0 = wrap;
+            }
+        } else {
+            wrap = (c0/line_ring.size)*line_ring.size;
+            c1 = (to - c0 > SEARCH_CHUNK_SIZE)?(c0 + SEARCH_CHUNK_SIZE):to;
+            if (c1 > wrap + line_ring.size) {
+                c1 = wrap + line_ring.size;
+            }
+        }
+
+        //matches starting before c1 may end past it
+        hay_end = c1 + plen - 1;
+        if (hay_end > stream_end) {
+            hay_end = stream_end;
+        }
+        if (hay_end > wrap + line_ring.size) {
+            hay_end = wrap + line_ring.size;
+        }
+
+        found = FALSE;
+        hay = &line_ring.bytes[c0 % line_ring.size];
+        pos = c0;
+        while (pos < c1 &&
+               (hit = gvd_memmem(hay + (pos - c0), hay_end - pos,
+                                 scr_search.pattern, plen))) {
+            pos = c0 + (hit - hay);
+            if (is_ring_match(pos, seq_p, off_p)) {
+                found = TRUE;
+                if (!backward) {
+                    break;
+                }
+            }
+            pos++;
+        }
+        if (found) {
+            return TRUE;
+        }
+
+        if (backward) {
+            c1 = c0;
+            c0 = from;
+        } else {
+            c0 = c1;
+            c1 = to;
+        }
     }
 
-    line_buffer_mask[idx/LINE_BUFFER_MASK_SIZE] = mask;
-    return;
+    return FALSE;
 }
 
-static void
-clean_line_buffer (line_buffer_t *p)
+/*
+ * Last match starting before (seq, off) if backward, first one starting
+ * at it or after otherwise. Disk tier is searched only when it joins the
+ * RAM ring.
+ */
+static bool
+search_scrollback (uint64_t seq, uint32_t off, bool backward,
+                   uint64_t *seq_p, uint32_t *off_p)
 {
-    unsigned long idx;
+    uint64_t head_pos, end_pos, pos;
+    bool spill;
+
+    head_pos = get_line(line_ring.head_seq)->pos;
+    end_pos = get_line(line_ring.tail_seq)->pos +
+              get_line(line_ring.tail_seq)->len;
+    spill = (get_first_line() != line_ring.head_seq);
+
+    if (seq >= line_ring.head_seq) {
+        pos = get_line(seq)->pos + off;
+        if (pos > end_pos) {
+            pos = end_pos;
+        }
+    } else {
+        pos = head_pos;
+    }
 
-    idx = ((unsigned long)p - (unsigned long)line_buffers_memory);
-    idx /= LINE_BUFFER_SIZE;
-    mask_line_buffer((uint32_t)idx, FALSE);
-    memset(p, 0, LINE_BUFFER_SIZE);
-    return;
+    if (backward) {
+        if (seq >= line_ring.head_seq &&
+            search_line_ring(head_pos, pos, TRUE, seq_p, off_p)) {
+            return TRUE;
+        }
+        return spill && line_spill_search(scr_search.pattern,
+                                          scr_search.len,
+                                          (seq < line_ring.head_seq)?seq:
+                                          line_ring.head_seq,
+                                          (seq < line_ring.head_seq)?off:0,
+                                          TRUE, seq_p, off_p);
+    }
+
+    if (seq < line_ring.head_seq && spill &&
+        line_spill_search(scr_search.pattern, scr_search.len, seq, off,
+                          FALSE, seq_p, off_p)) {
+        return TRUE;
+    }
+    return search_line_ring(pos, end_pos, FALSE, seq_p, off_p);
 }
 
+//current match goes to the middle of the screen
 static void
-recycle_head_line (void)
+show_search_match (void)
 {
-    line_buffer_t *p;
-
-    p = head;
-    head = p->next;
+    uint64_t top_seq;
+    uint32_t top_offset;
 
-    dump_one_line_to_disk(p);
+    scr_dump_ctx.bottom_seq = scr_search.seq;
+    scr_dump_ctx.bottom_row = (scr_search.off + scr_search.len - 1)/
+                              scr_dump_ctx.scr_x;
+    move_scr_rows_down(&scr_dump_ctx.bottom_seq, &scr_dump_ctx.bottom_row,
+                       get_scr_text_rows()/2);
 
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG)) {
-        free(p);
-    } else {
-        clean_line_buffer(p);
+    top_seq = decide_scr_dump_top(&top_offset);
+    if (top_seq == get_first_line() && top_offset == 0) {
+        re_calc_bottom_from_top(top_seq);
     }
 
+    dump_line_buffer_to_scr(top_seq, top_offset);
     return;
 }
 
 static void
-recycle_line_buffer (void)
+search_from (uint64_t seq, uint32_t off, bool backward, char *fail_msg)
 {
-    uint32_t i, num;
-
-    if (head == NULL || tail == NULL) {
+    uint64_t found_seq;
+    uint32_t found_off;
+
+    scr_search.status_gen++;
+    scr_search.fail_msg = NULL;
+    if (scr_search.len == 0) {
+        scr_search.found = FALSE;
+        refresh_scr();
         return;
     }
 
-    num = LINE_BUFFER_NUM/4;
-    for (i = 0; i < num; i++) {
-        recycle_head_line();
+    if (!search_scrollback(seq, off, backward, &found_seq, &found_off)) {
+        scr_search.fail_msg = fail_msg;
+        if (scr_search.found) {
+            show_search_match();
+        } else {
+            refresh_scr();
+        }
+        return;
     }
+
+    scr_search.found = TRUE;
+    scr_search.seq = found_seq;
+    scr_search.off = found_off;
+    show_search_match();
     return;
 }
 
-static int
-get_avail_line_buffer_idx (void)
+void
+search_start_refresh (void)
 {
-    int mask, idx;
-    uint32_t i, pos, found;
+    memset(&scr_search, 0, sizeof(scr_search_t));
+    scr_search.active = TRUE;
+    refresh_scr();
+    return;
+}
 
-    for (i = 0, pos = 0; i < LINE_BUFFER_MASK_NUM; i++) {
-        mask = line_buffer_mask[i];
-        found = ffs(mask);
-        if (found > 0) {
-            // -1 because found starts from 1
-            idx = pos + found - 1;
-            return idx;
-        }
+//the current match stays if it still matches, otherwise go older
+void
+search_update_refresh (char *pattern)
+{
+    safe_strncpy(scr_search.pattern, pattern, SCR_SEARCH_MAX_LEN);
+    scr_search.len = strlen(scr_search.pattern);
+    scr_search.gen++;
 
-        pos += LINE_BUFFER_MASK_SIZE;
+    if (scr_search.found) {
+        search_from(scr_search.seq, scr_search.off + 1, TRUE, "not found");
+    } else {
+        search_from(line_ring.tail_seq, get_line_len(line_ring.tail_seq),
+                    TRUE, "not found");
     }
-
-    return -1;
+    return;
 }
 
-static line_buffer_t *
-get_avail_line_buffer (void)
+void
+search_older_refresh (void)
 {
-    int idx;
-
-    idx = get_avail_line_buffer_idx();
-    if (idx >= LINE_BUFFER_NUM) {
-        return NULL;
-    } else if (idx >= 0) {
-        mask_line_buffer(idx, TRUE);
-        return line_buffers[idx];
+    if (!scr_search.found) {
+        return;
     }
+    search_from(scr_search.seq, scr_search.off, TRUE, "no older match");
+    return;
+}
 
-    if (idx == -1) {
-        recycle_line_buffer();
+void
+search_newer_refresh (void)
+{
+    if (!scr_search.found) {
+        return;
     }
+    search_from(scr_search.seq, scr_search.off + 1, FALSE, "no newer match");
+    return;
+}
+
+//the view stays at the match, or goes back to the bottom
+void
+search_stop_refresh (bool keep_view)
+{
+    uint64_t top_seq;
+    uint32_t top_offset;
 
-    idx = get_avail_line_buffer_idx();
-    if (idx >= 0) {
-        mask_line_buffer(idx, TRUE);
-        return line_buffers[idx];
+    memset(&scr_search, 0, sizeof(scr_search_t));
+    if (!keep_view) {
+        refresh_scr();
+        return;
     }
 
-    return NULL;
+    check_scr_dump_bottom();
+    top_seq = decide_scr_dump_top(&top_offset);
+    dump_line_buffer_to_scr(top_seq, top_offset);
+    return;
+}
+
+bool
+is_search_active (void)
+{
+    return scr_search.active;
 }
 
 static int
-switch_to_new_line_buffer (void)
+alloc_scr_rows (void)
 {
-    line_buffer_t *p;
+    uint32_t row_cnt = scr_dump_ctx.scr_y;
+    scr_row_t *shown, *frame;
+    uint8_t *marks;
+
+    scr_dump_ctx.shown_valid = FALSE;
 
-    p = get_avail_line_buffer();
-    if (p == NULL) {
+    marks = realloc(scr_dump_ctx.marks, scr_dump_ctx.scr_x+1);
+    if (!marks) {
+        scr_dump_ctx.row_cnt = 0;
         return -1;
     }
+    scr_dump_ctx.marks = marks;
 
-    FLAG_SET(p->flag, LINE_BUFFER_FLAG_DIRTY);
-
-    scr_dump_ctx.bottom_offset = 0;
-    scr_dump_ctx.bottom_p = p;
-
-    // on init
-    if (head == NULL || tail == NULL) {
-        head = tail = p;
+    if (row_cnt == scr_dump_ctx.row_cnt) {
         return 0;
     }
 
-    tail->next = p;
-    p->prev = tail;
-    tail = p;
+    shown = realloc(scr_dump_ctx.shown, row_cnt*sizeof(scr_row_t));
+    if (shown) {
+        scr_dump_ctx.shown = shown;
+    }
+    frame = realloc(scr_dump_ctx.frame, row_cnt*sizeof(scr_row_t));
+    if (frame) {
+        scr_dump_ctx.frame = frame;
+    }
+    if (!shown || !frame) {
+        scr_dump_ctx.row_cnt = 0;
+        return -1;
+    }
 
+    scr_dump_ctx.row_cnt = row_cnt;
     return 0;
 }
 
-static line_buffer_t *
-prepare_big_line_buffer (line_buffer_t *p)
+void
+resize_refresh (void)
+{
+    tty_get_scr_size(&scr_dump_ctx.scr_y, &scr_dump_ctx.scr_x);
+    alloc_scr_rows();
+
+    refresh_scr();
+    return;
+}
+
+//oldest line goes to disk tier
+static void
+evict_head_line (void)
 {
-    line_buffer_t *p_big;
+    uint64_t seq = line_ring.head_seq, time_ms;
 
-    p_big = calloc(1, BIG_LINE_BUFFER_SIZE);
-    if (!p_big) {
-        return NULL;
-    }
+    get_line_time(seq, &time_ms);
+    line_spill_append(seq, get_line_data(seq), get_line(seq)->len, time_ms);
+    line_ring.head_seq++;
+    return;
+}
 
-    memcpy(p_big, p, LINE_BUFFER_SIZE);
-    FLAG_SET(p_big->flag, LINE_BUFFER_FLAG_BIG);
+/*
+ * Make the line being written able to grow to new_len in place. If it
+ * would cross the ring end it moves to the ring start. Old lines are
+ * evicted until the bytes from head line to tail line end fit the ring.
+ */
+static void
+reserve_tail_line (uint32_t new_len)
+{
+    line_entry_t *tail_p = get_line(line_ring.tail_seq);
+    uint64_t new_pos, head_pos;
+    uint32_t ring_offset;
 
-    p_big->next = p->next;
-    p_big->prev = p->prev;
-    if (p_big->prev) {
-        p_big->prev->next = p_big;
-    } else {
-        head = p_big;
-    }
-    if (p_big->next) {
-        p_big->next->prev = p_big;
-    } else {
-        tail = p_big;
+    for (;;) {
+        ring_offset = tail_p->pos % line_ring.size;
+        new_pos = tail_p->pos;
+        if (ring_offset + new_len > line_ring.size) {
+            new_pos += line_ring.size - ring_offset;
+        }
+
+        if (line_ring.head_seq == line_ring.tail_seq) {
+            head_pos = new_pos;
+        } else {
+            head_pos = get_line(line_ring.head_seq)->pos;
+        }
+
+        if (new_pos + new_len - head_pos <= line_ring.size) {
+            break;
+        }
+        evict_head_line();
     }
 
-    clean_line_buffer(p);
+    if (new_pos != tail_p->pos) {
+        memmove(line_ring.bytes, &line_ring.bytes[ring_offset], tail_p->len);
+        tail_p->pos = new_pos;
+    }
 
-    return p_big;
+    return;
 }
 
-static uint32_t
-get_line_buffer_max_cp_len (line_buffer_t *p)
+//over long line is cut, but keeps its line break
+static void
+append_tail_line (char *str, uint32_t len)
 {
-    uint32_t cp_len;
+    line_entry_t *tail_p = get_line(line_ring.tail_seq);
+    uint32_t line_break;
+
+    line_break = (len > 0 && str[len-1] == '\n');
+    len -= line_break;
+    //room for the break is kept, it may come with later output
+    if (tail_p->len + len > LINE_MAX_LEN - 1) {
+        len = (tail_p->len < LINE_MAX_LEN - 1)?
+              (LINE_MAX_LEN - 1 - tail_p->len):0;
+    }
+    if (len + line_break == 0) {
+        return;
+    }
 
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG)) {
-        cp_len = BIG_LINE_BUFFER_CONTENT_MAX_LEN - p->len;
-    } else {
-        cp_len = LINE_BUFFER_CONTENT_MAX_LEN - p->len;
+    //a line is as old as its first bytes
+    if (tail_p->len == 0) {
+        stamp_line_time(line_ring.tail_seq);
     }
-    return cp_len;
+    reserve_tail_line(tail_p->len + len + line_break);
+    line_ring.tail_gen++;
+    memcpy(get_line_data(line_ring.tail_seq) + tail_p->len, str, len);
+    if (line_break) {
+        get_line_data(line_ring.tail_seq)[tail_p->len + len] = '\n';
+    }
+    tail_p->len += len + line_break;
+    return;
 }
 
 static void
-save_one_line (line_buffer_t *p, char *str)
+switch_to_new_line (void)
 {
-    char *start;
-    uint32_t len, cp_len;
+    line_entry_t *tail_p = get_line(line_ring.tail_seq);
+    uint64_t pos;
 
-    len = strlen(str);
-    cp_len = LINE_BUFFER_CONTENT_MAX_LEN;
-    
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG) == TRUE &&
-        (len + p->len) > BIG_LINE_BUFFER_CONTENT_MAX_LEN) {
-        //tty_print_error("Line too long.\n");
-        return;
+    //finished line goes to logfile right away, so its time is right
+    dump_one_line_to_disk(line_ring.tail_seq);
+
+    pos = tail_p->pos + tail_p->len;
+
+    if (line_ring.tail_seq - line_ring.head_seq + 1 == LINE_INDEX_NUM) {
+        evict_head_line();
     }
 
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG) == FALSE &&
-        (len + p->len) > LINE_BUFFER_CONTENT_MAX_LEN) {
-        p = prepare_big_line_buffer(p);
-        if (!p) {
-            return;
+    line_ring.tail_seq++;
+    tail_p = get_line(line_ring.tail_seq);
+    tail_p->pos = pos;
+    tail_p->len = 0;
+    stamp_line_time(line_ring.tail_seq);
+
+    scr_dump_ctx.bottom_row = 0;
+    scr_dump_ctx.bottom_seq = line_ring.tail_seq;
+    return;
+}
+
+/*
+ * A byte stored is a column on screen, so rows are split by bytes: tabs
+ * go in as spaces to the next tab stop and carriage returns, as of CRLF
+ * shell output, are dropped.
+ */
+static void
+append_tail_text (char *str, uint32_t len)
+{
+    uint32_t start = 0, pad, i;
+
+    for (i = 0; i < len; i++) {
+        if (str[i] != '\t' && str[i] != '\r') {
+            continue;
+        }
+        append_tail_line(str + start, i - start);
+        if (str[i] == '\t') {
+            pad = LINE_TAB_SIZE -
+                  get_line(line_ring.tail_seq)->len % LINE_TAB_SIZE;
+            append_tail_line("        ", pad);
         }
+        start = i + 1;
     }
 
-    cp_len = get_line_buffer_max_cp_len(p);
-    cp_len = (len>cp_len)?cp_len:len;
-
-    start = &p->content[p->len];
-    safe_strncpy(start, str, cp_len);
-    p->len = strlen(p->content);
+    append_tail_line(str + start, len - start);
     return;
 }
 
 static void
 save_output_to_line_buffer (char *output)
 {
-    char *start, *end, *next;
-    char temp = '\0';
-    int rc;
+    char *start, *end;
 
     start = output;
     for (;;) {
         end = strchr(start, '\n');
-        if (end) {
-            next = end + 1;
-            temp = *next;
-            *next = '\0';
-        } else {
-            next = NULL;
-        }
-
-        save_one_line(tail, start);
-
-        if (next) {
-            *next = temp;
-        } else {
+        if (!end) {
+            append_tail_text(start, strlen(start));
             break;
         }
 
-        rc = switch_to_new_line_buffer();
-        if (rc == -1) {
-            //tty_print_error("Run error on swtich to new line.\n");
-            return;
-        }
-        start = next;
+        append_tail_text(start, end-start+1);
+        switch_to_new_line();
+        start = end + 1;
     }
 
     return;
@@ -686,35 +1390,128 @@ printv (char *fmt, ...)
         free(output);
     }
 
-    refresh_scr();
+    //bursts of output make one frame, the rest waits for flush
+    scr_dump_ctx.dirty = TRUE;
+    if (get_now_us() - scr_dump_ctx.last_frame_us >= SCR_FRAME_INTERVAL_US) {
+        refresh_scr();
+    } else {
+        scr_render_stats.frames_coalesced++;
+    }
 
     return;
 }
 
+//draw output not on screen yet, before waiting for input
+void
+flush_line_buffer_to_scr (void)
+{
+    if (scr_dump_ctx.dirty) {
+        refresh_scr();
+    }
+    return;
+}
+
+/*
+ * An edit at off of the line being written, which makes it new_len long,
+ * can be done on the row shown if the view is at the bottom and the edit
+ * and both line ends stay in the last row of the line, not filling it.
+ */
+static bool
+can_edit_tail_row (uint32_t off, uint32_t new_len)
+{
+    uint32_t width = scr_dump_ctx.scr_x, len, start;
+    scr_row_t *row_p;
+
+    if (!scr_dump_ctx.shown_valid || scr_dump_ctx.dirty ||
+        scr_search.active || scr_dump_ctx.tail_y == SCR_ROW_NONE ||
+        scr_dump_ctx.bottom_seq != line_ring.tail_seq) {
+        return FALSE;
+    }
+
+    row_p = &scr_dump_ctx.shown[scr_dump_ctx.tail_y];
+    len = get_line(line_ring.tail_seq)->len;
+    start = row_p->start;
+    if (row_p->seq != line_ring.tail_seq || row_p->end != len || len == 0) {
+        return FALSE;
+    }
+
+    return (off >= start && len < start + width && new_len < start + width &&
+            (new_len > start || start == 0));
+}
+
 static void
-replace_last_line_content (char *ps, char *cmd)
+update_tail_row (void)
 {
-    line_buffer_t *p = tail;
-    uint32_t len;
+    scr_row_t *row_p = &scr_dump_ctx.shown[scr_dump_ctx.tail_y];
 
-    len = strlen(ps) + strlen(cmd);
+    row_p->end = get_line(line_ring.tail_seq)->len;
+    row_p->gen = line_ring.tail_gen;
+    scr_dump_ctx.frame[scr_dump_ctx.tail_y] = *row_p;
+    scr_render_stats.cell_edits++;
+    return;
+}
 
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG) == TRUE &&
-        len > BIG_LINE_BUFFER_CONTENT_MAX_LEN) {
-        //tty_print_error("Line too long.\n");
-        return;
+/*
+ * Insert ch at off of the line being written, which must be old_len long,
+ * with one character insert on the terminal. FALSE if it's not done, the
+ * caller then redraws the line.
+ */
+bool
+line_buffer_insert_tail_char (uint32_t off, char ch, uint32_t old_len)
+{
+    line_entry_t *tail_p = get_line(line_ring.tail_seq);
+    uint32_t x;
+    char *data;
+
+    if (!line_ring.bytes || tail_p->len != old_len || off > old_len ||
+        old_len + 1 > LINE_MAX_LEN || !can_edit_tail_row(off, old_len + 1)) {
+        return FALSE;
     }
 
-    if (FLAG_GET(p->flag, LINE_BUFFER_FLAG_BIG) == FALSE &&
-        len > LINE_BUFFER_CONTENT_MAX_LEN) {
-        p = prepare_big_line_buffer(p);
-        if (!p) {
-            return;
-        }
+    reserve_tail_line(old_len + 1);
+    data = get_line_data(line_ring.tail_seq);
+    memmove(data + off + 1, data + off, old_len - off);
+    data[off] = ch;
+    tail_p->len++;
+    line_ring.tail_gen++;
+
+    x = off - scr_dump_ctx.shown[scr_dump_ctx.tail_y].start;
+    tty_insert_char(scr_dump_ctx.tail_y, x, ch);
+    update_tail_row();
+    return TRUE;
+}
+
+//delete the character at off, the same way as the insert
+bool
+line_buffer_delete_tail_char (uint32_t off, uint32_t old_len)
+{
+    line_entry_t *tail_p = get_line(line_ring.tail_seq);
+    uint32_t x;
+    char *data;
+
+    if (!line_ring.bytes || tail_p->len != old_len || off >= old_len ||
+        !can_edit_tail_row(off, old_len - 1)) {
+        return FALSE;
     }
 
-    snprintf(p->content, len+1, "%s%s", ps, cmd);
-    p->len = len;
+    data = get_line_data(line_ring.tail_seq);
+    memmove(data + off, data + off + 1, old_len - off - 1);
+    tail_p->len--;
+    line_ring.tail_gen++;
+
+    x = off - scr_dump_ctx.shown[scr_dump_ctx.tail_y].start;
+    tty_delete_char(scr_dump_ctx.tail_y, x);
+    update_tail_row();
+    return TRUE;
+}
+
+static void
+replace_last_line_content (char *ps, char *cmd)
+{
+    get_line(line_ring.tail_seq)->len = 0;
+    line_ring.tail_gen++;
+    append_tail_line(ps, strlen(ps));
+    append_tail_line(cmd, strlen(cmd));
     return;
 }
 
@@ -726,24 +1523,52 @@ replace_last_line (char *ps, char *cmd)
     return;
 }
 
-static int
-prepare_line_buffers (void)
+/*
+ * Whole lines printed above the line being written, which is put back
+ * after them as it was, prompt and command. Drawn with the next frame.
+ */
+void
+line_buffer_print_above_tail (char *lines)
 {
-    void *buf;
-    uint32_t i;
+    line_entry_t *tail_p;
+    uint32_t tail_len;
+    char *tail;
 
-    memset(line_buffer_mask, 0xff, sizeof(line_buffer_mask));
+    if (!line_ring.bytes) {
+        return;
+    }
 
-    buf = calloc(LINE_BUFFER_NUM, LINE_BUFFER_SIZE);
-    if (!buf) {
-        return -1;
+    tail_p = get_line(line_ring.tail_seq);
+    tail_len = tail_p->len;
+    tail = malloc(tail_len + 1);
+    if (!tail) {
+        return;
     }
-    line_buffers_memory = buf;
+    memcpy(tail, get_line_data(line_ring.tail_seq), tail_len);
+
+    tail_p->len = 0;
+    line_ring.tail_gen++;
+    save_output_to_line_buffer(lines);
+    append_tail_line(tail, tail_len);
+    free(tail);
+
+    scr_dump_ctx.dirty = TRUE;
+    return;
+}
 
-    for (i = 0; i < LINE_BUFFER_NUM; i++) {
-        line_buffers[i] = (line_buffer_t *)buf;
-        buf = (void *)((char *)buf + LINE_BUFFER_SIZE);
+static int
+prepare_line_ring (void)
+{
+    memset(&line_ring, 0, sizeof(line_ring_t));
+
+    line_ring.size = line_ring_size;
+    line_ring.bytes = malloc(line_ring.size);
+    line_ring.lines = calloc(LINE_INDEX_NUM, sizeof(line_entry_t));
+    line_ring.time_bases = calloc(LINE_TIME_BASE_NUM, sizeof(uint64_t));
+    if (!line_ring.bytes || !line_ring.lines || !line_ring.time_bases) {
+        return -1;
     }
+    stamp_line_time(line_ring.tail_seq);
 
     return 0;
 }
@@ -752,10 +1577,122 @@ void
 line_buffer_clean (void)
 {
     tty_reset();
-    if (line_buffers_memory) {
-        free(line_buffers_memory);
+    if (line_ring.bytes) {
+        free(line_ring.bytes);
+    }
+    if (line_ring.lines) {
+        free(line_ring.lines);
+    }
+    free(line_ring.time_bases);
+    memset(&line_ring, 0, sizeof(line_ring_t));
+    free(scr_dump_ctx.shown);
+    free(scr_dump_ctx.frame);
+    free(scr_dump_ctx.marks);
+    memset(&scr_dump_ctx, 0, sizeof(scr_dump_ctx_t));
+    memset(&scr_search, 0, sizeof(scr_search_t));
+    reset_wrap_blocks();
+    line_spill_clean();
+    log_writer_stop();
+    return;
+}
+
+//everything but the line being written goes to disk tier, then regrow
+int
+line_buffer_set_mem_size (uint32_t size)
+{
+    line_entry_t *tail_p;
+    char *bytes;
+
+    line_ring_size = size;
+    if (!line_ring.bytes) {
+        return 0;
+    }
+
+    while (line_ring.head_seq != line_ring.tail_seq) {
+        evict_head_line();
+    }
+
+    tail_p = get_line(line_ring.tail_seq);
+    if (tail_p->len > size/4) {
+        tail_p->len = size/4;
+        line_ring.tail_gen++;
+    }
+
+    bytes = malloc(size);
+    if (!bytes) {
+        return -1;
+    }
+    memcpy(bytes, get_line_data(line_ring.tail_seq), tail_p->len);
+    free(line_ring.bytes);
+
+    line_ring.bytes = bytes;
+    line_ring.size = size;
+    tail_p->pos = 0;
+
+    refresh_scr();
+    return 0;
+}
+
+//line in RAM or on disk, data is valid until the next call
+bool
+line_buffer_get_line (uint64_t seq, char **data_p, uint32_t *len_p,
+                      uint64_t *time_ms_p)
+{
+    if (!line_ring.bytes || seq < get_first_line() ||
+        seq > line_ring.tail_seq) {
+        return FALSE;
+    }
+    if (!get_line_time(seq, time_ms_p)) {
+        return FALSE;
+    }
+    return get_line_text(seq, data_p, len_p);
+}
+
+//first line at or after time_ms, line times are sorted so binary search
+uint64_t
+line_buffer_find_time (uint64_t time_ms)
+{
+    uint64_t low, high, mid, mid_ms;
+
+    if (!line_ring.bytes) {
+        return 0;
+    }
+
+    low = get_first_line();
+    high = line_ring.tail_seq + 1;
+    while (low < high) {
+        mid = low + (high - low)/2;
+        if (get_line_time(mid, &mid_ms) && mid_ms < time_ms) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
     }
-    close(logfile_fd);
+    return low;
+}
+
+void
+line_buffer_get_render_stats (scr_render_stats_t *stats_p)
+{
+    memcpy(stats_p, &scr_render_stats, sizeof(scr_render_stats_t));
+    return;
+}
+
+void
+line_buffer_get_stats (line_buffer_stats_t *stats_p)
+{
+    memset(stats_p, 0, sizeof(line_buffer_stats_t));
+
+    stats_p->mem_size = line_ring_size;
+    if (line_ring.bytes) {
+        stats_p->mem_lines = line_ring.tail_seq - line_ring.head_seq + 1;
+        stats_p->mem_bytes = get_line(line_ring.tail_seq)->pos +
+                             get_line(line_ring.tail_seq)->len -
+                             get_line(line_ring.head_seq)->pos;
+        stats_p->first_seq = get_first_line();
+        stats_p->last_seq = line_ring.tail_seq;
+    }
+    line_spill_get_stats(&stats_p->spill);
     return;
 }
 
@@ -764,8 +1701,8 @@ line_buffer_init (void)
 {
     int rc;
 
-    // make sure there aren't used mask
-    if (LINE_BUFFER_NUM & (LINE_BUFFER_MASK_SIZE-1)) {
+    // index is addressed by masking the line sequence
+    if (LINE_INDEX_NUM & (LINE_INDEX_NUM-1)) {
         return -1;
     }
 
@@ -773,24 +1710,25 @@ line_buffer_init (void)
 
     tty_get_scr_size(&scr_dump_ctx.scr_y, &scr_dump_ctx.scr_x);
 
-    rc = prepare_line_buffers();
+    rc = alloc_scr_rows();
     if (rc == -1) {
         line_buffer_clean();
         return -1;
     }
 
-    rc = console_log_file_init();
+    rc = prepare_line_ring();
     if (rc == -1) {
         line_buffer_clean();
         return -1;
     }
 
-    rc = switch_to_new_line_buffer();
+    rc = console_log_file_init();
     if (rc == -1) {
         line_buffer_clean();
         return -1;
     }
 
+    scr_dump_ctx.bottom_seq = line_ring.tail_seq;
+    scr_dump_ctx.bottom_row = 0;
     return 0;
 }
-
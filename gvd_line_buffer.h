@@ -1,13 +1,62 @@
 #ifndef __GVD_LINE_BUFFER_H__
 #define __GVD_LINE_BUFFER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "gvd_line_spill.h"
+
+//! longest pattern of scrollback search
+#define SCR_SEARCH_MAX_LEN 63
+
+typedef struct line_buffer_stats_s {
+    //RAM tier
+    uint32_t mem_size;
+    uint64_t mem_bytes;
+    uint64_t mem_lines;
+    //whole scrollback
+    uint64_t first_seq;
+    uint64_t last_seq;
+    line_spill_stats_t spill;
+} line_buffer_stats_t;
+
+typedef struct scr_render_stats_s {
+    uint64_t frames;
+    uint64_t frames_coalesced;
+    uint64_t full_redraws;
+    uint64_t scrolls;
+    uint64_t rows_drawn;
+    uint64_t rows_skipped;
+    //blocks of lines wrapped for a new width, and stepped over whole
+    uint64_t wrap_blocks_counted;
+    uint64_t wrap_blocks_skipped;
+    //keys typed into the prompt row without redrawing it
+    uint64_t cell_edits;
+} scr_render_stats_t;
+
 void printv(char *fmt, ...);
 void replace_last_line(char *ps, char *cmd);
+void line_buffer_print_above_tail(char *lines);
+bool line_buffer_insert_tail_char(uint32_t off, char ch, uint32_t old_len);
+bool line_buffer_delete_tail_char(uint32_t off, uint32_t old_len);
+void flush_line_buffer_to_scr(void);
 void scroll_up_refresh(void);
 void scroll_down_refresh(void);
 void resize_refresh(void);
+void search_start_refresh(void);
+void search_update_refresh(char *pattern);
+void search_older_refresh(void);
+void search_newer_refresh(void);
+void search_stop_refresh(bool keep_view);
+bool is_search_active(void);
 void dump_all_lines_to_disk(void);
 void clear_disk_logfile(void);
 int line_buffer_init(void);
+void line_buffer_set_log_name(char *name);
 void line_buffer_clean(void);
+int line_buffer_set_mem_size(uint32_t size);
+void line_buffer_get_stats(line_buffer_stats_t *stats_p);
+void line_buffer_get_render_stats(scr_render_stats_t *stats_p);
+bool line_buffer_get_line(uint64_t seq, char **data_p, uint32_t *len_p,
+                          uint64_t *time_ms_p);
+uint64_t line_buffer_find_time(uint64_t time_ms);
 #endif
@@ -0,0 +1,850 @@
+/*
+ * gvd_line_spill.c
+ *
+ * Disk tier of the scrollback. Lines evicted from the RAM ring are
+ * appended to segment files, with the offset of every SPILL_INDEX_STRIDE
+ * line kept in memory. Lines are read back through a small mapped window.
+ * The time of each line is a 4 byte delta from the time of its index
+ * entry, kept in a file of its own next to the segment and read back a
+ * stride at a time. A trigram filter per segment lets searches skip
+ * segments that can't hold the pattern.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gvd_util.h"
+#include "gvd_line_spill.h"
+
+//! lines between two sparse index entries
+#define SPILL_INDEX_STRIDE 64
+//! max segments, oldest is dropped to make room
+#define SPILL_SEG_MAX 64
+//! segment size bounds, a quarter of disk budget in between
+#define SPILL_SEG_MIN_SIZE (1024*1024)
+#define SPILL_SEG_MAX_SIZE (64*1024*1024)
+//! appended lines are batched before written
+#define SPILL_WBUF_SIZE (64*1024)
+//! bytes of a segment mapped at a time for reading
+#define SPILL_WINDOW_SIZE (4*1024*1024)
+//! bits of the trigram filter of each segment, power of 2
+#define SPILL_TRIGRAM_BITS (256*1024)
+//! bytes scanned at a time when searching
+#define SPILL_SEARCH_CHUNK (SPILL_WINDOW_SIZE/2)
+//! default disk budget
+#define SPILL_MAX_BYTES_DEFAULT (256ULL*1024*1024)
+//! segment files are unlinked right after created
+#define SPILL_FILE_TEMPLATE "/tmp/gvd_spill_XXXXXX"
+
+typedef struct spill_seg_s {
+    int fd;
+    uint64_t first_seq;
+    uint64_t line_cnt;
+    //bytes of the segment, including those still in write buffer
+    uint64_t size;
+    //offset and time in ms of line first_seq + i*SPILL_INDEX_STRIDE
+    uint64_t *index;
+    uint64_t *time_bases;
+    uint32_t index_cap;
+    //ms of each line after the time base of its index entry, 4 bytes each
+    int time_fd;
+    //bit set for each trigram seen, segments without one are not scanned
+    uint8_t *trigrams;
+} spill_seg_t;
+
+typedef struct line_spill_s {
+    //used as a ring, from the oldest segment
+    spill_seg_t segs[SPILL_SEG_MAX];
+    uint32_t seg_head;
+    uint32_t seg_cnt;
+    uint64_t bytes;
+    uint64_t max_bytes;
+    //tail of the newest segment not written yet
+    char wbuf[SPILL_WBUF_SIZE];
+    uint32_t wbuf_len;
+    //read window
+    spill_seg_t *win_seg;
+    char *win_data;
+    uint64_t win_off;
+    uint64_t win_len;
+    //last line found, next line starts right after it
+    spill_seg_t *last_seg;
+    uint64_t last_seq;
+    uint64_t last_off;
+    uint32_t last_len;
+    //time deltas of the newest segment's last stride, not written yet
+    uint32_t time_wbuf[SPILL_INDEX_STRIDE];
+    //stride of time deltas read last
+    spill_seg_t *time_seg;
+    uint64_t time_slot;
+    uint32_t time_rbuf[SPILL_INDEX_STRIDE];
+} line_spill_t;
+
+static line_spill_t line_spill = {
+    .max_bytes = SPILL_MAX_BYTES_DEFAULT,
+};
+
+static spill_seg_t *
+get_spill_seg (uint32_t i)
+{
+    return &line_spill.segs[(line_spill.seg_head + i) % SPILL_SEG_MAX];
+}
+
+static spill_seg_t *
+get_newest_spill_seg (void)
+{
+    return get_spill_seg(line_spill.seg_cnt - 1);
+}
+
+static uint64_t
+get_spill_seg_limit (void)
+{
+    uint64_t limit = line_spill.max_bytes/4;
+
+    if (limit < SPILL_SEG_MIN_SIZE) {
+        return SPILL_SEG_MIN_SIZE;
+    }
+    if (limit > SPILL_SEG_MAX_SIZE) {
+        return SPILL_SEG_MAX_SIZE;
+    }
+    return limit;
+}
+
+static int
+write_spill_data (int fd, void *buf, uint32_t len, uint64_t off)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    if (gvd_write_all(fd, &iov, 1, off) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+static void
+flush_spill_wbuf (void)
+{
+    spill_seg_t *seg_p;
+
+    if (line_spill.wbuf_len == 0) {
+        return;
+    }
+
+    seg_p = get_newest_spill_seg();
+    (void)write_spill_data(seg_p->fd, line_spill.wbuf, line_spill.wbuf_len,
+                           seg_p->size - line_spill.wbuf_len);
+    line_spill.wbuf_len = 0;
+    return;
+}
+
+static void
+unmap_spill_window (void)
+{
+    if (line_spill.win_data) {
+        munmap(line_spill.win_data, line_spill.win_len);
+    }
+
+    line_spill.win_seg = NULL;
+    line_spill.win_data = NULL;
+    line_spill.win_off = 0;
+    line_spill.win_len = 0;
+    return;
+}
+
+static void
+drop_oldest_spill_seg (void)
+{
+    spill_seg_t *seg_p = get_spill_seg(0);
+
+    if (line_spill.seg_cnt == 1) {
+        line_spill.wbuf_len = 0;
+    }
+    if (line_spill.win_seg == seg_p) {
+        unmap_spill_window();
+    }
+    if (line_spill.last_seg == seg_p) {
+        line_spill.last_seg = NULL;
+    }
+    if (line_spill.time_seg == seg_p) {
+        line_spill.time_seg = NULL;
+    }
+
+    close(seg_p->fd);
+    close(seg_p->time_fd);
+    free(seg_p->index);
+    free(seg_p->time_bases);
+    free(seg_p->trigrams);
+    line_spill.bytes -= seg_p->size + seg_p->line_cnt*sizeof(uint32_t);
+    memset(seg_p, 0, sizeof(spill_seg_t));
+
+    line_spill.seg_head = (line_spill.seg_head + 1) % SPILL_SEG_MAX;
+    line_spill.seg_cnt--;
+    return;
+}
+
+//time deltas of the newest segment's last stride, even if not full
+static void
+flush_spill_times (void)
+{
+    spill_seg_t *seg_p;
+    uint32_t cnt;
+
+    if (line_spill.seg_cnt == 0) {
+        return;
+    }
+
+    seg_p = get_newest_spill_seg();
+    cnt = seg_p->line_cnt % SPILL_INDEX_STRIDE;
+    if (cnt == 0) {
+        return;
+    }
+    (void)write_spill_data(seg_p->time_fd, line_spill.time_wbuf,
+                           cnt*sizeof(uint32_t),
+                           (seg_p->line_cnt - cnt)*sizeof(uint32_t));
+    return;
+}
+
+//space goes back to disk as soon as fd is closed
+static int
+open_spill_file (void)
+{
+    char file_name[] = SPILL_FILE_TEMPLATE;
+    int fd;
+
+    fd = mkstemp(file_name);
+    if (fd != -1) {
+        unlink(file_name);
+    }
+    return fd;
+}
+
+static spill_seg_t *
+new_spill_seg (uint64_t first_seq)
+{
+    spill_seg_t *seg_p;
+    int fd, time_fd;
+
+    flush_spill_wbuf();
+    flush_spill_times();
+
+    if (line_spill.seg_cnt == SPILL_SEG_MAX) {
+        drop_oldest_spill_seg();
+    }
+
+    fd = open_spill_file();
+    if (fd == -1) {
+        return NULL;
+    }
+    time_fd = open_spill_file();
+    if (time_fd == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    line_spill.seg_cnt++;
+    seg_p = get_newest_spill_seg();
+    memset(seg_p, 0, sizeof(spill_seg_t));
+    seg_p->fd = fd;
+    seg_p->time_fd = time_fd;
+    seg_p->first_seq = first_seq;
+    //no filter means always scanned
+    seg_p->trigrams = calloc(SPILL_TRIGRAM_BITS/8, sizeof(uint8_t));
+    return seg_p;
+}
+
+static int
+add_spill_index (spill_seg_t *seg_p, uint64_t time_ms)
+{
+    uint32_t slot, new_cap;
+    uint64_t *new_index;
+
+    slot = seg_p->line_cnt/SPILL_INDEX_STRIDE;
+    if (slot == seg_p->index_cap) {
+        new_cap = seg_p->index_cap?(seg_p->index_cap*2):64;
+        new_index = realloc(seg_p->index, new_cap*sizeof(uint64_t));
+        if (!new_index) {
+            return -1;
+        }
+        seg_p->index = new_index;
+        new_index = realloc(seg_p->time_bases, new_cap*sizeof(uint64_t));
+        if (!new_index) {
+            return -1;
+        }
+        seg_p->time_bases = new_index;
+        seg_p->index_cap = new_cap;
+    }
+
+    seg_p->index[slot] = seg_p->size;
+    seg_p->time_bases[slot] = time_ms;
+    return 0;
+}
+
+//time is kept as a delta from the index entry, written a stride at a time
+static void
+add_spill_time (spill_seg_t *seg_p, uint64_t time_ms)
+{
+    uint64_t base, i = seg_p->line_cnt;
+
+    base = seg_p->time_bases[i/SPILL_INDEX_STRIDE];
+    if (time_ms < base) {
+        time_ms = base;
+    }
+    if (time_ms - base > UINT32_MAX) {
+        time_ms = base + UINT32_MAX;
+    }
+    line_spill.time_wbuf[i % SPILL_INDEX_STRIDE] = time_ms - base;
+
+    if ((i % SPILL_INDEX_STRIDE) == SPILL_INDEX_STRIDE-1) {
+        (void)write_spill_data(seg_p->time_fd, line_spill.time_wbuf,
+                               sizeof(line_spill.time_wbuf),
+                               (i + 1 - SPILL_INDEX_STRIDE)*sizeof(uint32_t));
+    }
+    return;
+}
+
+static void
+reset_line_spill (void)
+{
+    while (line_spill.seg_cnt > 0) {
+        drop_oldest_spill_seg();
+    }
+    return;
+}
+
+static uint64_t
+get_spill_next_seq (void)
+{
+    spill_seg_t *seg_p = get_newest_spill_seg();
+
+    return seg_p->first_seq + seg_p->line_cnt;
+}
+
+//v holds three bytes, the oldest in the low byte
+#define HASH_TRIGRAM(v) ((((v)*2654435761u) >> 14) & (SPILL_TRIGRAM_BITS-1))
+
+static uint32_t
+hash_trigram (const char *p)
+{
+    return HASH_TRIGRAM((uint8_t)p[0] | ((uint8_t)p[1] << 8) |
+                        ((uint32_t)(uint8_t)p[2] << 16));
+}
+
+static void
+add_spill_trigrams (spill_seg_t *seg_p, char *data, uint32_t len)
+{
+    uint8_t *trigrams = seg_p->trigrams;
+    uint32_t i, v, bit;
+
+    if (!trigrams || len < 3) {
+        return;
+    }
+
+    v = (uint8_t)data[0] << 8 | ((uint32_t)(uint8_t)data[1] << 16);
+    for (i = 2; i < len; i++) {
+        v = (v >> 8) | ((uint32_t)(uint8_t)data[i] << 16);
+        bit = HASH_TRIGRAM(v);
+        trigrams[bit >> 3] |= 1 << (bit & 7);
+    }
+    return;
+}
+
+//false means pat is surely not in the segment
+static bool
+may_spill_seg_have (spill_seg_t *seg_p, char *pat, uint32_t plen)
+{
+    uint32_t i, bit;
+
+    if (!seg_p->trigrams) {
+        return TRUE;
+    }
+
+    for (i = 0; i + 3 <= plen; i++) {
+        bit = hash_trigram(pat+i);
+        if (!(seg_p->trigrams[bit/8] & (1 << (bit%8)))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+//lines must come in sequence, a gap starts the spill over
+void
+line_spill_append (uint64_t seq, char *data, uint32_t len, uint64_t time_ms)
+{
+    spill_seg_t *seg_p;
+    int rc;
+
+    if (line_spill.max_bytes == 0) {
+        return;
+    }
+
+    if (line_spill.seg_cnt > 0 && seq != get_spill_next_seq()) {
+        reset_line_spill();
+    }
+
+    if (line_spill.seg_cnt == 0 ||
+        get_newest_spill_seg()->size + len > get_spill_seg_limit()) {
+        if (!new_spill_seg(seq)) {
+            return;
+        }
+    }
+
+    seg_p = get_newest_spill_seg();
+    if ((seg_p->line_cnt % SPILL_INDEX_STRIDE) == 0) {
+        rc = add_spill_index(seg_p, time_ms);
+        if (rc == -1) {
+            return;
+        }
+    }
+    add_spill_time(seg_p, time_ms);
+
+    if (line_spill.wbuf_len + len > SPILL_WBUF_SIZE) {
+        flush_spill_wbuf();
+    }
+    if (len > SPILL_WBUF_SIZE) {
+        (void)write_spill_data(seg_p->fd, data, len, seg_p->size);
+    } else {
+        memcpy(&line_spill.wbuf[line_spill.wbuf_len], data, len);
+        line_spill.wbuf_len += len;
+    }
+
+    add_spill_trigrams(seg_p, data, len);
+    seg_p->size += len;
+    seg_p->line_cnt++;
+    line_spill.bytes += len + sizeof(uint32_t);
+
+    while (line_spill.bytes > line_spill.max_bytes &&
+           line_spill.seg_cnt > 1) {
+        drop_oldest_spill_seg();
+    }
+
+    return;
+}
+
+//window covers [off, off+need) when it returns 0
+static int
+map_spill_window (spill_seg_t *seg_p, uint64_t off, uint64_t need)
+{
+    uint64_t start, len, page_mask;
+    void *data;
+
+    if (line_spill.win_seg == seg_p && off >= line_spill.win_off &&
+        off + need <= line_spill.win_off + line_spill.win_len) {
+        return 0;
+    }
+
+    unmap_spill_window();
+
+    page_mask = sysconf(_SC_PAGESIZE) - 1;
+    start = off & ~page_mask;
+    len = off - start + need;
+    if (len < SPILL_WINDOW_SIZE) {
+        len = SPILL_WINDOW_SIZE;
+    }
+    if (start + len > seg_p->size) {
+        len = seg_p->size - start;
+    }
+
+    data = mmap(NULL, len, PROT_READ, MAP_SHARED, seg_p->fd, start);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    line_spill.win_seg = seg_p;
+    line_spill.win_data = data;
+    line_spill.win_off = start;
+    line_spill.win_len = len;
+    return 0;
+}
+
+//length of the line at off, the whole line is in window when it returns
+static int
+get_spill_line_len (spill_seg_t *seg_p, uint64_t off, uint32_t *len_p)
+{
+    uint64_t need, win_end;
+    char *start, *end;
+
+    need = seg_p->size - off;
+    if (need > SPILL_WINDOW_SIZE/2) {
+        need = SPILL_WINDOW_SIZE/2;
+    }
+
+    for (;;) {
+        if (map_spill_window(seg_p, off, need) == -1) {
+            return -1;
+        }
+
+        win_end = line_spill.win_off + line_spill.win_len;
+        start = line_spill.win_data + (off - line_spill.win_off);
+        end = memchr(start, '\n', win_end - off);
+        if (end) {
+            *len_p = end - start + 1;
+            return 0;
+        }
+        if (win_end >= seg_p->size) {
+            *len_p = seg_p->size - off;
+            return 0;
+        }
+
+        //line longer than the window
+        need = (win_end - off)*2;
+    }
+}
+
+static spill_seg_t *
+find_spill_seg (uint64_t seq)
+{
+    spill_seg_t *seg_p;
+    int i;
+
+    //scrolling is mostly around the newest lines
+    for (i = line_spill.seg_cnt-1; i >= 0; i--) {
+        seg_p = get_spill_seg(i);
+        if (seq >= seg_p->first_seq) {
+            return seg_p;
+        }
+    }
+
+    return NULL;
+}
+
+//data is valid until the next call
+bool
+line_spill_get (uint64_t seq, char **data_p, uint32_t *len_p)
+{
+    spill_seg_t *seg_p;
+    uint64_t off, walk;
+    uint32_t len;
+
+    if (line_spill.seg_cnt == 0 || seq < line_spill_first_seq() ||
+        seq >= get_spill_next_seq()) {
+        return FALSE;
+    }
+
+    seg_p = find_spill_seg(seq);
+    if (!seg_p) {
+        return FALSE;
+    }
+    if (seg_p == get_newest_spill_seg()) {
+        flush_spill_wbuf();
+    }
+
+    if (line_spill.last_seg == seg_p && line_spill.last_seq == seq) {
+        off = line_spill.last_off;
+        walk = 0;
+    } else if (line_spill.last_seg == seg_p &&
+               line_spill.last_seq + 1 == seq) {
+        off = line_spill.last_off + line_spill.last_len;
+        walk = 0;
+    } else {
+        off = seg_p->index[(seq - seg_p->first_seq)/SPILL_INDEX_STRIDE];
+        walk = (seq - seg_p->first_seq) % SPILL_INDEX_STRIDE;
+    }
+
+    for (;;) {
+        if (get_spill_line_len(seg_p, off, &len) == -1) {
+            return FALSE;
+        }
+        if (walk == 0) {
+            break;
+        }
+        off += len;
+        walk--;
+    }
+
+    line_spill.last_seg = seg_p;
+    line_spill.last_seq = seq;
+    line_spill.last_off = off;
+    line_spill.last_len = len;
+
+    *data_p = line_spill.win_data + (off - line_spill.win_off);
+    *len_p = len;
+    return TRUE;
+}
+
+//seq and start of the line holding byte off
+static int
+find_spill_line_at (spill_seg_t *seg_p, uint64_t off, uint64_t *seq_p,
+                    uint64_t *line_off_p)
+{
+    uint64_t lo, hi, mid, seq, line_off;
+    uint32_t len;
+
+    lo = 0;
+    hi = (seg_p->line_cnt - 1)/SPILL_INDEX_STRIDE;
+    while (lo < hi) {
+        mid = (lo + hi + 1)/2;
+        if (seg_p->index[mid] <= off) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    seq = seg_p->first_seq + lo*SPILL_INDEX_STRIDE;
+    line_off = seg_p->index[lo];
+    for (;;) {
+        if (get_spill_line_len(seg_p, line_off, &len) == -1) {
+            return -1;
+        }
+        if (off < line_off + len) {
+            break;
+        }
+        line_off += len;
+        seq++;
+    }
+
+    *seq_p = seq;
+    *line_off_p = line_off;
+    return 0;
+}
+
+/*
+ * Match starting in [start, end) of one segment, the first one or the
+ * last one if backward. Segment is scanned a window at a time, lines are
+ * never split across segments, so neither is a match.
+ */
+static bool
+search_spill_seg (spill_seg_t *seg_p, uint64_t start, uint64_t end,
+                  char *pat, uint32_t plen, bool backward, uint64_t *off_p)
+{
+    uint64_t chunk_cnt, k, c0, c1, hay_len;
+    char *hay, *hit, *last;
+
+    if (end > seg_p->size) {
+        end = seg_p->size;
+    }
+    if (start >= end || !may_spill_seg_have(seg_p, pat, plen)) {
+        return FALSE;
+    }
+
+    chunk_cnt = (end - start + SPILL_SEARCH_CHUNK - 1)/SPILL_SEARCH_CHUNK;
+    for (k = 0; k < chunk_cnt; k++) {
+        c0 = start + (backward?(chunk_cnt-1-k):k)*SPILL_SEARCH_CHUNK;
+        c1 = c0 + SPILL_SEARCH_CHUNK;
+        if (c1 > end) {
+            c1 = end;
+        }
+        //matches starting before c1 may end past it
+        hay_len = c1 + plen - 1 - c0;
+        if (c0 + hay_len > seg_p->size) {
+            hay_len = seg_p->size - c0;
+        }
+        if (hay_len < plen) {
+            continue;
+        }
+        if (map_spill_window(seg_p, c0, hay_len) == -1) {
+            return FALSE;
+        }
+
+        hay = line_spill.win_data + (c0 - line_spill.win_off);
+        last = NULL;
+        hit = gvd_memmem(hay, hay_len, pat, plen);
+        while (hit && backward) {
+            last = hit;
+            hit = gvd_memmem(hit+1, hay+hay_len-hit-1, pat, plen);
+        }
+        if (backward) {
+            hit = last;
+        }
+        if (hit) {
+            *off_p = c0 + (hit - hay);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Find pat in the disk tier, backward for the last match starting before
+ * (seq, off), forward for the first one starting at it or after. seq out
+ * of the tier means from its end or its start.
+ */
+bool
+line_spill_search (char *pat, uint32_t plen, uint64_t seq, uint32_t off,
+                   bool backward, uint64_t *seq_p, uint32_t *off_p)
+{
+    spill_seg_t *seg_p;
+    uint64_t limit, found, line_off;
+    uint32_t len;
+    int i, from;
+    char *data;
+
+    if (line_spill.seg_cnt == 0 || plen == 0) {
+        return FALSE;
+    }
+    flush_spill_wbuf();
+
+    if (seq >= get_spill_next_seq()) {
+        if (!backward) {
+            return FALSE;
+        }
+        from = line_spill.seg_cnt - 1;
+        limit = get_newest_spill_seg()->size;
+    } else if (seq < line_spill_first_seq()) {
+        if (backward) {
+            return FALSE;
+        }
+        from = 0;
+        limit = 0;
+    } else {
+        if (!line_spill_get(seq, &data, &len)) {
+            return FALSE;
+        }
+        seg_p = line_spill.last_seg;
+        for (from = line_spill.seg_cnt-1; from > 0; from--) {
+            if (get_spill_seg(from) == seg_p) {
+                break;
+            }
+        }
+        limit = line_spill.last_off + off;
+    }
+
+    for (i = from; i >= 0 && i < line_spill.seg_cnt; i += backward?-1:1) {
+        seg_p = get_spill_seg(i);
+        if (backward) {
+            if (!search_spill_seg(seg_p, 0, (i == from)?limit:seg_p->size,
+                                  pat, plen, TRUE, &found)) {
+                continue;
+            }
+        } else {
+            if (!search_spill_seg(seg_p, (i == from)?limit:0, seg_p->size,
+                                  pat, plen, FALSE, &found)) {
+                continue;
+            }
+        }
+
+        if (find_spill_line_at(seg_p, found, seq_p, &line_off) == -1) {
+            return FALSE;
+        }
+        *off_p = found - line_off;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//one stride of time deltas, lines in a row are read with one pread
+static bool
+read_spill_times (spill_seg_t *seg_p, uint64_t slot)
+{
+    uint64_t first = slot*SPILL_INDEX_STRIDE;
+    uint32_t cnt = SPILL_INDEX_STRIDE, size;
+    ssize_t got;
+
+    if (seg_p->line_cnt - first < cnt) {
+        cnt = seg_p->line_cnt - first;
+    }
+    size = cnt*sizeof(uint32_t);
+
+    do {
+        got = pread(seg_p->time_fd, line_spill.time_rbuf, size,
+                    first*sizeof(uint32_t));
+    } while (got == -1 && errno == EINTR);
+    if (got != size) {
+        line_spill.time_seg = NULL;
+        return FALSE;
+    }
+
+    line_spill.time_seg = seg_p;
+    line_spill.time_slot = slot;
+    return TRUE;
+}
+
+bool
+line_spill_get_time (uint64_t seq, uint64_t *time_ms_p)
+{
+    spill_seg_t *seg_p;
+    uint64_t i, slot;
+    uint32_t *deltas;
+
+    if (line_spill.seg_cnt == 0 || seq < line_spill_first_seq() ||
+        seq >= get_spill_next_seq()) {
+        return FALSE;
+    }
+
+    seg_p = find_spill_seg(seq);
+    if (!seg_p) {
+        return FALSE;
+    }
+
+    i = seq - seg_p->first_seq;
+    slot = i/SPILL_INDEX_STRIDE;
+    if (seg_p == get_newest_spill_seg() &&
+        slot == seg_p->line_cnt/SPILL_INDEX_STRIDE) {
+        deltas = line_spill.time_wbuf;
+    } else {
+        if (line_spill.time_seg != seg_p || line_spill.time_slot != slot) {
+            if (!read_spill_times(seg_p, slot)) {
+                return FALSE;
+            }
+        }
+        deltas = line_spill.time_rbuf;
+    }
+
+    *time_ms_p = seg_p->time_bases[slot] + deltas[i % SPILL_INDEX_STRIDE];
+    return TRUE;
+}
+
+uint64_t
+line_spill_first_seq (void)
+{
+    if (line_spill.seg_cnt == 0) {
+        return 0;
+    }
+
+    return get_spill_seg(0)->first_seq;
+}
+
+uint64_t
+line_spill_line_cnt (void)
+{
+    if (line_spill.seg_cnt == 0) {
+        return 0;
+    }
+
+    return get_spill_next_seq() - line_spill_first_seq();
+}
+
+//0 turns the disk tier off
+void
+line_spill_set_limit (uint64_t max_bytes)
+{
+    line_spill.max_bytes = max_bytes;
+    if (max_bytes == 0) {
+        reset_line_spill();
+        return;
+    }
+
+    while (line_spill.bytes > line_spill.max_bytes &&
+           line_spill.seg_cnt > 1) {
+        drop_oldest_spill_seg();
+    }
+    return;
+}
+
+void
+line_spill_get_stats (line_spill_stats_t *stats_p)
+{
+    stats_p->first_seq = line_spill_first_seq();
+    stats_p->line_cnt = line_spill_line_cnt();
+    stats_p->bytes = line_spill.bytes;
+    stats_p->max_bytes = line_spill.max_bytes;
+    stats_p->seg_cnt = line_spill.seg_cnt;
+    stats_p->window_size = line_spill.win_len;
+    return;
+}
+
+void
+line_spill_clean (void)
+{
+    reset_line_spill();
+    return;
+}
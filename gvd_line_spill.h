@@ -0,0 +1,43 @@
+#ifndef __GVD_LINE_SPILL_H__
+#define __GVD_LINE_SPILL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct line_spill_stats_s {
+    uint64_t first_seq;
+    uint64_t line_cnt;
+    uint64_t bytes;
+    uint64_t max_bytes;
+    uint32_t seg_cnt;
+    uint32_t window_size;
+} line_spill_stats_t;
+
+void
+line_spill_set_limit(uint64_t max_bytes);
+
+void
+line_spill_append(uint64_t seq, char *data, uint32_t len, uint64_t time_ms);
+
+bool
+line_spill_get(uint64_t seq, char **data_p, uint32_t *len_p);
+
+bool
+line_spill_get_time(uint64_t seq, uint64_t *time_ms_p);
+
+bool
+line_spill_search(char *pat, uint32_t plen, uint64_t seq, uint32_t off,
+                  bool backward, uint64_t *seq_p, uint32_t *off_p);
+
+uint64_t
+line_spill_first_seq(void);
+
+uint64_t
+line_spill_line_cnt(void);
+
+void
+line_spill_get_stats(line_spill_stats_t *stats_p);
+
+void
+line_spill_clean(void);
+#endif //__GVD_LINE_SPILL_H__
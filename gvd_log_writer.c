@@ -0,0 +1,1010 @@
+/*
+ * gvd_log_writer.c
+ *
+ * Console logfile writer. Lines are copied into a single producer single
+ * consumer byte queue by the UI thread, a writer thread takes everything
+ * queued with one writev, so a slow disk never stalls the input.
+ *
+ * The logfile rotates by size and time into numbered segments, name.1,
+ * name.2 and so on, oldest removed beyond the keep count. Each segment
+ * has a text sidecar name.N.idx:
+ *   gvd-log-index 1
+ *   stride <max lines between entries>
+ *   line <line number> <byte offset> <time in us>
+ *   ...
+ *   end <lines> <bytes> <first time> <last time>
+ * An entry is added for the first line of the segment, then every stride
+ * lines or when the second changes. Line numbers count from 1 across all
+ * segments, times are when the line is written, wall clock.
+ */
+
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include "gvd_util.h"
+#include "gvd_log_writer.h"
+
+//! queue bytes, power of 2, append waits when it's full
+#define LOG_QUEUE_SIZE (1024*1024)
+//! queued bytes that wake up the writer before the interval
+#define LOG_WRITE_BATCH (64*1024)
+//! default max time a line waits in queue, in ms
+#define LOG_FLUSH_INTERVAL_DEFAULT 200
+//! writer wakes this often when flush interval is 0, in ms
+#define LOG_IDLE_WAKE_INTERVAL 1000
+//! default size the logfile rotates at
+#define LOG_ROTATE_SIZE_DEFAULT (64ULL*1024*1024)
+//! default rotated segments kept, older ones are removed
+#define LOG_ROTATE_KEEP_DEFAULT 16
+//! max lines between two index entries
+#define LOG_INDEX_STRIDE 1024
+#define LOG_INDEX_SUFFIX ".idx"
+//! index entries one write adds at most, one a stride and one a new second
+#define LOG_INDEX_ENTRY_MAX (LOG_QUEUE_SIZE/LOG_INDEX_STRIDE + 2)
+
+typedef struct log_writer_s {
+    int fd;
+    bool running;
+    pthread_t thread;
+    char name[LOG_NAME_MAX_LEN+1];
+    //active segment, writer thread only
+    FILE *idx_fp;
+    uint64_t seg_open_us;
+    bool line_start;
+    uint64_t entry_line;
+    uint64_t entry_sec;
+    //entries found under the lock, written to idx_fp after it
+    log_index_entry_t entries[LOG_INDEX_ENTRY_MAX];
+    uint32_t entry_cnt;
+    //byte ring, UI thread moves tail, writer thread moves head
+    char *bytes;
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    //below are under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake_cond;
+    pthread_cond_t done_cond;
+    bool kick;
+    bool stop;
+    uint32_t flush_interval_ms;
+    int fsync_policy;
+    uint32_t fsync_interval;
+    log_writer_stats_t stats;
+    bool clear_req;
+    uint64_t rotate_size;
+    //in minutes
+    uint32_t rotate_interval;
+    uint32_t rotate_keep;
+    uint32_t next_seg_no;
+    log_segment_t active;
+    //rotated segments as a ring, from the oldest
+    log_segment_t segs[LOG_ROTATE_KEEP_MAX];
+    uint32_t seg_head;
+    uint32_t seg_cnt;
+} log_writer_t;
+
+static log_writer_t log_writer = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .flush_interval_ms = LOG_FLUSH_INTERVAL_DEFAULT,
+    .fsync_policy = LOG_FSYNC_NEVER,
+    .rotate_size = LOG_ROTATE_SIZE_DEFAULT,
+    .rotate_keep = LOG_ROTATE_KEEP_DEFAULT,
+};
+
+static uint64_t
+get_now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static uint64_t
+get_real_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+//segment 0 is the active logfile
+void
+log_writer_get_segment_name (uint32_t no, bool idx, char *buf, uint32_t len)
+{
+    if (no == 0) {
+        snprintf(buf, len, "%s%s", log_writer.name, idx?LOG_INDEX_SUFFIX:"");
+    } else {
+        snprintf(buf, len, "%s.%u%s", log_writer.name, no,
+                 idx?LOG_INDEX_SUFFIX:"");
+    }
+    return;
+}
+
+static log_segment_t *
+get_rotated_segment (uint32_t i)
+{
+    return &log_writer.segs[(log_writer.seg_head + i) % LOG_ROTATE_KEEP_MAX];
+}
+
+static int
+open_log_index (void)
+{
+    char idx_name[LOG_NAME_MAX_LEN+16];
+
+    log_writer_get_segment_name(0, TRUE, idx_name, sizeof(idx_name));
+    log_writer.idx_fp = fopen(idx_name, "w");
+    if (!log_writer.idx_fp) {
+        return -1;
+    }
+
+    fprintf(log_writer.idx_fp, "gvd-log-index 1\nstride %u\n",
+            LOG_INDEX_STRIDE);
+    fflush(log_writer.idx_fp);
+    log_writer.line_start = TRUE;
+    log_writer.entry_line = 0;
+    return 0;
+}
+
+static int
+open_log_segment (void)
+{
+    log_writer.fd = open(log_writer.name,
+                         O_CREAT|O_WRONLY|O_TRUNC|O_APPEND, 0666);
+    if (log_writer.fd == -1) {
+        return -1;
+    }
+
+    if (open_log_index() != 0) {
+        close(log_writer.fd);
+        log_writer.fd = -1;
+        return -1;
+    }
+
+    log_writer.seg_open_us = get_now_us();
+    return 0;
+}
+
+static void
+close_log_segment (void)
+{
+    log_segment_t *seg_p = &log_writer.active;
+
+    if (log_writer.idx_fp) {
+        fprintf(log_writer.idx_fp, "end %llu %llu %llu %llu\n",
+                (unsigned long long)seg_p->line_cnt,
+                (unsigned long long)seg_p->bytes,
+                (unsigned long long)seg_p->first_us,
+                (unsigned long long)seg_p->last_us);
+        fclose(log_writer.idx_fp);
+        log_writer.idx_fp = NULL;
+    }
+
+    if (log_writer.fd != -1) {
+        if (log_writer.fsync_policy != LOG_FSYNC_NEVER) {
+            fdatasync(log_writer.fd);
+        }
+        close(log_writer.fd);
+        log_writer.fd = -1;
+    }
+    return;
+}
+
+static void
+remove_log_segment_files (uint32_t no)
+{
+    char name[LOG_NAME_MAX_LEN+16];
+
+    log_writer_get_segment_name(no, FALSE, name, sizeof(name));
+    unlink(name);
+    log_writer_get_segment_name(no, TRUE, name, sizeof(name));
+    unlink(name);
+    return;
+}
+
+//called with lock held, files of the segments dropped are removed after
+static uint32_t
+detach_rotated_segments (uint32_t keep, uint32_t *nos)
+{
+    uint32_t cnt = 0;
+
+    while (log_writer.seg_cnt > keep) {
+        nos[cnt++] = get_rotated_segment(0)->no;
+        log_writer.seg_head = (log_writer.seg_head + 1) % LOG_ROTATE_KEEP_MAX;
+        log_writer.seg_cnt--;
+    }
+    return cnt;
+}
+
+//without lock, the UI thread never waits on the unlinks
+static void
+remove_detached_segments (uint32_t *nos, uint32_t cnt)
+{
+    uint32_t i;
+
+    for (i = 0; i < cnt; i++) {
+        remove_log_segment_files(nos[i]);
+    }
+    return;
+}
+
+//called with lock held, active segment starts over after the last line
+static void
+reset_active_segment (void)
+{
+    log_segment_t *seg_p = &log_writer.active;
+
+    seg_p->first_line += seg_p->line_cnt;
+    seg_p->line_cnt = 0;
+    seg_p->bytes = 0;
+    seg_p->first_us = 0;
+    seg_p->last_us = 0;
+    return;
+}
+
+/*
+ * Sync, close and renames are done without the lock, only the segment
+ * list is updated under it, so an append never waits on the disk.
+ */
+static void
+rotate_log_segment (void)
+{
+    char old_name[LOG_NAME_MAX_LEN+16], new_name[LOG_NAME_MAX_LEN+16];
+    uint32_t no, nos[LOG_ROTATE_KEEP_MAX], cnt;
+
+    close_log_segment();
+
+    no = log_writer.next_seg_no++;
+    log_writer_get_segment_name(0, FALSE, old_name, sizeof(old_name));
+    log_writer_get_segment_name(no, FALSE, new_name, sizeof(new_name));
+    rename(old_name, new_name);
+    log_writer_get_segment_name(0, TRUE, old_name, sizeof(old_name));
+    log_writer_get_segment_name(no, TRUE, new_name, sizeof(new_name));
+    rename(old_name, new_name);
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.active.no = no;
+    *get_rotated_segment(log_writer.seg_cnt++) = log_writer.active;
+    log_writer.active.no = 0;
+    cnt = detach_rotated_segments(log_writer.rotate_keep, nos);
+    reset_active_segment();
+    log_writer.stats.rotations++;
+    pthread_mutex_unlock(&log_writer.lock);
+
+    remove_detached_segments(nos, cnt);
+
+    //lines are dropped if it fails, like on a write error
+    open_log_segment();
+    return;
+}
+
+//logfile clear, all segments go
+static void
+clear_log_segments (void)
+{
+    uint32_t nos[LOG_ROTATE_KEEP_MAX], cnt;
+
+    if (log_writer.fd != -1) {
+        ftruncate(log_writer.fd, 0);
+    }
+    if (log_writer.idx_fp) {
+        fclose(log_writer.idx_fp);
+    }
+    open_log_index();
+
+    pthread_mutex_lock(&log_writer.lock);
+    cnt = detach_rotated_segments(0, nos);
+    reset_active_segment();
+    log_writer.seg_open_us = get_now_us();
+    log_writer.clear_req = FALSE;
+    pthread_mutex_unlock(&log_writer.lock);
+
+    remove_detached_segments(nos, cnt);
+    return;
+}
+
+//count lines and find index entries for bytes just written
+static void
+index_log_piece (char *data, uint32_t len, uint64_t now_us)
+{
+    log_segment_t *seg_p = &log_writer.active;
+    log_index_entry_t *entry_p;
+    uint64_t line_no;
+    uint32_t pos = 0;
+    char *end;
+
+    while (pos < len) {
+        if (log_writer.line_start) {
+            line_no = seg_p->first_line + seg_p->line_cnt;
+            if (seg_p->line_cnt == 0) {
+                seg_p->first_us = now_us;
+            }
+            if (log_writer.idx_fp &&
+                log_writer.entry_cnt < LOG_INDEX_ENTRY_MAX &&
+                (log_writer.entry_line == 0 ||
+                 line_no - log_writer.entry_line >= LOG_INDEX_STRIDE ||
+                 now_us/1000000 != log_writer.entry_sec)) {
+                entry_p = &log_writer.entries[log_writer.entry_cnt++];
+                entry_p->line = line_no;
+                entry_p->offset = seg_p->bytes + pos;
+                entry_p->time_us = now_us;
+                log_writer.entry_line = line_no;
+                log_writer.entry_sec = now_us/1000000;
+            }
+            log_writer.line_start = FALSE;
+        }
+
+        end = memchr(data + pos, '\n', len - pos);
+        if (!end) {
+            break;
+        }
+        pos = end - data + 1;
+        seg_p->line_cnt++;
+        seg_p->last_us = now_us;
+        log_writer.line_start = TRUE;
+    }
+
+    seg_p->bytes += len;
+    return;
+}
+
+//contiguous queued bytes from pos, at most len
+static uint32_t
+get_log_piece (uint64_t pos, uint32_t len, char **data_p)
+{
+    uint32_t off = pos & (LOG_QUEUE_SIZE-1);
+
+    *data_p = &log_writer.bytes[off];
+    return (len < LOG_QUEUE_SIZE - off)?len:(LOG_QUEUE_SIZE - off);
+}
+
+//line counts are under the lock, the index file is written after it
+static void
+index_log_bytes (uint64_t pos, uint32_t len)
+{
+    uint64_t now_us = get_real_us();
+    log_index_entry_t *entry_p;
+    uint32_t cnt, i;
+    char *data;
+
+    pthread_mutex_lock(&log_writer.lock);
+    while (len > 0) {
+        cnt = get_log_piece(pos, len, &data);
+        index_log_piece(data, cnt, now_us);
+        pos += cnt;
+        len -= cnt;
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+
+    for (i = 0; i < log_writer.entry_cnt; i++) {
+        entry_p = &log_writer.entries[i];
+        fprintf(log_writer.idx_fp, "line %llu %llu %llu\n",
+                (unsigned long long)entry_p->line,
+                (unsigned long long)entry_p->offset,
+                (unsigned long long)entry_p->time_us);
+    }
+    log_writer.entry_cnt = 0;
+    return;
+}
+
+//bytes from pos up to the first line end at or after skip, 0 if none
+static uint32_t
+find_log_line_end (uint64_t pos, uint32_t len, uint32_t skip)
+{
+    uint32_t done = skip, cnt;
+    char *data, *end;
+
+    while (done < len) {
+        cnt = get_log_piece(pos + done, len - done, &data);
+        end = memchr(data, '\n', cnt);
+        if (end) {
+            return done + (end - data) + 1;
+        }
+        done += cnt;
+    }
+    return 0;
+}
+
+//rotate size reached, the segment ends with the line crossing it
+static uint32_t
+cut_log_at_rotate_size (uint64_t head, uint32_t len)
+{
+    uint64_t size = log_writer.rotate_size, bytes = log_writer.active.bytes;
+    uint32_t skip;
+
+    if (size == 0 || bytes + len < size) {
+        return 0;
+    }
+
+    skip = (size > bytes + 1)?(size - bytes - 1):0;
+    return find_log_line_end(head, len, skip);
+}
+
+static bool
+is_log_rotate_due (void)
+{
+    uint64_t interval_us = (uint64_t)log_writer.rotate_interval*60*1000000;
+
+    return (interval_us != 0 && log_writer.active.line_cnt > 0 &&
+            log_writer.line_start &&
+            get_now_us() - log_writer.seg_open_us >= interval_us);
+}
+
+static void
+kick_log_writer (void)
+{
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.kick = TRUE;
+    pthread_cond_signal(&log_writer.wake_cond);
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+//called with lock held, returns when kicked or the interval is over
+static void
+wait_log_writer_kick (void)
+{
+    struct timespec ts;
+    uint32_t wait_ms;
+
+    if (log_writer.kick || log_writer.stop) {
+        return;
+    }
+
+    wait_ms = log_writer.flush_interval_ms;
+    if (wait_ms == 0) {
+        wait_ms = LOG_IDLE_WAKE_INTERVAL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += wait_ms/1000;
+    ts.tv_nsec += (wait_ms%1000)*1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&log_writer.wake_cond, &log_writer.lock, &ts);
+    return;
+}
+
+static void
+count_log_write (uint64_t bytes, uint64_t write_us)
+{
+    log_writer_stats_t *stats_p = &log_writer.stats;
+
+    pthread_mutex_lock(&log_writer.lock);
+    stats_p->bytes_written += bytes;
+    stats_p->writes++;
+    stats_p->write_us_total += write_us;
+    if (write_us > stats_p->write_us_max) {
+        stats_p->write_us_max = write_us;
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+//write out everything queued, one writev for each pass over the ring
+static uint64_t
+write_log_queue (void)
+{
+    uint64_t head, tail, start_us, written = 0;
+    uint32_t len, cut;
+    struct iovec iov[2];
+    char *data;
+    int iov_cnt;
+    ssize_t rc;
+
+    for (;;) {
+        head = atomic_load_explicit(&log_writer.head, memory_order_relaxed);
+        tail = atomic_load_explicit(&log_writer.tail, memory_order_acquire);
+        if (head == tail) {
+            break;
+        }
+
+        len = tail - head;
+        cut = cut_log_at_rotate_size(head, len);
+        if (cut) {
+            len = cut;
+        }
+
+        iov[0].iov_len = get_log_piece(head, len, &data);
+        iov[0].iov_base = data;
+        iov_cnt = 1;
+        if (iov[0].iov_len < len) {
+            iov[1].iov_base = log_writer.bytes;
+            iov[1].iov_len = len - iov[0].iov_len;
+            iov_cnt = 2;
+        }
+
+        start_us = get_now_us();
+        rc = writev(log_writer.fd, iov, iov_cnt);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        //disk error, lines are dropped rather than blocking the console
+        if (rc <= 0) {
+            rc = len;
+        }
+        count_log_write(rc, get_now_us() - start_us);
+        index_log_bytes(head, rc);
+
+        written += rc;
+        atomic_store_explicit(&log_writer.head, head + rc,
+                              memory_order_release);
+
+        if (cut && rc == len) {
+            rotate_log_segment();
+        }
+    }
+
+    if (log_writer.idx_fp) {
+        fflush(log_writer.idx_fp);
+    }
+    return written;
+}
+
+//returns TRUE if the file is synced
+static bool
+sync_log_file (uint64_t unsynced, uint64_t *last_fsync_us_p)
+{
+    uint64_t now_us = get_now_us();
+    bool do_sync = FALSE;
+
+    if (unsynced == 0) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&log_writer.lock);
+    if (log_writer.fsync_policy == LOG_FSYNC_ALWAYS) {
+        do_sync = TRUE;
+    } else if (log_writer.fsync_policy == LOG_FSYNC_INTERVAL) {
+        do_sync = (now_us - *last_fsync_us_p >=
+                   (uint64_t)log_writer.fsync_interval*1000000);
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+
+    if (!do_sync) {
+        return FALSE;
+    }
+
+    fdatasync(log_writer.fd);
+    *last_fsync_us_p = now_us;
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.stats.fsyncs++;
+    pthread_mutex_unlock(&log_writer.lock);
+    return TRUE;
+}
+
+static void *
+log_writer_main (void *arg)
+{
+    uint64_t unsynced = 0, last_fsync_us;
+    bool stop, clear_req;
+
+    last_fsync_us = get_now_us();
+    for (;;) {
+        pthread_mutex_lock(&log_writer.lock);
+        wait_log_writer_kick();
+        log_writer.kick = FALSE;
+        stop = log_writer.stop;
+        clear_req = log_writer.clear_req;
+        pthread_mutex_unlock(&log_writer.lock);
+
+        unsynced += write_log_queue();
+        if (clear_req) {
+            clear_log_segments();
+        } else if (is_log_rotate_due()) {
+            rotate_log_segment();
+        }
+        if (sync_log_file(unsynced, &last_fsync_us)) {
+            unsynced = 0;
+        }
+
+        pthread_mutex_lock(&log_writer.lock);
+        pthread_cond_broadcast(&log_writer.done_cond);
+        pthread_mutex_unlock(&log_writer.lock);
+
+        if (stop) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+//queue is full, wait for the writer to make room
+static void
+wait_log_queue_room (void)
+{
+    uint64_t head, tail;
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.stats.stalls++;
+    for (;;) {
+        head = atomic_load_explicit(&log_writer.head, memory_order_acquire);
+        tail = atomic_load_explicit(&log_writer.tail, memory_order_relaxed);
+        if (tail - head < LOG_QUEUE_SIZE) {
+            break;
+        }
+        log_writer.kick = TRUE;
+        pthread_cond_signal(&log_writer.wake_cond);
+        pthread_cond_wait(&log_writer.done_cond, &log_writer.lock);
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+void
+log_writer_append (char *data, uint32_t len)
+{
+    uint64_t head, tail;
+    uint32_t room, cnt, off, first;
+
+    if (!log_writer.running) {
+        return;
+    }
+
+    while (len > 0) {
+        head = atomic_load_explicit(&log_writer.head, memory_order_acquire);
+        tail = atomic_load_explicit(&log_writer.tail, memory_order_relaxed);
+        room = LOG_QUEUE_SIZE - (tail - head);
+        if (room == 0) {
+            wait_log_queue_room();
+            continue;
+        }
+
+        cnt = (len < room)?len:room;
+        off = tail & (LOG_QUEUE_SIZE-1);
+        first = (cnt < LOG_QUEUE_SIZE - off)?cnt:(LOG_QUEUE_SIZE - off);
+        memcpy(&log_writer.bytes[off], data, first);
+        memcpy(log_writer.bytes, data + first, cnt - first);
+        atomic_store_explicit(&log_writer.tail, tail + cnt,
+                              memory_order_release);
+
+        //wake the writer only when a batch is just filled up
+        if (tail - head < LOG_WRITE_BATCH &&
+            tail + cnt - head >= LOG_WRITE_BATCH) {
+            kick_log_writer();
+        }
+        data += cnt;
+        len -= cnt;
+    }
+
+    if (log_writer.flush_interval_ms == 0) {
+        kick_log_writer();
+    }
+    return;
+}
+
+//returns after all appended lines are written
+void
+log_writer_sync (void)
+{
+    uint64_t target;
+
+    if (!log_writer.running) {
+        return;
+    }
+
+    target = atomic_load_explicit(&log_writer.tail, memory_order_relaxed);
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.kick = TRUE;
+    pthread_cond_signal(&log_writer.wake_cond);
+    while (atomic_load_explicit(&log_writer.head, memory_order_acquire) <
+           target) {
+        pthread_cond_wait(&log_writer.done_cond, &log_writer.lock);
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+//done by the writer thread, so it never races a rotation
+void
+log_writer_clear (void)
+{
+    if (!log_writer.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.clear_req = TRUE;
+    log_writer.kick = TRUE;
+    pthread_cond_signal(&log_writer.wake_cond);
+    while (log_writer.clear_req) {
+        pthread_cond_wait(&log_writer.done_cond, &log_writer.lock);
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+//0 for no rotation by size
+void
+log_writer_set_rotate_size (uint64_t size)
+{
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.rotate_size = size;
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+//in minutes, 0 for no rotation by time
+void
+log_writer_set_rotate_interval (uint32_t interval)
+{
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.rotate_interval = interval;
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+void
+log_writer_set_rotate_keep (uint32_t keep)
+{
+    uint32_t nos[LOG_ROTATE_KEEP_MAX], cnt;
+
+    if (keep > LOG_ROTATE_KEEP_MAX) {
+        keep = LOG_ROTATE_KEEP_MAX;
+    }
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.rotate_keep = keep;
+    cnt = detach_rotated_segments(keep, nos);
+    pthread_mutex_unlock(&log_writer.lock);
+
+    remove_detached_segments(nos, cnt);
+    return;
+}
+
+//rotated segments from the oldest, then the active one
+uint32_t
+log_writer_get_segments (log_segment_t *segs, uint32_t max)
+{
+    uint32_t i, cnt = 0;
+
+    pthread_mutex_lock(&log_writer.lock);
+    for (i = 0; i < log_writer.seg_cnt && cnt < max; i++) {
+        segs[cnt++] = *get_rotated_segment(i);
+    }
+    if (log_writer.running && cnt < max) {
+        segs[cnt++] = log_writer.active;
+    }
+    pthread_mutex_unlock(&log_writer.lock);
+    return cnt;
+}
+
+/*
+ * Find the index entry of a segment, the last one at or before line_no,
+ * or the first one at or after time_us when time_us is not 0.
+ */
+bool
+log_writer_find_index_entry (uint32_t no, uint64_t line_no, uint64_t time_us,
+                             log_index_entry_t *entry_p)
+{
+    char name[LOG_NAME_MAX_LEN+16], buf[128];
+    unsigned long long line, offset, us;
+    bool found = FALSE;
+    FILE *fp;
+
+    log_writer_get_segment_name(no, TRUE, name, sizeof(name));
+    fp = fopen(name, "r");
+    if (!fp) {
+        return FALSE;
+    }
+
+    while (fgets(buf, sizeof(buf), fp)) {
+        if (sscanf(buf, "line %llu %llu %llu", &line, &offset, &us) != 3) {
+            continue;
+        }
+        if (time_us == 0 && line > line_no) {
+            break;
+        }
+
+        entry_p->line = line;
+        entry_p->offset = offset;
+        entry_p->time_us = us;
+        found = TRUE;
+        if (time_us != 0 && us >= time_us) {
+            break;
+        }
+    }
+
+    fclose(fp);
+    return found;
+}
+
+void
+log_writer_set_flush_interval (uint32_t interval_ms)
+{
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.flush_interval_ms = interval_ms;
+    log_writer.kick = TRUE;
+    pthread_cond_signal(&log_writer.wake_cond);
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+void
+log_writer_set_fsync (int policy, uint32_t interval)
+{
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.fsync_policy = policy;
+    log_writer.fsync_interval = interval;
+    pthread_mutex_unlock(&log_writer.lock);
+    return;
+}
+
+void
+log_writer_get_stats (log_writer_stats_t *stats_p)
+{
+    uint64_t head, tail;
+
+    pthread_mutex_lock(&log_writer.lock);
+    memcpy(stats_p, &log_writer.stats, sizeof(log_writer_stats_t));
+    stats_p->flush_interval_ms = log_writer.flush_interval_ms;
+    stats_p->fsync_policy = log_writer.fsync_policy;
+    stats_p->fsync_interval = log_writer.fsync_interval;
+    pthread_mutex_unlock(&log_writer.lock);
+
+    head = atomic_load_explicit(&log_writer.head, memory_order_acquire);
+    tail = atomic_load_explicit(&log_writer.tail, memory_order_relaxed);
+    stats_p->queue_bytes = tail - head;
+    stats_p->queue_size = LOG_QUEUE_SIZE;
+    return;
+}
+
+static bool
+is_stale_segment_name (char *name, char *base)
+{
+    uint32_t len = strlen(base);
+
+    if (strncmp(name, base, len) != 0 || name[len] != '.' ||
+        !isdigit((unsigned char)name[len+1])) {
+        return FALSE;
+    }
+
+    name += len + 1;
+    while (isdigit((unsigned char)*name)) {
+        name++;
+    }
+    return (*name == '\0' || strcmp(name, LOG_INDEX_SUFFIX) == 0);
+}
+
+//segments of the last run go, like the logfile used to be truncated
+static void
+remove_stale_segments (void)
+{
+    char dir_name[LOG_NAME_MAX_LEN+1], path[2*LOG_NAME_MAX_LEN+2], *base;
+    struct dirent *ent;
+    DIR *dir;
+
+    safe_strncpy(dir_name, log_writer.name, LOG_NAME_MAX_LEN);
+    base = strrchr(dir_name, '/');
+    if (base) {
+        *(base++) = '\0';
+    } else {
+        base = dir_name;
+    }
+
+    dir = opendir((base == dir_name)?".":dir_name);
+    if (!dir) {
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (is_stale_segment_name(ent->d_name, base)) {
+            snprintf(path, sizeof(path), "%s/%s",
+                     (base == dir_name)?".":dir_name, ent->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    return;
+}
+
+static int
+create_log_writer_thread (void)
+{
+    pthread_condattr_t attr;
+    sigset_t all_set, old_set;
+    int rc;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log_writer.wake_cond, &attr);
+    pthread_cond_init(&log_writer.done_cond, NULL);
+    pthread_condattr_destroy(&attr);
+
+    //signals like SIGWINCH stay with the UI thread
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &old_set);
+    rc = pthread_create(&log_writer.thread, NULL, log_writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (rc != 0) {
+        pthread_cond_destroy(&log_writer.wake_cond);
+        pthread_cond_destroy(&log_writer.done_cond);
+        return -1;
+    }
+    return 0;
+}
+
+int
+log_writer_start (char *file_name)
+{
+    if (log_writer.running) {
+        return 0;
+    }
+
+    safe_strncpy(log_writer.name, file_name, LOG_NAME_MAX_LEN);
+    remove_stale_segments();
+    if (open_log_segment() != 0) {
+        return -1;
+    }
+
+    log_writer.bytes = malloc(LOG_QUEUE_SIZE);
+    if (!log_writer.bytes) {
+        close_log_segment();
+        return -1;
+    }
+
+    atomic_store(&log_writer.head, 0);
+    atomic_store(&log_writer.tail, 0);
+    log_writer.kick = FALSE;
+    log_writer.stop = FALSE;
+    memset(&log_writer.stats, 0, sizeof(log_writer_stats_t));
+    memset(&log_writer.active, 0, sizeof(log_segment_t));
+    log_writer.active.first_line = 1;
+    log_writer.next_seg_no = 1;
+    log_writer.seg_head = 0;
+    log_writer.seg_cnt = 0;
+    log_writer.clear_req = FALSE;
+
+    if (create_log_writer_thread() != 0) {
+        free(log_writer.bytes);
+        log_writer.bytes = NULL;
+        close_log_segment();
+        return -1;
+    }
+
+    log_writer.running = TRUE;
+    return 0;
+}
+
+//everything queued is written before the writer goes
+void
+log_writer_stop (void)
+{
+    if (!log_writer.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&log_writer.lock);
+    log_writer.stop = TRUE;
+    pthread_cond_signal(&log_writer.wake_cond);
+    pthread_mutex_unlock(&log_writer.lock);
+
+    pthread_join(log_writer.thread, NULL);
+    pthread_cond_destroy(&log_writer.wake_cond);
+    pthread_cond_destroy(&log_writer.done_cond);
+
+    free(log_writer.bytes);
+    log_writer.bytes = NULL;
+    close_log_segment();
+    log_writer.running = FALSE;
+    return;
+}
@@ -0,0 +1,94 @@
+#ifndef __GVD_LOG_WRITER_H__
+#define __GVD_LOG_WRITER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//! max rotated segments kept
+#define LOG_ROTATE_KEEP_MAX 1024
+#define LOG_NAME_MAX_LEN 255
+
+enum {
+    LOG_FSYNC_NEVER = 0,
+    LOG_FSYNC_ALWAYS,
+    LOG_FSYNC_INTERVAL,
+};
+
+typedef struct log_writer_stats_s {
+    //queued but not written
+    uint64_t queue_bytes;
+    uint32_t queue_size;
+    uint64_t bytes_written;
+    uint64_t writes;
+    uint64_t fsyncs;
+    uint64_t rotations;
+    //appends waiting for queue room
+    uint64_t stalls;
+    uint64_t write_us_total;
+    uint64_t write_us_max;
+    uint32_t flush_interval_ms;
+    int fsync_policy;
+    uint32_t fsync_interval;
+} log_writer_stats_t;
+
+typedef struct log_segment_s {
+    //0 for the active logfile
+    uint32_t no;
+    //line numbers count from 1 across all segments
+    uint64_t first_line;
+    uint64_t line_cnt;
+    uint64_t bytes;
+    //wall clock, when first and last line written
+    uint64_t first_us;
+    uint64_t last_us;
+} log_segment_t;
+
+typedef struct log_index_entry_s {
+    uint64_t line;
+    uint64_t offset;
+    uint64_t time_us;
+} log_index_entry_t;
+
+int
+log_writer_start(char *file_name);
+
+void
+log_writer_stop(void);
+
+void
+log_writer_append(char *data, uint32_t len);
+
+void
+log_writer_sync(void);
+
+void
+log_writer_clear(void);
+
+void
+log_writer_set_flush_interval(uint32_t interval_ms);
+
+void
+log_writer_set_fsync(int policy, uint32_t interval);
+
+void
+log_writer_get_stats(log_writer_stats_t *stats_p);
+
+void
+log_writer_set_rotate_size(uint64_t size);
+
+void
+log_writer_set_rotate_interval(uint32_t interval);
+
+void
+log_writer_set_rotate_keep(uint32_t keep);
+
+uint32_t
+log_writer_get_segments(log_segment_t *segs, uint32_t max);
+
+void
+log_writer_get_segment_name(uint32_t no, bool idx, char *buf, uint32_t len);
+
+bool
+log_writer_find_index_entry(uint32_t no, uint64_t line_no, uint64_t time_us,
+                            log_index_entry_t *entry_p);
+#endif //__GVD_LOG_WRITER_H__
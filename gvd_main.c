@@ -5,45 +5,56 @@
  * October, 2014
  */
 
-#include <ctype.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/wait.h>
 #include "gvd_tty.h"
 #include "gvd_util.h"
+#include "gvd_bench.h"
+#include "gvd_event.h"
+#include "gvd_notify.h"
+#include "gvd_replay.h"
 #include "gvd_common.h"
+#include "gvd_cmd_buf.h"
+#include "gvd_key_map.h"
 #include "gvd_cli_tty.h"
 #include "gvd_cli_tree.h"
 #include "gvd_cli_parser.h"
 #include "gvd_line_buffer.h"
+#include "gvd_session_rec.h"
 
 #define INPUT_HISTORY_MAX_SIZE 16
 
-#define CMD_HISTORY_MAX_SIZE 32
+//! keys typed while a command runs, replayed after it's done
+#define TYPEAHEAD_MAX_SIZE 64
 
-#define HOST_NAME_MAX_LEN 15
+//! keys read at once and handled before the screen is drawn again
+#define INPUT_BATCH_MAX_SIZE 4096
 
-#define PS_MAX_LEN 63
+//! shown at the bottom while paged output is pending
+#define MORE_PROMPT "--More--"
 
+//! watchdog for each command in autotest mode, in seconds
+#define AUTOTEST_CMD_TIMEOUT 300
+
+/*
+ * The command line being edited, shown as prompt and command on the last
+ * line. Keys typed are applied to the row on screen where possible, see
+ * line_buffer_insert_tail_char(), the whole line is redrawn otherwise.
+ */
 typedef struct read_ctx_s {
-    //typed keys for current command
-    char cmd[CMD_MAX_LEN+1];
-    //where the cursor locating
-    int cmd_next_idx;
+    //typed keys for current command, the cursor is its pos
+    cmd_buf_t cmd;
+    //width of the prompt last printed
+    int ps_len;
 } read_ctx_t;
 
 read_ctx_t read_ctx;
 
-typedef int (*input_handler)(int);
-
-typedef struct special_key_entry_s {
-    int key;
-    input_handler handler;
-} special_key_entry_t;
-
-static char host_name[HOST_NAME_MAX_LEN];
 
 static char *banner = 
     "=======================================\n"
@@ -67,160 +78,120 @@ static int input_process_pgdown(int input);
 static int input_process_resize(int input);
 static int input_process_ctrl_c(int input);
 static int input_process_ctrl_z(int input);
-
-special_key_entry_t special_key_table[] = {
-    {'?',               input_process_question_mark},
-    {'\t',              input_process_tab}, //TAB
-    {GVD_KEY_ENTER,     input_process_enter}, //Enter
-    {GVD_KEY_BACKSPACE, input_process_backspace}, //backspace
-    {GVD_KEY_DEL,       input_process_del}, //delete
-    {GVD_KEY_UP,        input_process_up}, //up
-    {GVD_KEY_DOWN,      input_process_down}, //down
-    {GVD_KEY_LEFT,      input_process_left}, //left
-    {GVD_KEY_RIGHT,     input_process_right}, //right
-    {GVD_KEY_HOME,      input_process_home}, //home
-    {GVD_KEY_END,       input_process_end}, //end
-    {GVD_KEY_PGUP,      input_process_pgup}, //page up
-    {GVD_KEY_PGDOWN,    input_process_pgdown}, //page down
-    {GVD_RESIZE,        input_process_resize}, //resize window
-    {GVD_CTRL_C,        input_process_ctrl_c}, //ctrl c
-    {GVD_CTRL_Z,        input_process_ctrl_z}, //ctrl z
+static int input_process_ctrl_f(int input);
+static int input_process_ctrl_r(int input);
+
+//bound to keys by the key map, key-binding in config mode moves them
+static key_action_t key_actions[] = {
+    {"help", "Show what can come next", input_process_question_mark, '?'},
+    {"complete", "Complete the word", input_process_tab, '\t'},
+    {"enter", "Run the command", input_process_enter, GVD_KEY_ENTER},
+    {"backspace", "Delete before the cursor",
+     input_process_backspace, GVD_KEY_BACKSPACE},
+    {"delete", "Delete at the cursor",
+     input_process_del, GVD_KEY_DEL},
+    {"history-up", "Older command", input_process_up, GVD_KEY_UP},
+    {"history-down", "Newer command", input_process_down, GVD_KEY_DOWN},
+    {"left", "Cursor left", input_process_left, GVD_KEY_LEFT},
+    {"right", "Cursor right", input_process_right, GVD_KEY_RIGHT},
+    {"home", "Cursor to line start", input_process_home, GVD_KEY_HOME},
+    {"end", "Cursor to line end", input_process_end, GVD_KEY_END},
+    {"page-up", "Scroll up a page", input_process_pgup, GVD_KEY_PGUP},
+    {"page-down", "Scroll down a page", input_process_pgdown,
+     GVD_KEY_PGDOWN},
+    {"resize", "Follow the window size", input_process_resize, GVD_RESIZE},
+    {"clear-line", "Drop the line", input_process_ctrl_c, GVD_CTRL_C},
+    {"exit-mode", "Back to exec mode", input_process_ctrl_z, GVD_CTRL_Z},
+    {"search-scrollback", "Search scrollback", input_process_ctrl_f,
+     GVD_CTRL_F},
+    {"search-history", "Search command history", input_process_ctrl_r,
+     GVD_CTRL_R},
 };
 
-//0-9a-zA-Z not mentioned here. so many, but what's not included? ? 
-static char *allowed_text_char_set = " ~`!@#$%^&*()-_=+[]{};:,.<>/|\\\"'";
-
+//keys last handled, a ring at input_history_idx
 static int input_history[INPUT_HISTORY_MAX_SIZE];
+static uint32_t input_history_idx = 0;
 
-//the last entry is for garbage, see update cmd history
-static char cmd_history[CMD_HISTORY_MAX_SIZE+1][CMD_MAX_LEN+1];
-static int cmd_history_size = 0;
-static int cmd_history_idx = 0;
-static bool cur_cmd_in_history = FALSE;
+//0 for the line typed, n for the nth newest command of the history
+static uint32_t cmd_history_idx = 0;
+//line typed before going up the history, back at idx 0
+static char *typed_cmd = NULL;
 
-extern gvd_tty_t gvd_tty;
-
-static void
-make_ps (char *ps)
-{
-    char *cli_mode_str;
+/*
+ * Reverse incremental search of the history by Ctrl-R. The match is put
+ * in the command line as found, the prompt shows the pattern.
+ */
+typedef struct history_search_s {
+    bool active;
+    bool found;
+    uint32_t seq;
     uint32_t len;
+    char pattern[SCR_SEARCH_MAX_LEN+1];
+    //line before the search, back on Ctrl-C
+    char *org_cmd;
+} history_search_t;
 
-    gethostname(host_name, HOST_NAME_MAX_LEN);
+static history_search_t hist_search;
 
-    cli_mode_str = gvd_tty.cli_mode_p->mode_string;
-    //two bytes reserved for "#"
-    if (*cli_mode_str) {
-        snprintf(ps, PS_MAX_LEN, "%s(%s)", host_name, cli_mode_str);
-    } else {
-        snprintf(ps, PS_MAX_LEN, "%s", host_name);
-    }
+static char search_pattern[SCR_SEARCH_MAX_LEN+1];
 
-    len = strlen(ps);
-    ps[len++] = '#';
-    ps[len++] = '\0';
-    return;
-}
+static int typeahead_keys[TYPEAHEAD_MAX_SIZE];
+static uint32_t typeahead_head = 0, typeahead_tail = 0;
 
-uint32_t
-get_ps_len (void)
-{
-    char ps[PS_MAX_LEN+1];
-    uint32_t len = 0;
+static int input_batch[INPUT_BATCH_MAX_SIZE];
+static uint32_t input_batch_idx = 0, input_batch_cnt = 0;
+//inside a bracketed paste, '?' and tab are text too
+static bool pasting = FALSE;
+//the key ran a command or paged its output, not counted as key latency
+static bool key_ran_cmd = FALSE;
 
-    make_ps(ps);
-    len = strlen(ps);
-    return len;
-}
+extern gvd_tty_t gvd_tty;
 
 static void
 print_ps (void)
 {
-    char ps[PS_MAX_LEN+1];
+    char *ps;
+    uint32_t ps_len;
 
-    make_ps(ps);
-    printv(ps);
+    ps = gvd_tty_get_ps(&gvd_tty, &ps_len);
+    read_ctx.ps_len = ps_len;
+    printv("%s", ps);
     return;
 }
 
 static void
 update_input_history (int input)
 {
-    memcpy(&input_history[1], input_history,
-           (INPUT_HISTORY_MAX_SIZE-1) * sizeof(input_history[0]));
-    input_history[0] = input;
+    input_history[(input_history_idx++) % INPUT_HISTORY_MAX_SIZE] = input;
     return;
 }
 
-static void
-move_cursor_cmd_home (void)
+static uint64_t
+get_mono_ns (void)
 {
-    int pos;
+    struct timespec ts;
 
-    pos = get_ps_len();
-    tty_move_cursor_pos(pos);
-    return;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
 }
 
 static void
-move_cursor_cmd_end (void)
+move_cursor_cmd_home (void)
 {
     int pos;
 
-    pos = get_ps_len() + strlen(read_ctx.cmd);
+    pos = read_ctx.ps_len;
     tty_move_cursor_pos(pos);
     return;
 }
 
-//Remove the character before cursor in command line
 static void
-remove_parser_cmd_prev_char (void)
-{
-    int idx = read_ctx.cmd_next_idx;
-    int cmd_len, cp_len;
-    char *cmd;
-
-    cmd = read_ctx.cmd;
-    cmd_len = strlen(cmd);
-    cp_len = cmd_len - idx;
-    memmove(&cmd[idx-1], &cmd[idx], cp_len+1);
-    read_ctx.cmd_next_idx--;
-
-    return;
-}
-
-//remove the character in cursor
-static void
-remove_parser_cmd_cur_char (void)
-{
-    int idx = read_ctx.cmd_next_idx;
-    int cmd_len, cp_len;
-    char *cmd;
-
-    cmd = read_ctx.cmd;
-    cmd_len = strlen(cmd);
-    cp_len = cmd_len - idx -1;
-    memmove(&cmd[idx], &cmd[idx+1], cp_len+1);
-    //reset the last char in cmd before del
-    read_ctx.cmd[cmd_len-1] = '\0';
-
-    return;
-}
-
-static void
-insert_parser_cmd_char (char input)
+move_cursor_cmd_end (void)
 {
-    int idx = read_ctx.cmd_next_idx;
-    int cmd_len, cp_len;
-    char *cmd;
-
-    cmd = read_ctx.cmd;
-    cmd_len = strlen(cmd);
-    cp_len = cmd_len - idx;
-    memmove(&cmd[idx+1], &cmd[idx], cp_len+1);
-    cmd[idx] = input;
-    read_ctx.cmd_next_idx++;
+    int pos;
 
+    pos = read_ctx.ps_len + cmd_buf_len(&read_ctx.cmd);
+    tty_move_cursor_pos(pos);
     return;
 }
 
@@ -229,72 +200,54 @@ adjust_cursor_pos (void)
 {
     int pos;
 
-    pos = get_ps_len() + read_ctx.cmd_next_idx;
+    pos = read_ctx.ps_len + cmd_buf_pos(&read_ctx.cmd);
     tty_move_cursor_pos(pos);
     return;
 }
 
-static bool
-is_cmd_empty (char *cmd)
-{
-    while (*cmd) {
-        if (*cmd != ' ') {
-            return FALSE;
-        }
-        cmd++;
-    }
-    return TRUE;
-}
-
+//commands are added to the history by the parser as they run
 static void
-update_cmd_history (void)
+reset_cmd_history_idx (void)
 {
-    int i;
-
-    if (is_cmd_empty(read_ctx.cmd)) {
-        return;
-    }
-
-    safe_strncpy(cmd_history[0], read_ctx.cmd, CMD_MAX_LEN);
-    if (cmd_history_size < CMD_HISTORY_MAX_SIZE) {
-        cmd_history_size++;
-    }
-
-    for (i = cmd_history_size; i > 0; i--) {
-        safe_strncpy(cmd_history[i], cmd_history[i-1], CMD_MAX_LEN);
-    }
-
-    memset(cmd_history[0], 0, CMD_MAX_LEN);
-
+    free(typed_cmd);
+    typed_cmd = NULL;
     cmd_history_idx = 0;
-    cur_cmd_in_history = FALSE;
     return;
 }
 
 static void
 replace_parser_cmd (char *new_cmd)
 {
-    memset(read_ctx.cmd, 0, CMD_MAX_LEN+1);
-    safe_strncpy(read_ctx.cmd, new_cmd, CMD_MAX_LEN);
-    read_ctx.cmd_next_idx = strlen(read_ctx.cmd);
+    new_cmd = new_cmd?new_cmd:"";
+    (void)cmd_buf_set(&read_ctx.cmd, new_cmd, strlen(new_cmd));
     return;
 }
 
 static void
-add_cur_cmd_to_history (void)
+replace_parser_cmd_by_history (uint32_t seq)
 {
-    safe_strncpy(cmd_history[0], read_ctx.cmd, CMD_MAX_LEN);
-    cur_cmd_in_history = TRUE;
+    uint32_t len;
+    char *data;
+
+    if (!gvd_tty.history_p ||
+        !cmd_history_get(gvd_tty.history_p, seq, &data, &len)) {
+        replace_parser_cmd("");
+        return;
+    }
+
+    (void)cmd_buf_set(&read_ctx.cmd, data, len);
     return;
 }
 
 static void
-re_print_cmd (char *cmd)
+re_print_cmd (void)
 {
-    char ps[PS_MAX_LEN+1];
+    char *ps;
+    uint32_t ps_len;
 
-    make_ps(ps);
-    replace_last_line(ps, read_ctx.cmd);
+    ps = gvd_tty_get_ps(&gvd_tty, &ps_len);
+    read_ctx.ps_len = ps_len;
+    replace_last_line(ps, cmd_buf_str(&read_ctx.cmd));
     return;
 }
 
@@ -304,25 +257,85 @@ input_process_enter (int input)
     int ret;
     char *output;
 
-    update_cmd_history();
+    key_ran_cmd = TRUE;
+    reset_cmd_history_idx();
 
     move_cursor_cmd_end();
     printv("\n");
 
-    ret = cli_parser_request(&gvd_tty, PARSER_REQ_EXEC, read_ctx.cmd, &output);
+    ret = cli_parser_request(&gvd_tty, PARSER_REQ_EXEC,
+                             cmd_buf_str(&read_ctx.cmd), &output);
     if (output) {
-        printv(output);
+        printv("%s", output);
         free(output);
     }
 
-    memset(read_ctx.cmd, 0, sizeof(read_ctx.cmd));
-    read_ctx.cmd_next_idx = 0;
+    cmd_buf_clear(&read_ctx.cmd);
 
-    print_ps();
+    if (cli_parser_more_pending(&gvd_tty)) {
+        printv(MORE_PROMPT);
+    } else {
+        print_ps();
+    }
 
     return ret;
 }
 
+//keys on --More--, space for next page, enter for next line, q to stop
+static int
+more_key_process (int input)
+{
+    uint32_t line_cnt;
+    char *output;
+    bool more;
+
+    switch (input) {
+    case ' ':
+        line_cnt = CLI_MORE_PAGE;
+        break;
+
+    case GVD_KEY_ENTER:
+        line_cnt = 1;
+        break;
+
+    case 'q':
+    case 'Q':
+    case GVD_CTRL_C:
+        cli_parser_more_stop(&gvd_tty);
+        replace_last_line("", "");
+        print_ps();
+        return PROCESS_CONTINUE;
+
+    case GVD_KEY_PGUP:
+        return input_process_pgup(input);
+
+    case GVD_KEY_PGDOWN:
+        return input_process_pgdown(input);
+
+    case GVD_RESIZE:
+        return input_process_resize(input);
+
+    default:
+        return PROCESS_CONTINUE;
+    }
+
+    key_ran_cmd = TRUE;
+    replace_last_line("", "");
+    more = cli_parser_more(&gvd_tty, line_cnt, &output);
+    if (output) {
+        printv("%s", output);
+        free(output);
+    }
+
+    if (more) {
+        printv(MORE_PROMPT);
+    } else {
+        print_ps();
+    }
+
+    return PROCESS_CONTINUE;
+}
+
 static int
 input_process_question_mark (int input)
 {
@@ -330,13 +343,14 @@ input_process_question_mark (int input)
 
     printv("?\n");
 
-    (void)cli_parser_request(&gvd_tty, PARSER_REQ_QUERY, read_ctx.cmd, &output);
+    (void)cli_parser_request(&gvd_tty, PARSER_REQ_QUERY,
+                             cmd_buf_str(&read_ctx.cmd), &output);
     if (output) {
-        printv(output);
+        printv("%s", output);
         free(output);
     }
 
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
 
     return PROCESS_CONTINUE;
 }
@@ -346,11 +360,11 @@ input_process_tab (int input)
     char *output = NULL, *cmd, *fill_output;
 
     (void)cli_parser_request(&gvd_tty, PARSER_REQ_AUTO_FILL,
-                             read_ctx.cmd, &output);
+                             cmd_buf_str(&read_ctx.cmd), &output);
     printv("\n");
 
     if (!output || !output[0]) {
-        re_print_cmd(read_ctx.cmd);
+        re_print_cmd();
         return PROCESS_CONTINUE;
     }
 
@@ -358,59 +372,43 @@ input_process_tab (int input)
     fill_output = strchr(output, '\n');
     if (!fill_output) {
         free(output);
-        re_print_cmd(read_ctx.cmd);
+        re_print_cmd();
         return PROCESS_CONTINUE;
     }
     *(fill_output++) = '\0';
 
     replace_parser_cmd(cmd);
     if (fill_output[0] != '\0') {
-        printv(fill_output);
+        printv("%s", fill_output);
     }
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
 
     free(output);
     return PROCESS_CONTINUE;
 }
 
-static bool
-is_in_allowed_text_char_set (int input)
-{
-    char *str, ch;
-
-    if ((input & ~(0x7f)) != 0) {
-        return FALSE;
-    }
-    ch = input & 0x7f;
-
-    if (isalnum(input)) {
-        return TRUE;
-    }
-
-    str = allowed_text_char_set;
-    while (*str) {
-        if (ch == *str) {
-            return TRUE;
-        }
-        str++;
-    }
-
-    return FALSE;
-}
-
 static int
 input_process_text (int input)
 {
+    uint32_t off, line_len;
     char input_ch;
 
     input_ch = input & 0x7f;
 
-    if (strlen(read_ctx.cmd) >= CMD_MAX_LEN) {
+    if (cmd_buf_len(&read_ctx.cmd) >= gvd_tty.cmd_max_len) {
         return PROCESS_CONTINUE;
     }
 
-    insert_parser_cmd_char(input_ch);
-    re_print_cmd(read_ctx.cmd);
+    off = read_ctx.ps_len + cmd_buf_pos(&read_ctx.cmd);
+    line_len = read_ctx.ps_len + cmd_buf_len(&read_ctx.cmd);
+    if (!cmd_buf_insert(&read_ctx.cmd, input_ch)) {
+        return PROCESS_CONTINUE;
+    }
+    if (line_buffer_insert_tail_char(off, input_ch, line_len)) {
+        return PROCESS_CONTINUE;
+    }
+
+    re_print_cmd();
     //after print, cursor comes to end of cmd, should adjust
     adjust_cursor_pos();
     
@@ -420,12 +418,20 @@ input_process_text (int input)
 static int
 input_process_backspace (int input)
 {
-    if (read_ctx.cmd_next_idx == 0) {
+    uint32_t off, line_len;
+
+    if (cmd_buf_pos(&read_ctx.cmd) == 0) {
+        return PROCESS_CONTINUE;
+    }
+
+    off = read_ctx.ps_len + cmd_buf_pos(&read_ctx.cmd) - 1;
+    line_len = read_ctx.ps_len + cmd_buf_len(&read_ctx.cmd);
+    (void)cmd_buf_delete_prev(&read_ctx.cmd);
+    if (line_buffer_delete_tail_char(off, line_len)) {
         return PROCESS_CONTINUE;
     }
 
-    remove_parser_cmd_prev_char();
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
     //after print, cursor comes to end of cmd, should adjust
     adjust_cursor_pos();
 
@@ -435,15 +441,20 @@ input_process_backspace (int input)
 static int
 input_process_del (int input)
 {
-    int cmd_len;
+    uint32_t off, line_len;
 
-    cmd_len = strlen(read_ctx.cmd);
-    if (cmd_len == read_ctx.cmd_next_idx) {
+    if (cmd_buf_len(&read_ctx.cmd) == cmd_buf_pos(&read_ctx.cmd)) {
         return PROCESS_CONTINUE;
     }
 
-    remove_parser_cmd_cur_char();
-    re_print_cmd(read_ctx.cmd);
+    off = read_ctx.ps_len + cmd_buf_pos(&read_ctx.cmd);
+    line_len = read_ctx.ps_len + cmd_buf_len(&read_ctx.cmd);
+    (void)cmd_buf_delete_next(&read_ctx.cmd);
+    if (line_buffer_delete_tail_char(off, line_len)) {
+        return PROCESS_CONTINUE;
+    }
+
+    re_print_cmd();
     //after print, cursor comes to end of cmd, should adjust
     adjust_cursor_pos();
 
@@ -454,7 +465,7 @@ static int
 input_process_home (int input)
 {
     move_cursor_cmd_home();
-    read_ctx.cmd_next_idx = 0;
+    cmd_buf_move(&read_ctx.cmd, 0);
     return PROCESS_CONTINUE;
 }
 
@@ -462,7 +473,7 @@ static int
 input_process_end (int input)
 {
     move_cursor_cmd_end();
-    read_ctx.cmd_next_idx = strlen(read_ctx.cmd);
+    cmd_buf_move(&read_ctx.cmd, cmd_buf_len(&read_ctx.cmd));
     return PROCESS_CONTINUE;
 
 }
@@ -470,53 +481,58 @@ input_process_end (int input)
 static int
 input_process_up (int input)
 {
-    int next_idx;
+    uint32_t first, end;
 
-    next_idx = cmd_history_idx + 1;
-    if (cmd_history_idx >= cmd_history_size) {
+    if (!gvd_tty.history_p) {
         return PROCESS_CONTINUE;
     }
 
-    if (cmd_history_idx == 0 && !cur_cmd_in_history) {
-        add_cur_cmd_to_history();
+    cmd_history_get_range(gvd_tty.history_p, &first, &end);
+    if (cmd_history_idx >= end - first) {
+        return PROCESS_CONTINUE;
     }
 
-    replace_parser_cmd(cmd_history[next_idx]);
-    cmd_history_idx = next_idx;
+    if (cmd_history_idx == 0) {
+        free(typed_cmd);
+        typed_cmd = safe_clone(cmd_buf_str(&read_ctx.cmd), 0);
+    }
+
+    cmd_history_idx++;
+    replace_parser_cmd_by_history(end - cmd_history_idx);
 
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
     return PROCESS_CONTINUE;
 }
 
 static int
 input_process_down (int input)
 {
-    int previous_idx;
+    uint32_t first, end;
 
     if (cmd_history_idx == 0) {
         return PROCESS_CONTINUE;
     }
 
-    previous_idx = cmd_history_idx-1;
-
-    replace_parser_cmd(cmd_history[previous_idx]);
-    cmd_history_idx = previous_idx;
+    cmd_history_idx--;
+    if (cmd_history_idx == 0) {
+        replace_parser_cmd(typed_cmd);
+    } else {
+        cmd_history_get_range(gvd_tty.history_p, &first, &end);
+        replace_parser_cmd_by_history(end - cmd_history_idx);
+    }
 
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
     return PROCESS_CONTINUE;
 }
 
 static int
 input_process_right (int input)
 {
-    int cmd_len;
-
-    cmd_len = strlen(read_ctx.cmd);
-    if (read_ctx.cmd_next_idx == cmd_len) {
+    if (cmd_buf_pos(&read_ctx.cmd) == cmd_buf_len(&read_ctx.cmd)) {
         return PROCESS_CONTINUE;
     }
 
-    read_ctx.cmd_next_idx++; 
+    cmd_buf_move(&read_ctx.cmd, cmd_buf_pos(&read_ctx.cmd) + 1);
     tty_move_cursor_right();
     return PROCESS_CONTINUE;
 }
@@ -524,11 +540,11 @@ input_process_right (int input)
 static int
 input_process_left (int input)
 {
-    if (read_ctx.cmd_next_idx == 0) {
+    if (cmd_buf_pos(&read_ctx.cmd) == 0) {
         return PROCESS_CONTINUE;
     }
 
-    read_ctx.cmd_next_idx--; 
+    cmd_buf_move(&read_ctx.cmd, cmd_buf_pos(&read_ctx.cmd) - 1);
     tty_move_cursor_left();
     return PROCESS_CONTINUE;
 }
@@ -547,10 +563,21 @@ input_process_pgdown (int input)
     return PROCESS_CONTINUE;
 }
 
+static void
+update_scr_len (void)
+{
+    uint32_t scr_y, scr_x;
+
+    tty_get_scr_size(&scr_y, &scr_x);
+    gvd_tty.scr_len = scr_y;
+    return;
+}
+
 static int
 input_process_resize (int input)
 {
     resize_refresh();
+    update_scr_len();
     return PROCESS_CONTINUE;
 }
 
@@ -558,8 +585,9 @@ static int
 input_process_ctrl_c (int input)
 {
     printv("\n");
+    reset_cmd_history_idx();
     replace_parser_cmd("");
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
     return PROCESS_CONTINUE;
 }
 
@@ -568,38 +596,301 @@ input_process_ctrl_z (int input)
 {
     gvd_return_exec_cli_mode(&gvd_tty);
     printv("\n");
+    reset_cmd_history_idx();
     replace_parser_cmd("");
-    re_print_cmd(read_ctx.cmd);
+    re_print_cmd();
     return PROCESS_CONTINUE;
 }
 
-static input_handler
-find_special_key_handler (int input)
+//search back through scrollback, matches are highlighted as typed
+static int
+input_process_ctrl_f (int input)
+{
+    memset(search_pattern, 0, sizeof(search_pattern));
+    search_start_refresh();
+    return PROCESS_CONTINUE;
+}
+
+//keys while searching, ctrl f or up for older match, down for newer,
+//enter stays at the match, ctrl c or esc goes back to the prompt
+static int
+search_key_process (int input)
+{
+    uint32_t len = strlen(search_pattern);
+
+    switch (input) {
+    case GVD_CTRL_F:
+    case GVD_KEY_UP:
+        search_older_refresh();
+        return PROCESS_CONTINUE;
+
+    case GVD_KEY_DOWN:
+        search_newer_refresh();
+        return PROCESS_CONTINUE;
+
+    case GVD_KEY_BACKSPACE:
+        if (len > 0) {
+            search_pattern[len-1] = '\0';
+            search_update_refresh(search_pattern);
+        }
+        return PROCESS_CONTINUE;
+
+    case GVD_KEY_ENTER:
+        search_stop_refresh(TRUE);
+        return PROCESS_CONTINUE;
+
+    case GVD_CTRL_C:
+    case GVD_KEY_ESC:
+        search_stop_refresh(FALSE);
+        adjust_cursor_pos();
+        return PROCESS_CONTINUE;
+
+    case GVD_KEY_PGUP:
+        return input_process_pgup(input);
+
+    case GVD_KEY_PGDOWN:
+        return input_process_pgdown(input);
+
+    case GVD_RESIZE:
+        return input_process_resize(input);
+
+    default:
+        break;
+    }
+
+    if (!key_map_is_text(input) || len >= SCR_SEARCH_MAX_LEN) {
+        return PROCESS_CONTINUE;
+    }
+    search_pattern[len] = input & 0x7f;
+    search_update_refresh(search_pattern);
+    return PROCESS_CONTINUE;
+}
+
+static void
+print_history_search (void)
+{
+    char ps[SCR_SEARCH_MAX_LEN+32];
+
+    snprintf(ps, sizeof(ps), "(%sreverse-i-search)`%s': ",
+             (hist_search.found || hist_search.len == 0)?"":"failed ",
+             hist_search.pattern);
+    read_ctx.ps_len = strlen(ps);
+    replace_last_line(ps, cmd_buf_str(&read_ctx.cmd));
+    return;
+}
+
+//newest match at or before seq, the line keeps the last match if none
+static void
+search_cmd_history (uint32_t seq)
+{
+    uint32_t found_seq;
+
+    hist_search.found = cmd_history_search(gvd_tty.history_p,
+                                           hist_search.pattern,
+                                           hist_search.len, seq, &found_seq);
+    if (hist_search.found) {
+        hist_search.seq = found_seq;
+        replace_parser_cmd_by_history(found_seq);
+    }
+
+    print_history_search();
+    return;
+}
+
+static int
+input_process_ctrl_r (int input)
+{
+    uint32_t first, end;
+
+    if (!gvd_tty.history_p) {
+        return PROCESS_CONTINUE;
+    }
+
+    cmd_history_get_range(gvd_tty.history_p, &first, &end);
+    memset(&hist_search, 0, sizeof(history_search_t));
+    hist_search.active = TRUE;
+    hist_search.seq = end;
+    hist_search.org_cmd = safe_clone(cmd_buf_str(&read_ctx.cmd), 0);
+    print_history_search();
+    return PROCESS_CONTINUE;
+}
+
+//a match taken is where up and down go on from
+static void
+stop_history_search (bool accept)
+{
+    uint32_t first, end;
+
+    hist_search.active = FALSE;
+    reset_cmd_history_idx();
+    if (accept && hist_search.found) {
+        cmd_history_get_range(gvd_tty.history_p, &first, &end);
+        cmd_history_idx = end - hist_search.seq;
+        typed_cmd = hist_search.org_cmd;
+    } else {
+        replace_parser_cmd(hist_search.org_cmd);
+        free(hist_search.org_cmd);
+    }
+    hist_search.org_cmd = NULL;
+
+    re_print_cmd();
+    return;
+}
+
+//keys while searching history, ctrl r for older match, ctrl c or esc
+//goes back to the line typed, other keys take the match and go on
+static bool
+history_search_key_process (int input)
+{
+    switch (input) {
+    case GVD_CTRL_R:
+        if (!hist_search.found) {
+            return TRUE;
+        }
+        if (hist_search.seq == 0) {
+            hist_search.found = FALSE;
+            print_history_search();
+            return TRUE;
+        }
+        search_cmd_history(hist_search.seq - 1);
+        return TRUE;
+
+    case GVD_KEY_BACKSPACE:
+        if (hist_search.len == 0) {
+            return TRUE;
+        }
+        hist_search.pattern[--hist_search.len] = '\0';
+        hist_search.found = FALSE;
+        if (hist_search.len == 0) {
+            print_history_search();
+            return TRUE;
+        }
+        search_cmd_history(UINT32_MAX);
+        return TRUE;
+
+    case GVD_CTRL_C:
+    case GVD_KEY_ESC:
+        stop_history_search(FALSE);
+        return TRUE;
+
+    case GVD_KEY_PGUP:
+    case GVD_KEY_PGDOWN:
+    case GVD_RESIZE:
+    case GVD_KEY_PASTE_START:
+    case GVD_KEY_PASTE_END:
+        return FALSE;
+
+    default:
+        break;
+    }
+
+    if (!key_map_is_text(input) && input != '?') {
+        stop_history_search(TRUE);
+        return FALSE;
+    }
+
+    if (hist_search.len < SCR_SEARCH_MAX_LEN) {
+        hist_search.pattern[hist_search.len++] = input & 0x7f;
+        search_cmd_history(hist_search.seq);
+    }
+    return TRUE;
+}
+
+//keys past the size are dropped, a paste still ends where it was cut
+static void
+save_typeahead_key (int input)
 {
-    int i, size;
-    special_key_entry_t *entry_p;
+    if (typeahead_tail - typeahead_head >= TYPEAHEAD_MAX_SIZE) {
+        if (input == GVD_KEY_PASTE_END) {
+            typeahead_keys[(typeahead_tail - 1) % TYPEAHEAD_MAX_SIZE] = input;
+        }
+        return;
+    }
+
+    typeahead_keys[(typeahead_tail++) % TYPEAHEAD_MAX_SIZE] = input;
+    return;
+}
 
-    size = ARRAY_LEN(special_key_table);
-    for (i = 0; i < size; i++) {
-        entry_p = &special_key_table[i];
-        if (entry_p->key == input) {
-            return entry_p->handler;
+/*
+ * Keys are read in batches, all typed or pasted by the time of the read,
+ * and the screen is drawn once the batch is done. Keys of the batch come
+ * before the ones saved while a command of it ran. FALSE if no key is
+ * waiting, the event loop calls again once the console is readable.
+ */
+static bool
+read_one_key (int *input_p)
+{
+    if (input_batch_idx < input_batch_cnt) {
+        *input_p = input_batch[input_batch_idx++];
+        return TRUE;
+    }
+
+    if (typeahead_head != typeahead_tail) {
+        *input_p = typeahead_keys[(typeahead_head++) % TYPEAHEAD_MAX_SIZE];
+        return TRUE;
+    }
+
+    flush_line_buffer_to_scr();
+    input_batch_cnt = tty_poll_keys(input_batch, INPUT_BATCH_MAX_SIZE);
+    input_batch_idx = 0;
+    if (input_batch_cnt == 0) {
+        return FALSE;
+    }
+
+    *input_p = input_batch[input_batch_idx++];
+    return TRUE;
+}
+
+//called while a command runs, Ctrl-C aborts it, other keys are kept,
+//once typeahead is full the rest is read and dropped, so a Ctrl-C after
+//a big paste still gets through
+static bool
+poll_cancel_key (void)
+{
+    int input;
+
+    while (tty_poll_one_key(&input)) {
+        if (input == GVD_CTRL_C) {
+            return TRUE;
         }
+        save_typeahead_key(input);
     }
 
-    return NULL;
+    return FALSE;
 }
 
 static int
 input_key_process (int input)
 {
     int ret = PROCESS_CONTINUE;
-    input_handler handler = NULL;
+    key_handler_t handler = NULL;
 
     update_input_history(input);
 
-    handler = find_special_key_handler(input);
-    if (!handler && is_in_allowed_text_char_set(input)) {
+    if (hist_search.active && history_search_key_process(input)) {
+        return PROCESS_CONTINUE;
+    }
+
+    if (input == GVD_KEY_PASTE_START || input == GVD_KEY_PASTE_END) {
+        pasting = (input == GVD_KEY_PASTE_START);
+        return PROCESS_CONTINUE;
+    }
+
+    if (cli_parser_more_pending(&gvd_tty)) {
+        return more_key_process(input);
+    }
+
+    if (is_search_active()) {
+        return search_key_process(input);
+    }
+
+    //pasted '?' is text and tab a space, no help or completion
+    if (pasting && (input == '?' || input == '\t')) {
+        return input_process_text((input == '?')?input:' ');
+    }
+
+    handler = key_map_lookup(input);
+    if (!handler && key_map_is_text(input)) {
         handler = input_process_text;
     }
 
@@ -612,14 +903,178 @@ input_key_process (int input)
     return ret;
 }
 
+//keys waiting are handled, the loop stops once one exits
+static void
+run_console_keys (void)
+{
+    int input, process_result;
+    uint64_t start_ns;
+
+    while (read_one_key(&input)) {
+        //time to apply the key, the screen is drawn once per batch
+        key_ran_cmd = FALSE;
+        start_ns = get_mono_ns();
+        process_result = input_key_process(input);
+        if (!key_ran_cmd) {
+            key_map_count_key(get_mono_ns() - start_ns);
+        }
+        if (process_result == PROCESS_EXIT) {
+            event_loop_stop();
+            return;
+        }
+    }
+    return;
+}
+
+static void
+console_input_event (int fd, uint32_t events, void *ctx)
+{
+    run_console_keys();
+    return;
+}
+
+//the backend takes the new size and gives the resize key
+static void
+console_resize_event (int signo, void *ctx)
+{
+    tty_resize();
+    run_console_keys();
+    return;
+}
+
+//children of commands are waited for by them, this reaps any left over
+static void
+child_exit_event (int signo, void *ctx)
+{
+    pid_t pid;
+    int status;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (WIFSIGNALED(status)) {
+            notify_post("%% Process %d killed by signal %d", (int)pid,
+                        WTERMSIG(status));
+        } else {
+            notify_post("%% Process %d exited with status %d", (int)pid,
+                        WEXITSTATUS(status));
+        }
+    }
+    return;
+}
+
+static void
+notify_event (int fd, uint32_t events, void *ctx)
+{
+    notify_ack();
+    return;
+}
+
+static void
+print_notify_msg (char *msg, uint32_t len, uint32_t repeat, void *ctx)
+{
+    char line[NOTIFY_MSG_MAX_LEN+32];
+
+    if (repeat > 1) {
+        snprintf(line, sizeof(line), "%s (%u times)\n", msg, repeat);
+    } else {
+        snprintf(line, sizeof(line), "%s\n", msg);
+    }
+    line_buffer_print_above_tail(line);
+    return;
+}
+
+//messages go above the prompt, they wait while --More-- or a search has it
+static void
+show_notify_msgs (void)
+{
+    if (cli_parser_more_pending(&gvd_tty) || is_search_active() ||
+        hist_search.active) {
+        return;
+    }
+
+    if (notify_drain(print_notify_msg, NULL) == 0) {
+        return;
+    }
+
+    //prompt and command are drawn again once for all the messages
+    flush_line_buffer_to_scr();
+    adjust_cursor_pos();
+    return;
+}
+
+//before the loop waits, what the events changed is shown
 static void
+update_console_scr (void)
+{
+    show_notify_msgs();
+    flush_line_buffer_to_scr();
+    tty_flush();
+    return;
+}
+
+//keys are one event source of the loop, with the signals of the console
+static int
+add_console_events (void)
+{
+    int rc;
+
+    rc = event_loop_init();
+    if (rc == -1) {
+        return -1;
+    }
+
+    rc = event_add_fd(STDIN_FILENO, EPOLLIN, console_input_event, NULL);
+    if (rc == -1) {
+        return -1;
+    }
+
+    rc = event_add_signal(SIGWINCH, console_resize_event, NULL);
+    if (rc == -1) {
+        return -1;
+    }
+
+    rc = event_add_signal(SIGCHLD, child_exit_event, NULL);
+    if (rc == -1) {
+        return -1;
+    }
+
+    rc = notify_init();
+    if (rc == -1) {
+        return -1;
+    }
+
+    return event_add_fd(notify_get_fd(), EPOLLIN, notify_event, NULL);
+}
+
+static int
 cli_read_init (void)
 {
     memset(input_history, 0, sizeof(input_history));
     memset(&read_ctx, 0, sizeof(read_ctx_t));
-    return;
+    key_map_init(key_actions, ARRAY_LEN(key_actions));
+    return cmd_buf_init(&read_ctx.cmd);
 }
 
+//the screen bench types through the prompt as the console does
+static int
+bench_prompt_init (void)
+{
+    int rc;
+
+    rc = cli_read_init();
+    if (rc == -1) {
+        return -1;
+    }
+
+    update_scr_len();
+    print_ps();
+    return 0;
+}
+
+static bench_prompt_t bench_prompt = {
+    .init = bench_prompt_init,
+    .key_process = input_key_process,
+};
+
 static int
 gvd_common_init (void)
 {
@@ -636,48 +1091,53 @@ gvd_common_init (void)
 static void
 printf_ps (void)
 {
-    char ps[PS_MAX_LEN+1];
-
-    make_ps(ps);
-    printf("%s", ps);
+    printf("%s", gvd_tty_get_ps(&gvd_tty, NULL));
     return;
 }
 
-static void
-autotest_read_in_cmd (char *cmd)
+//return FALSE on end of input, so a test run never hangs on EOF,
+//a line over the command length is read whole and refused by the parser
+static bool
+autotest_read_in_cmd (cmd_buf_t *cmd_p)
 {
-    uint32_t i = 0;
     int input;
-    char ch;
 
-    memset(cmd, 0, CMD_MAX_LEN+1);
+    cmd_buf_clear(cmd_p);
 
     for (;;) {
         input = getchar();
         if (input == EOF) {
+            if (cmd_buf_len(cmd_p) == 0) {
+                return FALSE;
+            }
             break;
         }
-        ch = (char)input;
-        if (ch == '\n') {
+        if (input == '\n') {
             break;
         }
-        if (i > CMD_MAX_LEN) {
-            continue;
+        if (!cmd_buf_insert(cmd_p, (char)input)) {
+            return FALSE;
         }
-        cmd[i++] = ch;
     }
 
-    cmd[i] = '\0';
-    return;
+    return TRUE;
 }
 
 int is_autotest_mode = 0;
 
+static void
+autotest_sigint_handler (int sig)
+{
+    request_cancel(&gvd_tty.cpi.cancel, CANCEL_REASON_USER);
+    return;
+}
+
 static void
 autotest_mode (void)
 {
     int rc, process_result;
-    char cmd[CMD_MAX_LEN+1], *output;
+    cmd_buf_t cmd;
+    char *output;
 
     is_autotest_mode = 1;
 
@@ -686,33 +1146,54 @@ autotest_mode (void)
         return;
     }
 
+    rc = cmd_buf_init(&cmd);
+    if (rc == -1) {
+        return;
+    }
+
+    gvd_tty.cmd_timeout = AUTOTEST_CMD_TIMEOUT;
+
     printf("%s", banner);
 
     printf_ps();
 
     for (;;) {
-        autotest_read_in_cmd(cmd);
+        if (!autotest_read_in_cmd(&cmd)) {
+            break;
+        }
+        //Ctrl-C cancels a running command, at the prompt it ends the test
+        signal(SIGINT, autotest_sigint_handler);
         process_result = cli_parser_request(&gvd_tty, PARSER_REQ_EXEC,
-                                            cmd, &output);
+                                            cmd_buf_str(&cmd), &output);
         if (output) {
             printf("%s", output);
             free(output);
         }
+        //no one to press space, take all pages
+        while (cli_parser_more_pending(&gvd_tty)) {
+            (void)cli_parser_more(&gvd_tty, CLI_MORE_PAGE, &output);
+            if (output) {
+                printf("%s", output);
+                free(output);
+            }
+        }
+        signal(SIGINT, SIG_DFL);
+        //a Ctrl-C after the command ended is not for the next one
+        disarm_cancel_token(&gvd_tty.cpi.cancel);
         if (process_result == PROCESS_EXIT) {
             break;
         }
         printf_ps();
     }
 
+    cmd_buf_free(&cmd);
     return;
 }
 
 int
 main (int argc, char *argv[])
 {
-    bool result;
-    int input;
-    int ret = 0, process_result;
+    int ret = 0;
     int rc;
 
     if (argv[1] && strcmp(argv[1], "autotest") == 0) {
@@ -720,6 +1201,22 @@ main (int argc, char *argv[])
         return 0;
     }
 
+    if (argv[1] && strcmp(argv[1], "bench") == 0) {
+        return gvd_bench_main(argc-2, argv+2, &bench_prompt);
+    }
+
+    if (argv[1] && strcmp(argv[1], "replay") == 0) {
+        return gvd_replay_main(argc-2, argv+2);
+    }
+
+    //terminal backend, curses unless "--tty vt100" is given
+    if (argv[1] && strcmp(argv[1], "--tty") == 0) {
+        if (!argv[2] || tty_set_backend(argv[2]) == -1) {
+            printf("Unknown terminal backend, curses or vt100.\n");
+            return -1;
+        }
+    }
+
     rc = gvd_common_init();
     if (rc == -1) {
         return -1;
@@ -730,25 +1227,42 @@ main (int argc, char *argv[])
         return -1;
     }
 
-    cli_read_init();
+    rc = cli_read_init();
+    if (rc == -1) {
+        line_buffer_clean();
+        return -1;
+    }
+
+    //commands of earlier runs, the ones run now are added to the file
+    if (gvd_tty.history_p) {
+        (void)cmd_history_load(gvd_tty.history_p, CMD_HISTORY_NAME_DEFAULT);
+    }
+
+    //cheap enough to be always on, "recording stop" turns it off
+    (void)session_rec_start(SESSION_REC_NAME_DEFAULT);
+
+    update_scr_len();
+
+    cli_parser_set_cancel_poll(poll_cancel_key);
 
     printv(banner);
 
     print_ps();
 
-    for (;;) {
-        result = tty_read_one_key(&input);
-        if (!result) {
-            ret = -1;
-            break;;
-        }
-        process_result = input_key_process(input);
-        if (process_result == PROCESS_EXIT) {
-            break;
-        }
+    rc = add_console_events();
+    if (rc == 0) {
+        rc = event_loop_run(update_console_scr);
+    }
+    if (rc == -1) {
+        ret = -1;
     }
 
+    event_loop_clean();
+    notify_clean();
+    session_rec_stop();
     line_buffer_clean();
+    cmd_buf_free(&read_ctx.cmd);
+    reset_cmd_history_idx();
     return ret;
 }
 
@@ -0,0 +1,318 @@
+/*
+ * gvd_notify.c
+ *
+ * Messages to the console from anywhere: other threads, timers, signal
+ * handlers of the event loop. Posts go into a bounded queue with many
+ * producers and one consumer, no locks: a producer claims a slot by
+ * moving the tail with compare and swap, fills it and publishes it with
+ * the slot's sequence. The first post after a drain writes to an eventfd
+ * to wake the UI thread, which drains the queue and prints the messages
+ * above the prompt, same messages in a row as one line.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include "gvd_util.h"
+#include "gvd_notify.h"
+
+//seq is pos when free for the post at pos, pos+1 once it holds it
+typedef struct notify_slot_s {
+    atomic_uint_fast64_t seq;
+    uint32_t len;
+    char msg[NOTIFY_MSG_MAX_LEN+1];
+} notify_slot_t;
+
+typedef struct notify_queue_s {
+    notify_slot_t slots[NOTIFY_QUEUE_SIZE];
+    atomic_uint_fast64_t tail;
+    //only the UI thread moves the head
+    uint64_t head;
+    int event_fd;
+    //set by the post that wrote the eventfd, cleared by the drain
+    atomic_bool wake_pending;
+    atomic_uint_fast64_t queued;
+    atomic_uint_fast64_t dropped;
+    uint64_t coalesced;
+    uint64_t drains;
+    //sending threads still running, clean waits for them to stop
+    pthread_mutex_t send_lock;
+    pthread_cond_t send_done;
+    uint32_t senders;
+    atomic_bool closing;
+} notify_queue_t;
+
+typedef struct notify_send_s {
+    uint32_t count;
+    char msg[NOTIFY_MSG_MAX_LEN+1];
+} notify_send_t;
+
+static notify_queue_t notify_queue = {
+    .event_fd = -1,
+    .send_lock = PTHREAD_MUTEX_INITIALIZER,
+    .send_done = PTHREAD_COND_INITIALIZER,
+};
+
+int
+notify_init (void)
+{
+    uint32_t i;
+
+    if (notify_queue.event_fd != -1) {
+        return 0;
+    }
+
+    // slot is found by masking the position
+    if (NOTIFY_QUEUE_SIZE & (NOTIFY_QUEUE_SIZE-1)) {
+        return -1;
+    }
+
+    for (i = 0; i < NOTIFY_QUEUE_SIZE; i++) {
+        atomic_init(&notify_queue.slots[i].seq, i);
+    }
+
+    notify_queue.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_queue.event_fd == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+//posts left in the queue are not shown, sending threads are stopped
+//first so none writes the eventfd once it's closed
+void
+notify_clean (void)
+{
+    atomic_store(&notify_queue.closing, TRUE);
+    pthread_mutex_lock(&notify_queue.send_lock);
+    while (notify_queue.senders) {
+        pthread_cond_wait(&notify_queue.send_done, &notify_queue.send_lock);
+    }
+    pthread_mutex_unlock(&notify_queue.send_lock);
+
+    if (notify_queue.event_fd != -1) {
+        close(notify_queue.event_fd);
+        notify_queue.event_fd = -1;
+    }
+    return;
+}
+
+//readable when posts are waiting, for the event loop
+int
+notify_get_fd (void)
+{
+    return notify_queue.event_fd;
+}
+
+//any thread, FALSE if the queue is full and the message dropped
+bool
+notify_post (char *fmt, ...)
+{
+    uint64_t pos, seq, one = 1;
+    notify_slot_t *slot_p;
+    va_list ap;
+    int len;
+
+    pos = atomic_load_explicit(&notify_queue.tail, memory_order_relaxed);
+    for (;;) {
+        slot_p = &notify_queue.slots[pos & (NOTIFY_QUEUE_SIZE-1)];
+        seq = atomic_load_explicit(&slot_p->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&notify_queue.tail,
+                    &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                break;
+            }
+        } else if (seq < pos) {
+            //still holds the post of one lap ago, the queue is full
+            atomic_fetch_add_explicit(&notify_queue.dropped, 1,
+                                      memory_order_relaxed);
+            return FALSE;
+        } else {
+            pos = atomic_load_explicit(&notify_queue.tail,
+                                       memory_order_relaxed);
+        }
+    }
+
+    va_start(ap, fmt);
+    len = vsnprintf(slot_p->msg, sizeof(slot_p->msg), fmt, ap);
+    va_end(ap);
+    if (len < 0) {
+        len = 0;
+    }
+    slot_p->len = (len > NOTIFY_MSG_MAX_LEN)?NOTIFY_MSG_MAX_LEN:len;
+    atomic_store_explicit(&slot_p->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&notify_queue.queued, 1, memory_order_relaxed);
+
+    if (!atomic_exchange(&notify_queue.wake_pending, TRUE) &&
+        notify_queue.event_fd != -1) {
+        (void)write(notify_queue.event_fd, &one, sizeof(one));
+    }
+    return TRUE;
+}
+
+bool
+notify_pending (void)
+{
+    notify_slot_t *slot_p;
+
+    slot_p = &notify_queue.slots[notify_queue.head & (NOTIFY_QUEUE_SIZE-1)];
+    return (atomic_load_explicit(&slot_p->seq, memory_order_acquire) ==
+            notify_queue.head + 1);
+}
+
+//eventfd read, posts are drained whenever the UI can show them
+void
+notify_ack (void)
+{
+    uint64_t cnt;
+
+    (void)read(notify_queue.event_fd, &cnt, sizeof(cnt));
+    return;
+}
+
+static notify_slot_t *
+peek_notify_slot (void)
+{
+    return notify_pending()?
+           &notify_queue.slots[notify_queue.head & (NOTIFY_QUEUE_SIZE-1)]:
+           NULL;
+}
+
+static void
+release_notify_slot (notify_slot_t *slot_p)
+{
+    atomic_store_explicit(&slot_p->seq, notify_queue.head + NOTIFY_QUEUE_SIZE,
+                          memory_order_release);
+    notify_queue.head++;
+    return;
+}
+
+/*
+ * UI thread only. The handler gets each message with the count of same
+ * ones right after it, up to what was posted when the drain started, so
+ * a steady stream can't hold the UI. Number of lines handed over.
+ */
+uint32_t
+notify_drain (notify_handler_t handler, void *ctx)
+{
+    char msg[NOTIFY_MSG_MAX_LEN+1];
+    notify_slot_t *slot_p;
+    uint32_t len, repeat, lines = 0, left = NOTIFY_QUEUE_SIZE;
+
+    //posts from now on wake the loop again
+    atomic_store(&notify_queue.wake_pending, FALSE);
+
+    while (left > 0 && (slot_p = peek_notify_slot())) {
+        len = slot_p->len;
+        memcpy(msg, slot_p->msg, len);
+        msg[len] = '\0';
+        release_notify_slot(slot_p);
+        left--;
+
+        repeat = 1;
+        while (left > 0 && (slot_p = peek_notify_slot()) &&
+               slot_p->len == len && memcmp(slot_p->msg, msg, len) == 0) {
+            release_notify_slot(slot_p);
+            left--;
+            repeat++;
+        }
+
+        notify_queue.coalesced += repeat - 1;
+        handler(msg, len, repeat, ctx);
+        lines++;
+    }
+
+    if (lines) {
+        notify_queue.drains++;
+    }
+    return lines;
+}
+
+static void *
+notify_send_main (void *arg)
+{
+    notify_send_t *send_p = arg;
+    uint32_t i;
+
+    for (i = 0; i < send_p->count; i++) {
+        if (atomic_load_explicit(&notify_queue.closing,
+                                 memory_order_relaxed)) {
+            break;
+        }
+        (void)notify_post("%s", send_p->msg);
+    }
+
+    free(send_p);
+
+    pthread_mutex_lock(&notify_queue.send_lock);
+    if (--notify_queue.senders == 0) {
+        pthread_cond_broadcast(&notify_queue.send_done);
+    }
+    pthread_mutex_unlock(&notify_queue.send_lock);
+    return NULL;
+}
+
+//a thread posts msg count times, as a burst of log messages would come
+int
+notify_send_thread (char *msg, uint32_t count)
+{
+    sigset_t all_set, old_set;
+    notify_send_t *send_p;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int rc;
+
+    send_p = malloc(sizeof(notify_send_t));
+    if (!send_p) {
+        return -1;
+    }
+    send_p->count = count;
+    snprintf(send_p->msg, sizeof(send_p->msg), "%s", msg);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    //counted before it runs, so clean can't miss it
+    pthread_mutex_lock(&notify_queue.send_lock);
+    notify_queue.senders++;
+    pthread_mutex_unlock(&notify_queue.send_lock);
+
+    //signals stay with the UI thread
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &old_set);
+    rc = pthread_create(&thread, &attr, notify_send_main, send_p);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        pthread_mutex_lock(&notify_queue.send_lock);
+        if (--notify_queue.senders == 0) {
+            pthread_cond_broadcast(&notify_queue.send_done);
+        }
+        pthread_mutex_unlock(&notify_queue.send_lock);
+        free(send_p);
+        return -1;
+    }
+    return 0;
+}
+
+void
+notify_get_stats (notify_stats_t *stats_p)
+{
+    memset(stats_p, 0, sizeof(notify_stats_t));
+    stats_p->queued = atomic_load(&notify_queue.queued);
+    stats_p->dropped = atomic_load(&notify_queue.dropped);
+    stats_p->coalesced = notify_queue.coalesced;
+    stats_p->drains = notify_queue.drains;
+    stats_p->pending = atomic_load(&notify_queue.tail) - notify_queue.head;
+    return;
+}
@@ -0,0 +1,53 @@
+#ifndef __GVD_NOTIFY_H__
+#define __GVD_NOTIFY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//! messages queued, power of 2, posts are dropped when it's full
+#define NOTIFY_QUEUE_SIZE 1024
+//! longer messages are cut
+#define NOTIFY_MSG_MAX_LEN 255
+//! most messages "send log" posts at once
+#define NOTIFY_SEND_COUNT_MAX 100000
+
+//repeat is how many same messages in a row came as this one
+typedef void (*notify_handler_t)(char *msg, uint32_t len, uint32_t repeat,
+                                 void *ctx);
+
+typedef struct notify_stats_s {
+    uint64_t queued;
+    uint64_t dropped;
+    //shown as one line with the same message before them
+    uint64_t coalesced;
+    uint64_t drains;
+    uint32_t pending;
+} notify_stats_t;
+
+int
+notify_init(void);
+
+void
+notify_clean(void);
+
+int
+notify_get_fd(void);
+
+bool
+notify_post(char *fmt, ...);
+
+bool
+notify_pending(void);
+
+void
+notify_ack(void);
+
+uint32_t
+notify_drain(notify_handler_t handler, void *ctx);
+
+int
+notify_send_thread(char *msg, uint32_t count);
+
+void
+notify_get_stats(notify_stats_t *stats_p);
+#endif //__GVD_NOTIFY_H__
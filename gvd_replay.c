@@ -0,0 +1,411 @@
+/*
+ * gvd_replay.c
+ *
+ * Replay of a session recording, run as "gvd replay [file] [max | speed]".
+ * Records are rendered through the line buffer as they were shown, at the
+ * recorded pace times speed, or all at once for max. While waiting PgUp
+ * and PgDn scroll, q stops, any other key skips to the next record. The
+ * wait is a timer of the event loop, keys and resizes come by it too.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gvd_tty.h"
+#include "gvd_util.h"
+#include "gvd_event.h"
+#include "gvd_replay.h"
+#include "gvd_cli_tty.h"
+#include "gvd_line_buffer.h"
+#include "gvd_session_rec.h"
+
+//! VTYs whose mode is followed, others show in exec mode
+#define REPLAY_VTY_MAX 64
+//! fastest replay, times the recorded pace
+#define REPLAY_SPEED_MAX 1000
+//! replay as fast as it renders
+#define REPLAY_SPEED_NO_WAIT 0
+
+//mode string of one VTY, points into the mapped recording
+typedef struct replay_vty_s {
+    uint32_t vty_id;
+    char *mode;
+    uint32_t mode_len;
+} replay_vty_t;
+
+typedef struct replay_ctx_s {
+    session_rec_reader_t reader;
+    uint32_t speed;
+    char *host;
+    uint32_t host_len;
+    replay_vty_t vtys[REPLAY_VTY_MAX];
+    uint32_t vty_cnt;
+    //recorded time shown at start_us, moves on when a wait is skipped
+    uint64_t base_rec_us;
+    uint64_t start_us;
+    bool stop;
+    //a key ended the wait before its timer
+    bool skipped;
+} replay_ctx_t;
+
+static uint64_t
+get_now_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static void
+print_replay_usage (void)
+{
+    printf("Usage: gvd replay [file] [max | <1-%u>]\n", REPLAY_SPEED_MAX);
+    printf("  file   recording, default %s\n", SESSION_REC_NAME_DEFAULT);
+    printf("  max    as fast as it renders\n");
+    printf("  speed  times the recorded pace, default 1\n");
+    return;
+}
+
+static replay_vty_t *
+find_replay_vty (replay_ctx_t *ctx_p, uint32_t vty_id)
+{
+    uint32_t i;
+
+    for (i = 0; i < ctx_p->vty_cnt; i++) {
+        if (ctx_p->vtys[i].vty_id == vty_id) {
+            return &ctx_p->vtys[i];
+        }
+    }
+
+    if (ctx_p->vty_cnt == REPLAY_VTY_MAX) {
+        return NULL;
+    }
+    ctx_p->vtys[ctx_p->vty_cnt].vty_id = vty_id;
+    return &ctx_p->vtys[ctx_p->vty_cnt++];
+}
+
+//same look as the live prompt, other VTYs are tagged with their id
+static void
+print_replay_input (replay_ctx_t *ctx_p, session_rec_t *rec_p, char *data)
+{
+    replay_vty_t *vty_p = find_replay_vty(ctx_p, rec_p->vty_id);
+
+    if (rec_p->vty_id != GVD_CONSOLE_VTY_ID) {
+        printv("[vty %u] ", rec_p->vty_id);
+    }
+    if (vty_p && vty_p->mode_len > 0) {
+        printv("%.*s(%.*s)#", ctx_p->host_len, ctx_p->host,
+               vty_p->mode_len, vty_p->mode);
+    } else {
+        printv("%.*s#", ctx_p->host_len, ctx_p->host);
+    }
+    printv("%.*s\n", rec_p->len, data);
+    return;
+}
+
+static void
+render_replay_rec (replay_ctx_t *ctx_p, session_rec_t *rec_p, char *data)
+{
+    replay_vty_t *vty_p;
+
+    switch (rec_p->type) {
+    case SESSION_REC_START:
+        ctx_p->host = data;
+        ctx_p->host_len = rec_p->len;
+        ctx_p->vty_cnt = 0;
+        break;
+
+    case SESSION_REC_INPUT:
+        print_replay_input(ctx_p, rec_p, data);
+        break;
+
+    case SESSION_REC_OUTPUT:
+        printv("%.*s", rec_p->len, data);
+        break;
+
+    case SESSION_REC_MODE:
+        vty_p = find_replay_vty(ctx_p, rec_p->vty_id);
+        if (vty_p) {
+            vty_p->mode = data;
+            vty_p->mode_len = rec_p->len;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return;
+}
+
+//return TRUE if the key skips the wait
+static bool
+replay_key_process (replay_ctx_t *ctx_p, int input)
+{
+    switch (input) {
+    case 'q':
+    case 'Q':
+    case GVD_CTRL_C:
+        ctx_p->stop = TRUE;
+        return TRUE;
+
+    case GVD_KEY_PGUP:
+        scroll_up_refresh();
+        return FALSE;
+
+    case GVD_KEY_PGDOWN:
+        scroll_down_refresh();
+        return FALSE;
+
+    case GVD_RESIZE:
+        resize_refresh();
+        return FALSE;
+
+    default:
+        return TRUE;
+    }
+}
+
+static void
+replay_input_event (int fd, uint32_t events, void *ctx)
+{
+    replay_ctx_t *ctx_p = ctx;
+    int input;
+
+    while (tty_poll_one_key(&input)) {
+        if (replay_key_process(ctx_p, input)) {
+            ctx_p->skipped = TRUE;
+            event_loop_stop();
+            return;
+        }
+    }
+    return;
+}
+
+static void
+replay_resize_event (int signo, void *ctx)
+{
+    tty_resize();
+    replay_input_event(STDIN_FILENO, EPOLLIN, ctx);
+    return;
+}
+
+static void
+replay_timer_event (int timer_id, void *ctx)
+{
+    event_loop_stop();
+    return;
+}
+
+static void
+update_replay_scr (void)
+{
+    flush_line_buffer_to_scr();
+    tty_flush();
+    return;
+}
+
+static void
+wait_replay_rec (replay_ctx_t *ctx_p, uint64_t rec_us)
+{
+    uint64_t due_us, now_us;
+    int timer_id;
+
+    if (rec_us < ctx_p->base_rec_us) {
+        return;
+    }
+    due_us = ctx_p->start_us + (rec_us - ctx_p->base_rec_us)/ctx_p->speed;
+    now_us = get_now_us();
+    if (now_us >= due_us) {
+        return;
+    }
+
+    //rounded up, the record is never shown early
+    timer_id = event_add_timer((due_us - now_us + 999)/1000, FALSE,
+                               replay_timer_event, ctx_p);
+    if (timer_id == -1) {
+        return;
+    }
+
+    ctx_p->skipped = FALSE;
+    if (event_loop_run(update_replay_scr) == -1) {
+        ctx_p->skipped = TRUE;
+        ctx_p->stop = TRUE;
+    }
+    if (!ctx_p->skipped) {
+        return;
+    }
+
+    //skipped, the pace carries on from this record
+    event_del_timer(timer_id);
+    ctx_p->base_rec_us = rec_us;
+    ctx_p->start_us = get_now_us();
+    return;
+}
+
+static void
+run_replay (replay_ctx_t *ctx_p)
+{
+    session_rec_t *rec_p;
+    char *data;
+    bool first = TRUE;
+
+    ctx_p->host = "";
+    while (!ctx_p->stop && session_rec_next(&ctx_p->reader, &rec_p, &data)) {
+        //each run plays from its own start, not after the gap between runs
+        if (first || rec_p->type == SESSION_REC_START) {
+            ctx_p->base_rec_us = rec_p->time_us;
+            ctx_p->start_us = get_now_us();
+            first = FALSE;
+        }
+        if (ctx_p->speed != REPLAY_SPEED_NO_WAIT) {
+            wait_replay_rec(ctx_p, rec_p->time_us);
+            if (ctx_p->stop) {
+                break;
+            }
+        }
+        render_replay_rec(ctx_p, rec_p, data);
+    }
+
+    return;
+}
+
+//the end stays on screen for scrolling until q
+static void
+wait_replay_quit (replay_ctx_t *ctx_p)
+{
+    printv("%% End of replay, q to quit");
+    do {
+        ctx_p->stop = FALSE;
+        if (event_loop_run(update_replay_scr) == -1) {
+            break;
+        }
+    } while (!ctx_p->stop);
+
+    return;
+}
+
+//"max" or <1-REPLAY_SPEED_MAX>
+static int
+parse_replay_speed (char *str, uint32_t *speed_p)
+{
+    char *end;
+    long speed;
+
+    if (strcmp(str, "max") == 0) {
+        *speed_p = REPLAY_SPEED_NO_WAIT;
+        return 0;
+    }
+
+    speed = strtol(str, &end, 10);
+    if (*end != '\0' || speed < 1 || speed > REPLAY_SPEED_MAX) {
+        return -1;
+    }
+    *speed_p = speed;
+    return 0;
+}
+
+//[file] [speed], a lone argument not a speed is the file
+static int
+parse_replay_args (replay_ctx_t *ctx_p, int argc, char *argv[], char **name_p)
+{
+    *name_p = SESSION_REC_NAME_DEFAULT;
+    ctx_p->speed = 1;
+
+    switch (argc) {
+    case 0:
+        return 0;
+
+    case 1:
+        if (parse_replay_speed(argv[0], &ctx_p->speed) == -1) {
+            *name_p = argv[0];
+        }
+        return 0;
+
+    case 2:
+        *name_p = argv[0];
+        return parse_replay_speed(argv[1], &ctx_p->speed);
+
+    default:
+        return -1;
+    }
+}
+
+static int
+add_replay_events (replay_ctx_t *ctx_p)
+{
+    int rc;
+
+    rc = event_loop_init();
+    if (rc == -1) {
+        return -1;
+    }
+
+    rc = event_add_fd(STDIN_FILENO, EPOLLIN, replay_input_event, ctx_p);
+    if (rc == -1) {
+        return -1;
+    }
+
+    return event_add_signal(SIGWINCH, replay_resize_event, ctx_p);
+}
+
+int
+gvd_replay_main (int argc, char *argv[])
+{
+    replay_ctx_t *ctx_p;
+    char *name;
+    int rc;
+
+    ctx_p = calloc(1, sizeof(replay_ctx_t));
+    if (!ctx_p) {
+        return -1;
+    }
+
+    rc = parse_replay_args(ctx_p, argc, argv, &name);
+    if (rc == -1) {
+        print_replay_usage();
+        free(ctx_p);
+        return -1;
+    }
+
+    rc = session_rec_open(name, &ctx_p->reader);
+    if (rc == -1) {
+        printf("Can't read recording %s.\n", name);
+        free(ctx_p);
+        return -1;
+    }
+
+    //replay leaves the console logfile alone
+    line_buffer_set_log_name(NULL);
+    rc = line_buffer_init();
+    if (rc == -1) {
+        session_rec_close(&ctx_p->reader);
+        free(ctx_p);
+        return -1;
+    }
+
+    rc = add_replay_events(ctx_p);
+    if (rc == -1) {
+        event_loop_clean();
+        line_buffer_clean();
+        session_rec_close(&ctx_p->reader);
+        free(ctx_p);
+        return -1;
+    }
+
+    run_replay(ctx_p);
+    if (!ctx_p->stop) {
+        wait_replay_quit(ctx_p);
+    }
+
+    event_loop_clean();
+    line_buffer_clean();
+    session_rec_close(&ctx_p->reader);
+    free(ctx_p);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef __GVD_REPLAY_H__
+#define __GVD_REPLAY_H__
+
+int
+gvd_replay_main(int argc, char *argv[]);
+#endif //__GVD_REPLAY_H__
@@ -0,0 +1,474 @@
+/*
+ * gvd_session_rec.c
+ *
+ * Session recording. Command lines, their output and mode changes of all
+ * VTYs are appended to one file as length-prefixed records, see
+ * session_rec_t. Records are collected in a write buffer, which goes to
+ * disk when full or when a command comes in, so recording costs a copy
+ * and a write per command. The file is read back through mmap.
+ *
+ * A start appends to the file, after its last whole record, so the run
+ * before a restart is kept. Once the file grows past the rotate size it
+ * is renamed to name.1, older ones move up to name.2 and so on, the
+ * oldest beyond the keep count removed. The next command starts a new
+ * file, with its own start record.
+ */
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gvd_util.h"
+#include "gvd_session_rec.h"
+
+//! bytes of records kept before written
+#define SESSION_REC_WBUF_SIZE (256*1024)
+//! records start at this alignment
+#define SESSION_REC_ALIGN 8
+
+typedef struct session_rec_writer_s {
+    pthread_mutex_t lock;
+    int fd;
+    char *wbuf;
+    uint32_t wbuf_len;
+    char host_name[SESSION_REC_NAME_MAX_LEN+1];
+    session_rec_stats_t stats;
+} session_rec_writer_t;
+
+static session_rec_writer_t session_rec = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1,
+    .stats = {
+        .rotate_size = SESSION_REC_ROTATE_SIZE_DEFAULT,
+        .rotate_keep = SESSION_REC_ROTATE_KEEP_DEFAULT,
+    },
+};
+
+static char session_rec_pad[SESSION_REC_ALIGN];
+
+static uint64_t
+get_real_us (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static uint32_t
+get_pad_len (uint32_t len)
+{
+    return (SESSION_REC_ALIGN - (len % SESSION_REC_ALIGN)) % SESSION_REC_ALIGN;
+}
+
+//a failed record is dropped
+static void
+write_session_rec (struct iovec *iov, int iov_cnt)
+{
+    ssize_t n;
+
+    n = gvd_write_all(session_rec.fd, iov, iov_cnt, GVD_WRITE_AT_POS);
+    if (n == -1) {
+        session_rec.stats.write_errors++;
+        return;
+    }
+    session_rec.stats.writes++;
+    session_rec.stats.file_size += n;
+    return;
+}
+
+static void
+flush_session_wbuf (void)
+{
+    struct iovec iov;
+
+    if (session_rec.wbuf_len == 0) {
+        return;
+    }
+
+    iov.iov_base = session_rec.wbuf;
+    iov.iov_len = session_rec.wbuf_len;
+    write_session_rec(&iov, 1);
+    session_rec.wbuf_len = 0;
+    return;
+}
+
+//record too big for the write buffer goes out by itself
+static void
+write_big_session_rec (session_rec_t *rec_p, char *data)
+{
+    struct iovec iov[3];
+
+    flush_session_wbuf();
+
+    iov[0].iov_base = rec_p;
+    iov[0].iov_len = sizeof(session_rec_t);
+    iov[1].iov_base = data;
+    iov[1].iov_len = rec_p->len;
+    iov[2].iov_base = session_rec_pad;
+    iov[2].iov_len = get_pad_len(rec_p->len);
+    write_session_rec(iov, 3);
+    return;
+}
+
+static void
+add_session_rec (uint32_t type, uint32_t vty_id, char *data, uint32_t len)
+{
+    session_rec_t rec;
+    uint32_t need;
+
+    memset(&rec, 0, sizeof(session_rec_t));
+    rec.len = len;
+    rec.type = type;
+    rec.time_us = get_real_us();
+    rec.vty_id = vty_id;
+
+    need = sizeof(session_rec_t) + len + get_pad_len(len);
+    if (need > SESSION_REC_WBUF_SIZE) {
+        write_big_session_rec(&rec, data);
+    } else {
+        if (session_rec.wbuf_len + need > SESSION_REC_WBUF_SIZE) {
+            flush_session_wbuf();
+        }
+        memcpy(session_rec.wbuf + session_rec.wbuf_len, &rec,
+               sizeof(session_rec_t));
+        memcpy(session_rec.wbuf + session_rec.wbuf_len +
+               sizeof(session_rec_t), data, len);
+        memset(session_rec.wbuf + session_rec.wbuf_len +
+               sizeof(session_rec_t) + len, 0, get_pad_len(len));
+        session_rec.wbuf_len += need;
+    }
+    session_rec.stats.records++;
+    session_rec.stats.bytes += need;
+
+    //output of the last command goes to disk as the next one starts
+    if (type == SESSION_REC_INPUT) {
+        flush_session_wbuf();
+    }
+    return;
+}
+
+static void
+write_session_rec_hdr (void)
+{
+    session_rec_file_hdr_t hdr;
+    struct iovec iov;
+
+    memset(&hdr, 0, sizeof(session_rec_file_hdr_t));
+    memcpy(hdr.magic, SESSION_REC_MAGIC, sizeof(SESSION_REC_MAGIC));
+    hdr.version = SESSION_REC_VERSION;
+    iov.iov_base = &hdr;
+    iov.iov_len = sizeof(session_rec_file_hdr_t);
+    write_session_rec(&iov, 1);
+    session_rec.stats.bytes += sizeof(session_rec_file_hdr_t);
+    return;
+}
+
+static void
+get_rotated_session_rec_name (uint32_t no, char *buf, uint32_t len)
+{
+    snprintf(buf, len, "%s.%u", session_rec.stats.name, no);
+    return;
+}
+
+//name.1 is the newest, the one past keep is overwritten
+static void
+shift_rotated_session_recs (void)
+{
+    char old_name[SESSION_REC_NAME_MAX_LEN+16];
+    char new_name[SESSION_REC_NAME_MAX_LEN+16];
+    uint32_t no;
+
+    get_rotated_session_rec_name(session_rec.stats.rotate_keep, old_name,
+                                 sizeof(old_name));
+    unlink(old_name);
+    for (no = session_rec.stats.rotate_keep; no > 1; no--) {
+        get_rotated_session_rec_name(no - 1, old_name, sizeof(old_name));
+        get_rotated_session_rec_name(no, new_name, sizeof(new_name));
+        rename(old_name, new_name);
+    }
+    get_rotated_session_rec_name(1, new_name, sizeof(new_name));
+    rename(session_rec.stats.name, new_name);
+    return;
+}
+
+//called with lock held, recording stops if the new file can't be opened
+static void
+rotate_session_rec (void)
+{
+    flush_session_wbuf();
+    close(session_rec.fd);
+    shift_rotated_session_recs();
+    session_rec.stats.rotations++;
+    session_rec.stats.file_size = 0;
+
+    session_rec.fd = open(session_rec.stats.name,
+                          O_CREAT|O_WRONLY|O_TRUNC|O_APPEND, 0666);
+    if (session_rec.fd == -1) {
+        free(session_rec.wbuf);
+        session_rec.wbuf = NULL;
+        session_rec.stats.running = FALSE;
+        return;
+    }
+
+    write_session_rec_hdr();
+    add_session_rec(SESSION_REC_START, 0, session_rec.host_name,
+                    strlen(session_rec.host_name));
+    return;
+}
+
+/*
+ * A command and its output are kept in one file, rotation waits for the
+ * next command, unless one command alone writes twice the rotate size.
+ */
+static bool
+is_session_rec_rotate_due (uint32_t type)
+{
+    uint64_t size = session_rec.stats.rotate_size;
+    uint64_t used = session_rec.stats.file_size + session_rec.wbuf_len;
+
+    if (size == 0 || used < size) {
+        return FALSE;
+    }
+    return (type == SESSION_REC_INPUT || used >= 2*size);
+}
+
+void
+session_rec_append (uint32_t type, uint32_t vty_id, char *data, uint32_t len)
+{
+    pthread_mutex_lock(&session_rec.lock);
+    if (session_rec.stats.running && is_session_rec_rotate_due(type)) {
+        rotate_session_rec();
+    }
+    if (session_rec.stats.running) {
+        add_session_rec(type, vty_id, data, len);
+    }
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+void
+session_rec_flush (void)
+{
+    pthread_mutex_lock(&session_rec.lock);
+    if (session_rec.stats.running) {
+        flush_session_wbuf();
+    }
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+static void
+stop_session_rec (void)
+{
+    if (!session_rec.stats.running) {
+        return;
+    }
+
+    flush_session_wbuf();
+    close(session_rec.fd);
+    free(session_rec.wbuf);
+    session_rec.fd = -1;
+    session_rec.wbuf = NULL;
+    session_rec.stats.running = FALSE;
+    return;
+}
+
+void
+session_rec_stop (void)
+{
+    pthread_mutex_lock(&session_rec.lock);
+    stop_session_rec();
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+//end of the last whole record, 0 if the file is no recording
+static uint64_t
+find_session_rec_end (char *file_name)
+{
+    session_rec_reader_t reader;
+    session_rec_t *rec_p;
+    uint64_t end;
+    char *data;
+
+    if (session_rec_open(file_name, &reader) == -1) {
+        return 0;
+    }
+
+    //a record cut short by a crash is written over
+    end = reader.off;
+    while (session_rec_next(&reader, &rec_p, &data) &&
+           (reader.off % SESSION_REC_ALIGN) == 0) {
+        end = reader.off;
+    }
+
+    session_rec_close(&reader);
+    return end;
+}
+
+//records are added after the last run's, with a start record first
+int
+session_rec_start (char *file_name)
+{
+    uint64_t end;
+
+    pthread_mutex_lock(&session_rec.lock);
+    stop_session_rec();
+
+    session_rec.wbuf = malloc(SESSION_REC_WBUF_SIZE);
+    if (!session_rec.wbuf) {
+        pthread_mutex_unlock(&session_rec.lock);
+        return -1;
+    }
+
+    end = find_session_rec_end(file_name);
+    session_rec.fd = open(file_name, O_CREAT|O_WRONLY|O_APPEND, 0666);
+    if (session_rec.fd == -1 || ftruncate(session_rec.fd, end) == -1) {
+        if (session_rec.fd != -1) {
+            close(session_rec.fd);
+            session_rec.fd = -1;
+        }
+        free(session_rec.wbuf);
+        session_rec.wbuf = NULL;
+        pthread_mutex_unlock(&session_rec.lock);
+        return -1;
+    }
+
+    session_rec.stats.records = 0;
+    session_rec.stats.bytes = 0;
+    session_rec.stats.writes = 0;
+    session_rec.stats.write_errors = 0;
+    session_rec.stats.rotations = 0;
+    session_rec.stats.file_size = end;
+    safe_strncpy(session_rec.stats.name, file_name, SESSION_REC_NAME_MAX_LEN);
+    session_rec.stats.running = TRUE;
+    session_rec.wbuf_len = 0;
+
+    if (end == 0) {
+        write_session_rec_hdr();
+    }
+
+    memset(session_rec.host_name, 0, sizeof(session_rec.host_name));
+    gethostname(session_rec.host_name, SESSION_REC_NAME_MAX_LEN);
+    add_session_rec(SESSION_REC_START, 0, session_rec.host_name,
+                    strlen(session_rec.host_name));
+    pthread_mutex_unlock(&session_rec.lock);
+    return 0;
+}
+
+//0 for no rotation, the file grows without bound
+void
+session_rec_set_rotate_size (uint64_t size)
+{
+    pthread_mutex_lock(&session_rec.lock);
+    session_rec.stats.rotate_size = size;
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+//rotated files beyond keep are removed at the next rotation
+void
+session_rec_set_rotate_keep (uint32_t keep)
+{
+    if (keep > SESSION_REC_ROTATE_KEEP_MAX) {
+        keep = SESSION_REC_ROTATE_KEEP_MAX;
+    }
+
+    pthread_mutex_lock(&session_rec.lock);
+    session_rec.stats.rotate_keep = keep;
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+void
+session_rec_get_stats (session_rec_stats_t *stats_p)
+{
+    pthread_mutex_lock(&session_rec.lock);
+    memcpy(stats_p, &session_rec.stats, sizeof(session_rec_stats_t));
+    pthread_mutex_unlock(&session_rec.lock);
+    return;
+}
+
+int
+session_rec_open (char *file_name, session_rec_reader_t *reader_p)
+{
+    session_rec_file_hdr_t *hdr_p;
+    struct stat st;
+    int fd;
+
+    memset(reader_p, 0, sizeof(session_rec_reader_t));
+
+    fd = open(file_name, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) == -1 ||
+        st.st_size < (off_t)sizeof(session_rec_file_hdr_t)) {
+        close(fd);
+        return -1;
+    }
+
+    reader_p->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (reader_p->map == MAP_FAILED) {
+        reader_p->map = NULL;
+        return -1;
+    }
+    reader_p->size = st.st_size;
+
+    hdr_p = (session_rec_file_hdr_t *)reader_p->map;
+    if (memcmp(hdr_p->magic, SESSION_REC_MAGIC, sizeof(SESSION_REC_MAGIC)) ||
+        hdr_p->version != SESSION_REC_VERSION) {
+        session_rec_close(reader_p);
+        return -1;
+    }
+
+    reader_p->off = sizeof(session_rec_file_hdr_t);
+    return 0;
+}
+
+//FALSE at the end, a record cut short by a crash ends it too
+bool
+session_rec_next (session_rec_reader_t *reader_p, session_rec_t **rec_pp,
+                  char **payload_p)
+{
+    session_rec_t *rec_p;
+    size_t left;
+
+    left = reader_p->size - reader_p->off;
+    if (left < sizeof(session_rec_t)) {
+        return FALSE;
+    }
+
+    rec_p = (session_rec_t *)(reader_p->map + reader_p->off);
+    if (rec_p->len > left - sizeof(session_rec_t)) {
+        return FALSE;
+    }
+
+    *rec_pp = rec_p;
+    *payload_p = (char *)(rec_p + 1);
+    reader_p->off += sizeof(session_rec_t) + rec_p->len;
+    reader_p->off += get_pad_len(rec_p->len);
+    if (reader_p->off > reader_p->size) {
+        reader_p->off = reader_p->size;
+    }
+    return TRUE;
+}
+
+void
+session_rec_close (session_rec_reader_t *reader_p)
+{
+    if (reader_p->map) {
+        munmap(reader_p->map, reader_p->size);
+    }
+    memset(reader_p, 0, sizeof(session_rec_reader_t));
+    return;
+}
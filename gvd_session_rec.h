@@ -0,0 +1,96 @@
+#ifndef __GVD_SESSION_REC_H__
+#define __GVD_SESSION_REC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SESSION_REC_NAME_MAX_LEN 255
+#define SESSION_REC_NAME_DEFAULT "./.console_session"
+#define SESSION_REC_MAGIC "GVDSREC"
+#define SESSION_REC_VERSION 1
+//! default size the recording rotates at
+#define SESSION_REC_ROTATE_SIZE_DEFAULT (16ULL*1024*1024)
+//! default rotated recordings kept, name.1 is the newest
+#define SESSION_REC_ROTATE_KEEP_DEFAULT 4
+//! max rotated recordings kept
+#define SESSION_REC_ROTATE_KEEP_MAX 64
+
+enum {
+    //payload is the host name
+    SESSION_REC_START = 1,
+    //command line as typed
+    SESSION_REC_INPUT,
+    //command output as shown
+    SESSION_REC_OUTPUT,
+    //mode string after the change, empty for exec mode
+    SESSION_REC_MODE,
+};
+
+typedef struct session_rec_file_hdr_s {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} session_rec_file_hdr_t;
+
+//payload follows, next record starts 8 byte aligned
+typedef struct session_rec_s {
+    uint32_t len;
+    uint32_t type;
+    //wall clock
+    uint64_t time_us;
+    uint32_t vty_id;
+    uint32_t reserved;
+} session_rec_t;
+
+typedef struct session_rec_stats_s {
+    bool running;
+    char name[SESSION_REC_NAME_MAX_LEN+1];
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t writes;
+    uint64_t write_errors;
+    //size of the file being written
+    uint64_t file_size;
+    uint64_t rotate_size;
+    uint32_t rotate_keep;
+    uint64_t rotations;
+} session_rec_stats_t;
+
+typedef struct session_rec_reader_s {
+    char *map;
+    size_t size;
+    size_t off;
+} session_rec_reader_t;
+
+int
+session_rec_start(char *file_name);
+
+void
+session_rec_stop(void);
+
+void
+session_rec_append(uint32_t type, uint32_t vty_id, char *data, uint32_t len);
+
+void
+session_rec_flush(void);
+
+void
+session_rec_get_stats(session_rec_stats_t *stats_p);
+
+void
+session_rec_set_rotate_size(uint64_t size);
+
+void
+session_rec_set_rotate_keep(uint32_t keep);
+
+int
+session_rec_open(char *file_name, session_rec_reader_t *reader_p);
+
+bool
+session_rec_next(session_rec_reader_t *reader_p, session_rec_t **rec_pp,
+                 char **payload_p);
+
+void
+session_rec_close(session_rec_reader_t *reader_p);
+#endif //__GVD_SESSION_REC_H__
@@ -1,9 +1,12 @@
+#include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 #include "gvd_tty.h"
 #include "gvd_util.h"
+#include "gvd_session_rec.h"
 
 typedef struct tty_ctrl_s {
     struct tty_ctrl_s *next;
@@ -14,6 +17,8 @@ typedef struct tty_ctrl_s {
 static pthread_mutex_t tty_ctrl_mutex;
 static tty_ctrl_t *tty_ctrl_head = NULL;
 static uint32_t next_tty_id = 1000;
+//bumped when the system host name may have changed
+static uint32_t host_name_gen = 0;
 
 extern gvd_tty_t gvd_tty;
 
@@ -25,12 +30,87 @@ insert_tty_ctrl (tty_ctrl_t *tty_ctrl_p)
     return;
 }
 
+/*
+ * Prompt of a VTY, "host(mode)#". It's kept in the VTY as it's asked for
+ * several times per key, and made again only when the mode or host name
+ * changes.
+ */
 static void
-init_tty (gvd_tty_t *tty_p)
+make_tty_ps (gvd_tty_t *tty_p)
+{
+    char host_name[GVD_HOST_NAME_MAX_LEN+1];
+    char *cli_mode_str;
+    uint32_t len;
+
+    if (tty_p->host_name[0]) {
+        safe_strncpy(host_name, tty_p->host_name, GVD_HOST_NAME_MAX_LEN);
+    } else {
+        memset(host_name, 0, sizeof(host_name));
+        gethostname(host_name, GVD_HOST_NAME_MAX_LEN);
+    }
+
+    cli_mode_str = tty_p->cli_mode_p->mode_string;
+    //two bytes reserved for "#"
+    if (*cli_mode_str) {
+        snprintf(tty_p->ps, GVD_PS_MAX_LEN, "%s(%s)", host_name, cli_mode_str);
+    } else {
+        snprintf(tty_p->ps, GVD_PS_MAX_LEN, "%s", host_name);
+    }
+
+    len = strlen(tty_p->ps);
+    tty_p->ps[len++] = '#';
+    tty_p->ps[len] = '\0';
+    tty_p->ps_len = len;
+    tty_p->ps_host_gen = host_name_gen;
+    return;
+}
+
+char *
+gvd_tty_get_ps (gvd_tty_t *tty_p, uint32_t *len_p)
+{
+    if (tty_p->ps_host_gen != host_name_gen) {
+        make_tty_ps(tty_p);
+    }
+
+    if (len_p) {
+        *len_p = tty_p->ps_len;
+    }
+    return tty_p->ps;
+}
+
+//NULL or empty goes back to the system host name
+void
+gvd_tty_set_host_name (gvd_tty_t *tty_p, char *host_name)
+{
+    memset(tty_p->host_name, 0, sizeof(tty_p->host_name));
+    if (host_name) {
+        safe_strncpy(tty_p->host_name, host_name, GVD_HOST_NAME_MAX_LEN);
+    }
+    make_tty_ps(tty_p);
+    return;
+}
+
+//prompts showing the system host name are made again when next asked for
+void
+gvd_tty_host_name_changed (void)
+{
+    host_name_gen++;
+    return;
+}
+
+static void
+init_tty (gvd_tty_t *tty_p, uint32_t vty_id)
 {
     memset(&tty_p->cpi, 0, sizeof(cli_parser_info_t));
+    tty_p->vty_id = vty_id;
     tty_p->cli_mode_p = gvd_get_exec_cli_mode();
     tty_p->cpi.tty_p = tty_p;
+    tty_p->cmd_timeout = GVD_CMD_TIMEOUT_DEFAULT;
+    tty_p->cmd_max_len = CMD_MAX_LEN;
+    tty_p->term_len = GVD_TERM_LEN_AUTO;
+    tty_p->scr_len = 0;
+    tty_p->history_p = cmd_history_create(CMD_HISTORY_DEPTH_DEFAULT);
+    gvd_tty_set_host_name(tty_p, NULL);
     return;
 }
 
@@ -45,7 +125,7 @@ create_tty (void)
     }
 
     tty_ctrl_p->tty_id = (next_tty_id++);
-    init_tty(&tty_ctrl_p->tty);
+    init_tty(&tty_ctrl_p->tty, tty_ctrl_p->tty_id);
 
     insert_tty_ctrl(tty_ctrl_p);
 
@@ -88,6 +168,7 @@ remove_tty_ctrl (uint32_t tty_id)
         prev_tty_ctrl_p->next = cur_tty_ctrl_p->next;
     }
 
+    cmd_history_destroy(cur_tty_ctrl_p->tty.history_p);
     free(cur_tty_ctrl_p);
     return;
 }
@@ -144,6 +225,16 @@ gvd_tty_run_cli (uint32_t tty_id, char *cli)
     return output;
 }
 
+static void
+record_cli_mode (gvd_tty_t *tty_p)
+{
+    char *mode_str = tty_p->cli_mode_p->mode_string;
+
+    session_rec_append(SESSION_REC_MODE, tty_p->vty_id, mode_str,
+                       strlen(mode_str));
+    return;
+}
+
 void
 gvd_enter_lower_cli_mode (gvd_tty_t *tty_p, int mode)
 {
@@ -155,6 +246,8 @@ gvd_enter_lower_cli_mode (gvd_tty_t *tty_p, int mode)
     }
 
     tty_p->cli_mode_p = cli_mode_p;
+    make_tty_ps(tty_p);
+    record_cli_mode(tty_p);
     return;
 }
 
@@ -163,6 +256,8 @@ gvd_return_upper_cli_mode (gvd_tty_t *tty_p)
 {
     if (tty_p->cli_mode_p->parent_p) {
         tty_p->cli_mode_p = tty_p->cli_mode_p->parent_p;
+        make_tty_ps(tty_p);
+        record_cli_mode(tty_p);
     }
     return;
 }
@@ -170,14 +265,18 @@ gvd_return_upper_cli_mode (gvd_tty_t *tty_p)
 void
 gvd_return_exec_cli_mode (gvd_tty_t *tty_p)
 {
-    tty_p->cli_mode_p = gvd_get_exec_cli_mode();
+    if (tty_p->cli_mode_p != gvd_get_exec_cli_mode()) {
+        tty_p->cli_mode_p = gvd_get_exec_cli_mode();
+        make_tty_ps(tty_p);
+        record_cli_mode(tty_p);
+    }
     return;
 }
 
 void
 gvd_tty_init_database (void)
 {
-    init_tty(&gvd_tty);
+    init_tty(&gvd_tty, GVD_CONSOLE_VTY_ID);
     (void)pthread_mutex_init(&tty_ctrl_mutex, NULL);
     return;
 }
@@ -4,12 +4,41 @@
 #include <stdint.h>
 #include "gvd_cli_tree.h"
 #include "gvd_cli_parser.h"
+#include "gvd_cmd_history.h"
 
 #define GVD_INVALID_VTY_ID 0
+//! the local console, created VTYs count from 1000
+#define GVD_CONSOLE_VTY_ID 1
+
+//! per command watchdog in seconds, 0 for no timeout
+#define GVD_CMD_TIMEOUT_DEFAULT 0
+
+//! page length follows the screen size
+#define GVD_TERM_LEN_AUTO -1
+
+//! longest host name shown in the prompt
+#define GVD_HOST_NAME_MAX_LEN 15
+#define GVD_PS_MAX_LEN 63
 
 typedef struct gvd_tty_s {
+    uint32_t vty_id;
     cli_mode_t *cli_mode_p;
     cli_parser_info_t cpi;
+    uint32_t cmd_timeout;
+    //longer commands are refused
+    uint32_t cmd_max_len;
+    //lines per page, 0 for no paging, or GVD_TERM_LEN_AUTO
+    int term_len;
+    //screen lines, 0 if there is no screen
+    uint32_t scr_len;
+    //set by terminal hostname, empty to show the system host name
+    char host_name[GVD_HOST_NAME_MAX_LEN+1];
+    //prompt, made again on mode or host name change
+    char ps[GVD_PS_MAX_LEN+1];
+    uint32_t ps_len;
+    uint32_t ps_host_gen;
+    //commands run, NULL if it could not be made
+    cmd_history_t *history_p;
 } gvd_tty_t;
 
 void
@@ -21,6 +50,15 @@ gvd_return_upper_cli_mode(gvd_tty_t *tty_p);
 void
 gvd_return_exec_cli_mode(gvd_tty_t *tty_p);
 
+char *
+gvd_tty_get_ps(gvd_tty_t *tty_p, uint32_t *len_p);
+
+void
+gvd_tty_set_host_name(gvd_tty_t *tty_p, char *host_name);
+
+void
+gvd_tty_host_name_changed(void);
+
 uint32_t
 gvd_create_tty(void);
 
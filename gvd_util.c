@@ -1,6 +1,14 @@
+#include <stdio.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "gvd_util.h"
 
 #define min(a,b) ((a)<(b)?(a):(b))
 
@@ -42,3 +50,142 @@ safe_clone (const char *src, uint32_t len)
     return buf;
 }
 
+
+//"hh:mm" or "hh:mm:ss" of today in local time
+int
+parse_clock_time (char *str, time_t *time_p)
+{
+    int hour, min, sec = 0, len = 0, sec_len = 0;
+
+    if (sscanf(str, "%d:%d%n", &hour, &min, &len) != 2) {
+        return -1;
+    }
+    if (str[len] == ':') {
+        if (sscanf(str+len, ":%d%n", &sec, &sec_len) != 1) {
+            return -1;
+        }
+        len += sec_len;
+    }
+    if (str[len] != '\0') {
+        return -1;
+    }
+    if (hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 59) {
+        return -1;
+    }
+
+    *time_p = get_today_time(hour, min, sec);
+    return 0;
+}
+
+//hour:min:sec of today in local time
+time_t
+get_today_time (int hour, int min, int sec)
+{
+    struct tm tm;
+    time_t now;
+
+    now = time(NULL);
+    localtime_r(&now, &tm);
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+//first and last byte of needle are checked 16 positions at a time, only
+//positions matching both are compared in full
+char *
+gvd_memmem (const char *hay, size_t hay_len, const char *needle,
+            size_t needle_len)
+{
+    size_t i = 0, last;
+    const char *p;
+
+    if (needle_len == 0) {
+        return (char *)hay;
+    }
+    if (hay_len < needle_len) {
+        return NULL;
+    }
+    if (needle_len == 1) {
+        return memchr(hay, needle[0], hay_len);
+    }
+
+    last = needle_len - 1;
+
+#ifdef __SSE2__
+    {
+        __m128i first_v, last_v, block_first, block_last;
+        uint32_t mask, bit;
+
+        first_v = _mm_set1_epi8(needle[0]);
+        last_v = _mm_set1_epi8(needle[last]);
+
+        for (; i + last + 16 <= hay_len; i += 16) {
+            block_first = _mm_loadu_si128((const __m128i *)(hay+i));
+            block_last = _mm_loadu_si128((const __m128i *)(hay+i+last));
+            mask = _mm_movemask_epi8(
+                       _mm_and_si128(_mm_cmpeq_epi8(first_v, block_first),
+                                     _mm_cmpeq_epi8(last_v, block_last)));
+            while (mask) {
+                bit = __builtin_ctz(mask);
+                if (memcmp(hay+i+bit+1, needle+1, needle_len-2) == 0) {
+                    return (char *)(hay+i+bit);
+                }
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    while (i + needle_len <= hay_len) {
+        p = memchr(hay+i, needle[0], hay_len-needle_len+1-i);
+        if (!p) {
+            return NULL;
+        }
+        i = p - hay;
+        if (hay[i+last] == needle[last] &&
+            memcmp(hay+i+1, needle+1, needle_len-2) == 0) {
+            return (char *)(hay+i);
+        }
+        i++;
+    }
+
+    return NULL;
+}
+
+//EINTR and short writes are retried, iov is used up on the way. Bytes
+//written, -1 on error
+ssize_t
+gvd_write_all (int fd, struct iovec *iov, int iov_cnt, off_t off)
+{
+    ssize_t n, done = 0;
+
+    while (iov_cnt > 0) {
+        if (off == GVD_WRITE_AT_POS) {
+            n = writev(fd, iov, iov_cnt);
+        } else {
+            n = pwritev(fd, iov, iov_cnt, off + done);
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += n;
+
+        while (iov_cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iov_cnt--;
+        }
+        if (iov_cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return done;
+}
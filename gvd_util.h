@@ -1,7 +1,11 @@
 #ifndef __GVD_UTIL_H__
 #define __GVD_UTIL_H__
 
+#include <time.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
+#include <sys/types.h>
 
 #ifndef TRUE
     #define TRUE true
@@ -11,10 +15,17 @@
     #define FALSE false
 #endif
 
-#define CMD_MAX_LEN 255
+//! longest command by default, terminal command-length sets it per VTY
+#define CMD_MAX_LEN 4096
+//! range of terminal command-length, a command stays one scrollback line
+#define CMD_MAX_LEN_MIN 256
+#define CMD_MAX_LEN_LIMIT 8192
 
 #define ARRAY_LEN(a) (sizeof(a)/sizeof(a[0]))
 
+//! gvd_write_all() at the file position, not at an offset
+#define GVD_WRITE_AT_POS (-1)
+
 enum {
     PROCESS_CONTINUE = 0,
     PROCESS_SUBMODE_ERROR,
@@ -26,4 +37,17 @@ safe_strncpy(char *dst, const char *src, uint32_t len);
 
 char *
 safe_clone(const char *src, uint32_t len);
+
+int
+parse_clock_time(char *str, time_t *time_p);
+
+time_t
+get_today_time(int hour, int min, int sec);
+
+char *
+gvd_memmem(const char *hay, size_t hay_len, const char *needle,
+           size_t needle_len);
+
+ssize_t
+gvd_write_all(int fd, struct iovec *iov, int iov_cnt, off_t off);
 #endif //__GVD_UTIL_H__